@@ -0,0 +1,189 @@
+set(ScannedRealityPlayerNative_Sources
+  src/scan_studio/common/io/mapped_file_input_stream.cpp
+  src/scan_studio/common/io/mapped_file_input_stream.hpp
+  src/scan_studio/common/io/structured_io.hpp
+  src/scan_studio/common/slot_queue.hpp
+  src/scan_studio/common/xrvideo_file.cpp
+  src/scan_studio/common/xrvideo_file.hpp
+  
+  src/scan_studio/player_library/scannedreality_player.cpp
+  src/scan_studio/player_library/scannedreality_player.h
+  
+  src/scan_studio/viewer_common/xrvideo/compressed_frame_cache.cpp
+  src/scan_studio/viewer_common/xrvideo/compressed_frame_cache.hpp
+  src/scan_studio/viewer_common/xrvideo/dav1d_picture_pool.cpp
+  src/scan_studio/viewer_common/xrvideo/dav1d_picture_pool.hpp
+  src/scan_studio/viewer_common/xrvideo/decoded_frame_cache.hpp
+  src/scan_studio/viewer_common/xrvideo/decoding_thread.hpp
+  src/scan_studio/viewer_common/xrvideo/decompression_workers.cpp
+  src/scan_studio/viewer_common/xrvideo/decompression_workers.hpp
+  src/scan_studio/viewer_common/xrvideo/deformation_state_decoding.cpp
+  src/scan_studio/viewer_common/xrvideo/deformation_state_decoding.hpp
+  src/scan_studio/viewer_common/xrvideo/frame_loading.cpp
+  src/scan_studio/viewer_common/xrvideo/frame_loading.hpp
+  src/scan_studio/viewer_common/xrvideo/index.cpp
+  src/scan_studio/viewer_common/xrvideo/index.hpp
+  src/scan_studio/viewer_common/xrvideo/pipeline_statistics.hpp
+  src/scan_studio/viewer_common/xrvideo/playback_state.cpp
+  src/scan_studio/viewer_common/xrvideo/playback_state.hpp
+  src/scan_studio/viewer_common/xrvideo/reading_thread.hpp
+  src/scan_studio/viewer_common/xrvideo/rendition_set.cpp
+  src/scan_studio/viewer_common/xrvideo/rendition_set.hpp
+  src/scan_studio/viewer_common/xrvideo/transfer_thread.hpp
+  src/scan_studio/viewer_common/xrvideo/video_thread.cpp
+  src/scan_studio/viewer_common/xrvideo/video_thread.hpp
+  src/scan_studio/viewer_common/xrvideo/xrvideo.cpp
+  src/scan_studio/viewer_common/xrvideo/xrvideo.hpp
+  src/scan_studio/viewer_common/xrvideo/xrvideo_common_resources.hpp
+  src/scan_studio/viewer_common/xrvideo/xrvideo_executor.cpp
+  src/scan_studio/viewer_common/xrvideo/xrvideo_executor.hpp
+  src/scan_studio/viewer_common/xrvideo/xrvideo_memory_governor.cpp
+  src/scan_studio/viewer_common/xrvideo/xrvideo_memory_governor.hpp
+  src/scan_studio/viewer_common/xrvideo/xrvideo_frame.hpp
+  
+  src/scan_studio/viewer_common/xrvideo/external/external_xrvideo.cpp
+  src/scan_studio/viewer_common/xrvideo/external/external_xrvideo.hpp
+  src/scan_studio/viewer_common/xrvideo/external/external_xrvideo_frame.cpp
+  src/scan_studio/viewer_common/xrvideo/external/external_xrvideo_frame.hpp
+  
+  src/scan_studio/viewer_common/opengl/context.hpp  # only the abstract GLContext interface is used, the External path never creates a context
+  src/scan_studio/viewer_common/debug.hpp
+  src/scan_studio/viewer_common/http_request.hpp
+  src/scan_studio/viewer_common/streaming_bandwidth_estimator.cpp
+  src/scan_studio/viewer_common/streaming_bandwidth_estimator.hpp
+  src/scan_studio/viewer_common/streaming_disk_cache.cpp
+  src/scan_studio/viewer_common/streaming_disk_cache.hpp
+  src/scan_studio/viewer_common/streaming_input_stream.cpp
+  src/scan_studio/viewer_common/streaming_input_stream.hpp
+  src/scan_studio/viewer_common/timing.hpp
+  src/scan_studio/viewer_common/util.cpp
+  src/scan_studio/viewer_common/util.hpp
+)
+
+# Sanitizer builds, e.g., for running the tests with: cmake -DENABLE_NATIVE_ASAN=ON
+option(ENABLE_NATIVE_ASAN "Build the native player library and tests with AddressSanitizer" OFF)
+option(ENABLE_NATIVE_TSAN "Build the native player library and tests with ThreadSanitizer" OFF)
+option(ENABLE_NATIVE_USAN "Build the native player library and tests with UndefinedBehaviorSanitizer" OFF)
+
+set(ScannedRealityPlayerNative_Options
+  ${COMMON_OPTIONS}
+  $<$<COMPILE_LANGUAGE:CXX>:-DEIGEN_MPL2_ONLY>
+)
+set(ScannedRealityPlayerNative_LinkOptions "")
+if (ENABLE_NATIVE_ASAN)
+  set(ScannedRealityPlayerNative_Options ${ScannedRealityPlayerNative_Options} $<$<COMPILE_LANGUAGE:CXX>:-fsanitize=address> $<$<COMPILE_LANGUAGE:CXX>:-fno-omit-frame-pointer>)
+  set(ScannedRealityPlayerNative_LinkOptions ${ScannedRealityPlayerNative_LinkOptions} -fsanitize=address)
+endif()
+if (ENABLE_NATIVE_TSAN)
+  set(ScannedRealityPlayerNative_Options ${ScannedRealityPlayerNative_Options} $<$<COMPILE_LANGUAGE:CXX>:-fsanitize=thread>)
+  set(ScannedRealityPlayerNative_LinkOptions ${ScannedRealityPlayerNative_LinkOptions} -fsanitize=thread)
+endif()
+if (ENABLE_NATIVE_USAN)
+  set(ScannedRealityPlayerNative_Options ${ScannedRealityPlayerNative_Options} $<$<COMPILE_LANGUAGE:CXX>:-fsanitize=undefined>)
+  set(ScannedRealityPlayerNative_LinkOptions ${ScannedRealityPlayerNative_LinkOptions} -fsanitize=undefined)
+endif()
+
+set(ScannedRealityPlayerNative_IncludeDirectories
+  src
+  third_party
+  third_party/zstd/lib
+  third_party/libvis/src
+  third_party/libvis/third_party/eigen
+  third_party/libvis/third_party/sophus
+  third_party/dav1d/include
+  ${DAVID_BINARY_DIR}/include/dav1d  # for dav1d's version.h
+)
+
+find_package(Threads REQUIRED)
+
+set(ScannedRealityPlayerNative_Libraries
+  libvis_io
+  libzstd_static
+  loguru
+  ${DAVID_BINARY_DIR}/src/libdav1d.a
+  Threads::Threads
+)
+
+# Native player library (C API with the External render path only; no SDL, OpenGL, or emscripten) - static version
+add_library(scannedreality_player_static STATIC ${ScannedRealityPlayerNative_Sources})
+target_compile_options(scannedreality_player_static PUBLIC ${ScannedRealityPlayerNative_Options})
+target_link_options(scannedreality_player_static PUBLIC ${ScannedRealityPlayerNative_LinkOptions})
+target_include_directories(scannedreality_player_static PUBLIC ${ScannedRealityPlayerNative_IncludeDirectories})
+target_link_libraries(scannedreality_player_static PUBLIC ${ScannedRealityPlayerNative_Libraries})
+set_target_properties(scannedreality_player_static PROPERTIES POSITION_INDEPENDENT_CODE ON)
+add_dependencies(scannedreality_player_static dav1d)
+
+# Native player library - shared version (libscannedreality_player.so)
+add_library(scannedreality_player SHARED ${ScannedRealityPlayerNative_Sources})
+target_compile_options(scannedreality_player PRIVATE ${ScannedRealityPlayerNative_Options})
+target_link_options(scannedreality_player PRIVATE ${ScannedRealityPlayerNative_LinkOptions})
+target_include_directories(scannedreality_player PUBLIC ${ScannedRealityPlayerNative_IncludeDirectories})
+target_link_libraries(scannedreality_player PRIVATE ${ScannedRealityPlayerNative_Libraries})
+add_dependencies(scannedreality_player dav1d)
+
+
+# XRVideo writing and synthetic video generation, for reproducible decoding benchmarks without an AV.1 encoder
+add_library(scannedreality_xrvideo_tools STATIC
+  src/scan_studio/common/xrvideo_writer.cpp
+  src/scan_studio/common/xrvideo_writer.hpp
+  src/scan_studio/tools/synthetic_xrvideo.cpp
+  src/scan_studio/tools/synthetic_xrvideo.hpp
+)
+target_compile_options(scannedreality_xrvideo_tools PRIVATE ${ScannedRealityPlayerNative_Options})
+target_link_libraries(scannedreality_xrvideo_tools PUBLIC scannedreality_player_static)
+
+add_executable(xrvideo_synth
+  src/scan_studio/tools/xrvideo_synth/main.cpp
+)
+target_compile_options(xrvideo_synth PRIVATE ${ScannedRealityPlayerNative_Options})
+target_link_libraries(xrvideo_synth PRIVATE scannedreality_xrvideo_tools)
+
+# Headless playback benchmark
+add_executable(xrvideo_bench
+  src/scan_studio/tools/xrvideo_bench/main.cpp
+)
+target_compile_options(xrvideo_bench PRIVATE ${ScannedRealityPlayerNative_Options})
+target_link_libraries(xrvideo_bench PRIVATE scannedreality_xrvideo_tools)
+
+# Microbenchmarks for individual decoding kernels
+add_executable(xrvideo_microbench
+  src/scan_studio/tools/xrvideo_microbench/main.cpp
+  src/scan_studio/viewer_common/test/http_request_mock.cpp
+  src/scan_studio/viewer_common/test/http_request_mock.hpp
+)
+target_compile_options(xrvideo_microbench PRIVATE ${ScannedRealityPlayerNative_Options})
+target_link_libraries(xrvideo_microbench PRIVATE scannedreality_xrvideo_tools)
+
+
+# Native tests
+if (BUILD_TESTING)
+  find_package(GTest)
+  
+  if (GTest_FOUND)
+    add_executable(scannedreality_player_test
+      src/scan_studio/viewer_common/test/decoded_frame_cache_test.cpp
+      src/scan_studio/viewer_common/test/decoding_thread_test.cpp
+      src/scan_studio/viewer_common/test/dav1d_picture_pool_test.cpp
+      src/scan_studio/viewer_common/test/deformation_state_decoding_test.cpp
+      src/scan_studio/viewer_common/test/frame_loading_test.cpp
+      src/scan_studio/viewer_common/test/http_request_mock.cpp
+      src/scan_studio/viewer_common/test/http_request_mock.hpp
+      src/scan_studio/viewer_common/test/index_test.cpp
+      src/scan_studio/viewer_common/test/main.cpp
+      src/scan_studio/viewer_common/test/slot_queue_test.cpp
+      src/scan_studio/viewer_common/test/streaming_bandwidth_estimator_test.cpp
+      src/scan_studio/viewer_common/test/streaming_disk_cache_test.cpp
+      src/scan_studio/viewer_common/test/streaming_input_stream_test.cpp
+      src/scan_studio/viewer_common/test/temporary_path.hpp
+      src/scan_studio/viewer_common/test/xrvideo_buffering_test.cpp
+      src/scan_studio/viewer_common/test/xrvideo_memory_governor_test.cpp
+      src/scan_studio/viewer_common/test/xrvideo_rendition_set_test.cpp
+      src/scan_studio/viewer_common/test/xrvideo_writer_test.cpp
+    )
+    target_compile_options(scannedreality_player_test PRIVATE ${ScannedRealityPlayerNative_Options})
+    target_link_libraries(scannedreality_player_test PRIVATE scannedreality_xrvideo_tools GTest::GTest)
+    add_test(NAME scannedreality_player_test COMMAND scannedreality_player_test)
+  else()
+    message(WARNING "GTest was not found, the native tests will not be built.")
+  endif()
+endif()
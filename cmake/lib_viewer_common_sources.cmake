@@ -2,6 +2,9 @@ set(VIEWER_COMMON_SRC_PATH "${SCAN_STUDIO_ROOT_PATH}/src/scan_studio/viewer_comm
 
 set(VIEWER_COMMON_SOURCES
   # TODO: Put these into a library that both `common` and `viewer_common` depend on:
+  ${VIEWER_COMMON_SRC_PATH}/../common/io/mapped_file_input_stream.cpp
+  ${VIEWER_COMMON_SRC_PATH}/../common/io/mapped_file_input_stream.hpp
+  ${VIEWER_COMMON_SRC_PATH}/../common/slot_queue.hpp
   ${VIEWER_COMMON_SRC_PATH}/../common/xrvideo_file.cpp
   ${VIEWER_COMMON_SRC_PATH}/../common/xrvideo_file.hpp
   
@@ -59,23 +62,38 @@ set(VIEWER_COMMON_SOURCES
   ${VIEWER_COMMON_SRC_PATH}/openxr/swapchain.cpp
   ${VIEWER_COMMON_SRC_PATH}/openxr/swapchain.hpp
   
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/compressed_frame_cache.cpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/compressed_frame_cache.hpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/dav1d_picture_pool.cpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/dav1d_picture_pool.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/decoded_frame_cache.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/decoding_thread.hpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/decompression_workers.cpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/decompression_workers.hpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/deformation_state_decoding.cpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/deformation_state_decoding.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/frame_loading.cpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/frame_loading.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/frame_loading_webcodecs.cpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/frame_loading_webcodecs.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/index.cpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/index.hpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/pipeline_statistics.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/playback_state.cpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/playback_state.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/reading_thread.hpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/rendition_set.cpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/rendition_set.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/transfer_thread.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/video_thread.cpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/video_thread.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/xrvideo.cpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/xrvideo.hpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/xrvideo_common_resources.hpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/xrvideo_executor.cpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/xrvideo_executor.hpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/xrvideo_memory_governor.cpp
+  ${VIEWER_COMMON_SRC_PATH}/xrvideo/xrvideo_memory_governor.hpp
   
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/vulkan/vulkan_xrvideo.cpp
   ${VIEWER_COMMON_SRC_PATH}/xrvideo/vulkan/vulkan_xrvideo.hpp
@@ -103,6 +121,10 @@ set(VIEWER_COMMON_SOURCES
   ${VIEWER_COMMON_SRC_PATH}/license_texts.hpp
   ${VIEWER_COMMON_SRC_PATH}/render_state.cpp
   ${VIEWER_COMMON_SRC_PATH}/render_state.hpp
+  ${VIEWER_COMMON_SRC_PATH}/streaming_bandwidth_estimator.cpp
+  ${VIEWER_COMMON_SRC_PATH}/streaming_bandwidth_estimator.hpp
+  ${VIEWER_COMMON_SRC_PATH}/streaming_disk_cache.cpp
+  ${VIEWER_COMMON_SRC_PATH}/streaming_disk_cache.hpp
   ${VIEWER_COMMON_SRC_PATH}/streaming_input_stream.cpp
   ${VIEWER_COMMON_SRC_PATH}/streaming_input_stream.hpp
   ${VIEWER_COMMON_SRC_PATH}/timing.hpp
@@ -0,0 +1,131 @@
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+
+#include <cstring>
+
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+#include <loguru.hpp>
+
+namespace scan_studio {
+
+bool MappedFileInputStream::Open(const fs::path& path) {
+  Close();
+  
+#ifdef _WIN32
+  HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) { return false; }
+  
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize)) {
+    CloseHandle(file);
+    return false;
+  }
+  size = fileSize.QuadPart;
+  
+  if (size > 0) {
+    HANDLE fileMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (fileMapping == nullptr) {
+      LOG(ERROR) << "CreateFileMappingW() failed for: " << path.string();
+      size = 0;
+      return false;
+    }
+    
+    const void* mappedData = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(fileMapping);  // the view keeps the mapping object alive
+    if (mappedData == nullptr) {
+      LOG(ERROR) << "MapViewOfFile() failed for: " << path.string();
+      size = 0;
+      return false;
+    }
+    
+    mapping = shared_ptr<const u8>(static_cast<const u8*>(mappedData), [](const u8* data) {
+      UnmapViewOfFile(data);
+    });
+  } else {
+    CloseHandle(file);
+  }
+#else
+  const int fd = open(path.string().c_str(), O_RDONLY);
+  if (fd < 0) { return false; }
+  
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    close(fd);
+    return false;
+  }
+  size = fileStat.st_size;
+  
+  if (size > 0) {
+    void* mappedData = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping remains valid after closing the file descriptor
+    if (mappedData == MAP_FAILED) {
+      LOG(ERROR) << "mmap() failed for: " << path.string();
+      size = 0;
+      return false;
+    }
+    
+    const u64 mappedSize = size;
+    mapping = shared_ptr<const u8>(static_cast<const u8*>(mappedData), [mappedSize](const u8* data) {
+      munmap(const_cast<u8*>(data), mappedSize);
+    });
+  } else {
+    close(fd);
+  }
+#endif
+  
+  readOffset = 0;
+  return true;
+}
+
+void MappedFileInputStream::Close() {
+  mapping.reset();
+  size = 0;
+  readOffset = 0;
+}
+
+usize MappedFileInputStream::Read(void* data, usize size) {
+  const usize readableSize = min<u64>(size, this->size - readOffset);
+  memcpy(data, mapping.get() + readOffset, readableSize);
+  readOffset += readableSize;
+  return readableSize;
+}
+
+bool MappedFileInputStream::Seek(u64 offsetFromStart) {
+  if (offsetFromStart > size) { return false; }
+  readOffset = offsetFromStart;
+  return true;
+}
+
+u64 MappedFileInputStream::SizeInBytes() {
+  return size;
+}
+
+void MappedFileInputStream::Prefetch(u64 offset, u64 size) {
+  if (offset >= this->size) { return; }
+  size = min(size, this->size - offset);
+  
+#ifdef _WIN32
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = const_cast<u8*>(mapping.get() + offset);
+  range.NumberOfBytes = size;
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+  // madvise() requires a page-aligned start address
+  const u64 pageSize = sysconf(_SC_PAGESIZE);
+  const u64 alignedOffset = offset - (offset % pageSize);
+  madvise(const_cast<u8*>(mapping.get() + alignedOffset), size + (offset - alignedOffset), MADV_WILLNEED);
+#endif
+}
+
+}
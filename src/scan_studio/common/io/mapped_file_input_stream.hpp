@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+
+#include <libvis/io/filesystem.h>
+#include <libvis/io/input_stream.h>
+#include <libvis/vulkan/libvis.h>
+
+namespace scan_studio {
+using namespace vis;
+
+/// Implementation of InputStream that memory-maps a whole file.
+///
+/// In addition to the usual (copying) InputStream interface, this gives direct read-only
+/// access to the mapped file content with Data(). The mapping is reference-counted:
+/// GetMapping() returns a shared pointer that keeps the mapping alive even after
+/// the input stream has been closed or destroyed. This allows to hand out pointers into
+/// the file to other threads without copying the data.
+class MappedFileInputStream : public InputStream {
+ public:
+  inline MappedFileInputStream() {}
+  
+  MappedFileInputStream(const MappedFileInputStream& other) = delete;
+  MappedFileInputStream& operator= (const MappedFileInputStream& other) = delete;
+  
+  MappedFileInputStream(MappedFileInputStream&& other) = default;
+  MappedFileInputStream& operator= (MappedFileInputStream&& other) = default;
+  
+  /// Opens and maps the file at the given path.
+  /// Returns true on success, false on failure.
+  bool Open(const fs::path& path);
+  
+  /// Drops this stream's reference to the mapping.
+  /// The mapping itself is only released once all references returned by GetMapping() are gone as well.
+  void Close();
+  
+  virtual usize Read(void* data, usize size) override;
+  virtual bool Seek(u64 offsetFromStart) override;
+  virtual u64 SizeInBytes() override;
+  
+  /// Hints to the operating system that the given byte range will be accessed soon,
+  /// such that it may start reading it from disk in the background.
+  void Prefetch(u64 offset, u64 size);
+  
+  /// Returns a pointer to the start of the mapped file content (or nullptr if no file is open, or if it is empty).
+  inline const u8* Data() const { return mapping.get(); }
+  
+  /// Returns a reference to the mapping that keeps it alive as long as the reference exists.
+  inline const shared_ptr<const u8>& GetMapping() const { return mapping; }
+  
+ private:
+  shared_ptr<const u8> mapping;
+  u64 size = 0;
+  u64 readOffset = 0;
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "scan_studio/common/common_defines.hpp"
+
+namespace scan_studio {
+using namespace vis;
+
+/// FIFO queue that stores its items in place, in a circular buffer of preallocated slots.
+///
+/// In contrast to a vector<ItemT*> from which the front item is erased, pushing and popping items
+/// is O(1) and does not allocate, except when the queue grows beyond its current capacity
+/// (in which case the capacity is doubled). Popped slots are reset to a default-constructed item,
+/// such that they do not keep any resources (e.g., locked cache items or shared pointers) alive.
+///
+/// ItemT must be default-constructible and move-assignable.
+/// The class is neither thread-safe nor lock-free; each of the pipeline threads guards its queues with a mutex
+/// (which it needs anyway for its condition variables, and since the queues get cleared from other threads).
+template <typename ItemT>
+class SlotQueue {
+ public:
+  /// Creates an empty queue with slots for the given number of items (rounded up to a power of two,
+  /// which keeps the index wrap-around a bit mask).
+  inline SlotQueue(usize initialCapacity = 16) {
+    usize capacity = 1;
+    while (capacity < initialCapacity) {
+      capacity *= 2;
+    }
+    slots.resize(capacity);
+  }
+  
+  inline bool Empty() const { return count == 0; }
+  inline usize Size() const { return count; }
+  inline usize Capacity() const { return slots.size(); }
+  
+  /// Returns the item at the given position, counted from the front of the queue.
+  inline ItemT& operator[] (usize index) { return slots[(head + index) & (slots.size() - 1)]; }
+  inline const ItemT& operator[] (usize index) const { return slots[(head + index) & (slots.size() - 1)]; }
+  
+  inline ItemT& Front() { return slots[head]; }
+  inline ItemT& Back() { return (*this)[count - 1]; }
+  
+  inline void PushBack(ItemT&& item) {
+    if (count == slots.size()) {
+      Grow();
+    }
+    (*this)[count] = std::move(item);
+    ++ count;
+  }
+  
+  /// Removes the front item and returns it. The queue must not be empty.
+  inline ItemT PopFront() {
+    ItemT item = std::move(slots[head]);
+    slots[head] = ItemT();
+    head = (head + 1) & (slots.size() - 1);
+    -- count;
+    return item;
+  }
+  
+  /// Removes the back item and returns it. The queue must not be empty.
+  inline ItemT PopBack() {
+    ItemT& slot = Back();
+    ItemT item = std::move(slot);
+    slot = ItemT();
+    -- count;
+    return item;
+  }
+  
+  /// Removes all items, keeping the capacity.
+  inline void Clear() {
+    for (usize i = 0; i < count; ++ i) {
+      (*this)[i] = ItemT();
+    }
+    head = 0;
+    count = 0;
+  }
+  
+ private:
+  void Grow() {
+    vector<ItemT> newSlots(2 * slots.size());
+    for (usize i = 0; i < count; ++ i) {
+      newSlots[i] = std::move((*this)[i]);
+    }
+    slots.swap(newSlots);
+    head = 0;
+  }
+  
+  /// Item slots; the size is always a power of two
+  vector<ItemT> slots;
+  
+  /// Slot index of the front item
+  usize head = 0;
+  
+  /// Number of items in the queue
+  usize count = 0;
+};
+
+}
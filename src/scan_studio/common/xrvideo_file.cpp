@@ -4,6 +4,9 @@
 
 #include <libvis/io/input_stream.h>
 
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+#include "scan_studio/viewer_common/streaming_input_stream.hpp"
+
 namespace scan_studio {
 
 XRVideoReader::~XRVideoReader() {
@@ -13,7 +16,9 @@ XRVideoReader::~XRVideoReader() {
 XRVideoReader::XRVideoReader(XRVideoReader&& other)
     : inputStream(other.inputStream),
       peekBuffer(std::move(other.peekBuffer)),
-      currentFileOffset(other.currentFileOffset) {
+      currentFileOffset(other.currentFileOffset),
+      usingStreamingInputStream(other.usingStreamingInputStream),
+      usingMappedFileInputStream(other.usingMappedFileInputStream) {
   other.inputStream = nullptr;
 }
 
@@ -21,16 +26,19 @@ XRVideoReader& XRVideoReader::operator=(XRVideoReader&& other) {
   swap(inputStream, other.inputStream);
   swap(peekBuffer, other.peekBuffer);
   swap(currentFileOffset, other.currentFileOffset);
+  swap(usingStreamingInputStream, other.usingStreamingInputStream);
+  swap(usingMappedFileInputStream, other.usingMappedFileInputStream);
   
   return *this;
 }
 
-void XRVideoReader::TakeInputStream(InputStream* inputStream, bool isStreamingInputStream) {
+void XRVideoReader::TakeInputStream(InputStream* inputStream, bool isStreamingInputStream, bool isMappedFileInputStream) {
   Close();
   peekBuffer.clear();
   currentFileOffset = 0;
   this->inputStream = inputStream;
   usingStreamingInputStream = isStreamingInputStream;
+  usingMappedFileInputStream = isMappedFileInputStream;
 }
 
 void XRVideoReader::Close() {
@@ -122,6 +130,126 @@ bool XRVideoReader::ReadNextFrame(vector<u8>* data, u64* fileOffset) {
   return true;
 }
 
+bool XRVideoReader::ReadNextFrameView(XRVideoFrameView* view, u64* fileOffset) {
+  if (usingStreamingInputStream) {
+    return ReadNextFrameViewFromStreamingInputStream(view, fileOffset);
+  } else if (!usingMappedFileInputStream) {
+    return ReadNextFrameViewIntoBuffer(view, fileOffset);
+  }
+  
+  // Seek to the next frame chunk and output its file offset if desired
+  if (!FindNextChunk(xrVideoFrameChunkIdentifierV0)) { return false; }
+  if (fileOffset) {
+    *fileOffset = currentFileOffset;
+  }
+  
+  u32 chunkSizeWithoutHeader;
+  u8 chunkType;
+  if (!ParseChunkHeader(&chunkSizeWithoutHeader, &chunkType)) { return false; }
+  
+  // Reference the frame data within the mapping instead of reading it
+  MappedFileInputStream* mappedInputStream = reinterpret_cast<MappedFileInputStream*>(inputStream);
+  const u64 dataOffset = currentFileOffset + XRVideoChunkHeaderScheme::GetConstantSize();
+  if (dataOffset + chunkSizeWithoutHeader > mappedInputStream->SizeInBytes()) {
+    LOG(WARNING) << "File is truncated";
+    return false;
+  }
+  
+  view->data = mappedInputStream->Data() + dataOffset;
+  view->size = chunkSizeWithoutHeader;
+  view->owner = mappedInputStream->GetMapping();
+  
+  // Have the OS start paging in the data, since it will be accessed by the decoding threads soon
+  mappedInputStream->Prefetch(dataOffset, chunkSizeWithoutHeader);
+  
+  return Seek(dataOffset + chunkSizeWithoutHeader);
+}
+
+bool XRVideoReader::ReadNextFrameViewIntoBuffer(XRVideoFrameView* view, u64* fileOffset) {
+  shared_ptr<vector<u8>> buffer(new vector<u8>());
+  if (!ReadNextFrame(buffer.get(), fileOffset)) { return false; }
+  
+  view->data = buffer->data();
+  view->size = buffer->size();
+  view->owner = std::move(buffer);
+  return true;
+}
+
+bool XRVideoReader::ReadNextFrameViewFromStreamingInputStream(XRVideoFrameView* view, u64* fileOffset) {
+  // Seek to the next frame chunk and output its file offset if desired
+  if (!FindNextChunk(xrVideoFrameChunkIdentifierV0)) { return false; }
+  if (fileOffset) {
+    *fileOffset = currentFileOffset;
+  }
+  
+  u32 chunkSizeWithoutHeader;
+  u8 chunkType;
+  if (!ParseChunkHeader(&chunkSizeWithoutHeader, &chunkType)) { return false; }
+  
+  const u64 chunkOffset = currentFileOffset;
+  const u64 dataOffset = chunkOffset + XRVideoChunkHeaderScheme::GetConstantSize();
+  if (!Seek(dataOffset)) { return false; }
+  
+  // Try to reference the frame data within the streamed range that contains it instead of copying it.
+  // This works if the frame does not cross a range boundary.
+  const u8* data;
+  shared_ptr<const void> pin;
+  if (chunkSizeWithoutHeader > 0 && GetStreamingInputStream()->ReadPinned(chunkSizeWithoutHeader, &data, &pin)) {
+    view->data = data;
+    view->size = chunkSizeWithoutHeader;
+    view->owner = std::move(pin);
+    currentFileOffset += chunkSizeWithoutHeader;
+    return true;
+  }
+  
+  if (aborted) {
+    return false;
+  }
+  
+  // Fall back to copying the data
+  return Seek(chunkOffset) && ReadNextFrameViewIntoBuffer(view);
+}
+
+bool XRVideoReader::ReadNextFrameHeader(s64* startTimestamp, s64* endTimestamp, bool* isKeyframe, u64* fileOffset) {
+  // Seek to the next frame chunk and output its file offset if desired
+  if (!FindNextChunk(xrVideoFrameChunkIdentifierV0)) { return false; }
+  if (fileOffset) {
+    *fileOffset = currentFileOffset;
+  }
+  
+  u32 chunkSizeWithoutHeader;
+  u8 chunkType;
+  if (!ParseChunkHeader(&chunkSizeWithoutHeader, &chunkType)) { return false; }
+  if (chunkSizeWithoutHeader < XRVideoHeaderScheme::GetConstantSize()) {
+    LOG(WARNING) << "Encountered a frame chunk that is too small to contain a frame header";
+    return false;
+  }
+  
+  const u64 dataOffset = currentFileOffset + XRVideoChunkHeaderScheme::GetConstantSize();
+  if (!Seek(dataOffset)) { return false; }
+  
+  // Read the frame header only
+  u8 header[XRVideoHeaderScheme::GetConstantSize()];
+  if (Read(sizeof(header), header) != sizeof(header)) {
+    if (!aborted) { LOG(WARNING) << "File is truncated"; }
+    return false;
+  }
+  
+  u8 version;
+  u8 bitflags;
+  u16 deformationNodeCount;
+  StructuredPtrReader<XRVideoHeaderScheme>(header)
+      .Read(&version)
+      .Read(&bitflags)
+      .Read(&deformationNodeCount)
+      .Read(startTimestamp)
+      .Read(endTimestamp);
+  *isKeyframe = bitflags & XRVideoIsKeyframeBitflag;
+  
+  // Seek over the rest of the frame data
+  return Seek(dataOffset + chunkSizeWithoutHeader);
+}
+
 bool XRVideoReader::Seek(u64 fileOffset) {
   if (fileOffset == currentFileOffset) {
     return true;
@@ -156,6 +284,10 @@ usize XRVideoReader::Read(usize bytes, u8* dest) {
   return bytesRead;
 }
 
+u64 XRVideoReader::GetStreamSize() {
+  return inputStream->SizeInBytes();
+}
+
 void XRVideoReader::AbortRead() {
   aborted = true;
   inputStream->AbortRead();
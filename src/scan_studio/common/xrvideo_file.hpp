@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fstream>
+#include <memory>
 
 #include <libvis/vulkan/libvis.h>
 
@@ -170,8 +171,21 @@ constexpr static u32 xrVideoIndexArrayItemIsKeyframeBit = static_cast<u32>(1) <<
 
 
 class FrameIndex;
+class MappedFileInputStream;
 class StreamingInputStream;
 
+/// Read-only view onto the data of a frame chunk, as returned by XRVideoReader::ReadNextFrameView().
+///
+/// `owner` keeps the memory that `data` points to alive. Depending on the input stream,
+/// this is either a buffer that the frame data was copied into, the memory mapping of the whole file,
+/// or a pinned range of a StreamingInputStream.
+/// Thus, views may be passed on to other threads freely and remain valid as long as they exist.
+struct XRVideoFrameView {
+  const u8* data = nullptr;
+  usize size = 0;
+  shared_ptr<const void> owner;
+};
+
 class XRVideoReader {
  public:
   inline XRVideoReader() {}
@@ -191,7 +205,10 @@ class XRVideoReader {
   /// It must be set to true if a StreamingInputStream is passed in, false otherwise.
   /// This is used to improve streaming performance by calling additional functions
   /// on StreamingInputStream to pre-read data.
-  void TakeInputStream(InputStream* inputStream, bool isStreamingInputStream);
+  ///
+  /// Similarly, `isMappedFileInputStream` must be set to true if a MappedFileInputStream is passed in.
+  /// This allows ReadNextFrameView() to return views into the file mapping instead of copying the data.
+  void TakeInputStream(InputStream* inputStream, bool isStreamingInputStream, bool isMappedFileInputStream = false);
   
   /// Closes and destroys the input stream.
   void Close();
@@ -220,6 +237,19 @@ class XRVideoReader {
   /// Optionally returns the frame's file offset in fileOffset.
   bool ReadNextFrame(vector<u8>* data, u64* fileOffset = nullptr);
   
+  /// Variant of ReadNextFrame() that returns a view onto the frame data.
+  /// If a MappedFileInputStream is used as input, the view directly points into the file mapping,
+  /// avoiding a copy of the data. If a StreamingInputStream is used and the frame lies within a single streamed range,
+  /// the view points into that range and pins it (see StreamingInputStream::ReadPinned()).
+  /// Otherwise, the data is read into a newly allocated buffer that is owned by the view.
+  bool ReadNextFrameView(XRVideoFrameView* view, u64* fileOffset = nullptr);
+  
+  /// Variant of ReadNextFrame() that only reads the frame's header (XRVideoHeaderScheme) and seeks over the rest of the frame data.
+  /// This allows to quickly build an index for files without an index chunk.
+  /// Note that this does not check whether the frame data is complete; compare the file offset
+  /// after the call with GetStreamSize() to detect truncated frames.
+  bool ReadNextFrameHeader(s64* startTimestamp, s64* endTimestamp, bool* isKeyframe, u64* fileOffset = nullptr);
+  
   /// Seeks to the given file offset.
   /// Returns true on success, false on failure.
   bool Seek(u64 fileOffset);
@@ -242,23 +272,33 @@ class XRVideoReader {
   /// Returns the current file offset of the reader.
   inline u64 GetFileOffset() const { return currentFileOffset; }
   
+  /// Returns the size of the input stream's content in bytes.
+  u64 GetStreamSize();
+  
   /// Returns whether a StreamingInputStream is used as input.
   inline bool UsesStreamingInputStream() const { return usingStreamingInputStream; }
   
   /// If a StreamingInputStream is used for input, provides access to it to be able to implement special-case actions for streaming.
   inline StreamingInputStream* GetStreamingInputStream() const { return usingStreamingInputStream ? reinterpret_cast<StreamingInputStream*>(inputStream) : nullptr; }
   
+  /// Returns whether a MappedFileInputStream is used as input.
+  inline bool UsesMappedFileInputStream() const { return usingMappedFileInputStream; }
+  
  private:
   /// Tries to read data from the file such that there are at least the requested number of bytes
   /// in peekBuffer. Returns true if successful, false if not enough bytes could be read before the
   /// end of file or before an I/O error occurred.
   bool Peek(usize bytes);
   
+  bool ReadNextFrameViewIntoBuffer(XRVideoFrameView* view, u64* fileOffset = nullptr);
+  bool ReadNextFrameViewFromStreamingInputStream(XRVideoFrameView* view, u64* fileOffset);
+  
   InputStream* inputStream = nullptr;
   vector<u8> peekBuffer;
   u64 currentFileOffset = 0;
   bool aborted = false;
   bool usingStreamingInputStream;
+  bool usingMappedFileInputStream = false;
 };
 
 }
@@ -0,0 +1,329 @@
+#include "scan_studio/common/xrvideo_writer.hpp"
+
+#include <Eigen/Core>
+
+#include <zstd.h>
+
+#include <loguru.hpp>
+
+namespace scan_studio {
+
+/// Compresses the given data with zstd and appends the result to `out`.
+/// Returns the compressed size in `compressedSize`.
+static bool AppendCompressedWithZStd(const void* src, usize size, const char* name, int zstdCompressionLevel, ZSTD_CCtx* zstdCtx, vector<u8>* out, u32* compressedSize) {
+  const usize oldSize = out->size();
+  out->resize(oldSize + ZSTD_compressBound(size));
+  
+  const usize result = ZSTD_compressCCtx(zstdCtx, out->data() + oldSize, out->size() - oldSize, src, size, zstdCompressionLevel);
+  if (ZSTD_isError(result)) {
+    LOG(ERROR) << name << ": Error compressing with zstd: " << ZSTD_getErrorName(result);
+    out->resize(oldSize);
+    return false;
+  }
+  
+  out->resize(oldSize + result);
+  *compressedSize = result;
+  return true;
+}
+
+bool XRVideoEncodeFrame(const XRVideoFrameContent& content, int zstdCompressionLevel, ZSTD_CCtx* zstdCtx, vector<u8>* out) {
+  // Validate the content
+  if (content.deformationState.size() % 12 != 0 || content.deformationState.size() / 12 > numeric_limits<u16>::max()) {
+    LOG(ERROR) << "Invalid deformation state size: " << content.deformationState.size();
+    return false;
+  }
+  if (content.textureRGB.size() != 0 && content.textureRGB.size() != 3ull * content.textureWidth * content.textureHeight) {
+    LOG(ERROR) << "Texture data size (" << content.textureRGB.size() << ") does not match the texture size (" << content.textureWidth << " x " << content.textureHeight << ")";
+    return false;
+  }
+  
+  const usize uniqueVertexCount = content.uniqueVertexPositions.size() / 3;
+  const usize vertexCount = uniqueVertexCount + content.duplicatedVertexSourceIndices.size();
+  
+  if (content.isKeyframe) {
+    if (content.uniqueVertexPositions.size() % 3 != 0 ||
+        vertexCount > numeric_limits<u16>::max() ||
+        content.texcoords.size() != 2 * vertexCount ||
+        content.indices.size() % 3 != 0 ||
+        content.vertexWeights.size() != uniqueVertexCount) {
+      LOG(ERROR) << "Inconsistent keyframe mesh attribute sizes";
+      return false;
+    }
+  }
+  
+  u8 bitflags = XRVideoZStdRGBTextureBitflag;
+  if (content.isKeyframe) { bitflags |= XRVideoIsKeyframeBitflag; }
+  if (!content.vertexAlpha.empty()) { bitflags |= XRVideoHasVertexAlphaBitflag; }
+  
+  // Reserve space for the header(s), which are filled in at the end once the compressed sizes are known
+  out->clear();
+  const usize headerSize = XRVideoHeaderScheme::GetConstantSize() + (content.isKeyframe ? XRVideoKeyframeHeaderScheme::GetConstantSize() : 0);
+  out->resize(headerSize);
+  
+  // Compressed mesh (for keyframes)
+  u32 compressedMeshSize = 0;
+  u32 encodedVertexWeightsSize = 0;
+  
+  if (content.isKeyframe) {
+    // Encode the vertex weights: For each vertex, the first node index has the node count minus one
+    // encoded in its top two bits, followed by the remaining node indices, followed by the node weights.
+    vector<u8> encodedVertexWeights;
+    encodedVertexWeights.reserve(uniqueVertexCount * 2);
+    
+    auto appendU16 = [&encodedVertexWeights](u16 value) {
+      encodedVertexWeights.push_back(value & 0xff);
+      encodedVertexWeights.push_back(value >> 8);
+    };
+    
+    for (const auto& weights : content.vertexWeights) {
+      if (weights.nodeCount == 0) {
+        appendU16(numeric_limits<u16>::max());
+        continue;
+      } else if (weights.nodeCount > 4) {
+        LOG(ERROR) << "Vertices may have at most 4 assigned deformation nodes";
+        return false;
+      }
+      
+      for (int k = 0; k < weights.nodeCount; ++ k) {
+        if (weights.nodeIndices[k] >= 0x3fff) {
+          LOG(ERROR) << "Deformation node index out of the encodable range: " << weights.nodeIndices[k];
+          return false;
+        }
+      }
+      
+      appendU16(weights.nodeIndices[0] | ((weights.nodeCount - 1) << 14));
+      for (int k = 1; k < weights.nodeCount; ++ k) {
+        appendU16(weights.nodeIndices[k]);
+      }
+      for (int k = 0; k < weights.nodeCount; ++ k) {
+        encodedVertexWeights.push_back(weights.nodeWeights[k]);
+      }
+    }
+    encodedVertexWeightsSize = encodedVertexWeights.size();
+    
+    // Concatenate the mesh data in the order expected by the decoder
+    vector<u8> meshData;
+    auto appendArray = [&meshData](const void* data, usize size) {
+      const usize oldSize = meshData.size();
+      meshData.resize(oldSize + size);
+      memcpy(meshData.data() + oldSize, data, size);
+    };
+    appendArray(content.uniqueVertexPositions.data(), content.uniqueVertexPositions.size() * sizeof(u16));
+    appendArray(content.duplicatedVertexSourceIndices.data(), content.duplicatedVertexSourceIndices.size() * sizeof(u16));
+    appendArray(content.texcoords.data(), content.texcoords.size() * sizeof(u16));
+    appendArray(content.indices.data(), content.indices.size() * sizeof(u16));
+    appendArray(encodedVertexWeights.data(), encodedVertexWeights.size());
+    
+    if (!AppendCompressedWithZStd(meshData.data(), meshData.size(), "Mesh data", zstdCompressionLevel, zstdCtx, out, &compressedMeshSize)) { return false; }
+  }
+  
+  // Compressed deformation state, stored as half floats with the identity subtracted
+  u32 compressedDeformationStateSize = 0;
+  
+  if (!content.deformationState.empty()) {
+    vector<Eigen::half> encodedValues(content.deformationState.size());
+    for (usize i = 0; i < encodedValues.size(); ++ i) {
+      const int coeffIdx = i % 12;
+      const bool isOneInIdentity = coeffIdx == 0 || coeffIdx == 4 || coeffIdx == 8;
+      
+      encodedValues[i] = static_cast<Eigen::half>(content.deformationState[i] - (isOneInIdentity ? 1.f : 0));
+    }
+    
+    if (!AppendCompressedWithZStd(encodedValues.data(), encodedValues.size() * sizeof(Eigen::half), "Deformation state", zstdCompressionLevel, zstdCtx, out, &compressedDeformationStateSize)) { return false; }
+  }
+  
+  // Compressed texture (a compressed size of zero denotes a frame without texture)
+  u32 compressedRGBSize = 0;
+  
+  if (!content.textureRGB.empty() &&
+      !AppendCompressedWithZStd(content.textureRGB.data(), content.textureRGB.size(), "Texture", zstdCompressionLevel, zstdCtx, out, &compressedRGBSize)) {
+    return false;
+  }
+  
+  // Compressed vertex alpha (its size is implicitly given by the remaining chunk size)
+  u32 compressedVertexAlphaSize = 0;
+  
+  if (!content.vertexAlpha.empty() &&
+      !AppendCompressedWithZStd(content.vertexAlpha.data(), content.vertexAlpha.size(), "Vertex alpha", zstdCompressionLevel, zstdCtx, out, &compressedVertexAlphaSize)) {
+    return false;
+  }
+  
+  // Write the header(s)
+  StructuredVectorWriter<XRVideoHeaderScheme>(out)
+      .Write(xrVideoHeaderSchemeCurrentVersion)
+      .Write(bitflags)
+      .Write(static_cast<u16>(content.deformationState.size() / 12))
+      .Write(content.startTimestamp)
+      .Write(content.endTimestamp)
+      .Write(content.textureWidth)
+      .Write(content.textureHeight)
+      .Write(compressedDeformationStateSize)
+      .Write(compressedRGBSize);
+  
+  if (content.isKeyframe) {
+    StructuredVectorWriter<XRVideoKeyframeHeaderScheme>(out, XRVideoHeaderScheme::GetConstantSize())
+        .Write(static_cast<u16>(uniqueVertexCount))
+        .Write(static_cast<u16>(vertexCount))
+        .Write(static_cast<u32>(content.indices.size() / 3))
+        .Write(content.bbox)
+        .Write(compressedMeshSize)
+        .Write(encodedVertexWeightsSize);
+  }
+  
+  return true;
+}
+
+
+XRVideoWriter::~XRVideoWriter() {
+  Abort();
+}
+
+bool XRVideoWriter::Open(const fs::path& path, const XRVideoMetadata* metadata, int zstdCompressionLevel) {
+  Abort();
+  
+  this->path = path;
+  framesPath = path;
+  framesPath += ".frames.tmp";
+  
+  framesFile = fopen(framesPath.string().c_str(), "wb");
+  if (!framesFile) {
+    LOG(ERROR) << "Cannot open file for writing: " << framesPath.string();
+    return false;
+  }
+  
+  haveMetadata = metadata != nullptr;
+  if (haveMetadata) {
+    this->metadata = *metadata;
+  }
+  
+  this->zstdCompressionLevel = zstdCompressionLevel;
+  if (!zstdCtx) {
+    zstdCtx.reset(ZSTD_createCCtx(), [](ZSTD_CCtx* ctx) { ZSTD_freeCCtx(ctx); });
+  }
+  
+  indexItems.clear();
+  lastEndTimestamp = 0;
+  return true;
+}
+
+bool XRVideoWriter::WriteFrame(const XRVideoFrameContent& content) {
+  if (!XRVideoEncodeFrame(content, zstdCompressionLevel, zstdCtx.get(), &encodedFrame)) { return false; }
+  return WriteEncodedFrame(encodedFrame.data(), encodedFrame.size(), content.isKeyframe, content.startTimestamp, content.endTimestamp);
+}
+
+bool XRVideoWriter::WriteEncodedFrame(const u8* data, usize size, bool isKeyframe, s64 startTimestamp, s64 endTimestamp) {
+  if (!framesFile) {
+    LOG(ERROR) << "WriteEncodedFrame() called without an open file";
+    return false;
+  }
+  if (indexItems.empty() && !isKeyframe) {
+    LOG(ERROR) << "The first frame of an XRVideo must be a keyframe";
+    return false;
+  }
+  if (size >= xrVideoIndexArrayItemIsKeyframeBit) {
+    LOG(ERROR) << "Frame too large to be stored: " << size << " bytes";
+    return false;
+  }
+  
+  StructuredFileWriter<XRVideoChunkHeaderScheme>(framesFile)
+      .Write(static_cast<u32>(size))
+      .Write(xrVideoFrameChunkIdentifierV0);
+  if (fwrite(data, 1, size, framesFile) != size) {
+    LOG(ERROR) << "Error writing to: " << framesPath.string();
+    return false;
+  }
+  
+  indexItems.push_back(IndexItem{static_cast<u32>(size), isKeyframe, startTimestamp});
+  lastEndTimestamp = endTimestamp;
+  return true;
+}
+
+bool XRVideoWriter::Close() {
+  if (!framesFile) { return false; }
+  fclose(framesFile);
+  framesFile = nullptr;
+  
+  FILE* file = fopen(path.string().c_str(), "wb");
+  if (!file) {
+    LOG(ERROR) << "Cannot open file for writing: " << path.string();
+    Abort();
+    return false;
+  }
+  
+  // Metadata chunk
+  if (haveMetadata) {
+    const vector<u8> metadataChunk = metadata.SerializeToChunk();
+    fwrite(metadataChunk.data(), 1, metadataChunk.size(), file);
+  }
+  
+  // Index chunk
+  vector<u8> indexArray(indexItems.size() * XRVideoIndexArrayItemScheme::GetConstantSize() + sizeof(s64));
+  usize indexArrayOffset = 0;
+  for (const IndexItem& item : indexItems) {
+    StructuredVectorWriter<XRVideoIndexArrayItemScheme>(&indexArray, indexArrayOffset)
+        .Write(item.sizeWithoutChunkHeader | (item.isKeyframe ? xrVideoIndexArrayItemIsKeyframeBit : 0))
+        .Write(item.startTimestamp);
+    indexArrayOffset += XRVideoIndexArrayItemScheme::GetConstantSize();
+  }
+  memcpy(indexArray.data() + indexArrayOffset, &lastEndTimestamp, sizeof(s64));
+  
+  vector<u8> compressedIndexArray;
+  u32 compressedIndexArraySize;
+  if (!AppendCompressedWithZStd(indexArray.data(), indexArray.size(), "Index", zstdCompressionLevel, zstdCtx.get(), &compressedIndexArray, &compressedIndexArraySize)) {
+    fclose(file);
+    Abort();
+    return false;
+  }
+  
+  StructuredFileWriter<XRVideoChunkHeaderScheme>(file)
+      .Write(static_cast<u32>(XRVideoIndexChunkScheme::GetConstantSize() + compressedIndexArraySize))
+      .Write(xrVideoIndexChunkIdentifierV0);
+  StructuredFileWriter<XRVideoIndexChunkScheme>(file)
+      .Write(xrVideoIndexChunkSchemeCurrentVersion)
+      .Write(compressedIndexArraySize);
+  fwrite(compressedIndexArray.data(), 1, compressedIndexArray.size(), file);
+  
+  // Frame chunks
+  FILE* framesReadFile = fopen(framesPath.string().c_str(), "rb");
+  if (!framesReadFile) {
+    LOG(ERROR) << "Cannot re-open the temporary file: " << framesPath.string();
+    fclose(file);
+    Abort();
+    return false;
+  }
+  
+  bool success = true;
+  vector<u8> copyBuffer(4 * 1024 * 1024);
+  while (true) {
+    const usize bytesRead = fread(copyBuffer.data(), 1, copyBuffer.size(), framesReadFile);
+    if (bytesRead == 0) { break; }
+    if (fwrite(copyBuffer.data(), 1, bytesRead, file) != bytesRead) {
+      LOG(ERROR) << "Error writing to: " << path.string();
+      success = false;
+      break;
+    }
+  }
+  
+  fclose(framesReadFile);
+  if (fclose(file) != 0) {
+    LOG(ERROR) << "Error closing: " << path.string();
+    success = false;
+  }
+  
+  Abort();
+  return success;
+}
+
+void XRVideoWriter::Abort() {
+  if (framesFile) {
+    fclose(framesFile);
+    framesFile = nullptr;
+  }
+  if (!framesPath.empty()) {
+    std::error_code errorCode;
+    fs::remove(framesPath, errorCode);
+    framesPath.clear();
+  }
+}
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+#include <libvis/io/filesystem.h>
+#include <libvis/vulkan/libvis.h>
+
+#include "scan_studio/common/xrvideo_file.hpp"
+
+typedef struct ZSTD_CCtx_s ZSTD_CCtx;
+
+namespace scan_studio {
+using namespace vis;
+
+/// Uncompressed content of an XRVideo frame, as input to XRVideoEncodeFrame().
+///
+/// The mesh attributes are only used for keyframes. All vertex attributes are given in the
+/// already quantized form that is stored in the file (see frame_loading.cpp for how they are decoded).
+struct XRVideoFrameContent {
+  /// Deformation node assignments of a single unique vertex.
+  struct VertexWeights {
+    /// Number of valid entries in nodeIndices and nodeWeights (1 to 4; 0 is allowed but should not occur in practice).
+    u8 nodeCount = 0;
+    
+    /// Node indices must be smaller than 0x3fff, since the top two bits of the first index are used to encode the node count.
+    u16 nodeIndices[4];
+    
+    u8 nodeWeights[4];
+  };
+  
+  bool isKeyframe = false;
+  
+  s64 startTimestamp = 0;
+  s64 endTimestamp = 0;
+  
+  // --- Keyframe mesh ---
+  
+  /// Quantized vertex positions of the unique vertices, 3 values per vertex.
+  /// The positions are reconstructed as `bboxMin + factor * value`.
+  vector<u16> uniqueVertexPositions;
+  
+  /// For each duplicated vertex (following the unique vertices), the index of the unique vertex that it duplicates.
+  vector<u16> duplicatedVertexSourceIndices;
+  
+  /// Quantized texture coordinates of all vertices (unique and duplicated ones), 2 values per vertex.
+  vector<u16> texcoords;
+  
+  /// Triangle indices, 3 per triangle.
+  vector<u16> indices;
+  
+  /// Deformation node assignments of the unique vertices.
+  vector<VertexWeights> vertexWeights;
+  
+  /// Bounding box minimum (x, y, z) followed by the quantization factors (x, y, z), with factor = (max - min) / 65535.
+  float bbox[6] = {0, 0, 0, 0, 0, 0};
+  
+  // --- Per-frame data ---
+  
+  /// Deformation state, 12 floats per deformation node (a 3x3 matrix followed by a translation).
+  /// The node count stored in the frame header is derived from the size of this vector.
+  vector<float> deformationState;
+  
+  /// RGB texture data, 3 bytes per pixel, stored with XRVideoZStdRGBTextureBitflag.
+  u32 textureWidth = 0;
+  u32 textureHeight = 0;
+  vector<u8> textureRGB;
+  
+  /// Optional alpha values, one per (renderable) vertex of the frame's keyframe. Leave empty for no vertex alpha.
+  vector<u8> vertexAlpha;
+};
+
+/// Encodes the given frame content into the data of a frame chunk (excluding the chunk header),
+/// compressing all parts with zstd. The texture is stored uncompressed apart from that
+/// (with XRVideoZStdRGBTextureBitflag), so no video encoder is required.
+/// Returns true on success, false on failure.
+bool XRVideoEncodeFrame(const XRVideoFrameContent& content, int zstdCompressionLevel, ZSTD_CCtx* zstdCtx, vector<u8>* out);
+
+/// Writes XRVideo files.
+///
+/// Since the index chunk must precede all frame chunks, but its (compressed) size is only known
+/// once all frames have been written, the frame chunks are first written to a temporary file next
+/// to the output file. Close() then writes the header chunks and appends the frame chunks.
+class XRVideoWriter {
+ public:
+  inline XRVideoWriter() {}
+  ~XRVideoWriter();
+  
+  XRVideoWriter(const XRVideoWriter& other) = delete;
+  XRVideoWriter& operator= (const XRVideoWriter& other) = delete;
+  
+  /// Starts writing an XRVideo file to the given path.
+  /// If metadata is non-null, a metadata chunk is written to the file.
+  /// Returns true on success, false on failure.
+  bool Open(const fs::path& path, const XRVideoMetadata* metadata = nullptr, int zstdCompressionLevel = 3);
+  
+  /// Encodes the given frame content with XRVideoEncodeFrame() and appends it to the video.
+  /// Returns true on success, false on failure.
+  bool WriteFrame(const XRVideoFrameContent& content);
+  
+  /// Appends an already encoded frame (the data of a frame chunk, excluding the chunk header) to the video.
+  /// Returns true on success, false on failure.
+  bool WriteEncodedFrame(const u8* data, usize size, bool isKeyframe, s64 startTimestamp, s64 endTimestamp);
+  
+  /// Writes the index chunk and finalizes the file.
+  /// Returns true on success, false on failure.
+  bool Close();
+  
+  /// Returns whether a file is currently being written.
+  inline bool IsOpen() const { return framesFile != nullptr; }
+  
+  /// Returns the number of frames written so far.
+  inline usize GetFrameCount() const { return indexItems.size(); }
+  
+ private:
+  struct IndexItem {
+    u32 sizeWithoutChunkHeader;
+    bool isKeyframe;
+    s64 startTimestamp;
+  };
+  
+  /// Closes and deletes the temporary frames file.
+  void Abort();
+  
+  fs::path path;
+  fs::path framesPath;
+  FILE* framesFile = nullptr;
+  
+  bool haveMetadata = false;
+  XRVideoMetadata metadata;
+  
+  int zstdCompressionLevel;
+  shared_ptr<ZSTD_CCtx> zstdCtx;
+  vector<u8> encodedFrame;
+  
+  vector<IndexItem> indexItems;
+  s64 lastEndTimestamp = 0;
+};
+
+}
@@ -2,6 +2,8 @@
 
 #include <loguru.hpp>
 
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+
 #include "scan_studio/viewer_common/xrvideo/external/external_xrvideo.hpp"
 
 using namespace scan_studio;
@@ -90,17 +92,23 @@ void SRPlayer_XRVideo_Destroy(SRPlayer_XRVideo* video) {
   delete videoImpl;
 }
 
+void SRPlayer_XRVideo_SetIndexCachePath(SRPlayer_XRVideo* video, const char* path) {
+  XRVideo* videoImpl = reinterpret_cast<XRVideo*>(video);
+  videoImpl->SetSidecarIndexPath(path ? fs::path(path) : fs::path());
+}
+
 SRBool32 SRPlayer_XRVideo_LoadFile(SRPlayer_XRVideo* video, const char* path, SRBool32 cacheAllFrames, uint32_t playbackMode) {
   XRVideo* videoImpl = reinterpret_cast<XRVideo*>(video);
   
-  IfstreamInputStream* inputStream = new IfstreamInputStream();
+  // Memory-map the file, such that the frame data can be passed to the decoding threads without copying it
+  MappedFileInputStream* inputStream = new MappedFileInputStream();
   if (!inputStream->Open(path)) {
     LOG(ERROR) << "Failed to open file: " << path;
     delete inputStream;
     return false;
   }
   
-  if (!videoImpl->TakeAndOpen(inputStream, /*isStreamingInputStream*/ false, cacheAllFrames)) {
+  if (!videoImpl->TakeAndOpen(inputStream, /*isStreamingInputStream*/ false, cacheAllFrames, /*isMappedFileInputStream*/ true)) {
     return false;
   }
   
@@ -364,6 +364,23 @@ SRPlayer_XRVideo* SRPlayer_XRVideo_NewExternal(uint32_t cachedDecodedFrameCount,
 SCANNEDREALITY_VIEWER_API
 void SRPlayer_XRVideo_Destroy(SRPlayer_XRVideo* video);
 
+/**
+ * Sets the path of a file in which to cache the frame index of the video that is loaded next, for videos without an index chunk.
+ *
+ * Building the index for such videos requires reading all their frame headers, which is slow for large files.
+ * If the file exists and belongs to the loaded video, the index is loaded from it instead; otherwise, the index is saved to it once built.
+ * Since a single file can only cache the index of one video, use a different path for each video file, for example,
+ * a path within the application's cache directory that is derived from the video's path.
+ * By default, no index file is used.
+ *
+ * This must be called before SRPlayer_XRVideo_LoadFile() or SRPlayer_XRVideo_LoadCustom() to take effect for the loaded video.
+ *
+ * @param video The XRVideo to operate on.
+ * @param path Path of the index cache file, or null or an empty string to not use an index cache file.
+ */
+SCANNEDREALITY_VIEWER_API
+void SRPlayer_XRVideo_SetIndexCachePath(SRPlayer_XRVideo* video, const char* path);
+
 /**
  * Loads a video from the XRV file at the given absolute path.
  *
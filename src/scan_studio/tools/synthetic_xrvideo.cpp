@@ -0,0 +1,239 @@
+#include "scan_studio/tools/synthetic_xrvideo.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <loguru.hpp>
+
+#include "scan_studio/common/xrvideo_writer.hpp"
+#include "scan_studio/viewer_common/pi.hpp"
+
+namespace scan_studio {
+
+constexpr float cylinderRadius = 0.5f;
+constexpr float cylinderHeight = 1.8f;
+
+/// Creates the mesh of a keyframe: a grid of vertices that is wrapped around a cylinder,
+/// with small random displacements such that different keyframes have different content.
+static void CreateKeyframeMesh(const SyntheticXRVideoConfig& config, std::mt19937* rng, XRVideoFrameContent* content) {
+  const u32 columns = max<u32>(2, std::round(sqrtf(config.uniqueVertexCount)));
+  const u32 rows = (config.uniqueVertexCount + columns - 1) / columns;
+  
+  // Bounding box, leaving some room for the displacements
+  const float bboxMin[3] = {-1.1f * cylinderRadius, -0.05f * cylinderHeight, -1.1f * cylinderRadius};
+  const float bboxMax[3] = {1.1f * cylinderRadius, 1.05f * cylinderHeight, 1.1f * cylinderRadius};
+  for (int d = 0; d < 3; ++ d) {
+    content->bbox[d] = bboxMin[d];
+    content->bbox[3 + d] = (bboxMax[d] - bboxMin[d]) / numeric_limits<u16>::max();
+  }
+  auto quantize = [&](float value, int d) {
+    return static_cast<u16>(std::round(std::clamp((value - bboxMin[d]) / (bboxMax[d] - bboxMin[d]), 0.f, 1.f) * numeric_limits<u16>::max()));
+  };
+  
+  std::uniform_real_distribution<float> displacementDistribution(-0.02f, 0.02f);
+  
+  // Unique vertices
+  content->uniqueVertexPositions.resize(3 * config.uniqueVertexCount);
+  content->texcoords.resize(2 * (config.uniqueVertexCount + config.duplicatedVertexCount));
+  
+  for (u32 i = 0; i < config.uniqueVertexCount; ++ i) {
+    const u32 row = i / columns;
+    const u32 column = i % columns;
+    
+    const float angle = 2 * M_PI * column / columns;
+    const float radius = cylinderRadius + displacementDistribution(*rng);
+    
+    content->uniqueVertexPositions[3 * i + 0] = quantize(radius * cosf(angle), 0);
+    content->uniqueVertexPositions[3 * i + 1] = quantize(cylinderHeight * row / max<u32>(1, rows - 1), 1);
+    content->uniqueVertexPositions[3 * i + 2] = quantize(radius * sinf(angle), 2);
+    
+    content->texcoords[2 * i + 0] = (numeric_limits<u16>::max() * column) / columns;
+    content->texcoords[2 * i + 1] = (numeric_limits<u16>::max() * row) / rows;
+  }
+  
+  // Duplicated vertices
+  std::uniform_int_distribution<u32> uniqueVertexDistribution(0, config.uniqueVertexCount - 1);
+  std::uniform_int_distribution<u32> texcoordDistribution(0, numeric_limits<u16>::max());
+  
+  content->duplicatedVertexSourceIndices.resize(config.duplicatedVertexCount);
+  for (u32 i = 0; i < config.duplicatedVertexCount; ++ i) {
+    content->duplicatedVertexSourceIndices[i] = uniqueVertexDistribution(*rng);
+    
+    const u32 vertex = config.uniqueVertexCount + i;
+    content->texcoords[2 * vertex + 0] = texcoordDistribution(*rng);
+    content->texcoords[2 * vertex + 1] = texcoordDistribution(*rng);
+  }
+  
+  // Triangles of the grid cells (only for cells whose vertices all exist), repeated until reaching the requested count
+  vector<u16> gridIndices;
+  for (u32 row = 0; row + 1 < rows; ++ row) {
+    for (u32 column = 0; column < columns; ++ column) {
+      const u32 nextColumn = (column + 1) % columns;
+      const u32 v00 = row * columns + column;
+      const u32 v01 = row * columns + nextColumn;
+      const u32 v10 = (row + 1) * columns + column;
+      const u32 v11 = (row + 1) * columns + nextColumn;
+      if (max(v10, v11) >= config.uniqueVertexCount) { continue; }
+      
+      gridIndices.insert(gridIndices.end(), {static_cast<u16>(v00), static_cast<u16>(v10), static_cast<u16>(v01)});
+      gridIndices.insert(gridIndices.end(), {static_cast<u16>(v01), static_cast<u16>(v10), static_cast<u16>(v11)});
+    }
+  }
+  
+  content->indices.resize(3 * config.triangleCount);
+  for (usize i = 0; i < content->indices.size(); ++ i) {
+    content->indices[i] = gridIndices[i % gridIndices.size()];
+  }
+  
+  // Let a few triangles use the duplicated vertices (instead of their source vertices), such that these are actually referenced
+  for (u32 i = 0; i < config.duplicatedVertexCount && i < content->indices.size(); ++ i) {
+    const usize index = (static_cast<usize>(i) * content->indices.size()) / config.duplicatedVertexCount;
+    content->indices[index] = config.uniqueVertexCount + i;
+    content->duplicatedVertexSourceIndices[i] = gridIndices[index % gridIndices.size()];
+  }
+  
+  // Deformation node assignments: Consecutive nodes along the vertex order, with random weights
+  const u32 nodesPerVertex = min(config.nodesPerVertex, config.deformationNodeCount);
+  std::uniform_int_distribution<u32> weightDistribution(1, 255);
+  
+  content->vertexWeights.resize(config.uniqueVertexCount);
+  for (u32 i = 0; i < config.uniqueVertexCount; ++ i) {
+    auto& weights = content->vertexWeights[i];
+    weights.nodeCount = nodesPerVertex;
+    
+    const u32 firstNode = (static_cast<u64>(i) * config.deformationNodeCount) / config.uniqueVertexCount;
+    u32 weightSum = 0;
+    for (u32 k = 0; k < nodesPerVertex; ++ k) {
+      weights.nodeIndices[k] = (firstNode + k) % config.deformationNodeCount;
+      weights.nodeWeights[k] = weightDistribution(*rng);
+      weightSum += weights.nodeWeights[k];
+    }
+    
+    // Normalize the weights to sum up to (approximately) 255
+    for (u32 k = 0; k < nodesPerVertex; ++ k) {
+      weights.nodeWeights[k] = max<u32>(1, (255 * weights.nodeWeights[k]) / weightSum);
+    }
+  }
+}
+
+/// Creates the deformation state of a frame: small rotations about the vertical axis plus small translations, varying over time.
+static void CreateDeformationState(const SyntheticXRVideoConfig& config, u32 frameIndex, XRVideoFrameContent* content) {
+  content->deformationState.resize(12 * config.deformationNodeCount);
+  
+  const float time = frameIndex / config.framesPerSecond;
+  for (u32 node = 0; node < config.deformationNodeCount; ++ node) {
+    const float angle = 0.05f * sinf(2 * time + 0.1f * node);
+    const float c = cosf(angle);
+    const float s = sinf(angle);
+    
+    float* state = content->deformationState.data() + 12 * node;
+    state[0] = c;   state[1] = 0;  state[2] = s;
+    state[3] = 0;   state[4] = 1;  state[5] = 0;
+    state[6] = -s;  state[7] = 0;  state[8] = c;
+    
+    state[9] = 0.02f * sinf(time + 0.3f * node);
+    state[10] = 0.01f * cosf(3 * time + 0.2f * node);
+    state[11] = 0.02f * cosf(time + 0.3f * node);
+  }
+}
+
+/// Creates the texture of a frame: a moving color gradient with some noise.
+static void CreateTexture(const SyntheticXRVideoConfig& config, u32 frameIndex, u32* noiseState, XRVideoFrameContent* content) {
+  content->textureWidth = config.textureWidth;
+  content->textureHeight = config.textureHeight;
+  content->textureRGB.resize(3ull * config.textureWidth * config.textureHeight);
+  
+  u8* ptr = content->textureRGB.data();
+  for (u32 y = 0; y < config.textureHeight; ++ y) {
+    for (u32 x = 0; x < config.textureWidth; ++ x) {
+      // Cheap xorshift random numbers, since std::mt19937 would dominate the generation time for large textures
+      u32 noise = 0;
+      if (config.textureNoise > 0) {
+        *noiseState ^= *noiseState << 13;
+        *noiseState ^= *noiseState >> 17;
+        *noiseState ^= *noiseState << 5;
+        noise = *noiseState % (config.textureNoise + 1);
+      }
+      
+      ptr[0] = (x + 4 * frameIndex + noise) & 0xff;
+      ptr[1] = (y + 2 * frameIndex + noise) & 0xff;
+      ptr[2] = ((x + y) / 2 + noise) & 0xff;
+      ptr += 3;
+    }
+  }
+}
+
+bool GenerateSyntheticXRVideo(const SyntheticXRVideoConfig& config, const fs::path& path) {
+  // Validate the config
+  if (config.frameCount == 0 || config.keyframeInterval == 0 || config.framesPerSecond <= 0) {
+    LOG(ERROR) << "frameCount, keyframeInterval, and framesPerSecond must be positive";
+    return false;
+  }
+  if (config.uniqueVertexCount < 4 || config.uniqueVertexCount + config.duplicatedVertexCount > numeric_limits<u16>::max()) {
+    LOG(ERROR) << "The vertex count must be at least 4, and the total vertex count (unique plus duplicated) must fit into 16 bits";
+    return false;
+  }
+  if (config.triangleCount == 0) {
+    LOG(ERROR) << "triangleCount must be positive";
+    return false;
+  }
+  if (config.deformationNodeCount == 0 || config.deformationNodeCount >= 0x3fff) {
+    LOG(ERROR) << "deformationNodeCount must be in [1, " << (0x3fff - 1) << "]";
+    return false;
+  }
+  if (config.nodesPerVertex < 1 || config.nodesPerVertex > 4) {
+    LOG(ERROR) << "nodesPerVertex must be in [1, 4]";
+    return false;
+  }
+  if (config.textureNoise > 255) {
+    LOG(ERROR) << "textureNoise must be in [0, 255]";
+    return false;
+  }
+  
+  XRVideoMetadata metadata;
+  metadata.lookAtX = 0;
+  metadata.lookAtY = 0.5f * cylinderHeight;
+  metadata.lookAtZ = 0;
+  metadata.radius = 3;
+  metadata.yaw = 0;
+  metadata.pitch = 0;
+  
+  XRVideoWriter writer;
+  if (!writer.Open(path, config.writeMetadata ? &metadata : nullptr, config.zstdCompressionLevel)) { return false; }
+  
+  std::mt19937 rng(config.seed);
+  u32 noiseState = config.seed * 2654435761u + 1;  // xorshift must not be seeded with zero
+  
+  const double frameDuration = 1e9 / config.framesPerSecond;
+  XRVideoFrameContent content;
+  
+  for (u32 frameIndex = 0; frameIndex < config.frameCount; ++ frameIndex) {
+    content.isKeyframe = (frameIndex % config.keyframeInterval) == 0;
+    content.startTimestamp = static_cast<s64>(std::round(frameIndex * frameDuration));
+    content.endTimestamp = static_cast<s64>(std::round((frameIndex + 1) * frameDuration));
+    
+    if (content.isKeyframe) {
+      CreateKeyframeMesh(config, &rng, &content);
+    }
+    CreateDeformationState(config, frameIndex, &content);
+    CreateTexture(config, frameIndex, &noiseState, &content);
+    
+    if (config.vertexAlpha) {
+      const u32 vertexCount = config.uniqueVertexCount + config.duplicatedVertexCount;
+      content.vertexAlpha.resize(vertexCount);
+      for (u32 i = 0; i < vertexCount; ++ i) {
+        content.vertexAlpha[i] = 127 + (((i + frameIndex) % 256) / 2);
+      }
+    }
+    
+    if (!writer.WriteFrame(content)) {
+      LOG(ERROR) << "Failed to write frame " << frameIndex;
+      return false;
+    }
+  }
+  
+  return writer.Close();
+}
+
+}
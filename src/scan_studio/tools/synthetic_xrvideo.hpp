@@ -0,0 +1,62 @@
+#pragma once
+
+#include <libvis/io/filesystem.h>
+#include <libvis/vulkan/libvis.h>
+
+namespace scan_studio {
+using namespace vis;
+
+/// Parameters for GenerateSyntheticXRVideo().
+struct SyntheticXRVideoConfig {
+  /// Number of frames in the video.
+  u32 frameCount = 300;
+  
+  /// Frame rate, determining the frame timestamps.
+  float framesPerSecond = 30;
+  
+  /// Every keyframeInterval-th frame is a keyframe (starting with the first frame).
+  u32 keyframeInterval = 30;
+  
+  /// Number of unique vertices of each keyframe mesh. These are arranged in a grid that is wrapped around a cylinder.
+  u32 uniqueVertexCount = 20000;
+  
+  /// Number of duplicated vertices (vertices with the same position as a unique vertex, but different texture coordinates).
+  u32 duplicatedVertexCount = 1000;
+  
+  /// Number of triangles of each keyframe mesh. If this exceeds the number of triangles in the vertex grid, the grid's triangles are repeated.
+  u32 triangleCount = 40000;
+  
+  /// Number of deformation nodes.
+  u32 deformationNodeCount = 500;
+  
+  /// Maximum number of deformation nodes that a vertex is assigned to (1 to 4).
+  u32 nodesPerVertex = 4;
+  
+  /// Texture size.
+  u32 textureWidth = 1024;
+  u32 textureHeight = 1024;
+  
+  /// Amount of random noise added to the texture, in [0, 255].
+  /// This controls how well the textures compress, with 0 being a smooth gradient.
+  u32 textureNoise = 8;
+  
+  /// Whether to store vertex alpha values.
+  bool vertexAlpha = false;
+  
+  /// Whether to write a metadata chunk.
+  bool writeMetadata = true;
+  
+  /// zstd compression level for all compressed parts of the frames.
+  int zstdCompressionLevel = 3;
+  
+  /// Seed for the random number generator, such that videos are reproducible.
+  u32 seed = 0;
+};
+
+/// Generates an XRVideo with synthetic content according to the given config and writes it to the given path.
+/// The result is deterministic for a given config. It does not look like anything meaningful, but exercises
+/// all parts of the decoding pipeline, except for AV.1 texture decoding (since the textures are stored with zstd).
+/// Returns true on success, false on failure.
+bool GenerateSyntheticXRVideo(const SyntheticXRVideoConfig& config, const fs::path& path);
+
+}
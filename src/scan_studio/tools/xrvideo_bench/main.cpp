@@ -0,0 +1,454 @@
+#define LOGURU_REPLACE_GLOG 1
+#include <loguru.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+  #include <windows.h>
+  #include <psapi.h>
+#else
+  #include <sys/resource.h>
+#endif
+
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+#include "scan_studio/tools/synthetic_xrvideo.hpp"
+#include "scan_studio/viewer_common/timing.hpp"
+#include "scan_studio/viewer_common/xrvideo/external/external_xrvideo.hpp"
+#include "scan_studio/viewer_common/xrvideo/pipeline_statistics.hpp"
+
+using namespace scan_studio;
+
+/// Frame user data for the benchmark: plain CPU buffers that the frames get decoded into.
+struct BenchmarkFrame {
+  vector<u8> vertices;
+  vector<u8> indices;
+  vector<u8> deformation;
+  vector<u8> texture;
+};
+
+/// Video user data for the benchmark.
+struct BenchmarkVideo {
+  atomic<u32> transferredFrameCount = {0};
+};
+
+static void* ConstructFrame(void* /*videoUserData*/) {
+  return new BenchmarkFrame();
+}
+
+static void DestructFrame(void* /*videoUserData*/, void* frameUserData) {
+  delete reinterpret_cast<BenchmarkFrame*>(frameUserData);
+}
+
+static SRBool32 PrepareDecodeFrame(
+    void* /*videoUserData*/,
+    void* frameUserData,
+    const SRPlayer_XRVideo_Frame_Metadata* frameMetadata,
+    void** outVertices,
+    void** outIndices,
+    void** outDeformation,
+    void** outTexture,
+    void** /*outDuplicatedVertexSourceIndices*/) {
+  BenchmarkFrame* frame = reinterpret_cast<BenchmarkFrame*>(frameUserData);
+  
+  // The buffers keep their capacity, so they only get re-allocated when a frame needs more space than before
+  if (frameMetadata->isKeyframe) {
+    frame->vertices.resize(frameMetadata->renderableVertexDataSize);
+    frame->indices.resize(frameMetadata->indexDataSize);
+  }
+  frame->deformation.resize(frameMetadata->deformationDataSize);
+  
+  // Reserve space for RGB, which is larger than what is required for YUV420
+  frame->texture.resize(3 * frameMetadata->textureWidth * frameMetadata->textureHeight);
+  
+  *outVertices = frame->vertices.data();
+  *outIndices = frame->indices.data();
+  *outDeformation = frame->deformation.data();
+  *outTexture = frame->texture.data();
+  return SRV_TRUE;
+}
+
+static SRBool32 AfterDecodeFrame(
+    void* /*videoUserData*/,
+    void* /*frameUserData*/,
+    const SRPlayer_XRVideo_Frame_Metadata* /*frameMetadata*/,
+    uint32_t /*vertexAlphaSize*/,
+    uint8_t* /*vertexAlpha*/) {
+  return SRV_TRUE;
+}
+
+static void TransferFrame(
+    void* videoUserData,
+    void* /*frameUserData*/,
+    const SRPlayer_XRVideo_Frame_Metadata* /*frameMetadata*/) {
+  ++ reinterpret_cast<BenchmarkVideo*>(videoUserData)->transferredFrameCount;
+}
+
+/// Returns the peak resident set size of the process in bytes, or 0 if it cannot be determined.
+static u64 GetPeakResidentSetSize() {
+  #ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) { return 0; }
+    return counters.PeakWorkingSetSize;
+  #else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+    #ifdef __APPLE__
+      return usage.ru_maxrss;  // in bytes
+    #else
+      return static_cast<u64>(usage.ru_maxrss) * 1024;  // in kilobytes
+    #endif
+  #endif
+}
+
+/// Appends a JSON object with the count, mean, and percentiles of the given durations (in nanoseconds) to the stream, in milliseconds.
+static void WriteLatencyJSON(vector<s64>* nanoseconds, ostringstream* json) {
+  double sum = 0;
+  for (s64 value : *nanoseconds) { sum += value; }
+  const double mean = nanoseconds->empty() ? 0 : (sum / nanoseconds->size());
+  
+  *json << "{\"count\": " << nanoseconds->size()
+        << ", \"meanMs\": " << (1e-6 * mean)
+        << ", \"p50Ms\": " << (1e-6 * XRVideoPipelineStatistics::Percentile(nanoseconds, 50))
+        << ", \"p90Ms\": " << (1e-6 * XRVideoPipelineStatistics::Percentile(nanoseconds, 90))
+        << ", \"p99Ms\": " << (1e-6 * XRVideoPipelineStatistics::Percentile(nanoseconds, 99))
+        << ", \"maxMs\": " << (1e-6 * XRVideoPipelineStatistics::Percentile(nanoseconds, 100))
+        << "}";
+}
+
+/// Escapes backslashes and quotes for use in a JSON string.
+static string EscapeJSON(const string& text) {
+  string result;
+  result.reserve(text.size());
+  for (char c : text) {
+    if (c == '\\' || c == '"') { result += '\\'; }
+    result += c;
+  }
+  return result;
+}
+
+/// Calls Update(0) on the video until the given condition holds, or until the timeout is reached.
+/// Returns true if the condition holds, false on timeout.
+template <typename Condition>
+static bool WaitFor(ExternalXRVideo* video, double timeoutSeconds, Condition condition) {
+  const TimePoint startTime = Clock::now();
+  while (true) {
+    video->Update(0);
+    if (condition()) { return true; }
+    if (SecondsFromTo(startTime, Clock::now()) > timeoutSeconds) { return false; }
+    this_thread::sleep_for(chrono::microseconds(100));
+  }
+}
+
+static void PrintUsage(const char* programName) {
+  printf("Usage: %s [options] <video.xrv>\n", programName);
+  printf("\n");
+  printf("Plays the given XRVideo headlessly as fast as possible (with no-op external frame callbacks)\n");
+  printf("and reports decoding throughput, per-stage latencies, seek latencies, and the peak memory usage as JSON.\n");
+  printf("\n");
+  printf("Options:\n");
+  printf("  --synthetic          Benchmark a synthetic video (generated in-process with default settings, which adds to the peak memory usage) instead of a file\n");
+  printf("  --cached-frames <n>  Size of the decoded frame cache (default: 30)\n");
+  printf("  --decompression-workers <n>  Worker threads for parallel intra-frame decompression (default: 0)\n");
+  printf("  --decoding-workers <n>  Workers that decode consecutive frames concurrently (default: 1)\n");
+  printf("  --backward           Play the video backwards, starting from its last frame\n");
+  printf("  --seeks <n>          Number of random seeks to measure after playback (default: 50)\n");
+  printf("  --scrubs <n>         Number of small seeks around the previous position (scrubbing) to measure after the random seeks (default: 100)\n");
+  printf("  --seed <n>           Random seed for the seek targets (default: 0)\n");
+  printf("  --timeout <s>        Timeout in seconds for waiting on any single frame (default: 10)\n");
+  printf("  --label <text>       Label to store in the output, e.g., a commit hash\n");
+  printf("  --output <path>      Write the JSON to this file instead of stdout\n");
+  printf("  --verbose            Enable all log output (this adds logging overhead to the measured timings)\n");
+}
+
+int main(int argc, char** argv) {
+  loguru::g_preamble_date = false;
+  loguru::g_preamble_thread = false;
+  loguru::g_preamble_uptime = false;
+  
+  const char* videoPath = nullptr;
+  bool useSyntheticVideo = false;
+  bool playBackward = false;
+  int cachedDecodedFrameCount = 30;
+  int decompressionWorkerCount = 0;
+  int decodingWorkerCount = 1;
+  int seekCount = 50;
+  int scrubCount = 100;
+  u32 seed = 0;
+  double timeoutSeconds = 10;
+  string label;
+  const char* outputPath = nullptr;
+  
+  for (int i = 1; i < argc; ++ i) {
+    const char* arg = argv[i];
+    
+    // Flags without a value
+    if (strcmp(arg, "--synthetic") == 0) {
+      useSyntheticVideo = true;
+      continue;
+    } else if (strcmp(arg, "--backward") == 0) {
+      playBackward = true;
+      continue;
+    } else if (strcmp(arg, "--verbose") == 0) {
+      loguru::g_stderr_verbosity = loguru::Verbosity_MAX;
+      continue;
+    } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+      PrintUsage(argv[0]);
+      return 0;
+    } else if (arg[0] != '-') {
+      if (videoPath) {
+        LOG(ERROR) << "More than one video path given";
+        return 1;
+      }
+      videoPath = arg;
+      continue;
+    }
+    
+    // Options with a value
+    if (i + 1 >= argc) {
+      LOG(ERROR) << "Missing value for option: " << arg;
+      return 1;
+    }
+    const char* value = argv[++ i];
+    
+    if (strcmp(arg, "--cached-frames") == 0) {
+      cachedDecodedFrameCount = atoi(value);
+    } else if (strcmp(arg, "--decompression-workers") == 0) {
+      decompressionWorkerCount = atoi(value);
+    } else if (strcmp(arg, "--decoding-workers") == 0) {
+      decodingWorkerCount = atoi(value);
+    } else if (strcmp(arg, "--seeks") == 0) {
+      seekCount = atoi(value);
+    } else if (strcmp(arg, "--scrubs") == 0) {
+      scrubCount = atoi(value);
+    } else if (strcmp(arg, "--seed") == 0) {
+      seed = atoi(value);
+    } else if (strcmp(arg, "--timeout") == 0) {
+      timeoutSeconds = atof(value);
+    } else if (strcmp(arg, "--label") == 0) {
+      label = value;
+    } else if (strcmp(arg, "--output") == 0) {
+      outputPath = value;
+    } else {
+      LOG(ERROR) << "Unknown option: " << arg;
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  
+  if (!videoPath == !useSyntheticVideo) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  
+  fs::path path;
+  if (useSyntheticVideo) {
+    path = fs::temp_directory_path() / "xrvideo_bench_synthetic.xrv";
+    if (!GenerateSyntheticXRVideo(SyntheticXRVideoConfig(), path)) {
+      LOG(ERROR) << "Failed to generate the synthetic video";
+      return 1;
+    }
+  } else {
+    path = videoPath;
+  }
+  
+  // Set up the video with no-op external callbacks
+  BenchmarkVideo benchmarkVideo;
+  
+  SRPlayer_XRVideo_External_Config callbacks;
+  callbacks.constructFrameCallback = &ConstructFrame;
+  callbacks.destructFrameCallback = &DestructFrame;
+  callbacks.decodingThread_prepareDecodeFrameCallback = &PrepareDecodeFrame;
+  callbacks.decodingThread_afterDecodeFrameCallback = &AfterDecodeFrame;
+  callbacks.transferThread_transferFrameCallback = &TransferFrame;
+  callbacks.videoUserData = &benchmarkVideo;
+  
+  XRVideoPipelineStatistics statistics;
+  
+  unique_ptr<ExternalXRVideo> video(new ExternalXRVideo(callbacks));
+  if (!video->Initialize(cachedDecodedFrameCount, /*verboseDecoding*/ false, /*commonResources*/ nullptr)) {
+    LOG(ERROR) << "Failed to initialize the video";
+    return 1;
+  }
+  video->SetPipelineStatistics(&statistics);
+  video->SetDecompressionWorkerCount(decompressionWorkerCount);
+  video->SetDecodingWorkerCount(decodingWorkerCount);
+  
+  const TimePoint openTime = Clock::now();
+  
+  MappedFileInputStream* inputStream = new MappedFileInputStream();
+  if (!inputStream->Open(path)) {
+    LOG(ERROR) << "Failed to open file: " << path;
+    delete inputStream;
+    return 1;
+  }
+  if (!video->TakeAndOpen(inputStream, /*isStreamingInputStream*/ false, /*cacheAllFrames*/ false, /*isMappedFileInputStream*/ true)) {
+    LOG(ERROR) << "Failed to open the video: " << path;
+    return 1;
+  }
+  
+  if (!WaitFor(video.get(), timeoutSeconds, [&]() { return video->GetAsyncLoadState() != XRVideoAsyncLoadState::Loading; }) ||
+      video->GetAsyncLoadState() != XRVideoAsyncLoadState::Ready) {
+    LOG(ERROR) << "Failed to load the video: " << path;
+    return 1;
+  }
+  video->GetPlaybackState().SetPlaybackMode(PlaybackMode::SingleShot);
+  
+  const FrameIndex& index = video->Index();
+  const int frameCount = index.GetFrameCount();
+  
+  // Playback: Advance to the next frame as soon as the current one is ready for display
+  if (playBackward) {
+    video->Seek(index.At(frameCount - 1).GetTimestamp(), /*forward*/ false);
+  }
+  if (!WaitFor(video.get(), timeoutSeconds, [&]() { return video->IsCurrentFrameDisplayReady(); })) {
+    LOG(ERROR) << "Timeout while waiting for the first frame";
+    return 1;
+  }
+  const double timeToFirstFrameMs = MillisecondsFromTo(openTime, Clock::now());
+  
+  const TimePoint playbackStartTime = Clock::now();
+  TimePoint lastProgressTime = playbackStartTime;
+  int displayedFrameCount = 0;
+  int lastDisplayedFrameIndex = -1;
+  
+  while (true) {
+    const s64 playbackTime = video->Update(0);
+    const int frameIndex = index.FindFrameIndexForTimestamp(playbackTime);
+    
+    if (frameIndex != lastDisplayedFrameIndex && video->IsCurrentFrameDisplayReady()) {
+      // "Display" the frame by taking a render lock for it
+      video->CreateRenderLock().reset();
+      ++ displayedFrameCount;
+      lastDisplayedFrameIndex = frameIndex;
+      lastProgressTime = Clock::now();
+      
+      if (frameIndex < 0 || (playBackward ? (frameIndex == 0) : (frameIndex >= frameCount - 1))) {
+        break;
+      }
+    }
+    
+    // Try to advance to the next frame (for backward playback, to just before the start of the current frame).
+    // This does not advance while the video is buffering.
+    if (frameIndex == lastDisplayedFrameIndex) {
+      const s64 elapsedTime = playBackward ? (playbackTime - index.At(frameIndex).GetTimestamp() + 1) : (index.At(frameIndex + 1).GetTimestamp() - playbackTime);
+      if (video->Update(elapsedTime) != playbackTime) {
+        continue;
+      }
+    }
+    
+    if (SecondsFromTo(lastProgressTime, Clock::now()) > timeoutSeconds) {
+      LOG(ERROR) << "Timeout during playback after frame " << lastDisplayedFrameIndex;
+      return 1;
+    }
+    this_thread::sleep_for(chrono::microseconds(50));
+  }
+  
+  const double playbackSeconds = SecondsFromTo(playbackStartTime, Clock::now());
+  const u32 transferredFrameCount = benchmarkVideo.transferredFrameCount;
+  
+  // Collect the pipeline statistics of the playback part before they get mixed with the seeking part
+  vector<s64> stageSamples[static_cast<int>(XRVideoPipelineStage::Count)];
+  for (int stage = 0; stage < static_cast<int>(XRVideoPipelineStage::Count); ++ stage) {
+    stageSamples[stage] = statistics.GetSamples(static_cast<XRVideoPipelineStage>(stage));
+  }
+  
+  // Seeking: Measure the time from Seek() until the seeked-to frame is ready for display
+  vector<s64> seekNanoseconds;
+  seekNanoseconds.reserve(seekCount);
+  
+  mt19937 generator(seed);
+  uniform_int_distribution<int> frameDistribution(0, frameCount - 1);
+  
+  for (int seekIndex = 0; seekIndex < seekCount; ++ seekIndex) {
+    const int targetFrameIndex = frameDistribution(generator);
+    
+    const TimePoint seekStartTime = Clock::now();
+    video->Seek(index.At(targetFrameIndex).GetTimestamp(), /*forward*/ true);
+    if (!WaitFor(video.get(), timeoutSeconds, [&]() { return video->IsCurrentFrameDisplayReady(); })) {
+      LOG(ERROR) << "Timeout while seeking to frame " << targetFrameIndex;
+      return 1;
+    }
+    seekNanoseconds.push_back(NanosecondsFromTo(seekStartTime, Clock::now()));
+  }
+  
+  // Scrubbing: Measure the same for small seeks that mostly go forward from the previous position, as when dragging
+  // a seek bar slowly. Most of these stay within the group of pictures of the previous position.
+  vector<s64> scrubNanoseconds;
+  scrubNanoseconds.reserve(scrubCount);
+  
+  uniform_int_distribution<int> scrubStepDistribution(-2, 6);
+  int scrubFrameIndex = frameDistribution(generator);
+  
+  for (int scrubIndex = 0; scrubIndex < scrubCount; ++ scrubIndex) {
+    scrubFrameIndex = clamp(scrubFrameIndex + scrubStepDistribution(generator), 0, frameCount - 1);
+    
+    const TimePoint seekStartTime = Clock::now();
+    video->Seek(index.At(scrubFrameIndex).GetTimestamp(), /*forward*/ true);
+    if (!WaitFor(video.get(), timeoutSeconds, [&]() { return video->IsCurrentFrameDisplayReady(); })) {
+      LOG(ERROR) << "Timeout while scrubbing to frame " << scrubFrameIndex;
+      return 1;
+    }
+    scrubNanoseconds.push_back(NanosecondsFromTo(seekStartTime, Clock::now()));
+  }
+  
+  video->Destroy();
+  video.reset();
+  
+  if (useSyntheticVideo) {
+    fs::remove(path);
+  }
+  
+  // Output
+  static const char* stageNames[static_cast<int>(XRVideoPipelineStage::Count)] = {"reading", "videoDecoding", "contentDecoding", "transfer"};
+  
+  ostringstream json;
+  json << std::setprecision(6);
+  json << "{\n";
+  json << "  \"label\": \"" << EscapeJSON(label) << "\",\n";
+  json << "  \"video\": \"" << EscapeJSON(useSyntheticVideo ? string("synthetic") : path.string()) << "\",\n";
+  json << "  \"frameCount\": " << frameCount << ",\n";
+  json << "  \"cachedDecodedFrameCount\": " << cachedDecodedFrameCount << ",\n";
+  json << "  \"decompressionWorkerCount\": " << decompressionWorkerCount << ",\n";
+  json << "  \"decodingWorkerCount\": " << decodingWorkerCount << ",\n";
+  json << "  \"backward\": " << (playBackward ? "true" : "false") << ",\n";
+  json << "  \"timeToFirstFrameMs\": " << timeToFirstFrameMs << ",\n";
+  json << "  \"playback\": {\"seconds\": " << playbackSeconds
+       << ", \"displayedFrames\": " << displayedFrameCount
+       << ", \"decodedFrames\": " << transferredFrameCount
+       << ", \"displayedFps\": " << (displayedFrameCount / playbackSeconds)
+       << ", \"decodedFps\": " << (transferredFrameCount / playbackSeconds) << "},\n";
+  json << "  \"stages\": {\n";
+  for (int stage = 0; stage < static_cast<int>(XRVideoPipelineStage::Count); ++ stage) {
+    json << "    \"" << stageNames[stage] << "\": ";
+    WriteLatencyJSON(&stageSamples[stage], &json);
+    json << ((stage + 1 < static_cast<int>(XRVideoPipelineStage::Count)) ? ",\n" : "\n");
+  }
+  json << "  },\n";
+  json << "  \"seekToDisplay\": ";
+  WriteLatencyJSON(&seekNanoseconds, &json);
+  json << ",\n";
+  json << "  \"scrubToDisplay\": ";
+  WriteLatencyJSON(&scrubNanoseconds, &json);
+  json << ",\n";
+  json << "  \"peakRssBytes\": " << GetPeakResidentSetSize() << "\n";
+  json << "}\n";
+  
+  if (outputPath) {
+    ofstream file(outputPath, ios::out | ios::binary);
+    file << json.str();
+    if (!file) {
+      LOG(ERROR) << "Failed to write the output file: " << outputPath;
+      return 1;
+    }
+  } else {
+    printf("%s", json.str().c_str());
+  }
+  
+  return 0;
+}
@@ -0,0 +1,696 @@
+#define LOGURU_REPLACE_GLOG 1
+#include <loguru.hpp>
+
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <zstd.h>
+
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+#include "scan_studio/common/slot_queue.hpp"
+#include "scan_studio/common/xrvideo_file.hpp"
+#include "scan_studio/tools/synthetic_xrvideo.hpp"
+#include "scan_studio/viewer_common/streaming_input_stream.hpp"
+#include "scan_studio/viewer_common/test/http_request_mock.hpp"
+#include "scan_studio/viewer_common/timing.hpp"
+#include "scan_studio/viewer_common/xrvideo/dav1d_picture_pool.hpp"
+#include "scan_studio/viewer_common/xrvideo/decoded_frame_cache.hpp"
+#include "scan_studio/viewer_common/xrvideo/deformation_state_decoding.hpp"
+#include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
+#include "scan_studio/viewer_common/xrvideo/index.hpp"
+#include "scan_studio/viewer_common/xrvideo/playback_state.hpp"
+
+using namespace scan_studio;
+
+/// Runs the given function `iterations` times and returns the minimum duration of a single run in nanoseconds.
+template <typename Func>
+static s64 MeasureMinimumNanoseconds(int iterations, Func func) {
+  s64 minimum = numeric_limits<s64>::max();
+  for (int i = 0; i < iterations; ++ i) {
+    const TimePoint startTime = Clock::now();
+    func();
+    minimum = std::min(minimum, NanosecondsFromTo(startTime, Clock::now()));
+  }
+  return minimum;
+}
+
+/// Like MeasureMinimumNanoseconds(), but for two functions that are run alternately (in ABBA order),
+/// such that neither of them systematically benefits from the caches being warmed up by the other.
+template <typename FuncA, typename FuncB>
+static void MeasureMinimumNanosecondsInterleaved(int iterations, FuncA funcA, FuncB funcB, s64* minimumA, s64* minimumB) {
+  *minimumA = numeric_limits<s64>::max();
+  *minimumB = numeric_limits<s64>::max();
+  
+  auto measureA = [&]() {
+    const TimePoint startTime = Clock::now();
+    funcA();
+    *minimumA = std::min(*minimumA, NanosecondsFromTo(startTime, Clock::now()));
+  };
+  auto measureB = [&]() {
+    const TimePoint startTime = Clock::now();
+    funcB();
+    *minimumB = std::min(*minimumB, NanosecondsFromTo(startTime, Clock::now()));
+  };
+  
+  for (int i = 0; i < iterations; ++ i) {
+    if (i % 2 == 0) {
+      measureA();
+      measureB();
+    } else {
+      measureB();
+      measureA();
+    }
+  }
+}
+
+static void BenchmarkDeformationStateDecoding(int nodeCount, int iterations) {
+  // Generate values in the range in which deformation state values usually are
+  mt19937 generator(0);
+  uniform_real_distribution<float> distribution(-1.f, 1.f);
+  
+  vector<u16> encodedValues(12 * nodeCount);
+  for (u16& value : encodedValues) {
+    const Eigen::half halfValue(distribution(generator));
+    memcpy(&value, &halfValue, sizeof(u16));
+  }
+  vector<float> decodedValues(encodedValues.size());
+  
+  const s64 scalarNanoseconds = MeasureMinimumNanoseconds(iterations, [&]() {
+    XRVideoDecodeDeformationStateScalar(encodedValues.data(), encodedValues.size(), decodedValues.data());
+  });
+  const s64 simdNanoseconds = MeasureMinimumNanoseconds(iterations, [&]() {
+    XRVideoDecodeDeformationState(encodedValues.data(), encodedValues.size(), decodedValues.data());
+  });
+  
+  printf("Deformation state decoding (%d nodes):\n", nodeCount);
+  printf("  scalar: %9.3f us\n", 1e-3 * scalarNanoseconds);
+  printf("  %-6s: %9.3f us  (%.2fx)\n", XRVideoDeformationStateDecodingInstructionSet(), 1e-3 * simdNanoseconds, scalarNanoseconds / static_cast<double>(std::max<s64>(1, simdNanoseconds)));
+}
+
+static bool BenchmarkKeyframeDecoding(u32 vertexCount, int iterations) {
+  // Create a single-keyframe synthetic video, with 5% of the vertices being duplicated vertices
+  SyntheticXRVideoConfig config;
+  config.frameCount = 1;
+  config.duplicatedVertexCount = vertexCount / 20;
+  config.uniqueVertexCount = vertexCount - config.duplicatedVertexCount;
+  config.triangleCount = 2 * vertexCount;
+  config.textureWidth = 16;
+  config.textureHeight = 16;
+  
+  const fs::path path = fs::temp_directory_path() / "xrvideo_microbench_keyframe.xrv";
+  if (!GenerateSyntheticXRVideo(config, path)) {
+    LOG(ERROR) << "Failed to generate the synthetic video";
+    return false;
+  }
+  
+  MappedFileInputStream* stream = new MappedFileInputStream();
+  if (!stream->Open(path)) {
+    delete stream;
+    return false;
+  }
+  XRVideoReader reader;
+  reader.TakeInputStream(stream, /*isStreamingInputStream*/ false, /*isMappedFileInputStream*/ true);
+  
+  XRVideoFrameView view;
+  if (!reader.FindNextChunk(xrVideoFrameChunkIdentifierV0) || !reader.ReadNextFrameView(&view)) {
+    LOG(ERROR) << "Failed to read the keyframe";
+    return false;
+  }
+  
+  const u8* contentPtr = view.data;
+  XRVideoFrameMetadata metadata;
+  if (!XRVideoReadMetadata(&contentPtr, view.size, &metadata)) {
+    LOG(ERROR) << "Failed to read the keyframe's metadata";
+    return false;
+  }
+  
+  XRVideoDecodingContext decodingContext;
+  decodingContext.Initialize();
+  
+  vector<XRVideoVertex> vertices(metadata.GetRenderableVertexCount());
+  vector<u16> indices(metadata.indexCount);
+  vector<float> deformationState(12 * metadata.deformationNodeCount);
+  
+  bool success = true;
+  const s64 nanoseconds = MeasureMinimumNanoseconds(iterations, [&]() {
+    success &= XRVideoDecompressContent(
+        contentPtr, metadata, &decodingContext,
+        vertices.data(), indices.data(), deformationState.data(),
+        /*outDuplicatedVertexSourceIndices*/ nullptr, /*outVertexAlpha*/ nullptr, /*verboseDecoding*/ false);
+  });
+  
+  // Benchmark the renderable vertex creation by itself. The mesh data is the first part of the frame's content.
+  vector<u8> meshData(metadata.GetMeshDataSize());
+  if (ZSTD_isError(ZSTD_decompress(meshData.data(), meshData.size(), contentPtr, metadata.compressedMeshSize))) {
+    LOG(ERROR) << "Failed to decompress the keyframe's mesh data";
+    return false;
+  }
+  
+  XRVideoScratchBuffer twoPassScratch;
+  XRVideoScratchBuffer fusedScratch;
+  s64 twoPassNanoseconds;
+  s64 fusedNanoseconds;
+  MeasureMinimumNanosecondsInterleaved(
+      iterations,
+      [&]() { XRVideoDecodeRenderableVerticesTwoPass(metadata, meshData.data(), &twoPassScratch, vertices.data()); },
+      [&]() { XRVideoDecodeRenderableVertices(metadata, meshData.data(), &fusedScratch, vertices.data()); },
+      &twoPassNanoseconds, &fusedNanoseconds);
+  
+  printf("Keyframe content decoding (%u vertices, %u of them duplicated, %u triangles):\n", metadata.vertexCount, metadata.vertexCount - metadata.uniqueVertexCount, metadata.indexCount / 3);
+  printf("  XRVideoDecompressContent(): %9.3f us\n", 1e-3 * nanoseconds);
+  printf("  vertices, two-pass        : %9.3f us\n", 1e-3 * twoPassNanoseconds);
+  printf("  vertices, fused           : %9.3f us  (%.2fx)\n", 1e-3 * fusedNanoseconds, twoPassNanoseconds / static_cast<double>(std::max<s64>(1, fusedNanoseconds)));
+  
+  twoPassScratch.Release();
+  fusedScratch.Release();
+  decodingContext.Destroy();
+  reader.Close();
+  fs::remove(path);
+  return success;
+}
+
+/// Sets up the given picture like dav1d's default picture allocator does (with a stride that is padded
+/// to a multiple of 128, plus 64 bytes if it is a multiple of 1024), backed by the given storage.
+static void SetUpDefaultLayoutPicture(u32 size, vector<u8>* storage, Dav1dPicture* picture) {
+  const usize lumaStride = ((size + 127) & ~127) + ((size % 1024 == 0) ? DAV1D_PICTURE_ALIGNMENT : 0);
+  const usize chromaStride = lumaStride / 2;
+  
+  storage->assign(lumaStride * size + 2 * chromaStride * (size / 2) + DAV1D_PICTURE_ALIGNMENT, 0);
+  u8* data = reinterpret_cast<u8*>((reinterpret_cast<uintptr_t>(storage->data()) + DAV1D_PICTURE_ALIGNMENT - 1) & ~static_cast<uintptr_t>(DAV1D_PICTURE_ALIGNMENT - 1));
+  
+  picture->stride[0] = lumaStride;
+  picture->stride[1] = chromaStride;
+  picture->data[0] = data;
+  picture->data[1] = data + lumaStride * size;
+  picture->data[2] = data + lumaStride * size + chromaStride * (size / 2);
+}
+
+static bool BenchmarkTextureCopy(u32 size, int iterations) {
+  Dav1dPicture picture;
+  memset(&picture, 0, sizeof(picture));
+  picture.p.w = size;
+  picture.p.h = size;
+  picture.p.layout = DAV1D_PIXEL_LAYOUT_I420;
+  picture.p.bpc = 8;
+  
+  vector<u8> texture((3 * size * size) / 2);
+  
+  // Copying out of a picture with the stride of dav1d's default allocator
+  vector<u8> defaultLayoutStorage;
+  SetUpDefaultLayoutPicture(size, &defaultLayoutStorage, &picture);
+  
+  const s64 defaultLayoutNanoseconds = MeasureMinimumNanoseconds(iterations, [&]() {
+    XRVideoCopyTexture(picture, texture.data(), /*verboseDecoding*/ false);
+  });
+  
+  // Copying out of a picture from Dav1dPicturePool
+  Dav1dPicturePool pool;
+  if (pool.Dav1dAllocPictureCallback(&picture) != 0) {
+    LOG(ERROR) << "Failed to allocate a picture from the pool";
+    return false;
+  }
+  memset(picture.data[0], 0, (3 * size * size) / 2);
+  
+  const s64 pooledNanoseconds = MeasureMinimumNanoseconds(iterations, [&]() {
+    XRVideoCopyTexture(picture, texture.data(), /*verboseDecoding*/ false);
+  });
+  
+  pool.Dav1dReleasePictureCallback(&picture);
+  
+  // Allocating a picture buffer and writing to it (as dav1d does), with and without pooling.
+  // Without pooling, each fresh allocation of this size is typically backed by new pages, which get faulted in on the first write.
+  const s64 pooledAllocationNanoseconds = MeasureMinimumNanoseconds(iterations, [&]() {
+    pool.Dav1dAllocPictureCallback(&picture);
+    memset(picture.data[0], 1, (3 * size * size) / 2);
+    pool.Dav1dReleasePictureCallback(&picture);
+  });
+  const s64 unpooledAllocationNanoseconds = MeasureMinimumNanoseconds(iterations, [&]() {
+    Dav1dPicturePool unpooled;
+    unpooled.Dav1dAllocPictureCallback(&picture);
+    memset(picture.data[0], 1, (3 * size * size) / 2);
+    unpooled.Dav1dReleasePictureCallback(&picture);
+  });
+  
+  printf("Texture copy (%u x %u, %s layout from the pool):\n", size, size, XRVideoIsContiguousTexture(picture) ? "contiguous" : "padded");
+  printf("  copy, dav1d default stride: %9.3f us\n", 1e-3 * defaultLayoutNanoseconds);
+  printf("  copy, pooled picture      : %9.3f us  (%.2fx)\n", 1e-3 * pooledNanoseconds, defaultLayoutNanoseconds / static_cast<double>(std::max<s64>(1, pooledNanoseconds)));
+  printf("  allocate + write, unpooled: %9.3f us\n", 1e-3 * unpooledAllocationNanoseconds);
+  printf("  allocate + write, pooled  : %9.3f us  (%.2fx)\n", 1e-3 * pooledAllocationNanoseconds, unpooledAllocationNanoseconds / static_cast<double>(std::max<s64>(1, pooledAllocationNanoseconds)));
+  return true;
+}
+
+/// Work item that resembles those of the pipeline threads' work queues.
+struct QueueBenchmarkItem {
+  int frameIndex;
+  shared_ptr<const void> frameDataOwner;
+  s64 readingTime;
+};
+
+/// Work queue as the pipeline threads implemented it originally: heap-allocated items in a vector, erased from its front.
+class VectorWorkQueue {
+ public:
+  inline bool Empty() const { return queue.empty(); }
+  inline usize Size() const { return queue.size(); }
+  
+  inline void PushBack(QueueBenchmarkItem&& item) {
+    QueueBenchmarkItem* newItem = new QueueBenchmarkItem();
+    *newItem = std::move(item);
+    queue.push_back(newItem);
+  }
+  
+  inline QueueBenchmarkItem PopFront() {
+    QueueBenchmarkItem* frontItem = queue.front();
+    queue.erase(queue.begin());
+    QueueBenchmarkItem result = std::move(*frontItem);
+    delete frontItem;
+    return result;
+  }
+  
+ private:
+  vector<QueueBenchmarkItem*> queue;
+};
+
+/// Passes `itemCount` items from a producer to a consumer thread for each of `videoCount` videos concurrently,
+/// through a mutex-guarded QueueT with a condition variable, like the pipeline threads do.
+/// The producers queue up to `maxQueueSize` items ahead, similar to the read-ahead that is bounded by the decoded frame cache size.
+template <typename QueueT>
+static void RunQueueContention(int videoCount, int itemCount, usize maxQueueSize) {
+  struct Video {
+    mutex queueMutex;
+    condition_variable queueChangedCondition;
+    QueueT queue;
+  };
+  vector<unique_ptr<Video>> videos(videoCount);
+  for (auto& video : videos) {
+    video.reset(new Video());
+  }
+  
+  const shared_ptr<const void> frameDataOwner(new int(0));
+  
+  vector<std::thread> threads;
+  for (auto& videoPtr : videos) {
+    Video* video = videoPtr.get();
+    
+    threads.emplace_back([video, itemCount, maxQueueSize, &frameDataOwner]() {
+      for (int i = 0; i < itemCount; ++ i) {
+        unique_lock<mutex> lock(video->queueMutex);
+        while (video->queue.Size() >= maxQueueSize) {
+          video->queueChangedCondition.wait(lock);
+        }
+        video->queue.PushBack(QueueBenchmarkItem{i, frameDataOwner, 0});
+        lock.unlock();
+        video->queueChangedCondition.notify_all();
+      }
+    });
+    
+    threads.emplace_back([video, itemCount]() {
+      for (int i = 0; i < itemCount; ++ i) {
+        unique_lock<mutex> lock(video->queueMutex);
+        while (video->queue.Empty()) {
+          video->queueChangedCondition.wait(lock);
+        }
+        const QueueBenchmarkItem item = video->queue.PopFront();
+        lock.unlock();
+        video->queueChangedCondition.notify_all();
+        
+        if (item.frameIndex != i) {
+          LOG(FATAL) << "Queue items are out of order";
+        }
+      }
+    });
+  }
+  
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+static void BenchmarkQueueContention(int videoCount, int iterations) {
+  constexpr int itemCount = 20000;
+  constexpr usize maxQueueSize = 64;
+  
+  s64 vectorNanoseconds;
+  s64 slotQueueNanoseconds;
+  MeasureMinimumNanosecondsInterleaved(
+      iterations,
+      [&]() { RunQueueContention<VectorWorkQueue>(videoCount, itemCount, maxQueueSize); },
+      [&]() { RunQueueContention<SlotQueue<QueueBenchmarkItem>>(videoCount, itemCount, maxQueueSize); },
+      &vectorNanoseconds, &slotQueueNanoseconds);
+  
+  printf("Work queue contention (%d videos, %d items each, up to %d queued, %u hardware threads):\n", videoCount, itemCount, static_cast<int>(maxQueueSize), std::thread::hardware_concurrency());
+  printf("  vector of heap-allocated items: %9.3f ns/item\n", vectorNanoseconds / static_cast<double>(videoCount * itemCount));
+  printf("  SlotQueue                     : %9.3f ns/item  (%.2fx)\n", slotQueueNanoseconds / static_cast<double>(videoCount * itemCount), vectorNanoseconds / static_cast<double>(std::max<s64>(1, slotQueueNanoseconds)));
+}
+
+/// Minimal frame type for the DecodedFrameCache, which only accesses the frames' metadata.
+struct CacheBenchmarkFrame {
+  inline const XRVideoFrameMetadata& GetMetadata() const { return metadata; }
+  
+  XRVideoFrameMetadata metadata;
+};
+
+/// Loops a video with the given number of frames, using a decoded frame cache with the given capacity like the loading threads do:
+/// For each played frame, the cache items for decoding the next frames get locked (and the frames are "decoded" right away) until
+/// the cache is full, and the decoding progress is checked (as done while buffering, or when using an executor).
+/// Returns the average duration per played frame in nanoseconds. The initial filling of the cache is not measured.
+static double RunDecodedFrameCachePlayback(int capacity, int frameCount, int playedFrameCount) {
+  constexpr int keyframeInterval = 30;
+  constexpr s64 frameDuration = 33'333'333;
+  
+  FrameIndex index;
+  for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+    index.PushFrame(frameIndex * frameDuration, /*offset*/ frameIndex, /*isKeyframe*/ frameIndex % keyframeInterval == 0);
+  }
+  index.PushVideoEnd(frameCount * frameDuration, /*endOffset*/ frameCount);
+  
+  PlaybackState playbackState;
+  playbackState.SetPlaybackConditions(index.GetVideoStartTimestamp(), index.GetVideoEndTimestamp(), PlaybackMode::Loop, /*speed*/ 1);
+  playbackState.Seek(index.GetVideoStartTimestamp(), /*forward*/ true);
+  
+  auto getNextFramesIterator = [&]() {
+    playbackState.Lock();
+    const NextFramesIterator nextFramesIt(&playbackState, &index);
+    playbackState.Unlock();
+    return nextFramesIt;
+  };
+  
+  DecodedFrameCache<CacheBenchmarkFrame> cache;
+  cache.Initialize(capacity);
+  
+  auto decodeUntilCacheIsFull = [&]() {
+    while (true) {
+      vector<WriteLockedCachedFrame<CacheBenchmarkFrame>> lockedFrames = cache.LockCacheItemsForDecodingNextFrame(getNextFramesIterator(), index);
+      if (lockedFrames.empty()) {
+        break;
+      }
+      
+      for (const auto& lockedFrame : lockedFrames) {
+        XRVideoFrameMetadata& metadata = lockedFrame.GetFrame()->metadata;
+        metadata.startTimestamp = index.At(lockedFrame.GetFrameIndex()).GetTimestamp();
+        metadata.endTimestamp = index.At(lockedFrame.GetFrameIndex() + 1).GetTimestamp();
+      }
+    }
+  };
+  
+  decodeUntilCacheIsFull();
+  
+  const TimePoint startTime = Clock::now();
+  for (int i = 0; i < playedFrameCount; ++ i) {
+    playbackState.Advance(frameDuration);
+    decodeUntilCacheIsFull();
+    
+    int requiredFramesCount, readyFramesCount;
+    s64 readyFramesStartTime, readyFramesEndTime;
+    cache.CheckDecodingProgress(getNextFramesIterator(), &requiredFramesCount, &readyFramesCount, &readyFramesStartTime, &readyFramesEndTime);
+    if (readyFramesCount == 0) {
+      LOG(FATAL) << "The decoded frame cache has no ready frames";
+    }
+  }
+  const s64 nanoseconds = NanosecondsFromTo(startTime, Clock::now());
+  
+  cache.Destroy();
+  return nanoseconds / static_cast<double>(playedFrameCount);
+}
+
+static void BenchmarkDecodedFrameCache(int playedFrameCount) {
+  printf("Decoded frame cache, per played frame (looped playback, including decoding the next frame and checking the decoding progress):\n");
+  for (int capacity : {8, 64, 512, 3000, 10000}) {
+    // Caching all frames (where nothing needs to be decoded during playback), and a video that is four times longer than the cache
+    const double cacheAllFramesNanoseconds = RunDecodedFrameCachePlayback(capacity, capacity, playedFrameCount);
+    const double longerVideoNanoseconds = RunDecodedFrameCachePlayback(capacity, 4 * capacity, playedFrameCount);
+    
+    printf("  capacity %5d: all frames cached: %9.3f us, video 4x longer than the cache: %9.3f us\n", capacity, 1e-3 * cacheAllFramesNanoseconds, 1e-3 * longerVideoNanoseconds);
+  }
+}
+
+/// Reference implementation of the FrameIndex lookups as an array of FrameIndexItems,
+/// with a binary search over the items and a linear search for the base keyframe.
+class ReferenceFrameIndex {
+ public:
+  void PushItem(s64 timestamp, u64 offset, bool isKeyframe) {
+    frames.emplace_back(timestamp, offset, isKeyframe);
+  }
+  
+  int FindFrameIndexForTimestamp(s64 timestamp) const {
+    if (timestamp < frames.front().GetTimestamp() || timestamp > frames.back().GetTimestamp()) { return -1; }
+    
+    int lowest = 0;
+    int highest = frames.size() - 2;
+    while (lowest < highest) {
+      const int mid = (lowest + highest + 1) / 2;
+      if (frames[mid].GetTimestamp() > timestamp) {
+        highest = mid - 1;
+      } else {
+        lowest = mid;
+      }
+    }
+    return lowest;
+  }
+  
+  int FindBaseKeyframe(int frameIndex) const {
+    while (frameIndex >= 0 && !frames[frameIndex].IsKeyframe()) {
+      -- frameIndex;
+    }
+    return frameIndex;
+  }
+  
+ private:
+  vector<FrameIndexItem> frames;
+};
+
+static void BenchmarkFrameIndex(int frameCount, int iterations) {
+  constexpr int keyframeInterval = 300;
+  constexpr double framesPerSecond = 30;
+  constexpr int queryCount = 4096;
+  
+  printf("Frame index (%d frames, keyframe interval %d), per lookup:\n", frameCount, keyframeInterval);
+  
+  for (bool constantFrameRate : {true, false}) {
+    // For a variable frame rate, jitter the frame start timestamps by up to a millisecond
+    mt19937 generator(0);
+    uniform_int_distribution<s64> jitterDistribution(-1'000'000, 1'000'000);
+    
+    FrameIndex index;
+    ReferenceFrameIndex referenceIndex;
+    for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+      // Round the timestamps like video files do, such that the frame durations alternate between 33333333 and 33333334 ns
+      const s64 timestamp = llround(frameIndex * 1e9 / framesPerSecond) + ((constantFrameRate || frameIndex == 0) ? 0 : jitterDistribution(generator));
+      const bool isKeyframe = frameIndex % keyframeInterval == 0;
+      index.PushFrame(timestamp, /*offset*/ frameIndex, isKeyframe);
+      referenceIndex.PushItem(timestamp, /*offset*/ frameIndex, isKeyframe);
+    }
+    const s64 endTimestamp = llround(frameCount * 1e9 / framesPerSecond);
+    index.PushVideoEnd(endTimestamp, /*endOffset*/ frameCount);
+    referenceIndex.PushItem(endTimestamp, /*offset*/ frameCount, /*isKeyframe*/ false);
+    
+    uniform_int_distribution<s64> timestampDistribution(index.GetVideoStartTimestamp(), index.GetVideoEndTimestamp());
+    uniform_int_distribution<int> frameDistribution(0, frameCount - 1);
+    vector<s64> queryTimestamps(queryCount);
+    vector<int> queryFrames(queryCount);
+    for (int i = 0; i < queryCount; ++ i) {
+      queryTimestamps[i] = timestampDistribution(generator);
+      queryFrames[i] = frameDistribution(generator);
+    }
+    
+    // Verify that the constant frame rate is detected, and that both implementations agree
+    if (index.HasConstantFrameRate() != constantFrameRate) {
+      LOG(FATAL) << "The frame index did not detect the " << (constantFrameRate ? "constant" : "variable") << " frame rate";
+    }
+    for (int i = 0; i < queryCount; ++ i) {
+      int baseKeyframe, predecessor;
+      index.FindDependencyFrames(queryFrames[i], &baseKeyframe, &predecessor);
+      if (index.FindFrameIndexForTimestamp(queryTimestamps[i]) != referenceIndex.FindFrameIndexForTimestamp(queryTimestamps[i]) ||
+          (baseKeyframe >= 0 ? baseKeyframe : queryFrames[i]) != referenceIndex.FindBaseKeyframe(queryFrames[i])) {
+        LOG(FATAL) << "The frame index lookups differ from the reference implementation";
+      }
+    }
+    
+    int checksum = 0;
+    s64 referenceNanoseconds, nanoseconds;
+    MeasureMinimumNanosecondsInterleaved(iterations, [&]() {
+      for (s64 timestamp : queryTimestamps) { checksum += referenceIndex.FindFrameIndexForTimestamp(timestamp); }
+    }, [&]() {
+      for (s64 timestamp : queryTimestamps) { checksum += index.FindFrameIndexForTimestamp(timestamp); }
+    }, &referenceNanoseconds, &nanoseconds);
+    
+    printf("  FindFrameIndexForTimestamp (%s frame rate):\n", constantFrameRate ? "constant" : "variable");
+    printf("    reference: %9.3f ns\n", referenceNanoseconds / static_cast<double>(queryCount));
+    printf("    FrameIndex: %8.3f ns  (%.2fx)\n", nanoseconds / static_cast<double>(queryCount), referenceNanoseconds / static_cast<double>(std::max<s64>(1, nanoseconds)));
+    
+    if (constantFrameRate) {
+      MeasureMinimumNanosecondsInterleaved(iterations, [&]() {
+        for (int frameIndex : queryFrames) { checksum += referenceIndex.FindBaseKeyframe(frameIndex); }
+      }, [&]() {
+        for (int frameIndex : queryFrames) {
+          int baseKeyframe, predecessor;
+          index.FindDependencyFrames(frameIndex, &baseKeyframe, &predecessor);
+          checksum += baseKeyframe;
+        }
+      }, &referenceNanoseconds, &nanoseconds);
+      
+      printf("  FindDependencyFrames:\n");
+      printf("    reference: %9.3f ns\n", referenceNanoseconds / static_cast<double>(queryCount));
+      printf("    FrameIndex: %8.3f ns  (%.2fx)\n", nanoseconds / static_cast<double>(queryCount), referenceNanoseconds / static_cast<double>(std::max<s64>(1, nanoseconds)));
+    }
+    
+    // Prevent the lookups from being optimized out
+    if (checksum == 42) { printf(" "); }
+  }
+}
+
+/// Streams the given file through a StreamingInputStream over a simulated network connection, the way the reading thread does:
+/// the ranges are scheduled in advance, and then read in frame-sized pieces. Returns the throughput in MiB/s.
+static double RunStreaming(const vector<u8>& file, double roundTripSeconds, double bytesPerSecond, int maxConcurrentRequests) {
+  constexpr s64 maxStreamSize = 1024 * 1024;
+  constexpr usize frameSize = 128 * 1024;
+  
+  MockNetwork network(roundTripSeconds, bytesPerSecond);
+  
+  StreamingInputStream stream;
+  stream.SetMaxConcurrentRequests(maxConcurrentRequests);
+  stream.Open(
+      "test://dummy",
+      /*minStreamSize*/ 256 * 1024,
+      /*maxCacheSize*/ file.size(),
+      /*allowUntrustedCertificates*/ false,
+      unique_ptr<HttpRequestFactory>(new MockHttpRequestFactory(&file, &network)));
+  if (stream.SizeInBytes() != file.size()) {
+    LOG(FATAL) << "Failed to open the stream";
+  }
+  
+  const TimePoint startTime = Clock::now();
+  
+  stream.StreamRange(0, file.size() - 1, /*allowExtendRange*/ false, maxStreamSize);
+  
+  vector<u8> frame(frameSize);
+  for (usize offset = 0; offset < file.size(); offset += frameSize) {
+    const usize size = std::min(frameSize, file.size() - offset);
+    if (stream.Read(frame.data(), size) != size || memcmp(frame.data(), file.data() + offset, size) != 0) {
+      LOG(FATAL) << "Streaming returned wrong data";
+    }
+  }
+  
+  return (file.size() / (1024. * 1024.)) / SecondsFromTo(startTime, Clock::now());
+}
+
+static void BenchmarkStreaming(int streamedMiB) {
+  constexpr double bytesPerSecond = 100 * 1024 * 1024;
+  constexpr int concurrencies[] = {1, 2, 4, 8};
+  
+  vector<u8> file(streamedMiB * 1024 * 1024);
+  for (usize i = 0; i < file.size(); ++ i) {
+    file[i] = i * 31 + (i >> 8);
+  }
+  
+  printf("Streaming throughput (%d MiB in 1 MiB ranges over a simulated %.0f MiB/s link), in MiB/s by concurrent range requests:\n", streamedMiB, bytesPerSecond / (1024 * 1024));
+  printf("  RTT     ");
+  for (int concurrency : concurrencies) { printf("  %6d", concurrency); }
+  printf("\n");
+  
+  for (int roundTripMilliseconds : {0, 10, 30, 100}) {
+    printf("  %4d ms ", roundTripMilliseconds);
+    for (int concurrency : concurrencies) {
+      printf("  %6.1f", RunStreaming(file, 1e-3 * roundTripMilliseconds, bytesPerSecond, concurrency));
+      fflush(stdout);
+    }
+    printf("\n");
+  }
+}
+
+static void PrintUsage(const char* programName) {
+  printf("Usage: %s [options]\n", programName);
+  printf("\n");
+  printf("Benchmarks individual XRVideo decoding kernels against their reference implementations.\n");
+  printf("\n");
+  printf("Options:\n");
+  printf("  --nodes <n>       Deformation node count (default: 1000)\n");
+  printf("  --vertices <n>    Keyframe vertex count, at most 65535 (default: 60000)\n");
+  printf("  --iterations <n>  Number of runs per kernel; the minimum duration is reported (default: 1000)\n");
+  printf("  --texture-iterations <n>  Number of runs per texture copy benchmark (default: 50)\n");
+  printf("  --queue-iterations <n>    Number of runs per work queue contention benchmark (default: 5)\n");
+  printf("  --cache-played-frames <n>  Number of played frames per decoded frame cache benchmark (default: 1000)\n");
+  printf("  --index-frames <n>        Frame count for the frame index benchmark (default: 108000, i.e., one hour at 30 FPS)\n");
+  printf("  --streamed-mib <n>        File size in MiB for the streaming throughput benchmark (default: 16)\n");
+}
+
+int main(int argc, char** argv) {
+  loguru::g_preamble_date = false;
+  loguru::g_preamble_thread = false;
+  loguru::g_preamble_uptime = false;
+  loguru::g_stderr_verbosity = 2;
+  
+  int nodeCount = 1000;
+  u32 vertexCount = 60000;
+  int iterations = 1000;
+  int textureIterations = 50;
+  int queueIterations = 5;
+  int cachePlayedFrameCount = 1000;
+  int indexFrameCount = 108000;
+  int streamedMiB = 16;
+  
+  for (int i = 1; i < argc; ++ i) {
+    const char* arg = argv[i];
+    
+    if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+      PrintUsage(argv[0]);
+      return 0;
+    }
+    
+    if (i + 1 >= argc) {
+      LOG(ERROR) << "Missing value for option: " << arg;
+      return 1;
+    }
+    const char* value = argv[++ i];
+    
+    if (strcmp(arg, "--nodes") == 0) {
+      nodeCount = atoi(value);
+    } else if (strcmp(arg, "--vertices") == 0) {
+      vertexCount = atoi(value);
+    } else if (strcmp(arg, "--iterations") == 0) {
+      iterations = atoi(value);
+    } else if (strcmp(arg, "--texture-iterations") == 0) {
+      textureIterations = atoi(value);
+    } else if (strcmp(arg, "--queue-iterations") == 0) {
+      queueIterations = atoi(value);
+    } else if (strcmp(arg, "--cache-played-frames") == 0) {
+      cachePlayedFrameCount = atoi(value);
+    } else if (strcmp(arg, "--index-frames") == 0) {
+      indexFrameCount = atoi(value);
+    } else if (strcmp(arg, "--streamed-mib") == 0) {
+      streamedMiB = atoi(value);
+    } else {
+      LOG(ERROR) << "Unknown option: " << arg;
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  
+  if (vertexCount < 20 || vertexCount > numeric_limits<u16>::max()) {
+    LOG(ERROR) << "The vertex count must be in [20, 65535]";
+    return 1;
+  }
+  
+  BenchmarkDeformationStateDecoding(nodeCount, iterations);
+  if (!BenchmarkKeyframeDecoding(vertexCount, iterations)) {
+    return 1;
+  }
+  for (u32 textureSize : {2048, 4096}) {
+    if (!BenchmarkTextureCopy(textureSize, textureIterations)) {
+      return 1;
+    }
+  }
+  for (int videoCount : {1, 8}) {
+    BenchmarkQueueContention(videoCount, queueIterations);
+  }
+  BenchmarkDecodedFrameCache(cachePlayedFrameCount);
+  BenchmarkFrameIndex(indexFrameCount, iterations);
+  BenchmarkStreaming(streamedMiB);
+  return 0;
+}
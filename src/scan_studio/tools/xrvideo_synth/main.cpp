@@ -0,0 +1,119 @@
+#define LOGURU_REPLACE_GLOG 1
+#include <loguru.hpp>
+
+#include <cstring>
+
+#include "scan_studio/tools/synthetic_xrvideo.hpp"
+
+using namespace scan_studio;
+
+static void PrintUsage(const char* programName) {
+  const SyntheticXRVideoConfig defaults;
+  
+  printf("Usage: %s [options] <output.xrv>\n", programName);
+  printf("\n");
+  printf("Generates an XRVideo file with synthetic content, for reproducible decoding benchmarks.\n");
+  printf("Textures are stored with zstd (instead of AV.1), so no video encoder is required.\n");
+  printf("\n");
+  printf("Options:\n");
+  printf("  --frames <n>               Number of frames (default: %u)\n", defaults.frameCount);
+  printf("  --fps <f>                  Frame rate (default: %g)\n", defaults.framesPerSecond);
+  printf("  --keyframe-interval <n>    Every n-th frame is a keyframe (default: %u)\n", defaults.keyframeInterval);
+  printf("  --vertices <n>             Unique vertex count per keyframe (default: %u)\n", defaults.uniqueVertexCount);
+  printf("  --duplicated-vertices <n>  Duplicated vertex count per keyframe (default: %u)\n", defaults.duplicatedVertexCount);
+  printf("  --triangles <n>            Triangle count per keyframe (default: %u)\n", defaults.triangleCount);
+  printf("  --nodes <n>                Deformation node count (default: %u)\n", defaults.deformationNodeCount);
+  printf("  --nodes-per-vertex <n>     Deformation nodes per vertex, 1 to 4 (default: %u)\n", defaults.nodesPerVertex);
+  printf("  --texture-width <n>        Texture width (default: %u)\n", defaults.textureWidth);
+  printf("  --texture-height <n>       Texture height (default: %u)\n", defaults.textureHeight);
+  printf("  --texture-noise <n>        Texture noise amplitude, 0 to 255; higher values compress worse (default: %u)\n", defaults.textureNoise);
+  printf("  --vertex-alpha             Store vertex alpha values\n");
+  printf("  --no-metadata              Do not write a metadata chunk\n");
+  printf("  --zstd-level <n>           zstd compression level (default: %d)\n", defaults.zstdCompressionLevel);
+  printf("  --seed <n>                 Random seed (default: %u)\n", defaults.seed);
+}
+
+int main(int argc, char** argv) {
+  loguru::g_preamble_date = false;
+  loguru::g_preamble_thread = false;
+  loguru::g_preamble_uptime = false;
+  loguru::g_stderr_verbosity = 2;
+  
+  SyntheticXRVideoConfig config;
+  const char* outputPath = nullptr;
+  
+  for (int i = 1; i < argc; ++ i) {
+    const char* arg = argv[i];
+    
+    // Flags without a value
+    if (strcmp(arg, "--vertex-alpha") == 0) {
+      config.vertexAlpha = true;
+      continue;
+    } else if (strcmp(arg, "--no-metadata") == 0) {
+      config.writeMetadata = false;
+      continue;
+    } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+      PrintUsage(argv[0]);
+      return 0;
+    } else if (arg[0] != '-') {
+      if (outputPath) {
+        LOG(ERROR) << "More than one output path given";
+        return 1;
+      }
+      outputPath = arg;
+      continue;
+    }
+    
+    // Options with a value
+    if (i + 1 >= argc) {
+      LOG(ERROR) << "Missing value for option: " << arg;
+      return 1;
+    }
+    const char* value = argv[++ i];
+    
+    if (strcmp(arg, "--frames") == 0) {
+      config.frameCount = atoi(value);
+    } else if (strcmp(arg, "--fps") == 0) {
+      config.framesPerSecond = atof(value);
+    } else if (strcmp(arg, "--keyframe-interval") == 0) {
+      config.keyframeInterval = atoi(value);
+    } else if (strcmp(arg, "--vertices") == 0) {
+      config.uniqueVertexCount = atoi(value);
+    } else if (strcmp(arg, "--duplicated-vertices") == 0) {
+      config.duplicatedVertexCount = atoi(value);
+    } else if (strcmp(arg, "--triangles") == 0) {
+      config.triangleCount = atoi(value);
+    } else if (strcmp(arg, "--nodes") == 0) {
+      config.deformationNodeCount = atoi(value);
+    } else if (strcmp(arg, "--nodes-per-vertex") == 0) {
+      config.nodesPerVertex = atoi(value);
+    } else if (strcmp(arg, "--texture-width") == 0) {
+      config.textureWidth = atoi(value);
+    } else if (strcmp(arg, "--texture-height") == 0) {
+      config.textureHeight = atoi(value);
+    } else if (strcmp(arg, "--texture-noise") == 0) {
+      config.textureNoise = atoi(value);
+    } else if (strcmp(arg, "--zstd-level") == 0) {
+      config.zstdCompressionLevel = atoi(value);
+    } else if (strcmp(arg, "--seed") == 0) {
+      config.seed = atoi(value);
+    } else {
+      LOG(ERROR) << "Unknown option: " << arg;
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+  
+  if (!outputPath) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  
+  if (!GenerateSyntheticXRVideo(config, outputPath)) {
+    LOG(ERROR) << "Failed to generate the synthetic XRVideo";
+    return 1;
+  }
+  
+  LOG(INFO) << "Wrote " << config.frameCount << " frames to: " << outputPath;
+  return 0;
+}
@@ -6,6 +6,7 @@
 
 #include "scan_studio/viewer_common/audio/audio_sdl.hpp"
 
+#include "scan_studio/viewer_common/util.hpp"
 #include "scan_studio/viewer_common/xrvideo/xrvideo.hpp"
 #include "scan_studio/viewer_common/xrvideo/xrvideo_common_resources.hpp"
 
@@ -276,7 +277,26 @@ bool ViewerCommon::OpenFile(bool preReadCompleteFile, const filesystem::path& vi
     }
   }
   
-  // Load the XRVideo file
+  // Load the XRVideo file. If it does not have an index chunk and an index cache directory is set,
+  // cache its index in a file in that directory. The file name is derived from the video's absolute path,
+  // while the index file itself stores the video's size and a hash of its contents to detect changed videos.
+  filesystem::path sidecarIndexPath;
+  if (!indexCacheDirectory.empty()) {
+    error_code errorCode;
+    const filesystem::path absoluteVideoPath = filesystem::absolute(videoPath, errorCode);
+    filesystem::create_directories(indexCacheDirectory, errorCode);
+    if (errorCode) {
+      LOG(WARNING) << "Failed to create the index cache directory " << indexCacheDirectory << ": " << errorCode.message();
+    } else {
+      const string pathString = absoluteVideoPath.empty() ? videoPath.string() : absoluteVideoPath.string();
+      const u64 pathHash = HashFNV1a(pathString.data(), pathString.size());
+      
+      char fileName[32];
+      snprintf(fileName, sizeof(fileName), "%016llx.index", static_cast<unsigned long long>(pathHash));
+      sidecarIndexPath = indexCacheDirectory / fileName;
+    }
+  }
+  xrVideo->SetSidecarIndexPath(sidecarIndexPath.string());
   if (!xrVideo->TakeAndOpen(inputStream.release(), isStreamingInputStream, cacheAllFrames)) {
     // TODO: Report error to user properly
     LOG(ERROR) << "xrVideo->TakeAndOpen() failed";
@@ -87,6 +87,11 @@ class ViewerCommon {
   
   bool OpenFile(bool preReadCompleteFile, const filesystem::path& videoPath);
   
+  /// Sets a directory (e.g., within the user's cache directory) in which OpenFile() caches the frame indices of videos
+  /// that do not have an index chunk, such that they do not need to be rebuilt when opening such a video again.
+  /// By default (empty path), no index files are written.
+  inline void SetIndexCacheDirectory(const filesystem::path& path) { indexCacheDirectory = path; }
+  
   /// Must be called once at the start of the frame (for Vulkan: before the render pass is started).
   void PrepareFrame(s64 predictedDisplayTimeNanoseconds, bool paused, RenderState* renderState);
   
@@ -118,6 +123,9 @@ class ViewerCommon {
   
   unique_ptr<SDLAudio> audio;
   
+  /// See SetIndexCacheDirectory()
+  filesystem::path indexCacheDirectory;
+  
   bool lastDisplayTimeInitialized = false;
   s64 lastDisplayTimeNanoseconds;
   
@@ -525,6 +525,15 @@ bool RenderCallbacks::InitializeSurfaceDependentImpl() {
     return false;
   }
   
+  #if !defined(__EMSCRIPTEN__) && !defined(__ANDROID__) && !defined(TARGET_OS_IOS)
+    // Cache the rebuilt indices of videos without an index chunk in the user's application data directory,
+    // such that reopening such a video does not need to read all of its frame headers again
+    if (char* prefPath = SDL_GetPrefPath("ScannedReality", "Viewer")) {
+      commonLogic.SetIndexCacheDirectory(filesystem::path(prefPath) / "index_cache");
+      SDL_free(prefPath);
+    }
+  #endif
+  
   if (!commonLogic.OpenFile(preReadCompleteFile, videoPath)) {
     LOG(ERROR) << "Failed to open video file!";
     // TODO: Report error to user properly
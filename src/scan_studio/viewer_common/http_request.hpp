@@ -133,6 +133,14 @@ class HttpRequest {
     return contentRangeTo;
   }
   
+  /// Returns the value of the ETag HTTP header of the response, or an empty string if the server did not send one
+  /// (or if the implementation does not provide it).
+  /// Must only be called once HasCompletedHeaders() returns true or WaitForHeaders() was called.
+  inline const string& ETag() {
+    if (!headersCompleteOrFailed) { LOG(ERROR) << "ETag() accessed when headers were not complete yet"; }
+    return etag;
+  }
+  
   /// Returns a pointer to the response content.
   /// Must only be called once HasCompletedHeaders() returns true or WaitForHeaders() was called;
   /// in addition, the content itself is only valid once HasCompletedContent() returns true or WaitForContent() was called.
@@ -167,6 +175,9 @@ class HttpRequest {
   s64 contentRangeFrom = -1;
   s64 contentRangeTo = -1;
   
+  /// Value of ETag HTTP header, or empty if unknown or not provided.
+  string etag;
+  
   /// If this is true, the values at contentPtr and of actualContentLength are valid.
   /// In case of failure, actualContentLength remains -1.
   atomic<bool> contentCompleteOrFailed = false;
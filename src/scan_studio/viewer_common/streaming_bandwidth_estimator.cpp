@@ -0,0 +1,149 @@
+#include "scan_studio/viewer_common/streaming_bandwidth_estimator.hpp"
+
+#include <algorithm>
+
+namespace scan_studio {
+
+/// Factor by which the weight of the previous transfers decays with each new transfer
+constexpr double transferWeightDecay = 0.8;
+
+/// Number of recent requests on an idle link that the round-trip time is estimated from
+constexpr int idleRequestSampleCount = 16;
+
+constexpr float defaultLookaheadSeconds = 5.f;
+constexpr float minLookaheadSeconds = 3.f;
+constexpr float maxLookaheadSeconds = 30.f;
+
+constexpr s64 defaultMaxStreamSize = 6 * 1024 * 1024;
+constexpr s64 minMaxStreamSize = 512 * 1024;
+constexpr s64 maxMaxStreamSize = 16 * 1024 * 1024;
+
+/// The transfer time that ranges are sized for (if the round-trip time is shorter)
+constexpr double targetRangeTransferSeconds = 0.25;
+
+void StreamingBandwidthEstimator::Reset() {
+  lock_guard<mutex> lock(estimatorMutex);
+  
+  weightedBytes = 0;
+  weightedBusySeconds = 0;
+  haveTransfers = false;
+  idleRequests.clear();
+  nextIdleRequest = 0;
+}
+
+void StreamingBandwidthEstimator::AddRoundTrip(const TimePoint& sendTime, const TimePoint& completionTime) {
+  lock_guard<mutex> lock(estimatorMutex);
+  AddIdleRequestLocked(SecondsFromTo(sendTime, completionTime), 0);
+}
+
+void StreamingBandwidthEstimator::AddTransfer(const TimePoint& sendTime, const TimePoint& completionTime, s64 bytes, bool otherRequestsInFlight) {
+  lock_guard<mutex> lock(estimatorMutex);
+  
+  const double duration = std::max(0.0, SecondsFromTo(sendTime, completionTime));
+  
+  // Determine the time at which the transfer started occupying the link. If the link was busy with the previous transfers
+  // until after the request's response could have started arriving, this is the completion time of the previous transfers.
+  // Otherwise, the response starts arriving one round-trip time after sending the request. Since the round-trip estimate may
+  // be too high initially (e.g., if it includes the connection setup of the first request), at least half of the request's
+  // duration is assumed to be spent transferring.
+  const double roundTripSeconds = GetRoundTripSecondsLocked();
+  TimePoint transferStartTime = sendTime + chrono::duration_cast<Clock::duration>(SecondsDuration(std::min(roundTripSeconds, 0.5 * duration)));
+  if (haveTransfers && lastCompletionTime > transferStartTime) {
+    transferStartTime = lastCompletionTime;
+  }
+  
+  // If the request completed before the previous transfers did, its transfer overlapped with them, and the link time
+  // was already accounted for. Only its bytes get added then.
+  const double busySeconds = std::max(0.0, SecondsFromTo(transferStartTime, completionTime));
+  
+  weightedBytes = transferWeightDecay * weightedBytes + bytes;
+  weightedBusySeconds = transferWeightDecay * weightedBusySeconds + busySeconds;
+  
+  if (!haveTransfers || completionTime > lastCompletionTime) {
+    lastCompletionTime = completionTime;
+  }
+  haveTransfers = true;
+  
+  // If other requests were in flight, the request may have waited for their transfers as well,
+  // so its duration would not tell anything about the round-trip time.
+  if (!otherRequestsInFlight) {
+    AddIdleRequestLocked(duration, bytes);
+  }
+}
+
+bool StreamingBandwidthEstimator::HasEstimates() {
+  lock_guard<mutex> lock(estimatorMutex);
+  return weightedBusySeconds > 0;
+}
+
+double StreamingBandwidthEstimator::GetBytesPerSecond() {
+  lock_guard<mutex> lock(estimatorMutex);
+  return (weightedBusySeconds > 0) ? (weightedBytes / weightedBusySeconds) : 0;
+}
+
+double StreamingBandwidthEstimator::GetRoundTripSeconds() {
+  lock_guard<mutex> lock(estimatorMutex);
+  return GetRoundTripSecondsLocked();
+}
+
+StreamingWindow StreamingBandwidthEstimator::ComputeWindow(double videoBytesPerSecond, int maxConcurrentRequests) {
+  const double bytesPerSecond = GetBytesPerSecond();
+  const double roundTrip = GetRoundTripSeconds();
+  
+  StreamingWindow window;
+  window.lookaheadSeconds = defaultLookaheadSeconds;
+  window.maxStreamSize = defaultMaxStreamSize;
+  
+  if (bytesPerSecond > 0) {
+    if (videoBytesPerSecond > 0) {
+      // The lookahead grows as the link's headroom over the video's data rate shrinks, e.g.,
+      // to 3.9 s at 10x the data rate, 11 s at 2x, and the maximum at 1.25x and below.
+      const double headroom = bytesPerSecond / videoBytesPerSecond - 1;
+      window.lookaheadSeconds = minLookaheadSeconds + 8 / std::max(0.25, headroom);
+    }
+    
+    // Buffer for at least a few round trips, such that a single stalled request does not make playback stall
+    window.lookaheadSeconds = std::min<float>(maxLookaheadSeconds, std::max<double>(window.lookaheadSeconds, 4 * roundTrip));
+    
+    window.maxStreamSize = std::clamp<s64>(bytesPerSecond * std::max(roundTrip, targetRangeTransferSeconds), minMaxStreamSize, maxMaxStreamSize);
+  }
+  
+  const s64 windowBytes = window.lookaheadSeconds * std::max(0.0, videoBytesPerSecond);
+  
+  // Make the window span multiple ranges, such that several requests may be in flight for it
+  if (bytesPerSecond > 0 && windowBytes > 0) {
+    window.maxStreamSize = std::max(minMaxStreamSize, std::min<s64>(window.maxStreamSize, windowBytes / std::max(1, maxConcurrentRequests)));
+  }
+  
+  window.requiredCacheSize = windowBytes + std::max(1, maxConcurrentRequests) * window.maxStreamSize;
+  return window;
+}
+
+void StreamingBandwidthEstimator::AddIdleRequestLocked(double seconds, s64 bytes) {
+  if (idleRequests.size() < idleRequestSampleCount) {
+    idleRequests.push_back(IdleRequest{seconds, bytes});
+  } else {
+    idleRequests[nextIdleRequest] = IdleRequest{seconds, bytes};
+    nextIdleRequest = (nextIdleRequest + 1) % idleRequestSampleCount;
+  }
+}
+
+double StreamingBandwidthEstimator::GetRoundTripSecondsLocked() {
+  // The round-trip time samples are computed from the current bandwidth estimate (instead of when adding the requests),
+  // since the bandwidth estimate gets more accurate over time, in particular once requests were in flight concurrently.
+  const double bytesPerSecond = (weightedBusySeconds > 0) ? (weightedBytes / weightedBusySeconds) : 0;
+  
+  double result = -1;
+  for (const IdleRequest& request : idleRequests) {
+    if (request.bytes > 0 && bytesPerSecond <= 0) { continue; }
+    
+    const double sample = std::max(0.0, request.seconds - ((request.bytes > 0) ? (request.bytes / bytesPerSecond) : 0.0));
+    if (result < 0 || sample < result) {
+      result = sample;
+    }
+  }
+  
+  return std::max(0.0, result);
+}
+
+}
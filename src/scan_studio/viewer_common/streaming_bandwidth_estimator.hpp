@@ -0,0 +1,98 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <libvis/vulkan/libvis.h>
+
+#include "scan_studio/viewer_common/timing.hpp"
+
+namespace scan_studio {
+using namespace vis;
+
+/// Streaming parameters that are adapted to the network connection and to the streamed video, see StreamingBandwidthEstimator::ComputeWindow().
+struct StreamingWindow {
+  /// The number of seconds of video to stream in advance of the playback position
+  float lookaheadSeconds;
+  
+  /// The maximum size of a single requested range in bytes
+  s64 maxStreamSize;
+  
+  /// The cache size in bytes that is required to hold the streamed window without dropping ranges before they are read
+  s64 requiredCacheSize;
+};
+
+/// Online estimator for the bandwidth and round-trip time of a streaming connection,
+/// fed with the timings of the completed HTTP requests of a StreamingInputStream.
+///
+/// Bandwidth is estimated as the (exponentially decaying) number of transferred bytes divided by the time in which
+/// the link was busy transferring them. With multiple requests in flight, their transfers share the link, so the busy time
+/// of a request is counted from the completion of the previous request (or, if the link was idle in the meantime,
+/// from the time at which the request's first byte can be expected). For requests that queue up behind each other's transfers,
+/// this is independent of the round-trip time, such that concurrent requests yield accurate bandwidth estimates.
+///
+/// The round-trip time is estimated as the minimum over the most recent requests that were sent on an idle link (including
+/// HEAD requests) of the part of their duration that is not explained by the transfer time. Requests that were sent while
+/// other requests were in flight are not used for this, since they may have waited for the transfers of the requests ahead of them.
+/// Notice that if requests are only ever sent one at a time, and all of them have the same size, round-trip time and bandwidth
+/// cannot be told apart. The estimates then depend on the round-trip time measured by the HEAD request.
+///
+/// All functions are thread-safe.
+class StreamingBandwidthEstimator {
+ public:
+  /// Discards all samples.
+  void Reset();
+  
+  /// Adds the timing of a request without content (such as a HEAD request), which only yields a round-trip time sample.
+  void AddRoundTrip(const TimePoint& sendTime, const TimePoint& completionTime);
+  
+  /// Adds the timing of a request that transferred the given number of bytes of content.
+  /// otherRequestsInFlight must be true if other requests were in flight on the same link while the request was sent.
+  void AddTransfer(const TimePoint& sendTime, const TimePoint& completionTime, s64 bytes, bool otherRequestsInFlight);
+  
+  /// Returns true once a bandwidth estimate is available (i.e., after the first transfer completed).
+  bool HasEstimates();
+  
+  /// Returns the estimated bandwidth in bytes per second, or zero if HasEstimates() returns false.
+  double GetBytesPerSecond();
+  
+  /// Returns the estimated round-trip time in seconds, or zero if there were no samples yet.
+  double GetRoundTripSeconds();
+  
+  /// Computes the streaming window for a video with the given average data rate (in bytes per second of playback time),
+  /// given the current estimates:
+  /// - The lookahead is short if the link is much faster than the video's data rate, since data missing after a seek or a
+  ///   network hiccup then gets fetched quickly, and grows as the link's headroom shrinks, up to a maximum for links that are
+  ///   (nearly) too slow for the video. This way, fast links fill up the window quickly without over-fetching data that may
+  ///   never be played (e.g., if the user seeks), while slow links buffer deeper.
+  /// - The range size grows with the bandwidth-delay product (such that the latency of each request is small compared to its
+  ///   transfer time), but is limited such that each range completes quickly, since its data is only usable once it completed.
+  /// - The required cache size covers the lookahead window and the ranges that may be in flight.
+  /// Without estimates, returns defaults that work for typical connections.
+  StreamingWindow ComputeWindow(double videoBytesPerSecond, int maxConcurrentRequests);
+  
+ private:
+  /// These require `estimatorMutex` to be locked.
+  void AddIdleRequestLocked(double seconds, s64 bytes);
+  double GetRoundTripSecondsLocked();
+  
+  mutex estimatorMutex;
+  
+  /// Exponentially decaying sums of transferred bytes and the busy link time required for transferring them
+  double weightedBytes = 0;
+  double weightedBusySeconds = 0;
+  
+  /// Completion time of the latest transfer. The link is assumed to be busy up to this time.
+  TimePoint lastCompletionTime;
+  bool haveTransfers = false;
+  
+  /// Duration and content size of the most recent requests that were sent on an idle link (used as a ring buffer)
+  struct IdleRequest {
+    double seconds;
+    s64 bytes;
+  };
+  vector<IdleRequest> idleRequests;
+  int nextIdleRequest = 0;
+};
+
+}
@@ -0,0 +1,540 @@
+#include "scan_studio/viewer_common/streaming_disk_cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <loguru.hpp>
+
+#include <libvis/io/util.h>
+
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+#include "scan_studio/common/io/structured_io.hpp"
+#include "scan_studio/viewer_common/util.hpp"
+
+namespace scan_studio {
+
+/// Header of range map files (see StreamingDiskCache).
+/// It is followed by the URI, the validator, and the ranges (see StreamingDiskCacheRangeScheme).
+typedef BufferScheme<
+    BufferField<u32>,  // magic (set to rangeMapMagic)
+    BufferField<u8>,   // version (set to rangeMapCurrentVersion)
+    BufferField<u64>,  // content length of the cached file
+    BufferField<u64>,  // last use of the entry (see StreamingDiskCache::Entry::lastUse)
+    BufferField<u32>,  // size of the URI
+    BufferField<u32>,  // size of the validator
+    BufferField<u32>   // number of ranges
+    > StreamingDiskCacheRangeMapHeaderScheme;
+
+typedef BufferScheme<
+    BufferField<u64>,  // first byte of the range
+    BufferField<u64>   // last byte of the range
+    > StreamingDiskCacheRangeScheme;
+
+constexpr u32 rangeMapMagic = 0x43535258;  // "XRSC" in little endian
+constexpr u8 rangeMapCurrentVersion = 0;
+
+constexpr const char* dataFileExtension = ".data";
+constexpr const char* rangeMapFileExtension = ".ranges";
+constexpr const char* temporaryFileExtension = ".tmp";
+
+/// Returns the key of the entry for the given URI, which is used as the file name stem of the entry's files
+static string KeyForUri(const string& uri) {
+  // Hash of the URI (collisions are detected by comparing the URI stored in the range map)
+  const u64 hash = HashFNV1a(uri.data(), uri.size());
+  
+  char key[17];
+  snprintf(key, sizeof(key), "%016llx", static_cast<unsigned long long>(hash));
+  return key;
+}
+
+/// Returns the number of bytes of the range [from, to] that are covered by the given ranges
+static s64 CountCoveredBytes(const vector<StreamingDiskCache::Range>& ranges, s64 from, s64 to) {
+  s64 result = 0;
+  for (const auto& range : ranges) {
+    result += std::max<s64>(0, std::min(to, range.to) - std::max(from, range.from) + 1);
+  }
+  return result;
+}
+
+/// Adds the range [from, to] to the given ordered ranges, merging it with the ranges that it overlaps or adjoins
+static void AddRange(vector<StreamingDiskCache::Range>* ranges, s64 from, s64 to) {
+  auto it = std::lower_bound(ranges->begin(), ranges->end(), from, [](const StreamingDiskCache::Range& range, s64 value) { return range.to + 1 < value; });
+  
+  auto endIt = it;
+  while (endIt != ranges->end() && endIt->from <= to + 1) {
+    from = std::min(from, endIt->from);
+    to = std::max(to, endIt->to);
+    ++ endIt;
+  }
+  
+  it = ranges->erase(it, endIt);
+  ranges->insert(it, StreamingDiskCache::Range{from, to});
+}
+
+StreamingDiskCache::~StreamingDiskCache() {
+  {
+    lock_guard<mutex> lock(queueMutex);
+    quitWriterThread = true;
+  }
+  operationsQueuedCondition.notify_all();
+  
+  if (writerThread.joinable()) {
+    writerThread.join();
+  }
+}
+
+bool StreamingDiskCache::Open(const fs::path& directory, s64 maxSizeInBytes) {
+  // Complete the operations for the previously opened directory
+  Flush();
+  
+  lock_guard<mutex> lock(cacheMutex);
+  
+  entries.clear();
+  sizeInBytes = 0;
+  useCounter = 0;
+  this->directory = directory;
+  this->maxSizeInBytes = maxSizeInBytes;
+  isOpen = false;
+  
+  error_code errorCode;
+  fs::create_directories(directory, errorCode);
+  if (!fs::is_directory(directory, errorCode)) {
+    LOG(ERROR) << "Cannot create the streaming disk cache directory: " << directory.string();
+    return false;
+  }
+  
+  vector<fs::path> paths;
+  for (const auto& item : fs::directory_iterator(directory, errorCode)) {
+    paths.push_back(item.path());
+  }
+  
+  // Load the range maps of all entries, and remove invalid ones as well as leftover temporary files
+  for (const fs::path& path : paths) {
+    const string extension = path.extension().string();
+    
+    if (extension == rangeMapFileExtension) {
+      const string key = path.stem().string();
+      
+      Entry entry;
+      const bool isValid =
+          LoadRangeMap(path, &entry) &&
+          KeyForUri(entry.uri) == key &&
+          fs::file_size(DataPath(key), errorCode) == static_cast<u64>(entry.contentLength) && !errorCode;
+      if (!isValid) {
+        LOG(WARNING) << "Removing an invalid entry from the streaming disk cache: " << path.string();
+        fs::remove(path, errorCode);
+        continue;
+      }
+      
+      useCounter = std::max(useCounter, entry.lastUse);
+      sizeInBytes += entry.storedBytes;
+      entries[key] = std::move(entry);
+    } else if (extension == temporaryFileExtension) {
+      fs::remove(path, errorCode);
+    }
+  }
+  
+  // Remove data files without a (valid) range map, e.g., if writing the range map of a new entry failed
+  for (const fs::path& path : paths) {
+    if (path.extension().string() == dataFileExtension && entries.count(path.stem().string()) == 0) {
+      fs::remove(path, errorCode);
+    }
+  }
+  
+  isOpen = true;
+  
+  // The budget may have been lowered since the cache was used last
+  EvictEntries(0);
+  
+  if (!writerThread.joinable()) {
+    writerThread = std::thread(&StreamingDiskCache::WriterThreadMain, this);
+  }
+  return true;
+}
+
+bool StreamingDiskCache::AcquireEntry(const string& uri, const string& validator, s64 contentLength, vector<Range>* storedRanges, shared_ptr<const u8>* mapping) {
+  // Wait for the queued ranges of the entry, such that they are served as well
+  {
+    unique_lock<mutex> queueLock(queueMutex);
+    operationsDoneCondition.wait(queueLock, [&]() { return pendingOperationCounts.count(uri) == 0; });
+  }
+  
+  lock_guard<mutex> lock(cacheMutex);
+  
+  storedRanges->clear();
+  mapping->reset();
+  if (!isOpen) { return false; }
+  
+  const string key = KeyForUri(uri);
+  auto it = entries.find(key);
+  
+  // Discard the stored data if the file changed (or if the URI has a hash collision with another URI)
+  if (it != entries.end() &&
+      (it->second.uri != uri || it->second.validator != validator || it->second.contentLength != contentLength)) {
+    if (it->second.useCount > 0) {
+      LOG(WARNING) << "The streaming disk cache entry for " << uri << " is in use for a different version of the file, not caching the file";
+      return false;
+    }
+    
+    RemoveEntry(key);
+    it = entries.end();
+  }
+  
+  if (it == entries.end()) {
+    // Create the data file with the size of the streamed file, but without writing any data to it, such that it is sparse if possible
+    FILE* file = fopen(DataPath(key).string().c_str(), "wb");
+    if (!file) {
+      LOG(WARNING) << "Cannot create a file in the streaming disk cache: " << DataPath(key).string();
+      return false;
+    }
+    fclose(file);
+    
+    error_code errorCode;
+    fs::resize_file(DataPath(key), contentLength, errorCode);
+    if (errorCode) {
+      LOG(WARNING) << "Cannot resize a file in the streaming disk cache: " << DataPath(key).string() << " (" << errorCode.message() << ")";
+      fs::remove(DataPath(key), errorCode);
+      return false;
+    }
+    
+    Entry entry;
+    entry.uri = uri;
+    entry.validator = validator;
+    entry.contentLength = contentLength;
+    it = entries.emplace(key, std::move(entry)).first;
+  }
+  
+  Entry& entry = it->second;
+  entry.lastUse = ++ useCounter;
+  ++ entry.useCount;
+  
+  // Persist the use for least-recently-used eviction (this also creates the range map of new entries)
+  SaveRangeMap(key, entry);
+  
+  if (!entry.ranges.empty()) {
+    MappedFileInputStream dataFile;
+    if (dataFile.Open(DataPath(key)) && dataFile.SizeInBytes() == static_cast<u64>(contentLength)) {
+      *storedRanges = entry.ranges;
+      *mapping = dataFile.GetMapping();
+    } else {
+      LOG(WARNING) << "Cannot map a file in the streaming disk cache, discarding its data: " << DataPath(key).string();
+      sizeInBytes -= entry.storedBytes;
+      entry.storedBytes = 0;
+      entry.ranges.clear();
+      SaveRangeMap(key, entry);
+    }
+  }
+  
+  return true;
+}
+
+void StreamingDiskCache::ReleaseEntry(const string& uri) {
+  {
+    lock_guard<mutex> lock(queueMutex);
+    queuedOperations.push_back(QueuedOperation{uri, /*release*/ true, -1, -1, nullptr, nullptr});
+    ++ pendingOperationCounts[uri];
+  }
+  operationsQueuedCondition.notify_all();
+}
+
+void StreamingDiskCache::QueueStoreRange(const string& uri, s64 from, s64 to, const u8* data, const shared_ptr<const void>& dataOwner) {
+  {
+    lock_guard<mutex> lock(queueMutex);
+    queuedOperations.push_back(QueuedOperation{uri, /*release*/ false, from, to, data, dataOwner});
+    ++ pendingOperationCounts[uri];
+  }
+  operationsQueuedCondition.notify_all();
+}
+
+void StreamingDiskCache::Flush() {
+  unique_lock<mutex> lock(queueMutex);
+  operationsDoneCondition.wait(lock, [&]() { return pendingOperationCounts.empty(); });
+}
+
+s64 StreamingDiskCache::GetSizeInBytes() {
+  lock_guard<mutex> lock(cacheMutex);
+  return sizeInBytes;
+}
+
+void StreamingDiskCache::WriterThreadMain() {
+  SCAN_STUDIO_SET_THREAD_NAME("scan-disk-cache");
+  
+  while (true) {
+    vector<QueuedOperation> operations;
+    {
+      unique_lock<mutex> lock(queueMutex);
+      operationsQueuedCondition.wait(lock, [&]() { return quitWriterThread || !queuedOperations.empty(); });
+      if (queuedOperations.empty()) {
+        return;
+      }
+      operations.swap(queuedOperations);
+    }
+    
+    {
+      lock_guard<mutex> lock(cacheMutex);
+      
+      // Store all ranges, and save the range map of each changed entry only once afterwards
+      vector<string> changedKeys;
+      for (const QueuedOperation& operation : operations) {
+        if (operation.release) {
+          ReleaseEntryLocked(operation.uri);
+        } else if (StoreRangeLocked(operation.uri, operation.from, operation.to, operation.data)) {
+          const string key = KeyForUri(operation.uri);
+          if (std::find(changedKeys.begin(), changedKeys.end(), key) == changedKeys.end()) {
+            changedKeys.push_back(key);
+          }
+        }
+      }
+      
+      for (const string& key : changedKeys) {
+        // The entry may have been evicted by a later range in the meantime
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+          SaveRangeMap(key, it->second);
+        }
+      }
+    }
+    
+    {
+      lock_guard<mutex> lock(queueMutex);
+      for (const QueuedOperation& operation : operations) {
+        auto it = pendingOperationCounts.find(operation.uri);
+        if (-- it->second == 0) {
+          pendingOperationCounts.erase(it);
+        }
+      }
+    }
+    operations.clear();
+    operationsDoneCondition.notify_all();
+  }
+}
+
+void StreamingDiskCache::ReleaseEntryLocked(const string& uri) {
+  auto it = entries.find(KeyForUri(uri));
+  if (it == entries.end() || it->second.uri != uri || it->second.useCount <= 0) {
+    LOG(ERROR) << "Releasing a streaming disk cache entry that is not in use: " << uri;
+    return;
+  }
+  
+  -- it->second.useCount;
+}
+
+bool StreamingDiskCache::StoreRangeLocked(const string& uri, s64 from, s64 to, const u8* data) {
+  if (!isOpen) { return false; }
+  
+  const string key = KeyForUri(uri);
+  auto it = entries.find(key);
+  if (it == entries.end() || it->second.uri != uri || it->second.useCount <= 0) {
+    LOG(ERROR) << "Storing a range for a streaming disk cache entry that is not in use: " << uri;
+    return false;
+  }
+  Entry& entry = it->second;
+  
+  if (from < 0 || to < from || to >= entry.contentLength) {
+    LOG(ERROR) << "Invalid range to store in the streaming disk cache: " << from << " to " << to << " (content length: " << entry.contentLength << ")";
+    return false;
+  }
+  
+  const s64 newBytes = (to - from + 1) - CountCoveredBytes(entry.ranges, from, to);
+  if (newBytes == 0) {
+    return false;
+  }
+  
+  if (sizeInBytes + newBytes > maxSizeInBytes && !EvictEntries(newBytes)) {
+    return false;
+  }
+  
+  FILE* file = fopen(DataPath(key).string().c_str(), "r+b");
+  if (!file) {
+    LOG(WARNING) << "Cannot open a file in the streaming disk cache for writing: " << DataPath(key).string();
+    return false;
+  }
+  
+  const usize size = to - from + 1;
+  const bool success = portable_fseek(file, from, SEEK_SET) == 0 && fwrite(data, 1, size, file) == size;
+  if (fclose(file) != 0 || !success) {
+    LOG(WARNING) << "Failed to write to a file in the streaming disk cache: " << DataPath(key).string();
+    return false;
+  }
+  
+  AddRange(&entry.ranges, from, to);
+  entry.storedBytes += newBytes;
+  sizeInBytes += newBytes;
+  
+  return true;
+}
+
+fs::path StreamingDiskCache::DataPath(const string& key) const {
+  return directory / (key + dataFileExtension);
+}
+
+fs::path StreamingDiskCache::RangeMapPath(const string& key) const {
+  return directory / (key + rangeMapFileExtension);
+}
+
+bool StreamingDiskCache::LoadRangeMap(const fs::path& path, Entry* entry) {
+  FILE* file = fopen(path.string().c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  
+  vector<u8> data;
+  vector<u8> readBuffer(64 * 1024);
+  while (true) {
+    const usize bytesRead = fread(readBuffer.data(), 1, readBuffer.size(), file);
+    if (bytesRead == 0) { break; }
+    data.insert(data.end(), readBuffer.begin(), readBuffer.begin() + bytesRead);
+  }
+  fclose(file);
+  
+  constexpr usize headerSize = StreamingDiskCacheRangeMapHeaderScheme::GetConstantSize();
+  if (data.size() < headerSize) {
+    return false;
+  }
+  
+  u32 magic;
+  u8 version;
+  u64 contentLength;
+  u32 uriSize;
+  u32 validatorSize;
+  u32 rangeCount;
+  StructuredVectorReader<StreamingDiskCacheRangeMapHeaderScheme>(data)
+      .Read(&magic)
+      .Read(&version)
+      .Read(&contentLength)
+      .Read(&entry->lastUse)
+      .Read(&uriSize)
+      .Read(&validatorSize)
+      .Read(&rangeCount);
+  if (magic != rangeMapMagic || version != rangeMapCurrentVersion) {
+    return false;
+  }
+  
+  constexpr usize rangeSize = StreamingDiskCacheRangeScheme::GetConstantSize();
+  if (data.size() != headerSize + uriSize + validatorSize + static_cast<usize>(rangeCount) * rangeSize) {
+    return false;
+  }
+  
+  entry->contentLength = contentLength;
+  entry->uri.assign(reinterpret_cast<const char*>(data.data() + headerSize), uriSize);
+  entry->validator.assign(reinterpret_cast<const char*>(data.data() + headerSize + uriSize), validatorSize);
+  
+  // Load the ranges, verifying that they are ordered and within the file
+  entry->ranges.resize(rangeCount);
+  entry->storedBytes = 0;
+  s64 previousRangeEnd = -1;
+  
+  for (u32 rangeIndex = 0; rangeIndex < rangeCount; ++ rangeIndex) {
+    u64 from, to;
+    StructuredVectorReader<StreamingDiskCacheRangeScheme>(data, headerSize + uriSize + validatorSize + rangeIndex * rangeSize)
+        .Read(&from)
+        .Read(&to);
+    if (static_cast<s64>(from) <= previousRangeEnd || from > to || to >= contentLength) {
+      return false;
+    }
+    
+    entry->ranges[rangeIndex] = Range{static_cast<s64>(from), static_cast<s64>(to)};
+    entry->storedBytes += to - from + 1;
+    previousRangeEnd = to;
+  }
+  
+  return true;
+}
+
+bool StreamingDiskCache::SaveRangeMap(const string& key, const Entry& entry) {
+  constexpr usize headerSize = StreamingDiskCacheRangeMapHeaderScheme::GetConstantSize();
+  constexpr usize rangeSize = StreamingDiskCacheRangeScheme::GetConstantSize();
+  
+  vector<u8> data(headerSize + entry.uri.size() + entry.validator.size() + entry.ranges.size() * rangeSize);
+  StructuredVectorWriter<StreamingDiskCacheRangeMapHeaderScheme>(&data)
+      .Write(rangeMapMagic)
+      .Write(rangeMapCurrentVersion)
+      .Write(static_cast<u64>(entry.contentLength))
+      .Write(entry.lastUse)
+      .Write(static_cast<u32>(entry.uri.size()))
+      .Write(static_cast<u32>(entry.validator.size()))
+      .Write(static_cast<u32>(entry.ranges.size()));
+  memcpy(data.data() + headerSize, entry.uri.data(), entry.uri.size());
+  memcpy(data.data() + headerSize + entry.uri.size(), entry.validator.data(), entry.validator.size());
+  
+  for (usize rangeIndex = 0; rangeIndex < entry.ranges.size(); ++ rangeIndex) {
+    StructuredVectorWriter<StreamingDiskCacheRangeScheme>(&data, headerSize + entry.uri.size() + entry.validator.size() + rangeIndex * rangeSize)
+        .Write(static_cast<u64>(entry.ranges[rangeIndex].from))
+        .Write(static_cast<u64>(entry.ranges[rangeIndex].to));
+  }
+  
+  // Write to a temporary file first and then rename it, such that no incomplete range map remains if writing fails
+  const fs::path path = RangeMapPath(key);
+  const fs::path temporaryPath = path.string() + temporaryFileExtension;
+  FILE* file = fopen(temporaryPath.string().c_str(), "wb");
+  if (!file) {
+    LOG(WARNING) << "Cannot open a file in the streaming disk cache for writing: " << temporaryPath.string();
+    return false;
+  }
+  
+  const bool success = fwrite(data.data(), 1, data.size(), file) == data.size();
+  if (fclose(file) != 0 || !success) {
+    LOG(WARNING) << "Failed to write a file in the streaming disk cache: " << temporaryPath.string();
+    error_code errorCode;
+    fs::remove(temporaryPath, errorCode);
+    return false;
+  }
+  
+  error_code errorCode;
+  fs::rename(temporaryPath, path, errorCode);
+  if (errorCode) {
+    LOG(WARNING) << "Failed to rename a file in the streaming disk cache to: " << path.string() << " (" << errorCode.message() << ")";
+    fs::remove(temporaryPath, errorCode);
+    return false;
+  }
+  
+  return true;
+}
+
+void StreamingDiskCache::RemoveEntry(const string& key) {
+  auto it = entries.find(key);
+  if (it == entries.end()) { return; }
+  
+  sizeInBytes -= it->second.storedBytes;
+  entries.erase(it);
+  
+  // Remove the range map first, such that the data file does not get used anymore if removing it fails
+  error_code errorCode;
+  fs::remove(RangeMapPath(key), errorCode);
+  fs::remove(DataPath(key), errorCode);
+}
+
+bool StreamingDiskCache::EvictEntries(s64 requiredBytes) {
+  // Entries that are in use cannot be evicted. If the required bytes do not fit next to them, do not evict anything in vain.
+  s64 inUseBytes = 0;
+  for (const auto& item : entries) {
+    if (item.second.useCount != 0) {
+      inUseBytes += item.second.storedBytes;
+    }
+  }
+  if (inUseBytes + requiredBytes > maxSizeInBytes) {
+    return false;
+  }
+  
+  while (sizeInBytes + requiredBytes > maxSizeInBytes) {
+    auto leastRecentlyUsedIt = entries.end();
+    for (auto it = entries.begin(); it != entries.end(); ++ it) {
+      if (it->second.useCount == 0 &&
+          (leastRecentlyUsedIt == entries.end() || it->second.lastUse < leastRecentlyUsedIt->second.lastUse)) {
+        leastRecentlyUsedIt = it;
+      }
+    }
+    
+    if (leastRecentlyUsedIt == entries.end()) {
+      return false;
+    }
+    
+    const string key = leastRecentlyUsedIt->first;
+    RemoveEntry(key);
+  }
+  
+  return true;
+}
+
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <libvis/io/filesystem.h>
+#include <libvis/vulkan/libvis.h>
+
+namespace scan_studio {
+using namespace vis;
+
+/// Persistent on-disk cache for the ranges of files streamed by StreamingInputStream (see StreamingInputStream::SetDiskCache()).
+///
+/// Each cached file (entry) is identified by its URI, and validated by the file size and the ETag that the server returned
+/// for the HEAD request that StreamingInputStream sends when opening the file. If either changed, the entry's stored data is discarded.
+/// Each entry consists of two files in the cache directory, named after a hash of the URI:
+/// - A data file (".data") with the size of the streamed file, to which downloaded ranges are written at their file offsets.
+///   Parts that were not downloaded are never written, such that the data file is sparse on file systems that support this.
+/// - A range map file (".ranges"), which stores the URI, the validator, the ranges that are stored in the data file,
+///   and when the entry was last used. It is written after the data, such that it never lists data that was not written.
+///
+/// The total size of the stored ranges is limited by a byte budget across all entries. If storing a range exceeds it,
+/// the least-recently-used entries get evicted as a whole. Entries that are in use by an open stream are never evicted;
+/// if only those remain, the new range is not stored.
+///
+/// Downloaded ranges are stored by a writer thread (see QueueStoreRange()), such that the streams' download callbacks do not wait
+/// for the disk I/O. The writer thread stores all ranges that were queued in the meantime at once, updating the range map of each
+/// affected entry only once for them.
+///
+/// A single cache may be shared by multiple StreamingInputStreams; it is thread-safe.
+/// Only one cache instance (in one process) must use a given directory at a time.
+///
+/// The cache is not created automatically: applications that stream videos create it (choosing the directory and the budget)
+/// and pass it to their streams with StreamingInputStream::SetDiskCache(). The bundled viewers and the C API
+/// do not stream videos yet (they only open local files or custom input streams), and thus do not use a disk cache.
+class StreamingDiskCache {
+ public:
+  /// A range of bytes in a cached file (with inclusive ends, like the ranges of StreamingInputStream)
+  struct Range {
+    s64 from;
+    s64 to;
+  };
+  
+  inline StreamingDiskCache() {}
+  
+  /// Stores the queued ranges and stops the writer thread.
+  ~StreamingDiskCache();
+  
+  StreamingDiskCache(const StreamingDiskCache& other) = delete;
+  StreamingDiskCache& operator= (const StreamingDiskCache& other) = delete;
+  
+  /// Opens (or creates) the cache in the given directory, with the given maximum total size of the stored ranges in bytes.
+  /// Loads the range maps of the existing entries, removes invalid files, and evicts entries if they exceed the budget.
+  /// Returns true on success, false if the directory cannot be created.
+  bool Open(const fs::path& directory, s64 maxSizeInBytes);
+  
+  /// Acquires the entry for the given URI for use by a stream, creating it if it does not exist. Ranges of the entry that are still
+  /// queued for storing (e.g., by a previous stream for the same URI) are stored before. If the entry exists but the
+  /// validator (e.g., the ETag, which may be empty if unknown) or the content length differ from the stored ones, its data is discarded.
+  /// On success, outputs the ranges stored for the file (ordered by increasing offset), and if there are any,
+  /// a read-only mapping of the data file that they may be accessed in. The mapping remains valid for as long as a reference to it exists.
+  /// The entry is protected from eviction until it is released with ReleaseEntry().
+  /// Returns false if the cache is not open, or if the entry cannot be used (e.g., since another stream uses a different version of the file).
+  bool AcquireEntry(const string& uri, const string& validator, s64 contentLength, vector<Range>* storedRanges, shared_ptr<const u8>* mapping);
+  
+  /// Releases an entry that was acquired with AcquireEntry(). Does not wait for the entry's queued ranges to be stored;
+  /// the release takes effect once they are.
+  void ReleaseEntry(const string& uri);
+  
+  /// Queues the given downloaded range of an acquired entry to be stored by the writer thread. dataOwner must keep the data valid
+  /// until then. When storing the range, least-recently-used entries are evicted if required to stay within the budget.
+  /// If this is not possible, the range is not stored.
+  void QueueStoreRange(const string& uri, s64 from, s64 to, const u8* data, const shared_ptr<const void>& dataOwner);
+  
+  /// Waits until the writer thread has processed all queued ranges and releases.
+  void Flush();
+  
+  /// Returns the total size of the stored ranges of all entries in bytes (not including queued ranges, see Flush()).
+  s64 GetSizeInBytes();
+  
+ private:
+  struct Entry {
+    string uri;
+    string validator;
+    s64 contentLength = 0;
+    
+    /// The stored ranges, ordered by increasing offset and merged if they are adjacent or overlap
+    vector<Range> ranges;
+    s64 storedBytes = 0;
+    
+    /// Value of useCounter when the entry was last acquired, for least-recently-used eviction
+    u64 lastUse = 0;
+    
+    /// Number of streams that currently use the entry
+    int useCount = 0;
+  };
+  
+  /// A range to store or an entry to release, queued for the writer thread
+  struct QueuedOperation {
+    string uri;
+    
+    /// If true, the entry is released (see ReleaseEntry()), otherwise the range [from, to] is stored
+    bool release;
+    
+    s64 from;
+    s64 to;
+    const u8* data;
+    shared_ptr<const void> dataOwner;
+  };
+  
+  void WriterThreadMain();
+  
+  /// These require `cacheMutex` to be locked. StoreRangeLocked() returns true if the range got added to the entry's stored ranges,
+  /// in which case the entry's range map must be saved afterwards.
+  void ReleaseEntryLocked(const string& uri);
+  bool StoreRangeLocked(const string& uri, s64 from, s64 to, const u8* data);
+  
+  fs::path DataPath(const string& key) const;
+  fs::path RangeMapPath(const string& key) const;
+  
+  bool LoadRangeMap(const fs::path& path, Entry* entry);
+  bool SaveRangeMap(const string& key, const Entry& entry);
+  
+  void RemoveEntry(const string& key);
+  
+  /// Evicts least-recently-used entries that are not in use until at most maxSizeInBytes - requiredBytes bytes are stored.
+  /// Returns true if this succeeded. If this cannot succeed, since the required bytes do not fit next to the entries in use,
+  /// returns false without evicting anything.
+  bool EvictEntries(s64 requiredBytes);
+  
+  /// Entries by key (the file name stem, derived from the URI)
+  unordered_map<string, Entry> entries;
+  
+  /// Total size of the stored ranges of all entries
+  s64 sizeInBytes = 0;
+  
+  /// Counter that is incremented with each use of an entry
+  u64 useCounter = 0;
+  
+  fs::path directory;
+  s64 maxSizeInBytes = 0;
+  bool isOpen = false;
+  
+  mutex cacheMutex;
+  
+  /// Operations for the writer thread, in the order in which they were queued, and the number of
+  /// queued or in-progress operations per URI. These are protected by queueMutex.
+  vector<QueuedOperation> queuedOperations;
+  unordered_map<string, int> pendingOperationCounts;
+  bool quitWriterThread = false;
+  
+  /// Signaled when operations get queued, respectively when the writer thread finished processing operations.
+  /// This is separate from cacheMutex, such that queuing operations does not wait for the disk I/O of the writer thread.
+  mutex queueMutex;
+  condition_variable operationsQueuedCondition;
+  condition_variable operationsDoneCondition;
+  
+  std::thread writerThread;
+};
+
+}
@@ -11,6 +11,40 @@ namespace scan_studio {
 constexpr bool kDebug = false;
 constexpr bool kDebugLogStatistics = false;
 
+/// SetRequiredCacheSize() raises the cache size to at most this factor times the maxCacheSize that was passed to Open()
+constexpr s64 maxRequiredCacheSizeFactor = 4;
+
+/// A range that is served from a mapping of a StreamingDiskCache data file.
+/// It poses as a completed request, such that it can be used like the downloaded ranges in cachedRanges.
+class DiskCachedRange : public HttpRequest {
+ public:
+  inline DiskCachedRange(s64 from, s64 to, const shared_ptr<const u8>& mapping)
+      : mapping(mapping) {
+    statusCode = 206;
+    contentLength = to - from + 1;
+    contentRangeFrom = from;
+    contentRangeTo = to;
+    actualContentLength = contentLength;
+    headersCompleteOrFailed = true;
+    contentCompleteOrFailed = true;
+  }
+  
+  virtual bool SendRangeRequest(Verb /*verb*/, const char* /*uri*/, s64 /*rangeFrom*/, s64 /*rangeTo*/, bool /*allowUntrustedCertificates*/) override {
+    LOG(ERROR) << "DiskCachedRange cannot send requests";
+    return false;
+  }
+  
+  virtual void Abort() override {}
+  
+  virtual const u8* Content() override {
+    return mapping.get() + contentRangeFrom;
+  }
+  
+ private:
+  /// Mapping of the whole data file
+  shared_ptr<const u8> mapping;
+};
+
 StreamingInputStream::~StreamingInputStream() {
   Close();
 }
@@ -21,10 +55,13 @@ bool StreamingInputStream::Open(const char* uri, s64 minStreamSize, s64 maxCache
   Close();
   shuttingDown = false;
   fatalErrorOccurred = false;
+  headRequestSuccessful = false;
   
   this->uri = uri;
   this->minStreamSize = minStreamSize;
   this->maxCacheSize = maxCacheSize;
+  requiredCacheSize = 0;
+  bandwidthEstimator.Reset();
   this->allowUntrustedCertificates = allowUntrustedCertificates;
   this->httpRequestFactory = std::move(httpRequestFactory);
   
@@ -36,6 +73,11 @@ bool StreamingInputStream::Open(const char* uri, s64 minStreamSize, s64 maxCache
   return true;
 }
 
+void StreamingInputStream::SetDiskCache(const shared_ptr<StreamingDiskCache>& cache) {
+  if (minStreamSize >= 0 && !shuttingDown) { LOG(ERROR) << "SetDiskCache() must be called while the stream is closed"; }
+  diskCache = cache;
+}
+
 void StreamingInputStream::Close() {
   if (kDebug) { LOG(1) << "StreamingInputStream: Close()"; }
   
@@ -56,6 +98,13 @@ void StreamingInputStream::Close() {
     shuttingDown = true;
   }
   
+  // Failed downloads are handled without locking callbackMutex (see DownloadFinishedOrFailedCallback()).
+  // ScheduleRetry() checks `shuttingDown` while holding retryMutex, so after locking it once here,
+  // no new retry thread will be started anymore.
+  {
+    lock_guard<mutex> retryLock(retryMutex);
+  }
+  
   {
     lock_guard<mutex> lock(headRequestSuccessfulMutex);
   }
@@ -66,15 +115,15 @@ void StreamingInputStream::Close() {
     
     headRequest.reset();
     
-    // This will also keep the retryThread from re-starting currentRange:
-    rangesLock->currentRange.reset();
+    // This will also keep the retryThread from re-starting any downloads:
+    rangesLock->activeRanges = vector<unique_ptr<ActiveRange>>();
     
     // Free up memory:
     rangesLock->cachedRanges = vector<CachedRange>();
     rangesLock->scheduledRanges = vector<ScheduledRange>();
   }
   
-  // The currentRange.reset() above keeps the retryThread from creating new requests, i.e., we have cleaned up all requests above.
+  // Clearing activeRanges above keeps the retryThread from creating new requests, i.e., we have cleaned up all requests above.
   // Finally, abort the retry thread in case it runs, and join it.
   abortRetryCondition.notify_all();
   if (retryThread.joinable()) {
@@ -83,12 +132,62 @@ void StreamingInputStream::Close() {
   if (headRetryThread.joinable()) {
     headRetryThread.join();
   }
+  
+  {
+    lock_guard<mutex> retryLock(retryMutex);
+    failedDownloads.clear();
+    retryThreadRunning = false;
+  }
+  
+  // All requests have been destructed above, so no completion callback accesses the disk cache entry anymore
+  if (diskCacheEntryAcquired) {
+    diskCache->ReleaseEntry(uri);
+    diskCacheEntryAcquired = false;
+  }
 }
 
 bool StreamingInputStream::HasFatalError() {
   return fatalErrorOccurred;
 }
 
+void StreamingInputStream::SetMaxConcurrentRequests(int count) {
+  auto rangesLock = ranges.Lock();
+  
+  maxConcurrentRequests = std::max(1, count);
+  StartScheduledDownloads(&rangesLock);
+}
+
+int StreamingInputStream::GetMaxConcurrentRequests() {
+  auto rangesLock = ranges.Lock();
+  return maxConcurrentRequests;
+}
+
+void StreamingInputStream::SetRequiredCacheSize(s64 bytes) {
+  auto rangesLock = ranges.Lock();
+  // A negative maxCacheSize means that the cache is unlimited, so there is nothing to cap
+  requiredCacheSize = (maxCacheSize < 0) ? bytes : std::min(bytes, maxRequiredCacheSizeFactor * maxCacheSize);
+}
+
+bool StreamingInputStream::IsRangeAvailable(s64 from, s64 to) {
+  auto rangesLock = ranges.Lock();
+  
+  // Since the cached ranges are ordered by increasing file position, a single pass suffices to check whether they cover [from, to]
+  s64 coveredUntil = from;  // exclusive
+  for (const auto& rangeItem : rangesLock->cachedRanges) {
+    const auto& range = rangeItem.range;
+    if (range->ContentRangeFrom() <= coveredUntil && range->ContentRangeTo() >= coveredUntil) {
+      coveredUntil = range->ContentRangeTo() + 1;
+      if (coveredUntil > to) {
+        return true;
+      }
+    } else if (range->ContentRangeFrom() > coveredUntil) {
+      break;
+    }
+  }
+  
+  return coveredUntil > to;
+}
+
 void StreamingInputStream::StreamRange(s64 from, s64 to, bool allowExtendRange, s64 maxStreamSize) {
   if (kDebug) { LOG(1) << "StreamingInputStream: StreamRange() from " << from << " to " << to; }
   if (minStreamSize < 0) { LOG(ERROR) << "The stream must be opened before calling this function"; return; }
@@ -154,8 +253,8 @@ void StreamingInputStream::StreamRange(s64 from, s64 to, bool allowExtendRange,
     removeExistingRange(range->ContentRangeFrom(), range->ContentRangeTo());
   }
   
-  if (rangesLock->currentRange) {
-    removeExistingRange(rangesLock->currentScheduledRange.from, rangesLock->currentScheduledRange.to);
+  for (const auto& activeRange : rangesLock->activeRanges) {
+    removeExistingRange(activeRange->scheduledRange.from, activeRange->scheduledRange.to);
   }
   
   for (const auto& range : rangesLock->scheduledRanges) {
@@ -324,7 +423,15 @@ usize StreamingInputStream::Read(void* data, usize size) {
         return true;
       };
       
-      if (rangesLock->currentRange && checkScheduledRange(rangesLock->currentScheduledRange)) {
+      bool rangeInProgress = false;
+      for (auto& activeRange : rangesLock->activeRanges) {
+        if (checkScheduledRange(activeRange->scheduledRange)) {
+          rangeInProgress = true;
+          break;
+        }
+      }
+      
+      if (rangeInProgress) {
         continue;
       }
       
@@ -397,7 +504,7 @@ usize StreamingInputStream::Read(void* data, usize size) {
         continue;
       }
       
-      if (rangesLock->currentRange == nullptr && rangesLock->scheduledRanges.empty()) {
+      if (rangesLock->activeRanges.empty() && rangesLock->scheduledRanges.empty()) {
         // At least one range is still missing, but no download is in progress anymore.
         // Since we protect all missing ranges from being dropped, this should in theory never happen.
         LOG(ERROR) << "Failed to wait for missing streamed ranges";
@@ -427,6 +534,117 @@ usize StreamingInputStream::Read(void* data, usize size) {
   return (size - remainingSize);
 }
 
+bool StreamingInputStream::ReadPinned(usize size, const u8** data, shared_ptr<const void>* pin) {
+  if (minStreamSize < 0) { LOG(ERROR) << "The stream must be opened before calling this function"; return false; }
+  
+  if (size == 0 || fatalErrorOccurred) {
+    return false;
+  }
+  
+  if (!WaitForHeadRequest()) { return false; }
+  
+  const s64 readFrom = filePosition;
+  const s64 readTo = filePosition + size - 1;
+  if (readTo >= headRequest->ContentLength()) {
+    return false;
+  }
+  
+  auto rangesLock = ranges.Lock();
+  
+  // Outputs the data and pin for the given cached range that contains the read
+  auto pinCachedRange = [&](CachedRange* cachedRangeItem) {
+    ++ accessCounter;
+    cachedRangeItem->lastAccess = accessCounter;
+    
+    *data = cachedRangeItem->range->Content() + (readFrom - cachedRangeItem->range->ContentRangeFrom());
+    *pin = cachedRangeItem->range;
+    filePosition += size;
+  };
+  
+  // Since ranges never overlap, the first range that overlaps the read either contains it,
+  // or the read crosses a range boundary and cannot be pinned.
+  for (auto& cachedRangeItem : rangesLock->cachedRanges) {
+    const auto& range = cachedRangeItem.range;
+    if (range->ContentRangeTo() < readFrom || range->ContentRangeFrom() > readTo) {
+      continue;
+    }
+    if (range->ContentRangeFrom() > readFrom || range->ContentRangeTo() < readTo) {
+      return false;
+    }
+    
+    pinCachedRange(&cachedRangeItem);
+    return true;
+  }
+  
+  // The data is not cached yet. Find the range that it is being downloaded in or scheduled for, or schedule a new range.
+  // In either case, protect the range from being dropped, and make sure that it is downloaded next.
+  ScheduledRange* containingRange = nullptr;
+  int containingScheduledRangeIdx = -1;
+  
+  for (auto& activeRange : rangesLock->activeRanges) {
+    ScheduledRange& range = activeRange->scheduledRange;
+    if (range.to >= readFrom && range.from <= readTo) {
+      containingRange = &range;
+      break;
+    }
+  }
+  
+  for (usize scheduledRangeIdx = 0; containingRange == nullptr && scheduledRangeIdx < rangesLock->scheduledRanges.size(); ++ scheduledRangeIdx) {
+    ScheduledRange& range = rangesLock->scheduledRanges[scheduledRangeIdx];
+    if (range.to >= readFrom && range.from <= readTo) {
+      containingRange = &range;
+      containingScheduledRangeIdx = static_cast<int>(scheduledRangeIdx);
+    }
+  }
+  
+  ScheduledRange waitedRange;
+  
+  if (containingRange != nullptr) {
+    if (containingRange->from > readFrom || containingRange->to < readTo) {
+      return false;
+    }
+    containingRange->isProtected = true;
+    waitedRange = *containingRange;
+    
+    if (containingScheduledRangeIdx >= 0) {
+      // Re-schedule the range to the start of the queue.
+      auto rangeIt = rangesLock->scheduledRanges.begin() + containingScheduledRangeIdx;
+      std::rotate(rangesLock->scheduledRanges.begin(), rangeIt, rangeIt + 1);
+    }
+  } else {
+    // No part of the read is available or scheduled, so we can request a range that contains it.
+    // Extending the range (if at all) only grows it.
+    waitedRange = ScheduleRange(readFrom, readTo, /*allowExtendRange*/ true, /*bypassQueue*/ true, /*protectRange*/ true, &rangesLock);
+  }
+  
+  // Wait for the range to finish downloading
+  abortCurrentRead = false;
+  
+  while (true) {
+    for (auto& cachedRangeItem : rangesLock->cachedRanges) {
+      if (cachedRangeItem.range->ContentRangeFrom() == waitedRange.from &&
+          cachedRangeItem.range->ContentRangeTo() == waitedRange.to) {
+        cachedRangeItem.isProtected = false;
+        pinCachedRange(&cachedRangeItem);
+        return true;
+      }
+    }
+    
+    if (rangesLock->activeRanges.empty() && rangesLock->scheduledRanges.empty()) {
+      // Since we protect the range from being dropped, this should in theory never happen.
+      LOG(ERROR) << "Failed to wait for a missing streamed range";
+      return false;
+    }
+    
+    newRangeCondition.wait(rangesLock.GetLock());
+    
+    if (abortCurrentRead || fatalErrorOccurred) {
+      if (kDebug) { LOG(1) << "StreamingInputStream: ReadPinned() aborted"; }
+      return false;
+    }
+  }
+}
+
 void StreamingInputStream::AbortRead() {
   // Note: This implementation won't abort Read() if Read()'s execution is still before the point where it acquires `rangesLock`.
   //       This should not be a problem though.
@@ -470,8 +688,10 @@ s64 StreamingInputStream::FindPreviousRangeEnd(s64 position, LockedWrapMutex<Ran
     }
   }
   
-  if (lock->currentRange && lock->currentScheduledRange.to < position) {
-    result = std::max(result, lock->currentScheduledRange.to);
+  for (const auto& activeRange : lock->activeRanges) {
+    if (activeRange->scheduledRange.to < position) {
+      result = std::max(result, activeRange->scheduledRange.to);
+    }
   }
   
   for (const auto& range : lock->scheduledRanges) {
@@ -496,8 +716,10 @@ s64 StreamingInputStream::FindNextRangeStart(s64 position, LockedWrapMutex<Range
     }
   }
   
-  if (lock->currentRange && lock->currentScheduledRange.from > position) {
-    result = std::min(result, lock->currentScheduledRange.from);
+  for (const auto& activeRange : lock->activeRanges) {
+    if (activeRange->scheduledRange.from > position) {
+      result = std::min(result, activeRange->scheduledRange.from);
+    }
   }
   
   for (const auto& range : lock->scheduledRanges) {
@@ -545,7 +767,8 @@ StreamingInputStream::ScheduledRange StreamingInputStream::ScheduleRange(s64 fro
   ScheduledRange newScheduledRange(from, to, scheduleCounter, protectRange);
   ++ scheduleCounter;
   
-  if (lock->currentRange == nullptr) {
+  if (static_cast<int>(lock->activeRanges.size()) < maxConcurrentRequests) {
+    // Since free request slots get filled from scheduledRanges right away, the queue is empty in this case.
     StartDownload(newScheduledRange, rangesLock);
   } else if (bypassQueue) {
     lock->scheduledRanges.insert(lock->scheduledRanges.begin(), newScheduledRange);
@@ -569,21 +792,50 @@ void StreamingInputStream::StartDownload(const ScheduledRange& range, LockedWrap
   if (kDebug) { LOG(1) << "StreamingInputStream: StartDownload(), range: " << range.from << " to " << range.to; }
   LockedWrapMutex<Ranges>& lock = *rangesLock;
   
-  if (lock->currentRange) {
-    LOG(ERROR) << "A download is already in progress";
-    return;
+  lock->activeRanges.emplace_back(new ActiveRange(this, range));
+  if (!SendDownloadRequest(lock->activeRanges.back().get(), rangesLock)) {
+    ScheduleRetry(range.scheduleCounter);
+  }
+}
+
+void StreamingInputStream::StartScheduledDownloads(LockedWrapMutex<Ranges>* rangesLock) {
+  LockedWrapMutex<Ranges>& lock = *rangesLock;
+  
+  // Keep up to maxConcurrentRequests downloads in flight, such that the latency of each request
+  // overlaps with the transfer of the previous requests' content.
+  while (static_cast<int>(lock->activeRanges.size()) < maxConcurrentRequests && !lock->scheduledRanges.empty()) {
+    ScheduledRange range = lock->scheduledRanges.front();
+    lock->scheduledRanges.erase(lock->scheduledRanges.begin());
+    
+    StartDownload(range, rangesLock);
   }
+}
+
+bool StreamingInputStream::SendDownloadRequest(ActiveRange* activeRange, LockedWrapMutex<Ranges>* rangesLock) {
+  activeRange->sendTime = Clock::now();
+  activeRange->otherRequestsInFlight = (*rangesLock)->activeRanges.size() > 1;
   
-  lock->currentScheduledRange = range;
+  activeRange->request = httpRequestFactory->CreateHttpRequest();
+  activeRange->request->SetCompletionCallback(&StreamingInputStream::DownloadFinishedOrFailedCallbackStatic, activeRange);
+  return activeRange->request->SendRangeRequest(HttpRequest::Verb::GET, uri.c_str(), activeRange->scheduledRange.from, activeRange->scheduledRange.to, allowUntrustedCertificates);
+}
+
+void StreamingInputStream::ScheduleRetry(u64 scheduleCounter) {
+  lock_guard<mutex> lock(retryMutex);
+  if (shuttingDown) { return; }
   
-  lock->currentRange = httpRequestFactory->CreateHttpRequest();
-  lock->currentRange->SetCompletionCallback(&StreamingInputStream::DownloadFinishedOrFailedCallbackStatic, this);
-  if (!lock->currentRange->SendRangeRequest(HttpRequest::Verb::GET, uri.c_str(), range.from, range.to, allowUntrustedCertificates)) {
+  failedDownloads.push_back(scheduleCounter);
+  
+  // If the retry thread is running, it will also pick up this download. Otherwise, start it.
+  // Notice that this may be called by the retry thread itself (if a request fails directly within SendRangeRequest()),
+  // in which case retryThreadRunning is true.
+  if (!retryThreadRunning) {
     if (retryThread.joinable()) {
-      // TODO: Check whether this wait is fully thread-safe with shutdown and with the retry thread
+      // The old retry thread has cleared retryThreadRunning as its last action, so this does not block for long.
       retryThread.join();
     }
     retryThread = std::thread(&StreamingInputStream::RetryThreadMain, this);
+    retryThreadRunning = true;
   }
 }
 
@@ -591,67 +843,95 @@ void StreamingInputStream::RetryThreadMain() {
   if (kDebug) { LOG(1) << "StreamingInputStream: RetryThreadMain()"; }
   
   // Wait shortly to prevent creating 100% CPU load in case all retries fail immediately
-  // TODO: Would possible spurious wake-ups of wait_until() (which will return std::cv_status::no_timeout) cause issues here?
   {
     unique_lock<mutex> lock(abortRetryMutex);
-    auto waitUntil = chrono::steady_clock::now() + 5ms;
-    if (abortRetryCondition.wait_until(lock, waitUntil) == std::cv_status::no_timeout) {
-      return;
-    }
+    abortRetryCondition.wait_for(lock, 5ms, [this]() { return shuttingDown.load(); });
   }
   
   while (true) {
+    vector<u64> retriedDownloads;
     {
-      auto rangesLock = ranges.Lock();
-      
-      if (rangesLock->currentRange == nullptr) {
-        // Cancel() has been called.
+      lock_guard<mutex> lock(retryMutex);
+      if (failedDownloads.empty() || shuttingDown) {
+        failedDownloads.clear();
+        retryThreadRunning = false;
         return;
       }
+      retriedDownloads.swap(failedDownloads);
+    }
+    
+    // A download may have been reported as failed twice: by the return value of SendRangeRequest(), and by the completion callback.
+    std::sort(retriedDownloads.begin(), retriedDownloads.end());
+    retriedDownloads.erase(std::unique(retriedDownloads.begin(), retriedDownloads.end()), retriedDownloads.end());
+    
+    vector<u64> stillFailedDownloads;
+    {
+      auto rangesLock = ranges.Lock();
       
-      rangesLock->currentRange = httpRequestFactory->CreateHttpRequest();
-      rangesLock->currentRange->SetCompletionCallback(&StreamingInputStream::DownloadFinishedOrFailedCallbackStatic, this);
-      if (rangesLock->currentRange->SendRangeRequest(HttpRequest::Verb::GET, uri.c_str(), rangesLock->currentScheduledRange.from, rangesLock->currentScheduledRange.to, allowUntrustedCertificates)) {
-        return;
+      for (u64 scheduleCounter : retriedDownloads) {
+        // If the range is not active anymore, Close() has been called.
+        for (auto& activeRange : rangesLock->activeRanges) {
+          if (activeRange->scheduledRange.scheduleCounter == scheduleCounter) {
+            if (!SendDownloadRequest(activeRange.get(), &rangesLock)) {
+              stillFailedDownloads.push_back(scheduleCounter);
+            }
+            break;
+          }
+        }
       }
     }
     
+    if (!stillFailedDownloads.empty()) {
+      lock_guard<mutex> lock(retryMutex);
+      failedDownloads.insert(failedDownloads.end(), stillFailedDownloads.begin(), stillFailedDownloads.end());
+    }
+    
     this_thread::sleep_for(1ms);
   }
 }
 
-void StreamingInputStream::DownloadFinishedOrFailedCallback(HttpRequest* request, bool success) {
+void StreamingInputStream::DownloadFinishedOrFailedCallback(ActiveRange* activeRange, HttpRequest* request, bool success) {
   if (kDebug) { LOG(1) << "StreamingInputStream: DownloadFinishedOrFailedCallback(), success: " << success; }
-  lock_guard<mutex> callbackLock(callbackMutex);
-  if (shuttingDown) { return; }
   
   if (!success) {
-    if (kDebug) { LOG(WARNING) << "Streaming of a file range failed, starting retry thread ..."; }
+    if (kDebug) { LOG(WARNING) << "Streaming of a file range failed, scheduling a retry ..."; }
     
     // Schedule a retry after a short delay.
     // This delay on the one hand prevents creating 100% CPU load in case all retries fail immediately.
-    // On the other hand, it prevents endless recursion if this failure callback is invoked directly by currentRange->SendRangeRequest().
-    if (retryThread.joinable()) {
-      // TODO: Check whether this wait is fully thread-safe with shutdown and with the retry thread
-      retryThread.join();
-    }
-    retryThread = std::thread(&StreamingInputStream::RetryThreadMain, this);
-    
+    // On the other hand, it prevents endless recursion if this failure callback is invoked directly by SendRangeRequest().
+    //
+    // Notice that this path must neither lock callbackMutex nor the ranges, since failed requests may invoke this callback
+    // while the ranges are locked (directly from within SendRangeRequest(), or while the retry thread destructs the failed request),
+    // and the ranges are locked while callbackMutex is held by other completion callbacks.
+    ScheduleRetry(activeRange->scheduledRange.scheduleCounter);
     return;
   }
   
+  const TimePoint completionTime = Clock::now();
+  
+  lock_guard<mutex> callbackLock(callbackMutex);
+  if (shuttingDown) { return; }
+  
+  // Reference to the new range, for writing it to the disk cache after unlocking the ranges
+  shared_ptr<HttpRequest> newRange;
+  
   {
     auto rangesLock = ranges.Lock();
     
-    if (request != rangesLock->currentRange.get()) {
-      LOG(ERROR) << "Got a download finished/failed callback for a request which is not current";
+    auto activeRangeIt = std::find_if(rangesLock->activeRanges.begin(), rangesLock->activeRanges.end(), [activeRange](const unique_ptr<ActiveRange>& item) {
+      return item.get() == activeRange;
+    });
+    if (activeRangeIt == rangesLock->activeRanges.end() || request != activeRange->request.get()) {
+      LOG(ERROR) << "Got a download finished/failed callback for a request which is not active";
       return;
     }
     
-    if (request->ContentRangeFrom() != rangesLock->currentScheduledRange.from ||
-        request->ContentRangeTo() != rangesLock->currentScheduledRange.to) {
+    const ScheduledRange scheduledRange = activeRange->scheduledRange;
+    
+    if (request->ContentRangeFrom() != scheduledRange.from ||
+        request->ContentRangeTo() != scheduledRange.to) {
       LOG(ERROR) << "Got a different content range (" << request->ContentRangeFrom() << " to " << request->ContentRangeTo()
-                << ") from the server than requested (" << rangesLock->currentScheduledRange.from << " to " << rangesLock->currentScheduledRange.to
+                << ") from the server than requested (" << scheduledRange.from << " to " << scheduledRange.to
                 << "). Possibly the file was truncated on the server after streaming started? We likely cannot continue streaming in this situation, giving up.";
       fatalErrorOccurred = true;
       rangesLock.GetLock().unlock();
@@ -659,17 +939,19 @@ void StreamingInputStream::DownloadFinishedOrFailedCallback(HttpRequest* request
       return;
     }
     
-    // Move currentRange into its correct place in cachedRanges.
+    bandwidthEstimator.AddTransfer(activeRange->sendTime, completionTime, scheduledRange.to - scheduledRange.from + 1, activeRange->otherRequestsInFlight);
+    
+    // Move the request into its correct place in cachedRanges.
     // TODO: Use a binary search for that
     int newScheduledRangeIdx = -1;
     
     for (int i = 0; i < rangesLock->cachedRanges.size(); ++ i) {
-      if (rangesLock->currentScheduledRange.to < rangesLock->cachedRanges[i].range->ContentRangeFrom()) {
+      if (scheduledRange.to < rangesLock->cachedRanges[i].range->ContentRangeFrom()) {
         rangesLock->cachedRanges.emplace(
             rangesLock->cachedRanges.begin() + i,
-            std::move(rangesLock->currentRange),
-            rangesLock->currentScheduledRange.scheduleCounter,
-            rangesLock->currentScheduledRange.isProtected);
+            std::move(activeRange->request),
+            scheduledRange.scheduleCounter,
+            scheduledRange.isProtected);
         newScheduledRangeIdx = i;
         break;
       }
@@ -678,16 +960,22 @@ void StreamingInputStream::DownloadFinishedOrFailedCallback(HttpRequest* request
     if (newScheduledRangeIdx < 0) {
       newScheduledRangeIdx = rangesLock->cachedRanges.size();
       rangesLock->cachedRanges.emplace_back(
-          std::move(rangesLock->currentRange),
-          rangesLock->currentScheduledRange.scheduleCounter,
-          rangesLock->currentScheduledRange.isProtected);
+          std::move(activeRange->request),
+          scheduledRange.scheduleCounter,
+          scheduledRange.isProtected);
     }
     
-    rangesLock->currentRange = nullptr;
+    rangesLock->activeRanges.erase(activeRangeIt);
+    
+    if (diskCacheEntryAcquired) {
+      newRange = rangesLock->cachedRanges[newScheduledRangeIdx].range;
+    }
     
-    // If the cached ranges exceed maxCacheSize, remove ranges from the cache as needed.
+    // If the cached ranges exceed maxCacheSize (or the larger size set with SetRequiredCacheSize()), remove ranges from the cache as needed.
     // Removal heuristic:
     // - Do not remove any range that is required for a Read() operation that is in progress.
+    // - Do not remove any range that is pinned by ReadPinned(), since its data is in use (and removing it would not free its memory).
+    // - Do not remove any range that is served from the disk cache, since it does not use any memory apart from its mapping.
     // - Do not remove the range that was last accessed by a read operation, as it is very likely to be read again.
     // - Do not remove that has just been inserted (this could cause threading issues where a thread
     //   attempts to wait for itself to complete).
@@ -707,10 +995,14 @@ void StreamingInputStream::DownloadFinishedOrFailedCallback(HttpRequest* request
         if (lastUsedRange != nullptr) { LOG(ERROR) << "Found multiple ranges having the current accessCounter value"; }
         lastUsedRange = &rangeItem;
       }
-      cacheSize += range->ContentRangeTo() - range->ContentRangeFrom() + 1;
+      if (!rangeItem.isOnDisk) {
+        cacheSize += range->ContentRangeTo() - range->ContentRangeFrom() + 1;
+      }
     }
     
-    if (cacheSize > maxCacheSize) {
+    const usize cacheSizeLimit = std::max<s64>(maxCacheSize, requiredCacheSize);
+    
+    if (maxCacheSize >= 0 && cacheSize > cacheSizeLimit) {
       vector<int> removableItems;
       removableItems.reserve(rangesLock->scheduledRanges.size());
       
@@ -720,6 +1012,8 @@ void StreamingInputStream::DownloadFinishedOrFailedCallback(HttpRequest* request
         if (rangeItemIdx != newScheduledRangeIdx &&
             &rangeItem != lastUsedRange &&
             !rangeItem.isProtected &&
+            !rangeItem.isOnDisk &&
+            rangeItem.range.use_count() == 1 &&
             (lastUsedRange == nullptr || rangeItem.scheduleCounter < lastUsedRange->scheduleCounter)) {
           removableItems.emplace_back(rangeItemIdx);
         }
@@ -733,7 +1027,7 @@ void StreamingInputStream::DownloadFinishedOrFailedCallback(HttpRequest* request
       });
       
       int cleanupEndIndex = 0;
-      while (cleanupEndIndex < removableItems.size() && cacheSize > maxCacheSize) {
+      while (cleanupEndIndex < removableItems.size() && cacheSize > cacheSizeLimit) {
         const auto& cleanedRange = rangesLock->cachedRanges[removableItems[cleanupEndIndex]].range;
         const s64 rangeSize = cleanedRange->ContentRangeTo() - cleanedRange->ContentRangeFrom() + 1;
         
@@ -773,13 +1067,8 @@ void StreamingInputStream::DownloadFinishedOrFailedCallback(HttpRequest* request
       }
     }
     
-    // Start the next download (if any is queued)
-    if (!rangesLock->scheduledRanges.empty()) {
-      ScheduledRange range = rangesLock->scheduledRanges.front();
-      rangesLock->scheduledRanges.erase(rangesLock->scheduledRanges.begin());
-      
-      StartDownload(range, &rangesLock);
-    }
+    // Start the next download(s) (if any are queued)
+    StartScheduledDownloads(&rangesLock);
     
     // Debug logging
     if (kDebugLogStatistics) {
@@ -797,17 +1086,23 @@ void StreamingInputStream::DownloadFinishedOrFailedCallback(HttpRequest* request
       LOG(1) << "Streaming stats: cached: " << rangesLock->cachedRanges.size() << " (" << 0.1 * ((cachedBytes + (1024 * 1024 / 10) / 2) / (1024 * 1024 / 10)) << " MiB) |"
                 " cleaned: " << cleanedRangesCount << " (" << 0.1 * ((cleanedUpBytes + (1024 * 1024 / 10) / 2) / (1024 * 1024 / 10)) << " MiB) |"
                 " scheduled: " << rangesLock->scheduledRanges.size() << " (" << 0.1 * ((scheduledBytes + (1024 * 1024 / 10) / 2) / (1024 * 1024 / 10)) << " MiB) |"
-                " in_progress: " << ((rangesLock->currentRange != nullptr) ? 1 : 0);
+                " in_progress: " << rangesLock->activeRanges.size();
     }
   }
   
   // If the new range was needed for an ongoing Read() call, notify it
   newRangeCondition.notify_all();
+  
+  // Persist the new range. The disk cache's writer thread stores it, such that neither reads nor the other
+  // completion callbacks (which wait for callbackMutex) wait for the disk write. The request keeps the data alive until then.
+  if (newRange) {
+    diskCache->QueueStoreRange(uri, newRange->ContentRangeFrom(), newRange->ContentRangeTo(), newRange->Content(), newRange);
+  }
 }
 
 void StreamingInputStream::DownloadFinishedOrFailedCallbackStatic(HttpRequest* request, bool success, void* userPtr) {
-  StreamingInputStream* self = reinterpret_cast<StreamingInputStream*>(userPtr);
-  self->DownloadFinishedOrFailedCallback(request, success);
+  ActiveRange* activeRange = reinterpret_cast<ActiveRange*>(userPtr);
+  activeRange->stream->DownloadFinishedOrFailedCallback(activeRange, request, success);
 }
 
 bool StreamingInputStream::StartHeadRequest() {
@@ -815,6 +1110,7 @@ bool StreamingInputStream::StartHeadRequest() {
   
   headRequest = httpRequestFactory->CreateHttpRequest();
   headRequest->SetCompletionCallback(&StreamingInputStream::HeadFinishedOrFailedCallbackStatic, this);
+  headRequestSendTime = Clock::now();
   return headRequest->Send(HttpRequest::Verb::HEAD, uri.c_str(), allowUntrustedCertificates);
 }
 
@@ -856,6 +1152,12 @@ void StreamingInputStream::HeadFinishedOrFailedCallback(HttpRequest* /*request*/
   if (shuttingDown) { return; }
   
   if (success) {
+    bandwidthEstimator.AddRoundTrip(headRequestSendTime, Clock::now());
+    
+    if (diskCache && !diskCacheEntryAcquired) {
+      AcquireDiskCacheEntry();
+    }
+    
     headRequestSuccessfulMutex.lock();
     headRequestSuccessful = true;
     headRequestSuccessfulMutex.unlock();
@@ -874,6 +1176,30 @@ void StreamingInputStream::HeadFinishedOrFailedCallback(HttpRequest* /*request*/
   }
 }
 
+void StreamingInputStream::AcquireDiskCacheEntry() {
+  vector<StreamingDiskCache::Range> storedRanges;
+  shared_ptr<const u8> mapping;
+  if (!diskCache->AcquireEntry(uri, headRequest->ETag(), headRequest->ContentLength(), &storedRanges, &mapping)) {
+    return;
+  }
+  diskCacheEntryAcquired = true;
+  
+  if (kDebug) { LOG(1) << "StreamingInputStream: Serving " << storedRanges.size() << " ranges from the disk cache"; }
+  
+  // Since this happens before the HEAD request is marked as successful, no other ranges have been scheduled or downloaded yet
+  auto rangesLock = ranges.Lock();
+  rangesLock->cachedRanges.clear();
+  rangesLock->cachedRanges.reserve(storedRanges.size());
+  
+  for (const auto& storedRange : storedRanges) {
+    rangesLock->cachedRanges.emplace_back(
+        shared_ptr<HttpRequest>(new DiskCachedRange(storedRange.from, storedRange.to, mapping)),
+        /*scheduleCounter*/ 0,
+        /*isProtected*/ false);
+    rangesLock->cachedRanges.back().isOnDisk = true;
+  }
+}
+
 void StreamingInputStream::HeadFinishedOrFailedCallbackStatic(HttpRequest* request, bool success, void* userPtr) {
   StreamingInputStream* self = reinterpret_cast<StreamingInputStream*>(userPtr);
   self->HeadFinishedOrFailedCallback(request, success);
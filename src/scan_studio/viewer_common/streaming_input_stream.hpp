@@ -9,6 +9,8 @@
 #include "scan_studio/common/wrap_mutex.hpp"
 
 #include "scan_studio/viewer_common/http_request.hpp"
+#include "scan_studio/viewer_common/streaming_bandwidth_estimator.hpp"
+#include "scan_studio/viewer_common/streaming_disk_cache.hpp"
 
 namespace scan_studio {
 using namespace vis;
@@ -33,22 +35,26 @@ using namespace vis;
 /// All streamed ranges are cached.
 /// A maximum cache size may be set, which causes the class to drop least-recently-used ranges.
 ///
-/// TODO: For each new request, there is the ping overhead: it travels to the server, is handled there, and finally the headers for the request arrive back at the sender (us).
-///       The actual content receiving only starts after this period of latency.
-///       For better streaming performance, it seems that it would be important to start a second request before the current request finishes,
-///       trying to avoid any waiting time where we only wait for the next request's headers, but do not transfer any data!
+/// For each request, there is the ping overhead: it travels to the server, is handled there, and finally the headers for the request arrive back at the sender (us).
+/// The actual content receiving only starts after this period of latency. To avoid waiting times in which we only wait for the next request's headers,
+/// but do not transfer any data, multiple requests are kept in flight at the same time (see SetMaxConcurrentRequests()).
+/// The next scheduled range thus gets requested before the current one finishes. Scheduled ranges are started in the order of their priority,
+/// i.e., ranges required by Read() first, followed by the other scheduled ranges in the order in which they were scheduled.
 ///
-/// TODO: Using this class to stream XRV files, currently we copy memory when reading data.
-///       In order to achieve zero-copy operation, consider:
-///       - Make it possible to externally pin ranges in order to ensure that they won't be dropped
-///         (allowing for zero-copy use of the pinned data). Notice that this may cause the maximum cache size to be exceeded when pinning too many ranges.
-///       - We first read the headers while not knowing about the file structure yet, and later read the chunks, while knowing all chunk boundaries exactly.
-///         For this use-case, it may be useful to 'retire' all current ranges after finishing reading the headers,
-///         allowing all future ranges to be aligned with chunk boundaries, which enables zero-copy use of the chunk data.
-///         The retired ranges may still be kept for a while and be used to memcpy() data into new ranges if they overlap with new ranges,
-///         such that only the actually unknown ranges need to be streamed.
-///         Alternatively, if the consuming code can transparently handle both the case that memory is copied and the case of zero-copy access,
-///         then no such explicit retiring may be necessary.
+/// Read() copies the data out of the streamed ranges. For zero-copy access, ReadPinned() instead returns a pointer into a range,
+/// pinning the range for as long as the data is used. This works if the read lies within a single range. For XRV files,
+/// ranges get scheduled aligned to frame chunk boundaries once the file index is known, such that this is the case for almost all frames.
+/// Reads that cross range boundaries (for example, since the ranges were requested while reading the file headers,
+/// without knowing about the file structure yet) must use Read() instead.
+///
+/// The timings of all completed requests are fed into a StreamingBandwidthEstimator (see GetBandwidthEstimator()).
+/// Its estimates allow the code that schedules ranges to adapt the amount of data streamed in advance, and the size of the ranges,
+/// to the network connection. Since the appropriate cache size depends on that, it may be raised with SetRequiredCacheSize().
+///
+/// The in-memory cache is dropped by Close(). To keep streamed data across sessions, a StreamingDiskCache may be set with SetDiskCache().
+/// All downloaded ranges then get written to it, and the next time that the same file is opened (with an unchanged size and ETag),
+/// the stored ranges are served from a mapping of the cache file without any network requests (apart from the HEAD request,
+/// which is still required to validate the stored data). Only the gaps between them get downloaded.
 class StreamingInputStream : public InputStream {
  public:
   inline StreamingInputStream() {}
@@ -67,6 +73,7 @@ class StreamingInputStream : public InputStream {
   /// Open() will return asynchronously, without waiting for this request to complete.
   ///
   /// Notice that maxCacheSize is treated as a guideline and not as a strict maximum.
+  /// A negative maxCacheSize makes the cache unlimited, i.e., cached ranges are never removed.
   ///
   /// TODO: We could make an optional parameter that allows to pass the file size if already known.
   ///       Then the HEAD request could be skipped for slightly better performance.
@@ -75,9 +82,36 @@ class StreamingInputStream : public InputStream {
   /// Closes the stream if it is open.
   void Close();
   
+  /// Sets a disk cache that stored ranges are read from and downloaded ranges are written to (see StreamingDiskCache),
+  /// or nullptr to not use a disk cache. Must be called while the stream is closed; it is used by all following calls to Open().
+  /// The cache may be shared among multiple streams.
+  void SetDiskCache(const shared_ptr<StreamingDiskCache>& cache);
+  
   /// Returns true if there was an unrecoverable streaming error.
   bool HasFatalError();
   
+  /// Sets the maximum number of range requests that may be in flight at the same time (at least 1).
+  /// Higher values hide more of the request latency, at the cost of more parallel connections to the server.
+  /// May be called at any time; if the limit is raised, additional scheduled ranges are requested right away.
+  void SetMaxConcurrentRequests(int count);
+  
+  /// Returns the maximum number of range requests that may be in flight at the same time.
+  int GetMaxConcurrentRequests();
+  
+  /// Raises the cache size above the maxCacheSize that was passed to Open(), if the given size is larger.
+  /// This is intended for the streaming window computed by StreamingBandwidthEstimator::ComputeWindow(),
+  /// which may require a larger cache on slow connections, on which more data is streamed in advance.
+  /// The cache size is raised to at most four times maxCacheSize, such that the caller's limit stays meaningful.
+  /// The value gets reset by Open().
+  void SetRequiredCacheSize(s64 bytes);
+  
+  /// Returns true if the given range of the file (with inclusive bounds) has been downloaded completely
+  /// (or is stored in the disk cache), such that reading it does not have to wait for the network.
+  bool IsRangeAvailable(s64 from, s64 to);
+  
+  /// Returns the estimator for the connection's bandwidth and round-trip time, which is fed with the timings of this stream's requests.
+  inline StreamingBandwidthEstimator& GetBandwidthEstimator() { return bandwidthEstimator; }
+  
   /// Requests the given range of the file to be streamed.
   /// If the range overlaps with existing ranges, it will be clamped / broken up / discarded, adding only new parts that are not available or already scheduled yet.
   /// If allowExtendRange is true, the first and last range may be extended to try to increase their size up to minStreamSize, in order to avoid tiny packets with comparatively too large overhead.
@@ -89,6 +123,15 @@ class StreamingInputStream : public InputStream {
   /// This may be used if the knowledge about future reads changes, for example, when the user seeks to a different position in a video file.
   void DropPendingRequests();
   
+  /// Variant of Read() that avoids copying the data: If the `size` bytes at the current file position lie within a single
+  /// streamed range, outputs a pointer to them in *data and a pin on the range in *pin, advances the file position, and returns true.
+  /// The data remains valid for as long as the pin (or a copy of it) exists, even if the stream gets closed in the meantime.
+  /// Pinned ranges are not dropped from the cache, so notice that holding many pins may cause maxCacheSize to be exceeded.
+  ///
+  /// If the data is not available yet, this waits for it (streaming it if required), as Read() does.
+  /// Returns false if the data spans multiple ranges (in which case Read() must be used to read it), or on errors or if the read was aborted.
+  bool ReadPinned(usize size, const u8** data, shared_ptr<const void>* pin);
+  
   // InputStream implementation
   virtual usize Read(void* data, usize size) override;
   virtual void AbortRead() override;
@@ -99,7 +142,7 @@ class StreamingInputStream : public InputStream {
   struct CachedRange {
     inline CachedRange() {}
     
-    inline CachedRange(unique_ptr<HttpRequest>&& range, u64 scheduleCounter, bool isProtected)
+    inline CachedRange(shared_ptr<HttpRequest>&& range, u64 scheduleCounter, bool isProtected)
         : range(std::move(range)),
           lastAccess(-1),
           scheduleCounter(scheduleCounter),
@@ -113,7 +156,8 @@ class StreamingInputStream : public InputStream {
     
     /// Contains the downloaded cached data
     /// as well as its range information (ContentRangeFrom() to ContentRangeTo()).
-    unique_ptr<HttpRequest> range;
+    /// Additional references to this are held by the pins returned by ReadPinned().
+    shared_ptr<HttpRequest> range;
     
     /// Value of the access counter when this range was last accessed by a read operation.
     /// Used to clean up the ranges that have been accessed the longest ago.
@@ -127,6 +171,10 @@ class StreamingInputStream : public InputStream {
     /// Is this range required to fulfill an ongoing Read() call?
     /// If yes, it is protected from being removed by the cache cleanup routine.
     bool isProtected;
+    
+    /// Is this range stored in the disk cache (instead of having been downloaded in this session)?
+    /// These ranges are mapped from disk, so they do not count towards the cache size and never get removed by the cache cleanup routine.
+    bool isOnDisk = false;
   };
   
   struct ScheduledRange {
@@ -149,6 +197,28 @@ class StreamingInputStream : public InputStream {
     bool isProtected;
   };
   
+  struct ActiveRange {
+    inline ActiveRange(StreamingInputStream* stream, const ScheduledRange& scheduledRange)
+        : stream(stream),
+          scheduledRange(scheduledRange) {}
+    
+    /// The stream that this range belongs to. The ActiveRange is passed as user pointer to the
+    /// request's completion callback, which uses this to forward the call.
+    StreamingInputStream* stream;
+    
+    ScheduledRange scheduledRange;
+    
+    /// The time at which the (latest attempt of the) request was sent, and whether other requests were active at that time.
+    /// These are passed to the bandwidth estimator once the request completes.
+    TimePoint sendTime;
+    bool otherRequestsInFlight = false;
+    
+    /// The request downloading the range.
+    /// This is declared last such that it is destructed first: destructing a request waits for its
+    /// completion callback to finish, which accesses the other attributes.
+    unique_ptr<HttpRequest> request;
+  };
+  
   struct Ranges {
     /// Already-downloaded, cached ranges, ordered by increasing file position.
     ///
@@ -157,9 +227,9 @@ class StreamingInputStream : public InputStream {
     /// So, we have to keep the request object around as long as we want to access the response content without copying.
     vector<CachedRange> cachedRanges;
     
-    /// The range currently being downloaded, or null if there is no active download.
-    unique_ptr<HttpRequest> currentRange;
-    ScheduledRange currentScheduledRange;
+    /// The ranges currently being downloaded (at most maxConcurrentRequests), in the order in which they were started.
+    /// These are heap-allocated such that their address stays valid for the completion callbacks.
+    vector<unique_ptr<ActiveRange>> activeRanges;
     
     /// Ranges scheduled for future download, in the order in which they will be downloaded
     /// (unless re-prioritization happens).
@@ -174,17 +244,22 @@ class StreamingInputStream : public InputStream {
   bool WaitForHeadRequest();
   
   void StartDownload(const ScheduledRange& range, LockedWrapMutex<Ranges>* rangesLock);
+  void StartScheduledDownloads(LockedWrapMutex<Ranges>* rangesLock);
+  bool SendDownloadRequest(ActiveRange* activeRange, LockedWrapMutex<Ranges>* rangesLock);
+  void ScheduleRetry(u64 scheduleCounter);
   void RetryThreadMain();
-  void DownloadFinishedOrFailedCallback(HttpRequest* request, bool success);
+  void DownloadFinishedOrFailedCallback(ActiveRange* activeRange, HttpRequest* request, bool success);
   static void DownloadFinishedOrFailedCallbackStatic(HttpRequest* request, bool success, void* userPtr);
   
   bool StartHeadRequest();
   void HeadRetryThreadMain();
   void HeadFinishedOrFailedCallback(HttpRequest* request, bool success);
+  void AcquireDiskCacheEntry();
   static void HeadFinishedOrFailedCallbackStatic(HttpRequest* request, bool success, void* userPtr);
   
   /// Once completed successfully, contains the file size information
   unique_ptr<HttpRequest> headRequest;
+  TimePoint headRequestSendTime;
   mutex headRequestSuccessfulMutex;
   condition_variable headRequestSuccessfulCondition;
   atomic<bool> headRequestSuccessful = false;
@@ -196,6 +271,9 @@ class StreamingInputStream : public InputStream {
   /// or a fatal streaming error occurred.
   condition_variable newRangeCondition;
   
+  /// Estimates the connection's bandwidth and round-trip time from the completed requests
+  StreamingBandwidthEstimator bandwidthEstimator;
+  
   /// Whether a fatal error occurred during streaming.
   /// This is the case if we get a different content range from the server than we request.
   /// This implies that the file has been truncated on the server after streaming started.
@@ -213,10 +291,22 @@ class StreamingInputStream : public InputStream {
   /// Range scheduling counter, used to protect ranges that were scheduled after the range that was last read.
   u64 scheduleCounter = 0;
   
-  /// A thread which is started after a download fails. It re-tries the download after a short delay.
+  /// A thread which is started after a download fails. It re-tries the failed downloads after a short delay.
   std::thread retryThread;
   std::thread headRetryThread;
   
+  /// Protects failedDownloads and retryThreadRunning (and the retryThread object itself).
+  /// This is separate from the ranges mutex since failing requests may invoke their completion callback
+  /// while the ranges mutex is held, e.g., directly from within SendRangeRequest(), or while the
+  /// failed request gets destructed.
+  mutex retryMutex;
+  
+  /// Schedule counters of the active ranges whose download failed and must be re-tried by the retry thread.
+  vector<u64> failedDownloads;
+  
+  /// Whether the retry thread is running. As long as it runs, it takes care of all (newly) failed downloads.
+  bool retryThreadRunning = false;
+  
   /// This may be signaled to abort the retry threads.
   condition_variable abortRetryCondition;
   mutex abortRetryMutex;
@@ -225,9 +315,16 @@ class StreamingInputStream : public InputStream {
   mutex callbackMutex;
   atomic<bool> shuttingDown = false;
   
+  /// Optional persistent cache (see SetDiskCache()), and whether the entry for the current file has been acquired in it.
+  /// The latter is protected by callbackMutex.
+  shared_ptr<StreamingDiskCache> diskCache;
+  bool diskCacheEntryAcquired = false;
+  
   // Configuration
   s64 minStreamSize = -1;
   s64 maxCacheSize = -1;
+  s64 requiredCacheSize = 0;  // protected by the ranges mutex
+  int maxConcurrentRequests = 3;
   string uri;
   bool allowUntrustedCertificates;
   unique_ptr<HttpRequestFactory> httpRequestFactory;
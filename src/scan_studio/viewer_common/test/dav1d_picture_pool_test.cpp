@@ -0,0 +1,69 @@
+#include "scan_studio/viewer_common/xrvideo/dav1d_picture_pool.hpp"
+
+#include <gtest/gtest.h>
+
+#include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
+
+using namespace scan_studio;
+
+static Dav1dPicture CreateTestPicture(int width, int height) {
+  Dav1dPicture picture;
+  memset(&picture, 0, sizeof(picture));
+  picture.p.w = width;
+  picture.p.h = height;
+  picture.p.layout = DAV1D_PIXEL_LAYOUT_I420;
+  picture.p.bpc = 8;
+  return picture;
+}
+
+// Pictures whose size is a multiple of 128 get a contiguous layout, which copies to the same bytes as the generic path
+TEST(Dav1dPicturePool, TightPicturesAreContiguous) {
+  constexpr int width = 256;
+  constexpr int height = 128;
+  
+  Dav1dPicturePool pool;
+  Dav1dPicture picture = CreateTestPicture(width, height);
+  ASSERT_EQ(0, pool.Dav1dAllocPictureCallback(&picture));
+  
+  EXPECT_TRUE(Dav1dPicturePool::UsesTightLayout(width, height));
+  EXPECT_TRUE(XRVideoIsContiguousTexture(picture));
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(picture.data[0]) % DAV1D_PICTURE_ALIGNMENT);
+  
+  const usize textureSize = (3 * width * height) / 2;
+  u8* data = static_cast<u8*>(picture.data[0]);
+  for (usize i = 0; i < textureSize; ++ i) {
+    data[i] = i % 251;
+  }
+  
+  vector<u8> texture(textureSize);
+  XRVideoCopyTexture(picture, texture.data(), /*verboseDecoding*/ false);
+  for (usize i = 0; i < textureSize; ++ i) {
+    ASSERT_EQ(i % 251, texture[i]) << "at byte " << i;
+  }
+  
+  // A released buffer gets reused for the next picture
+  void* firstData = picture.data[0];
+  pool.Dav1dReleasePictureCallback(&picture);
+  
+  Dav1dPicture secondPicture = CreateTestPicture(width, height);
+  ASSERT_EQ(0, pool.Dav1dAllocPictureCallback(&secondPicture));
+  EXPECT_EQ(firstData, secondPicture.data[0]);
+  pool.Dav1dReleasePictureCallback(&secondPicture);
+}
+
+// Other picture sizes get a padded stride, with all planes aligned as dav1d requires
+TEST(Dav1dPicturePool, OtherPicturesArePadded) {
+  Dav1dPicturePool pool;
+  Dav1dPicture picture = CreateTestPicture(200, 100);
+  ASSERT_EQ(0, pool.Dav1dAllocPictureCallback(&picture));
+  
+  EXPECT_FALSE(Dav1dPicturePool::UsesTightLayout(200, 100));
+  EXPECT_FALSE(XRVideoIsContiguousTexture(picture));
+  EXPECT_EQ(256, picture.stride[0]);
+  EXPECT_EQ(128, picture.stride[1]);
+  for (int plane = 0; plane < 3; ++ plane) {
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(picture.data[plane]) % DAV1D_PICTURE_ALIGNMENT);
+  }
+  
+  pool.Dav1dReleasePictureCallback(&picture);
+}
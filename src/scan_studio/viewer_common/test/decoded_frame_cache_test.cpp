@@ -0,0 +1,162 @@
+#include "scan_studio/viewer_common/xrvideo/decoded_frame_cache.hpp"
+#include "scan_studio/viewer_common/xrvideo/xrvideo_memory_governor.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace scan_studio;
+
+struct DecodedFrameCacheTestFrame {
+  /// Whether the frame holds (pretended) resources, i.e., whether it was decoded and its resources were not released since
+  bool hasResources = false;
+};
+
+/// Creates a frame index with the given frame count, a duration of 1 per frame, and a keyframe every `keyframeInterval` frames
+static void CreateFrameIndex(int frameCount, int keyframeInterval, FrameIndex* index) {
+  for (int frame = 0; frame < frameCount; ++ frame) {
+    index->PushFrame(/*timestamp*/ frame, /*offset*/ frame, /*isKeyframe*/ frame % keyframeInterval == 0);
+  }
+  index->PushVideoEnd(/*timestamp*/ frameCount, /*endOffset*/ frameCount);
+}
+
+/// Decodes frames into the cache (without actually decoding anything) for playback starting at the given frame,
+/// until the cache does not return cache items for decoding anymore. The frames are reported with the given decoded data size.
+static void FillCache(int startFrame, bool forward, PlaybackMode mode, FrameIndex* index, DecodedFrameCache<DecodedFrameCacheTestFrame>* cache, s64 bytesPerFrame = 0) {
+  PlaybackState playbackState;
+  playbackState.SetPlaybackConditions(index->GetVideoStartTimestamp(), index->GetVideoEndTimestamp(), mode, /*speed*/ 1);
+  playbackState.Seek(startFrame, forward);
+  
+  for (int i = 0; i < 1000; ++ i) {
+    playbackState.Lock();
+    NextFramesIterator nextFramesIt(&playbackState, index);
+    playbackState.Unlock();
+    
+    vector<WriteLockedCachedFrame<DecodedFrameCacheTestFrame>> lockedFrames = cache->LockCacheItemsForDecodingNextFrame(nextFramesIt, *index);
+    if (lockedFrames.empty()) {
+      return;
+    }
+    for (WriteLockedCachedFrame<DecodedFrameCacheTestFrame>& lockedFrame : lockedFrames) {
+      lockedFrame.GetFrame()->hasResources = true;
+      lockedFrame.SetDecodedDataSize(bytesPerFrame);
+    }
+  }
+  
+  FAIL() << "The cache did not get filled";
+}
+
+// Verifies that the frames are evicted in the same order as sorting them by decreasing duration until they will be played back,
+// for all playback modes and directions, and including cached frames that are not part of the video (anymore)
+TEST(DecodedFrameCache, EvictionOrderMatchesSortingByDurationToFrame) {
+  constexpr int frameCount = 40;
+  constexpr int shortenedFrameCount = 32;
+  constexpr int capacity = 16;
+  
+  FrameIndex index;
+  CreateFrameIndex(frameCount, /*keyframeInterval*/ 8, &index);
+  
+  // Frames 32 to 39 are not part of this version of the video, to cover frames that are cached from a previous video
+  FrameIndex shortenedIndex;
+  CreateFrameIndex(shortenedFrameCount, /*keyframeInterval*/ 8, &shortenedIndex);
+  
+  DecodedFrameCache<DecodedFrameCacheTestFrame> cache;
+  ASSERT_TRUE(cache.Initialize(capacity));
+  
+  for (PlaybackMode fillMode : {PlaybackMode::SingleShot, PlaybackMode::Loop, PlaybackMode::BackAndForth}) {
+    for (int fillStartFrame : {0, 13, 27, 36}) {
+      for (bool fillForward : {true, false}) {
+        // Change the cached frames, leaving over some frames of the previous fill
+        FillCache(fillStartFrame, fillForward, fillMode, &index, &cache);
+        
+        for (FrameIndex* queryIndex : {&index, &shortenedIndex}) {
+          for (PlaybackMode mode : {PlaybackMode::SingleShot, PlaybackMode::Loop, PlaybackMode::BackAndForth}) {
+            PlaybackState playbackState;
+            playbackState.SetPlaybackConditions(queryIndex->GetVideoStartTimestamp(), queryIndex->GetVideoEndTimestamp(), mode, /*speed*/ 1);
+            
+            for (int currentFrame = 0; currentFrame < queryIndex->GetFrameCount(); ++ currentFrame) {
+              for (bool forward : {true, false}) {
+                playbackState.Seek(currentFrame, forward);
+                playbackState.Lock();
+                NextFramesIterator nextFramesIt(&playbackState, queryIndex);
+                playbackState.Unlock();
+                
+                const vector<int> evictionOrder = cache.GetCachedFramesInEvictionOrder(nextFramesIt, *queryIndex);
+                ASSERT_EQ(capacity, evictionOrder.size()) << "Not all cached frames were visited";
+                
+                // Sort the cached frames by decreasing duration until they will be played back
+                vector<int> sortedFrames = evictionOrder;
+                std::sort(sortedFrames.begin(), sortedFrames.end());
+                ASSERT_TRUE(std::adjacent_find(sortedFrames.begin(), sortedFrames.end()) == sortedFrames.end()) << "A frame was visited twice";
+                std::stable_sort(sortedFrames.begin(), sortedFrames.end(), [&](int a, int b) {
+                  return nextFramesIt.ComputeDurationToFrame(a) > nextFramesIt.ComputeDurationToFrame(b);
+                });
+                
+                // The order of frames with equal durations (frames that are never played back) is arbitrary, so compare the durations
+                ASSERT_EQ(sortedFrames.size(), evictionOrder.size());
+                for (int i = 0, size = evictionOrder.size(); i < size; ++ i) {
+                  ASSERT_EQ(nextFramesIt.ComputeDurationToFrame(sortedFrames[i]), nextFramesIt.ComputeDurationToFrame(evictionOrder[i]))
+                      << "at eviction order position " << i << " (frame count: " << queryIndex->GetFrameCount() << ", mode: " << static_cast<int>(mode)
+                      << ", current frame: " << currentFrame << ", forward: " << forward << ")";
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+// Verifies that lowering the slot limit notifies the video, and that the cache items of the evicted frames
+// are returned once for releasing their resources
+TEST(DecodedFrameCache, LoweredSlotLimitEvictsFramesForReleasingTheirResources) {
+  constexpr int frameCount = 40;
+  constexpr int capacity = 16;
+  constexpr s64 bytesPerFrame = 100;
+  
+  FrameIndex index;
+  CreateFrameIndex(frameCount, /*keyframeInterval*/ 8, &index);
+  
+  XRVideoMemoryGovernor governor(/*budgetBytes*/ capacity * bytesPerFrame);
+  shared_ptr<XRVideoMemoryAccount> account = governor.CreateAccount();
+  int slotLimitChangedCount = 0;
+  account->SetSlotLimitChangedCallback([&]() { ++ slotLimitChangedCount; });
+  account->SetSlotRange(/*minSlotCount*/ 3, /*maxSlotCount*/ capacity);
+  
+  DecodedFrameCache<DecodedFrameCacheTestFrame> cache;
+  ASSERT_TRUE(cache.Initialize(capacity));
+  cache.SetMemoryAccount(account.get());
+  
+  // Decode the minimum slot count, then let the governor assign the rest of the budget based on the frame size
+  FillCache(/*startFrame*/ 0, /*forward*/ true, PlaybackMode::Loop, &index, &cache, bytesPerFrame);
+  governor.Rebalance();
+  ASSERT_EQ(capacity, account->GetSlotLimit());
+  FillCache(/*startFrame*/ 0, /*forward*/ true, PlaybackMode::Loop, &index, &cache, bytesPerFrame);
+  EXPECT_EQ(capacity * bytesPerFrame, account->GetCachedBytes());
+  EXPECT_TRUE(cache.LockEvictedCacheItems().empty());
+  
+  // Lower the slot limit. The frames get evicted once the cache gets used for decoding again.
+  slotLimitChangedCount = 0;
+  governor.SetBudget(0);
+  EXPECT_EQ(1, slotLimitChangedCount);
+  ASSERT_EQ(3, account->GetSlotLimit());
+  FillCache(/*startFrame*/ 0, /*forward*/ true, PlaybackMode::Loop, &index, &cache, bytesPerFrame);
+  EXPECT_EQ(3 * bytesPerFrame, account->GetCachedBytes());
+  
+  vector<WriteLockedCachedFrame<DecodedFrameCacheTestFrame>> evictedFrames = cache.LockEvictedCacheItems();
+  EXPECT_EQ(capacity - 3, evictedFrames.size());
+  for (WriteLockedCachedFrame<DecodedFrameCacheTestFrame>& evictedFrame : evictedFrames) {
+    EXPECT_EQ(-1, evictedFrame.GetFrameIndex());
+    EXPECT_TRUE(evictedFrame.GetFrame()->hasResources);
+    evictedFrame.GetFrame()->hasResources = false;
+  }
+  evictedFrames.clear();
+  EXPECT_TRUE(cache.LockEvictedCacheItems().empty());
+  
+  // Raising the slot limit again reuses the released cache items
+  governor.SetBudget(capacity * bytesPerFrame);
+  EXPECT_EQ(2, slotLimitChangedCount);
+  FillCache(/*startFrame*/ 0, /*forward*/ true, PlaybackMode::Loop, &index, &cache, bytesPerFrame);
+  EXPECT_EQ(capacity * bytesPerFrame, account->GetCachedBytes());
+  EXPECT_TRUE(cache.LockEvictedCacheItems().empty());
+  
+  cache.SetMemoryAccount(nullptr);
+}
@@ -0,0 +1,108 @@
+#include "scan_studio/viewer_common/xrvideo/decoding_thread.hpp"
+
+#include <chrono>
+
+#include <gtest/gtest.h>
+
+#include <loguru.hpp>
+
+using namespace scan_studio;
+
+/// Frame indices in the order in which the TransferThread received the frames of DecodingThreadTestFrame
+static mutex transferredFrameIndicesMutex;
+static vector<int> transferredFrameIndices;
+
+/// Minimal frame type that takes its frame index from the metadata's start timestamp
+/// and stores the first byte of its (uncompressed RGB) texture frame.
+struct DecodingThreadTestFrame {
+  bool Initialize(
+      const XRVideoFrameMetadata& metadata,
+      const u8* /*contentPtr*/,
+      TextureFramePromise* textureFramePromise,
+      XRVideoDecodingContext* /*decodingContext*/,
+      bool /*verboseDecoding*/) {
+    frameIndex = metadata.startTimestamp;
+    
+    if (!textureFramePromise->Wait()) {
+      return false;
+    }
+    vector<u8> rgbData;
+    textureFramePromise->TakeRGB(&rgbData);
+    textureValue = rgbData.at(0);
+    
+    // Make earlier frames take longer to decode than later ones, such that concurrently decoded frames finish out of order
+    this_thread::sleep_for(chrono::milliseconds(2 * (16 - frameIndex % 16)));
+    return true;
+  }
+  
+  void WaitForResourceTransfers() {
+    lock_guard<mutex> lock(transferredFrameIndicesMutex);
+    transferredFrameIndices.push_back(frameIndex);
+  }
+  
+  int frameIndex = -1;
+  int textureValue = -1;
+};
+
+// Decodes frames with multiple workers and verifies that each frame gets matched with its own texture frame,
+// and that the frames are handed to the transfer thread in order
+TEST(DecodingThread, MultipleWorkersHandFramesToTransferThreadInOrder) {
+  constexpr int frameCount = 24;
+  
+  transferredFrameIndices.clear();
+  
+  DecodedFrameCache<DecodingThreadTestFrame> cache;
+  ASSERT_TRUE(cache.Initialize(frameCount));
+  
+  TransferThread<DecodingThreadTestFrame> transferThread;
+  transferThread.StartThread(/*verboseDecoding*/ false);
+  ASSERT_TRUE(transferThread.WaitForThreadToInitialize());
+  
+  DecodingThread<DecodingThreadTestFrame> decodingThread;
+  decodingThread.SetWorkerCount(4);
+  decodingThread.StartThread(/*verboseDecoding*/ false, &transferThread);
+  ASSERT_TRUE(decodingThread.WaitForThreadToInitialize());
+  
+  // Deliver some texture frames before their frames get queued, and the others afterwards
+  constexpr int earlyTextureFrameCount = 5;
+  for (int frameIndex = 0; frameIndex < earlyTextureFrameCount; ++ frameIndex) {
+    decodingThread.QueueUncompressedRGB(frameIndex, vector<u8>(1, 100 + frameIndex));
+  }
+  
+  for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+    shared_ptr<XRVideoFrameMetadata> metadata(new XRVideoFrameMetadata());
+    metadata->isKeyframe = true;
+    metadata->startTimestamp = frameIndex;
+    
+    WriteLockedCachedFrame<DecodingThreadTestFrame> cacheItem = cache.LockCacheItemForWriting(frameIndex);
+    ASSERT_NE(nullptr, cacheItem.GetFrame());
+    ASSERT_TRUE(decodingThread.QueueFrame(frameIndex, metadata, XRVideoFrameView(), /*frameContentPtr*/ nullptr, /*readingTime*/ 0, std::move(cacheItem)));
+  }
+  
+  for (int frameIndex = earlyTextureFrameCount; frameIndex < frameCount; ++ frameIndex) {
+    decodingThread.QueueUncompressedRGB(frameIndex, vector<u8>(1, 100 + frameIndex));
+  }
+  
+  // Wait for all frames to be transferred
+  const TimePoint startTime = Clock::now();
+  while (true) {
+    {
+      lock_guard<mutex> lock(transferredFrameIndicesMutex);
+      if (transferredFrameIndices.size() >= frameCount) { break; }
+    }
+    ASSERT_LT(SecondsFromTo(startTime, Clock::now()), 10.0) << "Timed out waiting for the frames to be transferred";
+    this_thread::sleep_for(chrono::milliseconds(1));
+  }
+  
+  decodingThread.Destroy();
+  transferThread.Destroy(/*finishAllTransfers*/ false);
+  
+  ASSERT_EQ(frameCount, transferredFrameIndices.size());
+  for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+    EXPECT_EQ(frameIndex, transferredFrameIndices[frameIndex]);
+    
+    WriteLockedCachedFrame<DecodingThreadTestFrame> cacheItem = cache.LockCacheItemForWriting(frameIndex);
+    ASSERT_NE(nullptr, cacheItem.GetFrame());
+    EXPECT_EQ(100 + frameIndex, cacheItem.GetFrame()->textureValue);
+  }
+}
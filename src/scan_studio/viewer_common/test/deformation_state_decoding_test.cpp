@@ -0,0 +1,40 @@
+#include "scan_studio/viewer_common/xrvideo/deformation_state_decoding.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace scan_studio;
+
+// Compares the SIMD implementation against the scalar one for all 2^16 half-float bit patterns,
+// placing each pattern at each of the 12 coefficient positions of a deformation node
+TEST(DeformationStateDecoding, MatchesScalarImplementation) {
+  constexpr int valuesPerNode = 12;
+  constexpr int patternCount = 1 << 16;
+  
+  for (int offset = 0; offset < valuesPerNode; ++ offset) {
+    // Use a count that is not a multiple of the SIMD width to also exercise the remainder handling
+    vector<u16> encodedValues(offset + patternCount + 3);
+    for (usize i = 0; i < encodedValues.size(); ++ i) {
+      encodedValues[i] = static_cast<u16>(i - offset);
+    }
+    
+    vector<float> simdResult(encodedValues.size());
+    vector<float> scalarResult(encodedValues.size());
+    XRVideoDecodeDeformationState(encodedValues.data(), encodedValues.size(), simdResult.data());
+    XRVideoDecodeDeformationStateScalar(encodedValues.data(), encodedValues.size(), scalarResult.data());
+    
+    for (usize i = 0; i < encodedValues.size(); ++ i) {
+      if (std::isnan(scalarResult[i])) {
+        EXPECT_TRUE(std::isnan(simdResult[i])) << "at index " << i << " (" << XRVideoDeformationStateDecodingInstructionSet() << ")";
+      } else {
+        u32 simdBits, scalarBits;
+        memcpy(&simdBits, &simdResult[i], sizeof(float));
+        memcpy(&scalarBits, &scalarResult[i], sizeof(float));
+        ASSERT_EQ(scalarBits, simdBits) << "at index " << i << ", encoded value " << encodedValues[i] << " (" << XRVideoDeformationStateDecodingInstructionSet() << ")";
+      }
+    }
+  }
+}
@@ -0,0 +1,212 @@
+#include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+#include <loguru.hpp>
+
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+#include "scan_studio/common/xrvideo_file.hpp"
+#include "scan_studio/tools/synthetic_xrvideo.hpp"
+#include "scan_studio/viewer_common/test/temporary_path.hpp"
+#include "scan_studio/viewer_common/xrvideo/index.hpp"
+
+using namespace scan_studio;
+
+// Decodes a synthetic video multiple times and verifies that after the first pass,
+// decoding does not perform any further allocations for intermediate data
+TEST(XRVideoDecodingContext, NoSteadyStateScratchAllocations) {
+  SyntheticXRVideoConfig config;
+  config.frameCount = 20;
+  config.keyframeInterval = 5;
+  config.uniqueVertexCount = 500;
+  config.duplicatedVertexCount = 30;
+  config.triangleCount = 900;
+  config.deformationNodeCount = 60;
+  config.textureWidth = 32;
+  config.textureHeight = 32;
+  config.vertexAlpha = true;
+  
+  const TemporaryPath temporaryPath("frame_loading_test", ".xrv");
+  const fs::path& path = temporaryPath.GetPath();
+  ASSERT_TRUE(GenerateSyntheticXRVideo(config, path));
+  
+  MappedFileInputStream* stream = new MappedFileInputStream();
+  ASSERT_TRUE(stream->Open(path));
+  XRVideoReader reader;
+  reader.TakeInputStream(stream, /*isStreamingInputStream*/ false, /*isMappedFileInputStream*/ true);
+  
+  ASSERT_TRUE(reader.FindNextChunk(xrVideoIndexChunkIdentifierV0));
+  FrameIndex index;
+  ASSERT_TRUE(index.CreateFromIndexChunk(&reader));
+  
+  XRVideoDecodingContext decodingContext;
+  ASSERT_TRUE(decodingContext.Initialize());
+  
+  vector<XRVideoVertex> vertices(config.uniqueVertexCount + config.duplicatedVertexCount);
+  vector<u16> indices(3 * config.triangleCount);
+  vector<float> deformationState(12 * config.deformationNodeCount);
+  
+  u64 allocationCountAfterFirstPass = 0;
+  
+  for (int pass = 0; pass < 3; ++ pass) {
+    ASSERT_TRUE(reader.Seek(index.At(0).GetOffset()));
+    
+    for (int frameIndex = 0; frameIndex < index.GetFrameCount(); ++ frameIndex) {
+      XRVideoFrameView view;
+      ASSERT_TRUE(reader.ReadNextFrameView(&view));
+      
+      const u8* dataPtr = view.data;
+      XRVideoFrameMetadata frameMetadata;
+      ASSERT_TRUE(XRVideoReadMetadata(&dataPtr, view.size, &frameMetadata));
+      
+      ASSERT_TRUE(XRVideoDecompressContent(
+          dataPtr, frameMetadata, &decodingContext,
+          vertices.data(), indices.data(), deformationState.data(),
+          /*outDuplicatedVertexSourceIndices*/ nullptr, decodingContext.GetVertexAlphaScratchVector(), /*verboseDecoding*/ false));
+      EXPECT_EQ(vertices.size(), decodingContext.GetVertexAlphaScratchVector()->size());
+    }
+    
+    if (pass == 0) {
+      allocationCountAfterFirstPass = decodingContext.GetScratchAllocationCount();
+      EXPECT_GT(allocationCountAfterFirstPass, 0);
+    } else {
+      EXPECT_EQ(allocationCountAfterFirstPass, decodingContext.GetScratchAllocationCount()) << "in pass " << pass;
+    }
+  }
+  
+  decodingContext.Destroy();
+  reader.Close();
+}
+
+// Verifies that decompressing the independent parts of each frame in parallel gives the same results as decompressing them serially
+TEST(XRVideoDecodingContext, ParallelDecompressionMatchesSerialDecompression) {
+  SyntheticXRVideoConfig config;
+  config.frameCount = 6;
+  config.keyframeInterval = 3;
+  config.uniqueVertexCount = 500;
+  config.duplicatedVertexCount = 30;
+  config.triangleCount = 900;
+  config.deformationNodeCount = 60;
+  config.textureWidth = 32;
+  config.textureHeight = 32;
+  config.vertexAlpha = true;
+  
+  const TemporaryPath temporaryPath("frame_loading_parallel_test", ".xrv");
+  const fs::path& path = temporaryPath.GetPath();
+  ASSERT_TRUE(GenerateSyntheticXRVideo(config, path));
+  
+  MappedFileInputStream* stream = new MappedFileInputStream();
+  ASSERT_TRUE(stream->Open(path));
+  XRVideoReader reader;
+  reader.TakeInputStream(stream, /*isStreamingInputStream*/ false, /*isMappedFileInputStream*/ true);
+  ASSERT_TRUE(reader.FindNextChunk(xrVideoFrameChunkIdentifierV0));
+  
+  XRVideoDecodingContext serialContext;
+  ASSERT_TRUE(serialContext.Initialize());
+  XRVideoDecodingContext parallelContext;
+  ASSERT_TRUE(parallelContext.Initialize(/*decompressionWorkerCount*/ 2));
+  ASSERT_NE(nullptr, parallelContext.GetDecompressionWorkers());
+  
+  const usize vertexCount = config.uniqueVertexCount + config.duplicatedVertexCount;
+  vector<XRVideoVertex> serialVertices(vertexCount), parallelVertices(vertexCount);
+  vector<u16> serialIndices(3 * config.triangleCount), parallelIndices(3 * config.triangleCount);
+  vector<float> serialDeformationState(12 * config.deformationNodeCount), parallelDeformationState(12 * config.deformationNodeCount);
+  vector<u8> serialVertexAlpha, parallelVertexAlpha;
+  
+  for (u32 frameIndex = 0; frameIndex < config.frameCount; ++ frameIndex) {
+    XRVideoFrameView view;
+    ASSERT_TRUE(reader.ReadNextFrameView(&view));
+    
+    const u8* dataPtr = view.data;
+    XRVideoFrameMetadata frameMetadata;
+    ASSERT_TRUE(XRVideoReadMetadata(&dataPtr, view.size, &frameMetadata));
+    
+    ASSERT_TRUE(XRVideoDecompressContent(
+        dataPtr, frameMetadata, &serialContext,
+        serialVertices.data(), serialIndices.data(), serialDeformationState.data(),
+        /*outDuplicatedVertexSourceIndices*/ nullptr, &serialVertexAlpha, /*verboseDecoding*/ false));
+    ASSERT_TRUE(XRVideoDecompressContent(
+        dataPtr, frameMetadata, &parallelContext,
+        parallelVertices.data(), parallelIndices.data(), parallelDeformationState.data(),
+        /*outDuplicatedVertexSourceIndices*/ nullptr, &parallelVertexAlpha, /*verboseDecoding*/ false));
+    
+    EXPECT_EQ(0, memcmp(serialVertices.data(), parallelVertices.data(), vertexCount * sizeof(XRVideoVertex))) << "in frame " << frameIndex;
+    EXPECT_EQ(serialIndices, parallelIndices) << "in frame " << frameIndex;
+    EXPECT_EQ(serialDeformationState, parallelDeformationState) << "in frame " << frameIndex;
+    EXPECT_EQ(serialVertexAlpha, parallelVertexAlpha) << "in frame " << frameIndex;
+    EXPECT_EQ(vertexCount, parallelVertexAlpha.size());
+  }
+  
+  serialContext.Destroy();
+  parallelContext.Destroy();
+  reader.Close();
+}
+
+// Compares the fused renderable vertex decoding against the two-pass reference implementation on a small hand-made keyframe
+// that contains all node counts, a vertex without nodes (which is decoded to all-zero weights), and duplicated vertices
+TEST(XRVideoDecodeRenderableVertices, MatchesTwoPassImplementation) {
+  XRVideoFrameMetadata metadata;
+  memset(&metadata, 0, sizeof(metadata));
+  metadata.isKeyframe = true;
+  metadata.uniqueVertexCount = 5;
+  metadata.vertexCount = 8;
+  metadata.indexCount = 3;
+  
+  vector<u8> encodedVertexWeights;
+  auto appendU16 = [&](u16 value) {
+    encodedVertexWeights.push_back(value & 0xff);
+    encodedVertexWeights.push_back(value >> 8);
+  };
+  auto appendVertexWeights = [&](const vector<u16>& nodeIndices, const vector<u8>& nodeWeights) {
+    appendU16(((nodeIndices.size() - 1) << 14) | nodeIndices[0]);
+    for (usize k = 1; k < nodeIndices.size(); ++ k) {
+      appendU16(nodeIndices[k]);
+    }
+    encodedVertexWeights.insert(encodedVertexWeights.end(), nodeWeights.begin(), nodeWeights.end());
+  };
+  appendVertexWeights({17, 3, 8000, 5}, {10, 20, 30, 195});
+  appendVertexWeights({42}, {255});
+  appendU16(UINT16_MAX);
+  appendVertexWeights({1, 2}, {100, 155});
+  appendVertexWeights({7, 6, 5}, {1, 2, 252});  // at the end of the data, such that the vertex's encoding is shorter than the maximum size
+  metadata.encodedVertexWeightsSize = encodedVertexWeights.size();
+  
+  vector<u8> meshData;
+  auto appendU16s = [&](const vector<u16>& values) {
+    const usize offset = meshData.size();
+    meshData.resize(offset + values.size() * sizeof(u16));
+    memcpy(meshData.data() + offset, values.data(), values.size() * sizeof(u16));
+  };
+  appendU16s({1, 2, 3,  4, 5, 6,  7, 8, 9,  10, 11, 12,  13, 14, 15});  // unique vertex positions
+  appendU16s({4, 0, 2});  // duplicated vertex source indices
+  appendU16s({100, 101,  102, 103,  104, 105,  106, 107,  108, 109,  110, 111,  112, 113,  114, 115});  // texture coordinates
+  appendU16s({0, 1, 2});  // indices
+  meshData.insert(meshData.end(), encodedVertexWeights.begin(), encodedVertexWeights.end());
+  ASSERT_EQ(metadata.GetMeshDataSize(), meshData.size());
+  
+  XRVideoScratchBuffer scratch;
+  vector<XRVideoVertex> fusedVertices(metadata.vertexCount);
+  vector<XRVideoVertex> twoPassVertices(metadata.vertexCount);
+  memset(fusedVertices.data(), 0xcd, fusedVertices.size() * sizeof(XRVideoVertex));
+  memset(twoPassVertices.data(), 0, twoPassVertices.size() * sizeof(XRVideoVertex));  // the two-pass implementation does not write the 'w' components
+  
+  XRVideoDecodeRenderableVertices(metadata, meshData.data(), &scratch, fusedVertices.data());
+  XRVideoDecodeRenderableVerticesTwoPass(metadata, meshData.data(), &scratch, twoPassVertices.data());
+  
+  EXPECT_EQ(0, memcmp(fusedVertices.data(), twoPassVertices.data(), fusedVertices.size() * sizeof(XRVideoVertex)));
+  
+  // Spot-check some decoded values
+  EXPECT_EQ(42, fusedVertices[1].nodeIndices[3]);
+  EXPECT_EQ(0, fusedVertices[1].nodeWeights[1]);
+  EXPECT_EQ(0, fusedVertices[2].nodeWeights[0]);
+  EXPECT_EQ(5, fusedVertices[4].nodeIndices[2]);
+  EXPECT_EQ(5, fusedVertices[4].nodeIndices[3]);
+  EXPECT_EQ(13, fusedVertices[5].x);
+  EXPECT_EQ(110, fusedVertices[5].tx);
+  EXPECT_EQ(7, fusedVertices[5].nodeIndices[0]);
+  EXPECT_EQ(8000, fusedVertices[6].nodeIndices[2]);
+  
+  scratch.Release();
+}
@@ -2,6 +2,14 @@
 
 namespace scan_studio {
 
+chrono::steady_clock::time_point MockNetwork::ReserveTransfer(chrono::steady_clock::time_point earliestStart, s64 bytes) {
+  lock_guard<mutex> lock(linkMutex);
+  
+  const auto transferStart = std::max(earliestStart, linkBusyUntil);
+  linkBusyUntil = transferStart + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(bytes / bytesPerSecond));
+  return linkBusyUntil;
+}
+
 MockHttpRequest::~MockHttpRequest() {
   Abort();
 }
@@ -12,6 +20,13 @@ bool MockHttpRequest::SendRangeRequest(HttpRequest::Verb verb, const char* /*uri
     LOG(FATAL) << "Invalid range specified: " << rangeFrom << " to " << rangeTo;
     return false;
   }
+  
+  if (counters && verb == HttpRequest::Verb::GET) {
+    const int inFlightCount = ++ counters->inFlightGetRequestCount;
+    int peakCount = counters->peakInFlightGetRequestCount;
+    while (inFlightCount > peakCount && !counters->peakInFlightGetRequestCount.compare_exchange_weak(peakCount, inFlightCount)) {}
+  }
+  
   requestThread = std::thread(&MockHttpRequest::RequestThreadMain, this, verb, rangeFrom, rangeTo);
   return true;
 }
@@ -30,6 +45,13 @@ const u8* MockHttpRequest::Content() {
   return content->data() + contentRangeFrom;
 }
 
+void MockHttpRequest::RequestCompleted(HttpRequest::Verb verb) {
+  // This is called before the completion callback, which may send further requests, such that these do not count as concurrent to this one
+  if (counters && verb == HttpRequest::Verb::GET) {
+    -- counters->inFlightGetRequestCount;
+  }
+}
+
 void MockHttpRequest::RequestThreadMain(HttpRequest::Verb verb, s64 rangeFrom, s64 rangeTo) {
   // Clamp the range to the file size (if specified)
   if (rangeFrom >= 0 && rangeTo >= 0) {
@@ -37,8 +59,22 @@ void MockHttpRequest::RequestThreadMain(HttpRequest::Verb verb, s64 rangeFrom, s
     rangeTo = std::min<s64>(rangeTo, content->size() - 1);
   }
   
-  // Simulate receiving the headers
-  statusCode = 200;
+  // Simulate the latency until the headers arrive
+  if (network) {
+    this_thread::sleep_for(chrono::duration<double>(network->RoundTripSeconds()));
+  }
+  
+  // Simulate receiving the headers, or a failure if requested
+  bool fail = false;
+  if (counters && verb == HttpRequest::Verb::GET) {
+    ++ counters->getRequestCount;
+    
+    int remainingFailureCount = counters->remainingGetFailureCount;
+    while (remainingFailureCount > 0 && !counters->remainingGetFailureCount.compare_exchange_weak(remainingFailureCount, remainingFailureCount - 1)) {}
+    fail = remainingFailureCount > 0;
+  }
+  
+  statusCode = fail ? -1 : 200;
   if (rangeFrom < 0 || rangeTo < 0) {
     contentLength = content->size();
   } else {
@@ -46,6 +82,7 @@ void MockHttpRequest::RequestThreadMain(HttpRequest::Verb verb, s64 rangeFrom, s
   }
   contentRangeFrom = rangeFrom;
   contentRangeTo = rangeTo;
+  etag = responseETag;
   
   headersCompleteOrFailedMutex.lock();
   headersCompleteOrFailed = true;
@@ -54,6 +91,7 @@ void MockHttpRequest::RequestThreadMain(HttpRequest::Verb verb, s64 rangeFrom, s
   
   if (statusCode < 0) {
     // The request failed.
+    RequestCompleted(verb);
     if (completionCallback) { completionCallback(this, /*success*/ false, completionCallbackUserPtr); }
     return;
   } else if (verb == HttpRequest::Verb::HEAD) {
@@ -62,6 +100,10 @@ void MockHttpRequest::RequestThreadMain(HttpRequest::Verb verb, s64 rangeFrom, s
   }
   
   // Simulate receiving the content
+  if (network && verb == HttpRequest::Verb::GET) {
+    this_thread::sleep_until(network->ReserveTransfer(chrono::steady_clock::now(), contentLength));
+  }
+  
   actualContentLength = contentLength;
   
   contentCompleteOrFailedMutex.lock();
@@ -69,6 +111,7 @@ void MockHttpRequest::RequestThreadMain(HttpRequest::Verb verb, s64 rangeFrom, s
   contentCompleteOrFailedMutex.unlock();
   contentCompleteOrFailedCondition.notify_all();
   
+  RequestCompleted(verb);
   if (completionCallback) { completionCallback(this, /*success*/ actualContentLength >= 0, completionCallbackUserPtr); }
 }
 
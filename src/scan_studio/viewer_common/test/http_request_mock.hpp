@@ -1,6 +1,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <mutex>
@@ -13,11 +14,55 @@
 namespace scan_studio {
 using namespace vis;
 
+/// Simulated network connection for MockHttpRequest, to allow for benchmarking StreamingInputStream.
+///
+/// Each request takes one round trip time until its headers arrive. Its content is then transferred
+/// over a link with the given bandwidth that is shared by all requests, i.e., the contents of concurrent requests are
+/// transferred one after another.
+class MockNetwork {
+ public:
+  inline MockNetwork(double roundTripSeconds, double bytesPerSecond)
+      : roundTripSeconds(roundTripSeconds),
+        bytesPerSecond(bytesPerSecond) {}
+  
+  /// Reserves the link for transferring the given number of bytes, starting at the earliest at `earliestStart`.
+  /// Returns the time at which the transfer completes.
+  chrono::steady_clock::time_point ReserveTransfer(chrono::steady_clock::time_point earliestStart, s64 bytes);
+  
+  inline double RoundTripSeconds() const { return roundTripSeconds; }
+  
+ private:
+  mutex linkMutex;
+  chrono::steady_clock::time_point linkBusyUntil;
+  
+  double roundTripSeconds;
+  double bytesPerSecond;
+};
+
+/// Counters that are shared by the requests created by a MockHttpRequestFactory.
+struct MockHttpRequestCounters {
+  /// Number of GET requests whose headers arrived (including failed requests and retries)
+  atomic<int> getRequestCount = 0;
+  
+  /// Number of GET requests that were sent but did not complete yet, and the maximum of this number so far
+  atomic<int> inFlightGetRequestCount = 0;
+  atomic<int> peakInFlightGetRequestCount = 0;
+  
+  /// Number of the next GET requests that fail once their headers arrive, to test retrying
+  atomic<int> remainingGetFailureCount = 0;
+};
+
 /// Mock HTTP requests to allow for testing StreamingInputStream.
+///
+/// If a MockNetwork is given, the requests are delayed accordingly. Otherwise, they complete immediately.
+/// The responses carry the given ETag. If counters are given, the request updates them and fails if requested by them.
 class MockHttpRequest : public HttpRequest {
  public:
-  inline MockHttpRequest(const vector<u8>* content)
-      : content(content) {}
+  inline MockHttpRequest(const vector<u8>* content, MockNetwork* network = nullptr, const string& responseETag = string(), MockHttpRequestCounters* counters = nullptr)
+      : content(content),
+        network(network),
+        responseETag(responseETag),
+        counters(counters) {}
   
   virtual ~MockHttpRequest();
   
@@ -26,26 +71,51 @@ class MockHttpRequest : public HttpRequest {
   virtual const u8* Content() override;
   
  private:
+  /// Updates the counters when the request completed or failed.
+  void RequestCompleted(HttpRequest::Verb verb);
+  
   void RequestThreadMain(HttpRequest::Verb verb, s64 rangeFrom, s64 rangeTo);
   
   std::thread requestThread;
   
   const vector<u8>* content;
+  MockNetwork* network;
+  string responseETag;
+  MockHttpRequestCounters* counters;
 };
 
 class MockHttpRequestFactory : public HttpRequestFactory {
  public:
-  inline MockHttpRequestFactory(const vector<u8>* content)
-      : content(content) {}
+  inline MockHttpRequestFactory(const vector<u8>* content, MockNetwork* network = nullptr)
+      : content(content),
+        network(network) {}
   
   virtual ~MockHttpRequestFactory() {}
   
   virtual inline unique_ptr<HttpRequest> CreateHttpRequest() override {
-    return unique_ptr<HttpRequest>(new MockHttpRequest(content));
+    return unique_ptr<HttpRequest>(new MockHttpRequest(content, network, etag, &counters));
   }
   
+  /// Sets the ETag that the responses of requests created afterwards carry.
+  inline void SetETag(const string& value) { etag = value; }
+  
+  /// Makes the next `count` GET requests fail once their headers arrive.
+  inline void FailNextGetRequests(int count) { counters.remainingGetFailureCount = count; }
+  
+  /// Returns the number of GET requests sent by the requests created by this factory (including failed requests and retries).
+  inline int GetRequestCount() const { return counters.getRequestCount; }
+  
+  /// Returns the maximum number of GET requests that were in flight at the same time.
+  inline int GetPeakInFlightRequestCount() const { return counters.peakInFlightGetRequestCount; }
+  
+  /// Returns the number of GET requests that are still to fail (see FailNextGetRequests()).
+  inline int GetRemainingFailureCount() const { return counters.remainingGetFailureCount; }
+  
  private:
   const vector<u8>* content;
+  MockNetwork* network;
+  string etag;
+  MockHttpRequestCounters counters;
 };
 
 }
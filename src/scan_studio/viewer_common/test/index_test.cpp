@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "scan_studio/viewer_common/xrvideo/index.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace scan_studio;
+
+/// Reference implementation of FrameIndex::FindFrameIndexForTimestamp(), using a binary search
+static int FindFrameIndexForTimestampWithBinarySearch(const vector<s64>& timestamps, s64 timestamp) {
+  if (timestamp < timestamps.front() || timestamp > timestamps.back()) { return -1; }
+  
+  // Exclude the video end timestamp at the end
+  return std::max<int>(0, std::upper_bound(timestamps.begin(), timestamps.end() - 1, timestamp) - timestamps.begin() - 1);
+}
+
+static void TestFindFrameIndexForTimestamp(const vector<s64>& timestamps, bool expectConstantFrameRate) {
+  FrameIndex index;
+  for (usize frame = 0; frame < timestamps.size() - 1; ++ frame) {
+    index.PushFrame(timestamps[frame], /*offset*/ frame, /*isKeyframe*/ frame % 30 == 0);
+  }
+  index.PushVideoEnd(timestamps.back(), /*endOffset*/ timestamps.size() - 1);
+  
+  EXPECT_EQ(expectConstantFrameRate, index.HasConstantFrameRate());
+  
+  // Query all frame start timestamps, their neighbors, and random timestamps (including ones outside of the video)
+  vector<s64> queries;
+  for (s64 timestamp : timestamps) {
+    queries.push_back(timestamp - 1);
+    queries.push_back(timestamp);
+    queries.push_back(timestamp + 1);
+  }
+  mt19937 generator(0);
+  uniform_int_distribution<s64> timestampDistribution(timestamps.front() - 1000, timestamps.back() + 1000);
+  for (int i = 0; i < 10000; ++ i) {
+    queries.push_back(timestampDistribution(generator));
+  }
+  
+  for (s64 timestamp : queries) {
+    EXPECT_EQ(FindFrameIndexForTimestampWithBinarySearch(timestamps, timestamp), index.FindFrameIndexForTimestamp(timestamp)) << "timestamp: " << timestamp;
+  }
+}
+
+TEST(FrameIndex, FindFrameIndexForTimestampWithRoundedTimestamps) {
+  // Timestamps of 30 fps and 29.97 fps videos, rounded to nanoseconds like in video files,
+  // such that the frame durations differ by one nanosecond between frames
+  for (double framesPerSecond : {30., 30000. / 1001.}) {
+    constexpr int frameCount = 1000;
+    
+    vector<s64> timestamps(frameCount + 1);
+    for (int frame = 0; frame <= frameCount; ++ frame) {
+      timestamps[frame] = 5000 + llround(frame * 1e9 / framesPerSecond);
+    }
+    
+    TestFindFrameIndexForTimestamp(timestamps, /*expectConstantFrameRate*/ true);
+    
+    // A shorter last frame does not affect the frame rate
+    timestamps.back() -= 1'000'000;
+    TestFindFrameIndexForTimestamp(timestamps, /*expectConstantFrameRate*/ true);
+  }
+}
+
+TEST(FrameIndex, FindFrameIndexForTimestampWithVariableFrameRate) {
+  constexpr int frameCount = 1000;
+  constexpr s64 frameDuration = 33'333'333;
+  
+  mt19937 generator(0);
+  uniform_int_distribution<s64> jitterDistribution(-1'000'000, 1'000'000);
+  
+  vector<s64> timestamps(frameCount + 1);
+  for (int frame = 0; frame <= frameCount; ++ frame) {
+    timestamps[frame] = frame * frameDuration + ((frame == 0 || frame == frameCount) ? 0 : jitterDistribution(generator));
+  }
+  
+  TestFindFrameIndexForTimestamp(timestamps, /*expectConstantFrameRate*/ false);
+}
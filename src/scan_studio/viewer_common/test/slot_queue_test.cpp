@@ -0,0 +1,55 @@
+#include "scan_studio/common/slot_queue.hpp"
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+using namespace scan_studio;
+
+// Pushes and pops items such that the front wraps around the end of the slots several times,
+// and the buffer has to grow while it wraps around, verifying that the FIFO order is preserved
+TEST(SlotQueue, PreservesOrderWhenWrappingAndGrowing) {
+  SlotQueue<int> queue(4);
+  EXPECT_EQ(4, queue.Capacity());
+  
+  int nextPushed = 0;
+  int nextPopped = 0;
+  for (int round = 0; round < 10; ++ round) {
+    // Push one more item per round than is popped, such that the queue eventually needs to grow
+    for (int i = 0; i < 3; ++ i) {
+      queue.PushBack(int(nextPushed ++));
+    }
+    for (int i = 0; i < 2; ++ i) {
+      ASSERT_EQ(nextPopped ++, queue.PopFront());
+    }
+    
+    ASSERT_EQ(nextPushed - nextPopped, queue.Size());
+    for (usize i = 0; i < queue.Size(); ++ i) {
+      EXPECT_EQ(nextPopped + i, queue[i]);
+    }
+  }
+  EXPECT_EQ(16, queue.Capacity());
+  
+  while (!queue.Empty()) {
+    EXPECT_EQ(nextPopped ++, queue.PopFront());
+  }
+  EXPECT_EQ(nextPushed, nextPopped);
+}
+
+// Popped and cleared items must not keep their resources alive in the slots
+TEST(SlotQueue, ReleasesPoppedAndClearedItems) {
+  shared_ptr<int> resource(new int(42));
+  
+  SlotQueue<shared_ptr<int>> queue;
+  queue.PushBack(shared_ptr<int>(resource));
+  queue.PushBack(shared_ptr<int>(resource));
+  queue.PushBack(shared_ptr<int>(resource));
+  EXPECT_EQ(4, resource.use_count());
+  
+  queue.PopFront();
+  EXPECT_EQ(3, resource.use_count());
+  
+  queue.Clear();
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_EQ(1, resource.use_count());
+}
@@ -0,0 +1,105 @@
+#include "scan_studio/viewer_common/streaming_bandwidth_estimator.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace scan_studio;
+
+static TimePoint TimeAt(const TimePoint& start, double seconds) {
+  return start + chrono::duration_cast<Clock::duration>(SecondsDuration(seconds));
+}
+
+// Requests that are sent one after another on an idle link yield both the bandwidth and the round-trip time
+TEST(StreamingBandwidthEstimator, SequentialTransfers) {
+  constexpr double roundTripSeconds = 0.1;
+  constexpr double bytesPerSecond = 1000 * 1000;
+  constexpr s64 requestBytes = 500 * 1000;
+  
+  StreamingBandwidthEstimator estimator;
+  EXPECT_FALSE(estimator.HasEstimates());
+  
+  const TimePoint start = Clock::now();
+  
+  estimator.AddRoundTrip(start, TimeAt(start, roundTripSeconds));
+  EXPECT_NEAR(roundTripSeconds, estimator.GetRoundTripSeconds(), 1e-6);
+  EXPECT_FALSE(estimator.HasEstimates());
+  
+  double sendTime = 1;
+  for (int i = 0; i < 8; ++ i) {
+    const double completionTime = sendTime + roundTripSeconds + requestBytes / bytesPerSecond;
+    estimator.AddTransfer(TimeAt(start, sendTime), TimeAt(start, completionTime), requestBytes, /*otherRequestsInFlight*/ false);
+    sendTime = completionTime + 0.5;
+  }
+  
+  ASSERT_TRUE(estimator.HasEstimates());
+  EXPECT_NEAR(bytesPerSecond, estimator.GetBytesPerSecond(), 0.01 * bytesPerSecond);
+  EXPECT_NEAR(roundTripSeconds, estimator.GetRoundTripSeconds(), 0.01);
+}
+
+// With several requests in flight on a shared link, the requests queue up behind each other's transfers.
+// The bandwidth must still be estimated correctly, and the queueing must not be mistaken for latency.
+// This also corrects a round-trip time measured by a HEAD request that included the connection setup.
+TEST(StreamingBandwidthEstimator, ConcurrentTransfers) {
+  constexpr double roundTripSeconds = 0.1;
+  constexpr double bytesPerSecond = 4 * 1000 * 1000;
+  constexpr s64 requestBytes = 200 * 1000;
+  constexpr int concurrentRequests = 4;
+  
+  StreamingBandwidthEstimator estimator;
+  const TimePoint start = Clock::now();
+  estimator.AddRoundTrip(start, TimeAt(start, 3 * roundTripSeconds));
+  
+  // Keep concurrentRequests requests in flight, sending the next request whenever one completes
+  vector<double> sendTimes(concurrentRequests, 1);
+  double linkBusyUntil = 0;
+  
+  for (int i = 0; i < 64; ++ i) {
+    const double sendTime = sendTimes[i % concurrentRequests];
+    const double completionTime = std::max(sendTime + roundTripSeconds, linkBusyUntil) + requestBytes / bytesPerSecond;
+    linkBusyUntil = completionTime;
+    
+    estimator.AddTransfer(TimeAt(start, sendTime), TimeAt(start, completionTime), requestBytes, /*otherRequestsInFlight*/ i >= 1);
+    sendTimes[i % concurrentRequests] = completionTime;
+  }
+  
+  ASSERT_TRUE(estimator.HasEstimates());
+  EXPECT_NEAR(bytesPerSecond, estimator.GetBytesPerSecond(), 0.01 * bytesPerSecond);
+  EXPECT_NEAR(roundTripSeconds, estimator.GetRoundTripSeconds(), 0.01);
+}
+
+// Slow links get a deeper lookahead than fast links, and the ranges grow with the bandwidth
+TEST(StreamingBandwidthEstimator, ComputeWindow) {
+  constexpr double videoBytesPerSecond = 1000 * 1000;
+  constexpr int concurrentRequests = 3;
+  
+  const TimePoint start = Clock::now();
+  
+  // Without estimates, the defaults are used
+  StreamingBandwidthEstimator unknown;
+  const StreamingWindow defaultWindow = unknown.ComputeWindow(videoBytesPerSecond, concurrentRequests);
+  EXPECT_FLOAT_EQ(5.f, defaultWindow.lookaheadSeconds);
+  EXPECT_EQ(6 * 1024 * 1024, defaultWindow.maxStreamSize);
+  EXPECT_GE(defaultWindow.requiredCacheSize, defaultWindow.lookaheadSeconds * videoBytesPerSecond);
+  
+  auto computeWindow = [&](double bytesPerSecond) {
+    StreamingBandwidthEstimator estimator;
+    estimator.AddRoundTrip(start, TimeAt(start, 0.05));
+    
+    const s64 requestBytes = bytesPerSecond;
+    estimator.AddTransfer(TimeAt(start, 1), TimeAt(start, 1 + 0.05 + requestBytes / bytesPerSecond), requestBytes, /*otherRequestsInFlight*/ false);
+    
+    return estimator.ComputeWindow(videoBytesPerSecond, concurrentRequests);
+  };
+  
+  const StreamingWindow slowWindow = computeWindow(1.5 * videoBytesPerSecond);
+  const StreamingWindow fastWindow = computeWindow(20 * videoBytesPerSecond);
+  const StreamingWindow tooSlowWindow = computeWindow(0.5 * videoBytesPerSecond);
+  
+  EXPECT_GT(slowWindow.lookaheadSeconds, defaultWindow.lookaheadSeconds);
+  EXPECT_LT(fastWindow.lookaheadSeconds, defaultWindow.lookaheadSeconds);
+  EXPECT_GE(tooSlowWindow.lookaheadSeconds, slowWindow.lookaheadSeconds);
+  EXPECT_LE(tooSlowWindow.lookaheadSeconds, 30.f);
+  
+  EXPECT_LT(slowWindow.maxStreamSize, fastWindow.maxStreamSize);
+  EXPECT_GE(slowWindow.requiredCacheSize, slowWindow.lookaheadSeconds * videoBytesPerSecond);
+  EXPECT_GE(fastWindow.requiredCacheSize, fastWindow.lookaheadSeconds * videoBytesPerSecond);
+}
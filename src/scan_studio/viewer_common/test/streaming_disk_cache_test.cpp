@@ -0,0 +1,189 @@
+#include "scan_studio/viewer_common/streaming_disk_cache.hpp"
+
+#include <gtest/gtest.h>
+
+#include "scan_studio/viewer_common/streaming_input_stream.hpp"
+#include "scan_studio/viewer_common/test/http_request_mock.hpp"
+#include "scan_studio/viewer_common/test/temporary_path.hpp"
+
+using namespace scan_studio;
+
+static vector<u8> CreateMockFile(usize size) {
+  vector<u8> mockFile(size);
+  for (usize i = 0; i < mockFile.size(); ++ i) {
+    mockFile[i] = rand() % 256;
+  }
+  return mockFile;
+}
+
+/// Opens a stream for the mock file with the given disk cache, reads the given range, verifies the read data, and closes the stream again.
+/// Returns the number of GET requests that the stream sent.
+static int StreamRead(const char* uri, const vector<u8>& mockFile, const string& etag, const shared_ptr<StreamingDiskCache>& cache, int readStart, int readLength) {
+  MockHttpRequestFactory* factory = new MockHttpRequestFactory(&mockFile);
+  factory->SetETag(etag);
+  
+  StreamingInputStream stream;
+  stream.SetDiskCache(cache);
+  stream.Open(
+      uri,
+      /*minStreamSize*/ 1,
+      /*maxCacheSize*/ 100 * 1000,
+      /*allowUntrustedCertificates*/ true,
+      unique_ptr<HttpRequestFactory>(factory));
+  
+  EXPECT_TRUE(stream.Seek(readStart));
+  
+  vector<u8> readResult(readLength);
+  EXPECT_EQ(readLength, stream.Read(readResult.data(), readLength));
+  EXPECT_TRUE(std::equal(readResult.begin(), readResult.end(), mockFile.begin() + readStart));
+  
+  stream.Close();
+  
+  // Wait for the downloaded ranges to be stored
+  cache->Flush();
+  return factory->GetRequestCount();
+}
+
+// A later session serves the stored ranges from the disk cache and downloads only the gaps.
+TEST(StreamingDiskCache, ServesStoredRanges) {
+  srand(time(nullptr));
+  
+  const TemporaryPath temporaryDirectory("streaming_disk_cache_test");
+  const fs::path& directory = temporaryDirectory.GetPath();
+  const vector<u8> mockFile = CreateMockFile(1000);
+  
+  shared_ptr<StreamingDiskCache> cache(new StreamingDiskCache());
+  ASSERT_TRUE(cache->Open(directory, /*maxSizeInBytes*/ 100 * 1000));
+  
+  EXPECT_EQ(1, StreamRead("test://video", mockFile, "\"v1\"", cache, 0, 400));
+  EXPECT_EQ(400, cache->GetSizeInBytes());
+  
+  // Re-open the cache to verify that the range map got persisted
+  cache.reset(new StreamingDiskCache());
+  ASSERT_TRUE(cache->Open(directory, /*maxSizeInBytes*/ 100 * 1000));
+  EXPECT_EQ(400, cache->GetSizeInBytes());
+  
+  EXPECT_EQ(0, StreamRead("test://video", mockFile, "\"v1\"", cache, 0, 400));
+  EXPECT_EQ(1, StreamRead("test://video", mockFile, "\"v1\"", cache, 300, 400));
+  EXPECT_EQ(700, cache->GetSizeInBytes());
+  
+  // Ranges from the disk cache can be read without copying
+  MockHttpRequestFactory* factory = new MockHttpRequestFactory(&mockFile);
+  factory->SetETag("\"v1\"");
+  
+  StreamingInputStream stream;
+  stream.SetDiskCache(cache);
+  stream.Open("test://video", /*minStreamSize*/ 1, /*maxCacheSize*/ 100 * 1000, /*allowUntrustedCertificates*/ true, unique_ptr<HttpRequestFactory>(factory));
+  
+  const u8* data;
+  shared_ptr<const void> pin;
+  ASSERT_TRUE(stream.Seek(100));
+  ASSERT_TRUE(stream.ReadPinned(500, &data, &pin));
+  stream.Close();
+  
+  EXPECT_TRUE(std::equal(data, data + 500, mockFile.begin() + 100));
+  EXPECT_EQ(0, factory->GetRequestCount());
+}
+
+// Stored ranges are discarded if the ETag of the file changes.
+TEST(StreamingDiskCache, InvalidatesChangedFiles) {
+  srand(time(nullptr));
+  
+  const TemporaryPath temporaryDirectory("streaming_disk_cache_invalidation_test");
+  const fs::path& directory = temporaryDirectory.GetPath();
+  const vector<u8> oldFile = CreateMockFile(1000);
+  const vector<u8> newFile = CreateMockFile(1000);
+  
+  shared_ptr<StreamingDiskCache> cache(new StreamingDiskCache());
+  ASSERT_TRUE(cache->Open(directory, /*maxSizeInBytes*/ 100 * 1000));
+  
+  EXPECT_EQ(1, StreamRead("test://video", oldFile, "\"v1\"", cache, 0, 600));
+  EXPECT_EQ(1, StreamRead("test://video", newFile, "\"v2\"", cache, 0, 400));
+  EXPECT_EQ(400, cache->GetSizeInBytes());
+  EXPECT_EQ(0, StreamRead("test://video", newFile, "\"v2\"", cache, 0, 400));
+}
+
+// If the budget is exceeded, the least-recently-used files are evicted.
+TEST(StreamingDiskCache, EvictsLeastRecentlyUsed) {
+  srand(time(nullptr));
+  
+  const TemporaryPath temporaryDirectory("streaming_disk_cache_eviction_test");
+  const fs::path& directory = temporaryDirectory.GetPath();
+  const vector<u8> mockFile = CreateMockFile(1000);
+  
+  shared_ptr<StreamingDiskCache> cache(new StreamingDiskCache());
+  ASSERT_TRUE(cache->Open(directory, /*maxSizeInBytes*/ 1000));
+  
+  EXPECT_EQ(1, StreamRead("test://a", mockFile, "", cache, 0, 400));
+  EXPECT_EQ(1, StreamRead("test://b", mockFile, "", cache, 0, 400));
+  EXPECT_EQ(0, StreamRead("test://a", mockFile, "", cache, 0, 400));
+  
+  // This evicts b, which was used less recently than a
+  EXPECT_EQ(1, StreamRead("test://c", mockFile, "", cache, 0, 400));
+  EXPECT_EQ(800, cache->GetSizeInBytes());
+  
+  EXPECT_EQ(0, StreamRead("test://a", mockFile, "", cache, 0, 400));
+  EXPECT_EQ(1, StreamRead("test://b", mockFile, "", cache, 0, 400));
+}
+
+// A range that does not fit into the budget next to the entries in use is not stored, and does not evict any other entries.
+TEST(StreamingDiskCache, KeepsEntriesForRangesThatCannotFit) {
+  srand(time(nullptr));
+  
+  const TemporaryPath temporaryDirectory("streaming_disk_cache_oversized_test");
+  const vector<u8> mockFile = CreateMockFile(1000);
+  
+  shared_ptr<StreamingDiskCache> cache(new StreamingDiskCache());
+  ASSERT_TRUE(cache->Open(temporaryDirectory.GetPath(), /*maxSizeInBytes*/ 700));
+  
+  EXPECT_EQ(1, StreamRead("test://a", mockFile, "", cache, 0, 300));
+  EXPECT_EQ(300, cache->GetSizeInBytes());
+  
+  // This range is larger than the whole budget
+  EXPECT_EQ(1, StreamRead("test://b", mockFile, "", cache, 0, 800));
+  EXPECT_EQ(300, cache->GetSizeInBytes());
+  
+  // The second range fits into the budget on its own, but not next to the first one, whose entry is in use
+  vector<StreamingDiskCache::Range> storedRanges;
+  shared_ptr<const u8> mapping;
+  ASSERT_TRUE(cache->AcquireEntry("test://c", "", mockFile.size(), &storedRanges, &mapping));
+  cache->QueueStoreRange("test://c", 0, 299, mockFile.data(), /*dataOwner*/ nullptr);
+  cache->QueueStoreRange("test://c", 300, 799, mockFile.data() + 300, /*dataOwner*/ nullptr);
+  cache->ReleaseEntry("test://c");
+  cache->Flush();
+  EXPECT_EQ(600, cache->GetSizeInBytes());
+  
+  EXPECT_EQ(0, StreamRead("test://a", mockFile, "", cache, 0, 300));
+}
+
+// Ranges that are queued for storing before releasing the entry get stored, and acquiring the entry again waits for them.
+TEST(StreamingDiskCache, StoresQueuedRanges) {
+  srand(time(nullptr));
+  
+  const TemporaryPath temporaryDirectory("streaming_disk_cache_queue_test");
+  const vector<u8> mockFile = CreateMockFile(1000);
+  
+  shared_ptr<StreamingDiskCache> cache(new StreamingDiskCache());
+  ASSERT_TRUE(cache->Open(temporaryDirectory.GetPath(), /*maxSizeInBytes*/ 100 * 1000));
+  
+  vector<StreamingDiskCache::Range> storedRanges;
+  shared_ptr<const u8> mapping;
+  ASSERT_TRUE(cache->AcquireEntry("test://video", "", mockFile.size(), &storedRanges, &mapping));
+  EXPECT_TRUE(storedRanges.empty());
+  
+  for (int i = 0; i < 10; ++ i) {
+    cache->QueueStoreRange("test://video", 100 * i, 100 * i + 49, mockFile.data() + 100 * i, /*dataOwner*/ nullptr);
+  }
+  cache->ReleaseEntry("test://video");
+  
+  ASSERT_TRUE(cache->AcquireEntry("test://video", "", mockFile.size(), &storedRanges, &mapping));
+  ASSERT_EQ(10, static_cast<int>(storedRanges.size()));
+  ASSERT_NE(nullptr, mapping);
+  for (const StreamingDiskCache::Range& range : storedRanges) {
+    EXPECT_TRUE(std::equal(mapping.get() + range.from, mapping.get() + range.to + 1, mockFile.begin() + range.from));
+  }
+  cache->ReleaseEntry("test://video");
+  
+  cache->Flush();
+  EXPECT_EQ(500, cache->GetSizeInBytes());
+}
@@ -4,7 +4,10 @@
 
 #include <loguru.hpp>
 
+#include "scan_studio/common/xrvideo_file.hpp"
+#include "scan_studio/tools/synthetic_xrvideo.hpp"
 #include "scan_studio/viewer_common/test/http_request_mock.hpp"
+#include "scan_studio/viewer_common/xrvideo/index.hpp"
 
 using namespace scan_studio;
 
@@ -142,6 +145,59 @@ TEST(StreamingInputStream, CacheCleanup) {
   }
 }
 
+TEST(StreamingInputStream, RangeAvailability) {
+  srand(time(nullptr));
+  
+  vector<u8> mockFile(32);
+  for (int i = 0; i < mockFile.size(); ++ i) {
+    mockFile[i] = rand() % 256;
+  }
+  
+  StreamingInputStream stream;
+  stream.Open(
+      "test://dummy",
+      /*minStreamSize*/ 1,
+      /*maxCacheSize*/ 100,
+      /*allowUntrustedCertificates*/ true,
+      unique_ptr<HttpRequestFactory>(new MockHttpRequestFactory(&mockFile)));
+  
+  TestRead(&stream, mockFile, 0, 8);
+  EXPECT_TRUE(stream.IsRangeAvailable(0, 7));
+  EXPECT_TRUE(stream.IsRangeAvailable(2, 5));
+  EXPECT_FALSE(stream.IsRangeAvailable(24, 31));
+  
+  // Ranges that are covered by multiple adjacent downloaded ranges are available
+  TestRead(&stream, mockFile, 24, 8);
+  EXPECT_TRUE(stream.IsRangeAvailable(24, 31));
+  EXPECT_FALSE(stream.IsRangeAvailable(0, 31));
+  TestRead(&stream, mockFile, 8, 16);
+  EXPECT_TRUE(stream.IsRangeAvailable(0, 31));
+}
+
+// A negative maxCacheSize makes the cache unlimited, which a required cache size set for the streaming window must not limit
+TEST(StreamingInputStream, UnlimitedCacheIgnoresRequiredCacheSize) {
+  srand(time(nullptr));
+  
+  vector<u8> mockFile(32);
+  for (int i = 0; i < mockFile.size(); ++ i) {
+    mockFile[i] = rand() % 256;
+  }
+  
+  StreamingInputStream stream;
+  stream.Open(
+      "test://dummy",
+      /*minStreamSize*/ 1,
+      /*maxCacheSize*/ -1,
+      /*allowUntrustedCertificates*/ true,
+      unique_ptr<HttpRequestFactory>(new MockHttpRequestFactory(&mockFile)));
+  stream.SetRequiredCacheSize(2);
+  
+  for (int i = 0; i < mockFile.size(); ++ i) {
+    TestRead(&stream, mockFile, i, 1);
+  }
+  EXPECT_TRUE(stream.IsRangeAvailable(0, mockFile.size() - 1));
+}
+
 TEST(StreamingInputStream, RandomReadTest) {
   srand(time(nullptr));
   
@@ -213,3 +269,193 @@ TEST(StreamingInputStream, RandomReadAndSchedulingTest) {
     }
   }
 }
+
+TEST(StreamingInputStream, ConcurrentRequestsWithLatency) {
+  srand(time(nullptr));
+  
+  vector<u8> mockFile(256);
+  for (int i = 0; i < mockFile.size(); ++ i) {
+    mockFile[i] = rand() % 256;
+  }
+  
+  MockNetwork network(/*roundTripSeconds*/ 0.002, /*bytesPerSecond*/ 256 * 1024);
+  MockHttpRequestFactory* factory = new MockHttpRequestFactory(&mockFile, &network);
+  
+  StreamingInputStream stream;
+  stream.SetMaxConcurrentRequests(4);
+  stream.Open(
+      "test://dummy",
+      /*minStreamSize*/ 1,
+      /*maxCacheSize*/ 64,
+      /*allowUntrustedCertificates*/ true,
+      unique_ptr<HttpRequestFactory>(factory));
+  
+  // Schedule many small ranges, such that several requests are in flight while reading
+  stream.StreamRange(/*from*/ 0, /*to*/ mockFile.size() - 1, /*allowExtendRange*/ false, /*maxStreamSize*/ 16);
+  
+  for (int i = 0; i < mockFile.size(); i += 32) {
+    TestRead(&stream, mockFile, i, 32);
+  }
+  
+  constexpr int iterationCount = 64;
+  
+  for (int i = 0; i < iterationCount; ++ i) {
+    const int a = rand() % mockFile.size();
+    const int b = rand() % mockFile.size();
+    
+    const int readStart = std::min(a, b);
+    const int readSize = std::max(a, b) - readStart + 1;
+    
+    TestRead(&stream, mockFile, readStart, readSize);
+    
+    if (i % 2 == 0) {
+      stream.StreamRange(readStart, std::max(a, b), /*allowExtendRange*/ true, /*maxStreamSize*/ 8);
+    }
+  }
+  
+  EXPECT_GT(factory->GetPeakInFlightRequestCount(), 1) << "The requests were not sent concurrently";
+}
+
+// Verifies that ranges whose requests fail are requested again, and that reads wait for the successful retries
+TEST(StreamingInputStream, RetriesFailedRanges) {
+  srand(time(nullptr));
+  
+  vector<u8> mockFile(256);
+  for (int i = 0; i < mockFile.size(); ++ i) {
+    mockFile[i] = rand() % 256;
+  }
+  
+  MockNetwork network(/*roundTripSeconds*/ 0.002, /*bytesPerSecond*/ 256 * 1024);
+  MockHttpRequestFactory* factory = new MockHttpRequestFactory(&mockFile, &network);
+  
+  // Fail the first requests, including concurrent ones
+  constexpr int failedRequestCount = 3;
+  factory->FailNextGetRequests(failedRequestCount);
+  
+  StreamingInputStream stream;
+  stream.SetMaxConcurrentRequests(4);
+  stream.Open(
+      "test://dummy",
+      /*minStreamSize*/ 1,
+      /*maxCacheSize*/ 64,
+      /*allowUntrustedCertificates*/ true,
+      unique_ptr<HttpRequestFactory>(factory));
+  
+  stream.StreamRange(/*from*/ 0, /*to*/ mockFile.size() - 1, /*allowExtendRange*/ false, /*maxStreamSize*/ 16);
+  
+  for (int i = 0; i < mockFile.size(); i += 32) {
+    TestRead(&stream, mockFile, i, 32);
+  }
+  
+  EXPECT_FALSE(stream.HasFatalError());
+  EXPECT_EQ(0, factory->GetRemainingFailureCount());
+  EXPECT_GE(factory->GetRequestCount(), static_cast<int>(mockFile.size()) / 16 + failedRequestCount);
+}
+
+TEST(StreamingInputStream, PinnedReads) {
+  srand(time(nullptr));
+  
+  vector<u8> mockFile(64);
+  for (int i = 0; i < mockFile.size(); ++ i) {
+    mockFile[i] = rand() % 256;
+  }
+  
+  StreamingInputStream stream;
+  stream.Open(
+      "test://dummy",
+      /*minStreamSize*/ 1,
+      /*maxCacheSize*/ 100,
+      /*allowUntrustedCertificates*/ true,
+      unique_ptr<HttpRequestFactory>(new MockHttpRequestFactory(&mockFile)));
+  
+  stream.StreamRange(/*from*/ 0, /*to*/ 15, /*allowExtendRange*/ false, /*maxStreamSize*/ -1);
+  stream.StreamRange(/*from*/ 16, /*to*/ 31, /*allowExtendRange*/ false, /*maxStreamSize*/ -1);
+  
+  // A read within a single range references the range's content (which MockHttpRequest takes from mockFile directly)
+  const u8* data;
+  shared_ptr<const void> pin;
+  ASSERT_TRUE(stream.Seek(2));
+  ASSERT_TRUE(stream.ReadPinned(10, &data, &pin));
+  EXPECT_EQ(mockFile.data() + 2, data);
+  EXPECT_TRUE(pin != nullptr);
+  
+  // A read that crosses a range boundary fails without advancing the file position, and must use Read() instead
+  shared_ptr<const void> otherPin;
+  EXPECT_FALSE(stream.ReadPinned(8, &data, &otherPin));
+  TestRead(&stream, mockFile, 12, 8);
+  
+  // A read from a part of the file that was not requested yet gets streamed
+  ASSERT_TRUE(stream.Seek(40));
+  ASSERT_TRUE(stream.ReadPinned(4, &data, &otherPin));
+  EXPECT_EQ(mockFile.data() + 40, data);
+  for (int i = 0; i < 4; ++ i) {
+    EXPECT_EQ(mockFile[40 + i], data[i]);
+  }
+  
+  // Pins keep the ranges alive after closing the stream
+  stream.Close();
+  pin.reset();
+  otherPin.reset();
+}
+
+// Verifies that XRVideoReader accesses the frames of a streamed video without copying if the ranges are aligned to the frames
+TEST(StreamingInputStream, ZeroCopyXRVideoFrames) {
+  SyntheticXRVideoConfig config;
+  config.frameCount = 8;
+  config.keyframeInterval = 4;
+  config.uniqueVertexCount = 100;
+  config.duplicatedVertexCount = 0;
+  config.triangleCount = 150;
+  config.deformationNodeCount = 10;
+  config.textureWidth = 32;
+  config.textureHeight = 32;
+  
+  const fs::path path = fs::temp_directory_path() / "streaming_input_stream_test.xrv";
+  ASSERT_TRUE(GenerateSyntheticXRVideo(config, path));
+  
+  vector<u8> mockFile;
+  {
+    IfstreamInputStream fileStream;
+    ASSERT_TRUE(fileStream.Open(path));
+    mockFile.resize(fileStream.SizeInBytes());
+    ASSERT_EQ(mockFile.size(), fileStream.Read(mockFile.data(), mockFile.size()));
+  }
+  fs::remove(path);
+  
+  StreamingInputStream* stream = new StreamingInputStream();
+  stream->Open(
+      "test://dummy",
+      /*minStreamSize*/ 16,
+      /*maxCacheSize*/ mockFile.size(),
+      /*allowUntrustedCertificates*/ true,
+      unique_ptr<HttpRequestFactory>(new MockHttpRequestFactory(&mockFile)));
+  XRVideoReader reader;
+  reader.TakeInputStream(stream, /*isStreamingInputStream*/ true);
+  
+  ASSERT_TRUE(reader.FindNextChunk(xrVideoIndexChunkIdentifierV0));
+  FrameIndex index;
+  ASSERT_TRUE(index.CreateFromIndexChunk(&reader));
+  ASSERT_EQ(config.frameCount, index.GetFrameCount());
+  
+  // Request two frames per range, aligned to the frame chunks
+  for (int frameIndex = 0; frameIndex < index.GetFrameCount(); frameIndex += 2) {
+    stream->StreamRange(index.At(frameIndex).GetOffset(), index.At(frameIndex + 2).GetOffset() - 1, /*allowExtendRange*/ false, /*maxStreamSize*/ -1);
+  }
+  
+  for (int frameIndex = 0; frameIndex < index.GetFrameCount(); ++ frameIndex) {
+    ASSERT_TRUE(reader.Seek(index.At(frameIndex).GetOffset()));
+    
+    XRVideoFrameView view;
+    ASSERT_TRUE(reader.ReadNextFrameView(&view));
+    
+    const u8* expectedData = mockFile.data() + index.At(frameIndex).GetOffset() + XRVideoChunkHeaderScheme::GetConstantSize();
+    ASSERT_EQ(index.At(frameIndex + 1).GetOffset() - index.At(frameIndex).GetOffset() - XRVideoChunkHeaderScheme::GetConstantSize(), view.size);
+    EXPECT_EQ(0, memcmp(expectedData, view.data, view.size));
+    
+    // The range that was streamed for reading the index chunk extends into the first frame,
+    // so only the following frames lie within a single range.
+    if (frameIndex > 0) {
+      EXPECT_EQ(expectedData, view.data);
+    }
+  }
+}
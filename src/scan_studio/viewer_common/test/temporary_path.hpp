@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdio>
+#include <random>
+#include <string>
+
+#include <libvis/io/filesystem.h>
+#include <libvis/vulkan/libvis.h>
+
+namespace scan_studio {
+using namespace vis;
+
+/// A unique path in the temporary directory for a test's file or directory, which is removed (recursively)
+/// when this object is destructed. This way, concurrent test runs do not interfere with each other,
+/// and no files are left behind if a test returns early because an assertion failed.
+class TemporaryPath {
+ public:
+  /// Creates a path named `<prefix>_<random number><extension>`. Does not create a file or directory at the path.
+  inline explicit TemporaryPath(const string& prefix, const string& extension = "") {
+    random_device randomDevice;
+    const u64 randomNumber = (static_cast<u64>(randomDevice()) << 32) | randomDevice();
+    
+    char randomString[17];
+    snprintf(randomString, sizeof(randomString), "%016llx", static_cast<unsigned long long>(randomNumber));
+    path = fs::temp_directory_path() / (prefix + "_" + randomString + extension);
+  }
+  
+  inline ~TemporaryPath() {
+    error_code errorCode;
+    fs::remove_all(path, errorCode);
+  }
+  
+  TemporaryPath(const TemporaryPath& other) = delete;
+  TemporaryPath& operator= (const TemporaryPath& other) = delete;
+  
+  inline const fs::path& GetPath() const { return path; }
+  
+ private:
+  fs::path path;
+};
+
+}
@@ -0,0 +1,587 @@
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <loguru.hpp>
+
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+#include "scan_studio/tools/synthetic_xrvideo.hpp"
+#include "scan_studio/viewer_common/test/temporary_path.hpp"
+#include "scan_studio/viewer_common/timing.hpp"
+#include "scan_studio/viewer_common/xrvideo/pipeline_statistics.hpp"
+#include "scan_studio/viewer_common/xrvideo/xrvideo_executor.hpp"
+#include "scan_studio/viewer_common/xrvideo/xrvideo_memory_governor.hpp"
+#include "scan_studio/viewer_common/xrvideo/external/external_xrvideo.hpp"
+
+using namespace scan_studio;
+
+/// Frame user data: plain CPU buffers that the frames get decoded into.
+struct BufferingTestFrame {
+  vector<u8> vertices;
+  vector<u8> indices;
+  vector<u8> deformation;
+  vector<u8> texture;
+};
+
+static void* ConstructFrame(void* /*videoUserData*/) {
+  return new BufferingTestFrame();
+}
+
+static void DestructFrame(void* /*videoUserData*/, void* frameUserData) {
+  delete reinterpret_cast<BufferingTestFrame*>(frameUserData);
+}
+
+static SRBool32 PrepareDecodeFrame(
+    void* /*videoUserData*/,
+    void* frameUserData,
+    const SRPlayer_XRVideo_Frame_Metadata* frameMetadata,
+    void** outVertices,
+    void** outIndices,
+    void** outDeformation,
+    void** outTexture,
+    void** /*outDuplicatedVertexSourceIndices*/) {
+  BufferingTestFrame* frame = reinterpret_cast<BufferingTestFrame*>(frameUserData);
+  
+  if (frameMetadata->isKeyframe) {
+    frame->vertices.resize(frameMetadata->renderableVertexDataSize);
+    frame->indices.resize(frameMetadata->indexDataSize);
+  }
+  frame->deformation.resize(frameMetadata->deformationDataSize);
+  frame->texture.resize(3 * frameMetadata->textureWidth * frameMetadata->textureHeight);
+  
+  *outVertices = frame->vertices.data();
+  *outIndices = frame->indices.data();
+  *outDeformation = frame->deformation.data();
+  *outTexture = frame->texture.data();
+  return SRV_TRUE;
+}
+
+/// Variant of PrepareDecodeFrame() that simulates slow decoding, such that frames remain in the loading threads' queues for a while.
+static SRBool32 SlowPrepareDecodeFrame(
+    void* videoUserData,
+    void* frameUserData,
+    const SRPlayer_XRVideo_Frame_Metadata* frameMetadata,
+    void** outVertices,
+    void** outIndices,
+    void** outDeformation,
+    void** outTexture,
+    void** outDuplicatedVertexSourceIndices) {
+  this_thread::sleep_for(chrono::milliseconds(2));
+  return PrepareDecodeFrame(videoUserData, frameUserData, frameMetadata, outVertices, outIndices, outDeformation, outTexture, outDuplicatedVertexSourceIndices);
+}
+
+/// Number of frames that RenditionCountingPrepareDecodeFrame() prepared with a texture width of smallTextureWidth.
+constexpr u32 smallTextureWidth = 32;
+static atomic<int> smallTextureFrameCount = {0};
+
+/// Variant of PrepareDecodeFrame() that counts the frames of the rendition with the small texture size.
+static SRBool32 RenditionCountingPrepareDecodeFrame(
+    void* videoUserData,
+    void* frameUserData,
+    const SRPlayer_XRVideo_Frame_Metadata* frameMetadata,
+    void** outVertices,
+    void** outIndices,
+    void** outDeformation,
+    void** outTexture,
+    void** outDuplicatedVertexSourceIndices) {
+  if (frameMetadata->textureWidth == smallTextureWidth) {
+    ++ smallTextureFrameCount;
+  }
+  return PrepareDecodeFrame(videoUserData, frameUserData, frameMetadata, outVertices, outIndices, outDeformation, outTexture, outDuplicatedVertexSourceIndices);
+}
+
+static SRBool32 AfterDecodeFrame(void* /*videoUserData*/, void* /*frameUserData*/, const SRPlayer_XRVideo_Frame_Metadata* /*frameMetadata*/, uint32_t /*vertexAlphaSize*/, uint8_t* /*vertexAlpha*/) {
+  return SRV_TRUE;
+}
+
+static void TransferFrame(void* /*videoUserData*/, void* /*frameUserData*/, const SRPlayer_XRVideo_Frame_Metadata* /*frameMetadata*/) {}
+
+/// File input stream that counts the bytes read from it.
+class CountingInputStream : public IfstreamInputStream {
+ public:
+  inline CountingInputStream(atomic<u64>* readBytes)
+      : readBytes(readBytes) {}
+  
+  virtual usize Read(void* data, usize size) override {
+    const usize bytes = IfstreamInputStream::Read(data, size);
+    *readBytes += bytes;
+    return bytes;
+  }
+  
+ private:
+  atomic<u64>* readBytes;
+};
+
+/// Calls Update(0) on the video until the given condition holds, or until the timeout is reached.
+/// Returns true if the condition holds, false on timeout.
+template <typename Condition>
+static bool WaitFor(ExternalXRVideo* video, double timeoutSeconds, Condition condition) {
+  const TimePoint startTime = Clock::now();
+  while (true) {
+    video->Update(0);
+    if (condition()) { return true; }
+    if (SecondsFromTo(startTime, Clock::now()) > timeoutSeconds) { return false; }
+    this_thread::sleep_for(chrono::microseconds(100));
+  }
+}
+
+/// Fixture for the tests that play back synthetic videos with ExternalXRVideo.
+class XRVideoPlayback : public testing::Test {
+ protected:
+  /// Timeout for waiting on the loading threads, which is only reached if a test fails
+  static constexpr double timeoutSeconds = 10;
+  
+  /// Returns the config for a synthetic test video with the given frame count and keyframe interval, with small meshes and 64x64 textures.
+  static SyntheticXRVideoConfig VideoConfig(int frameCount, int keyframeInterval) {
+    SyntheticXRVideoConfig config;
+    config.frameCount = frameCount;
+    config.keyframeInterval = keyframeInterval;
+    config.uniqueVertexCount = 500;
+    config.duplicatedVertexCount = 50;
+    config.triangleCount = 800;
+    config.deformationNodeCount = 50;
+    config.textureWidth = 64;
+    config.textureHeight = 64;
+    return config;
+  }
+  
+  /// Generates a synthetic video in a temporary file, which gets removed at the end of the test.
+  bool GenerateVideo(const SyntheticXRVideoConfig& config, fs::path* path) {
+    temporaryPaths.emplace_back(new TemporaryPath("xrvideo_playback_test", ".xrv"));
+    *path = temporaryPaths.back()->GetPath();
+    return GenerateSyntheticXRVideo(config, *path);
+  }
+  
+  /// Returns callbacks that decode the frames into BufferingTestFrames, using the given prepareDecodeFrame callback.
+  static SRPlayer_XRVideo_External_Config FrameCallbacks(SRPlayer_XRVideo_External_DecodingThread_PrepareDecodeFrameCallback prepareDecodeFrameCallback = &PrepareDecodeFrame) {
+    SRPlayer_XRVideo_External_Config callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.constructFrameCallback = &ConstructFrame;
+    callbacks.destructFrameCallback = &DestructFrame;
+    callbacks.decodingThread_prepareDecodeFrameCallback = prepareDecodeFrameCallback;
+    callbacks.decodingThread_afterDecodeFrameCallback = &AfterDecodeFrame;
+    callbacks.transferThread_transferFrameCallback = &TransferFrame;
+    return callbacks;
+  }
+  
+  /// Opens the given video file with a MappedFileInputStream. The video must have been initialized.
+  static bool OpenMappedFile(ExternalXRVideo* video, const fs::path& path) {
+    MappedFileInputStream* inputStream = new MappedFileInputStream();
+    if (!inputStream->Open(path)) {
+      delete inputStream;
+      return false;
+    }
+    return video->TakeAndOpen(inputStream, /*isStreamingInputStream*/ false, /*cacheAllFrames*/ false, /*isMappedFileInputStream*/ true);
+  }
+  
+  /// Waits until the video finished loading, and sets its playback mode. Returns true if the video is ready for playback.
+  static bool WaitUntilLoaded(ExternalXRVideo* video, PlaybackMode playbackMode) {
+    if (!WaitFor(video, timeoutSeconds, [&]() { return video->GetAsyncLoadState() != XRVideoAsyncLoadState::Loading; }) ||
+        video->GetAsyncLoadState() != XRVideoAsyncLoadState::Ready) {
+      return false;
+    }
+    video->GetPlaybackState().SetPlaybackMode(playbackMode);
+    return true;
+  }
+  
+  /// Waits until the video's current frame is ready for display and the video is not buffering. Returns false on timeout.
+  static bool WaitUntilDisplayReady(ExternalXRVideo* video) {
+    return WaitFor(video, timeoutSeconds, [&]() { return !video->IsBuffering() && video->IsCurrentFrameDisplayReady(); });
+  }
+  
+  /// Plays a video with a large rendition (0, with 64x64 textures) and a small rendition (1, with smallTextureWidth), starting with
+  /// the given rendition and switching to the other one at the third frame. Returns the rendition that is decoded at the end and
+  /// the texture width of each displayed frame. Afterwards, smallTextureFrameCount holds the number of decoded small-rendition frames.
+  void PlayAndSwitchRendition(int startRendition, int frameCount, int keyframeInterval, int* decodingRendition, vector<u32>* displayedTextureWidths) {
+    constexpr int cachedDecodedFrameCount = 5;
+    
+    SyntheticXRVideoConfig config = VideoConfig(frameCount, keyframeInterval);
+    
+    fs::path highPath;
+    ASSERT_TRUE(GenerateVideo(config, &highPath));
+    
+    config.uniqueVertexCount = 200;
+    config.duplicatedVertexCount = 20;
+    config.triangleCount = 300;
+    config.textureWidth = smallTextureWidth;
+    config.textureHeight = smallTextureWidth;
+    fs::path lowPath;
+    ASSERT_TRUE(GenerateVideo(config, &lowPath));
+    
+    unique_ptr<ExternalXRVideo> video(new ExternalXRVideo(FrameCallbacks(&RenditionCountingPrepareDecodeFrame)));
+    ASSERT_TRUE(video->Initialize(cachedDecodedFrameCount, /*verboseDecoding*/ false, /*commonResources*/ nullptr));
+    video->SetRendition(startRendition);
+    
+    vector<InputStream*> inputStreams;
+    for (const fs::path& path : {highPath, lowPath}) {
+      MappedFileInputStream* inputStream = new MappedFileInputStream();
+      ASSERT_TRUE(inputStream->Open(path));
+      inputStreams.push_back(inputStream);
+    }
+    ASSERT_TRUE(video->TakeAndOpenRenditions(inputStreams, /*areStreamingInputStreams*/ false, /*cacheAllFrames*/ false, /*areMappedFileInputStreams*/ true));
+    
+    ASSERT_TRUE(WaitUntilLoaded(video.get(), PlaybackMode::SingleShot));
+    ASSERT_EQ(2, video->GetRenditionCount());
+    EXPECT_EQ(64, video->TextureWidth());
+    
+    const FrameIndex& index = video->Index();
+    smallTextureFrameCount = 0;
+    displayedTextureWidths->clear();
+    
+    for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+      ASSERT_TRUE(WaitUntilDisplayReady(video.get())) << "Timeout while waiting for frame " << frameIndex;
+      const s64 playbackTime = video->Update(0);
+      ASSERT_EQ(frameIndex, index.FindFrameIndexForTimestamp(playbackTime));
+      
+      unique_ptr<XRVideoRenderLock> renderLock = video->CreateRenderLock();
+      ASSERT_NE(nullptr, renderLock);
+      displayedTextureWidths->push_back(renderLock->GetKeyframeMetadata().textureWidth);
+      renderLock.reset();
+      
+      if (frameIndex == 2) {
+        video->SetRendition(1 - startRendition);
+      }
+      
+      if (frameIndex + 1 < frameCount) {
+        video->Update(index.At(frameIndex + 1).GetTimestamp() - playbackTime + 1);
+      }
+    }
+    
+    *decodingRendition = video->GetDecodingRendition();
+    
+    video->Destroy();
+  }
+  
+  /// Scrubs back and forth in small steps (see ScrubbingRetainsConsistentDecodingState), using the given executor if non-null.
+  void ScrubAndWaitForSeekedFrames(XRVideoExecutor* executor) {
+    constexpr int frameCount = 90;
+    constexpr int cachedDecodedFrameCount = 8;
+    constexpr int scrubCount = 100;
+    
+    fs::path path;
+    ASSERT_TRUE(GenerateVideo(VideoConfig(frameCount, /*keyframeInterval*/ 30), &path));
+    
+    unique_ptr<ExternalXRVideo> video(new ExternalXRVideo(FrameCallbacks(&SlowPrepareDecodeFrame)));
+    video->SetExecutor(executor);
+    ASSERT_TRUE(video->Initialize(cachedDecodedFrameCount, /*verboseDecoding*/ false, /*commonResources*/ nullptr));
+    ASSERT_TRUE(OpenMappedFile(video.get(), path));
+    ASSERT_TRUE(WaitUntilLoaded(video.get(), PlaybackMode::SingleShot));
+    
+    const FrameIndex& index = video->Index();
+    mt19937 generator(/*seed*/ 0);
+    uniform_int_distribution<int> scrubStepDistribution(-3, 6);
+    int frameIndex = 0;
+    
+    for (int scrubIndex = 0; scrubIndex < scrubCount; ++ scrubIndex) {
+      // Seek multiple times in a row without waiting in between, such that the later seeks happen while frames are still queued
+      for (int burstIndex = 0; burstIndex < 3; ++ burstIndex) {
+        frameIndex = clamp(frameIndex + scrubStepDistribution(generator), 0, frameCount - 1);
+        video->Seek(index.At(frameIndex).GetTimestamp(), /*forward*/ true);
+        video->Update(0);
+        this_thread::sleep_for(chrono::microseconds(200));
+      }
+      
+      ASSERT_TRUE(WaitFor(video.get(), timeoutSeconds, [&]() { return video->IsCurrentFrameDisplayReady(); })) << "Timeout while scrubbing to frame " << frameIndex;
+      ASSERT_EQ(frameIndex, index.FindFrameIndexForTimestamp(video->Update(0)));
+    }
+  }
+  
+ private:
+  vector<unique_ptr<TemporaryPath>> temporaryPaths;
+};
+
+// Seeks while the frames that were displayed before still hold read locks onto a part of the small cache.
+// The reading thread can then only fill the remaining cache items, and has to continue once the old frames'
+// read locks get released (when the seeked-to frame gets displayed). Releasing the read locks must wake it up
+// right away instead of leaving it waiting for its timeout, which previously stalled buffering by up to 250 ms.
+TEST_F(XRVideoPlayback, RefillsCacheRightAfterReadLocksAreReleased) {
+  constexpr int cachedDecodedFrameCount = 5;
+  constexpr int seekTargetFrameIndex = 30;
+  
+  fs::path path;
+  ASSERT_TRUE(GenerateVideo(VideoConfig(/*frameCount*/ 60, /*keyframeInterval*/ seekTargetFrameIndex), &path));
+  
+  unique_ptr<ExternalXRVideo> video(new ExternalXRVideo(FrameCallbacks()));
+  ASSERT_TRUE(video->Initialize(cachedDecodedFrameCount, /*verboseDecoding*/ false, /*commonResources*/ nullptr));
+  ASSERT_TRUE(OpenMappedFile(video.get(), path));
+  ASSERT_TRUE(WaitUntilLoaded(video.get(), PlaybackMode::SingleShot));
+  
+  // Display frame 2, which read-locks frames 0 to 2 (since it depends on its keyframe and its predecessor)
+  const FrameIndex& index = video->Index();
+  ASSERT_TRUE(WaitUntilDisplayReady(video.get()));
+  video->Update(index.At(2).GetTimestamp() - video->Update(0));
+  ASSERT_TRUE(WaitFor(video.get(), timeoutSeconds, [&]() { return video->IsCurrentFrameDisplayReady(); }));
+  ASSERT_EQ(2, index.FindFrameIndexForTimestamp(video->Update(0)));
+  
+  // Seek, and wait until the video stops buffering, which requires that the cache gets filled with the new frames.
+  // The refill time is only logged rather than checked, since wall-clock limits are unreliable on loaded machines.
+  const TimePoint seekTime = Clock::now();
+  video->Seek(index.At(seekTargetFrameIndex).GetTimestamp(), /*forward*/ true);
+  EXPECT_TRUE(video->IsBuffering());
+  
+  ASSERT_TRUE(WaitUntilDisplayReady(video.get()));
+  LOG(INFO) << "Time to refill the cache after seeking: " << MillisecondsFromTo(seekTime, Clock::now()) << " ms";
+  
+  // All frames of the seeked-to group of pictures that fit into the cache must get decoded after the old frames' read locks were released
+  for (int frameIndex = seekTargetFrameIndex; frameIndex < seekTargetFrameIndex + cachedDecodedFrameCount - 1; ++ frameIndex) {
+    ASSERT_TRUE(WaitUntilDisplayReady(video.get())) << "Timeout while waiting for frame " << frameIndex;
+    const s64 playbackTime = video->Update(0);
+    ASSERT_EQ(frameIndex, index.FindFrameIndexForTimestamp(playbackTime));
+    video->Update(index.At(frameIndex + 1).GetTimestamp() - playbackTime);
+  }
+}
+
+// Scrubs back and forth in small steps, which retains the still relevant frames of the loading threads' queues
+// when seeking instead of clearing them. Each seeked-to frame must still become ready for display
+// (which it would not if the retained frames and the video decoding state got out of sync).
+TEST_F(XRVideoPlayback, ScrubbingRetainsConsistentDecodingState) {
+  ScrubAndWaitForSeekedFrames(/*executor*/ nullptr);
+}
+
+// Variant of ScrubbingRetainsConsistentDecodingState on an executor with a single worker. The seeks clear the texture frames
+// for which decoding tasks were already submitted, in which case the tasks must not take their work items (and wait for
+// the texture frames on the worker), but leave them to the task that the next arriving texture frame submits.
+TEST_F(XRVideoPlayback, ScrubbingOnSharedExecutorRetainsConsistentDecodingState) {
+  XRVideoExecutor executor;
+  ASSERT_TRUE(executor.Initialize(/*threadCount*/ 1, /*dav1dThreadCount*/ 1));
+  
+  ScrubAndWaitForSeekedFrames(&executor);
+  
+  executor.Destroy();
+}
+
+// Plays back two groups of pictures backwards. Each dependent frame requires decoding the chain of frames from its keyframe to it,
+// which must be done only once per group of pictures (storing all frames of the chain in the cache), instead of once for each frame.
+TEST_F(XRVideoPlayback, BackwardPlaybackDecodesEachGroupOfPicturesOnce) {
+  constexpr int frameCount = 60;
+  constexpr int cachedDecodedFrameCount = 40;
+  
+  fs::path path;
+  ASSERT_TRUE(GenerateVideo(VideoConfig(frameCount, /*keyframeInterval*/ 30), &path));
+  
+  unique_ptr<ExternalXRVideo> video(new ExternalXRVideo(FrameCallbacks()));
+  ASSERT_TRUE(video->Initialize(cachedDecodedFrameCount, /*verboseDecoding*/ false, /*commonResources*/ nullptr));
+  ASSERT_TRUE(OpenMappedFile(video.get(), path));
+  ASSERT_TRUE(WaitUntilLoaded(video.get(), PlaybackMode::SingleShot));
+  
+  // Once the initial buffering finished, count the frames passed to the video decoder
+  // (including those that are only decoded to advance the decoding state)
+  ASSERT_TRUE(WaitUntilDisplayReady(video.get()));
+  XRVideoPipelineStatistics statistics;
+  video->SetPipelineStatistics(&statistics);
+  
+  const FrameIndex& index = video->Index();
+  video->Seek(index.At(frameCount - 1).GetTimestamp(), /*forward*/ false);
+  
+  for (int frameIndex = frameCount - 1; frameIndex >= 0; -- frameIndex) {
+    ASSERT_TRUE(WaitFor(video.get(), timeoutSeconds, [&]() { return video->IsCurrentFrameDisplayReady(); })) << "Timeout while waiting for frame " << frameIndex;
+    const s64 playbackTime = video->Update(0);
+    ASSERT_EQ(frameIndex, index.FindFrameIndexForTimestamp(playbackTime));
+    
+    // Advance backwards to just before the start of the current frame. This does not advance while the video is buffering.
+    if (frameIndex > 0) {
+      ASSERT_TRUE(WaitFor(video.get(), timeoutSeconds, [&]() { return video->Update(playbackTime - index.At(frameIndex).GetTimestamp() + 1) != playbackTime; }));
+    }
+  }
+  
+  const usize videoDecodedFrameCount = statistics.GetSamples(XRVideoPipelineStage::VideoDecoding).size();
+  
+  video->Destroy();
+  video.reset();
+  
+  LOG(INFO) << "Frames passed to the video decoder for backward playback: " << videoDecodedFrameCount;
+  EXPECT_LE(videoDecodedFrameCount, 2 * frameCount);  // decoding the chain of frames for each frame took 870 decodes
+}
+
+// Loops a video that is much longer than the decoded frame cache. With a compressed frame cache that fits the whole video,
+// the frames that get decoded again in the second loop must be taken from memory instead of being read from the input stream again.
+TEST_F(XRVideoPlayback, LoopsFromCompressedFrameCacheWithoutRereading) {
+  constexpr int frameCount = 30;
+  constexpr int cachedDecodedFrameCount = 5;
+  
+  fs::path path;
+  ASSERT_TRUE(GenerateVideo(VideoConfig(frameCount, /*keyframeInterval*/ 10), &path));
+  
+  unique_ptr<ExternalXRVideo> video(new ExternalXRVideo(FrameCallbacks()));
+  ASSERT_TRUE(video->Initialize(cachedDecodedFrameCount, /*verboseDecoding*/ false, /*commonResources*/ nullptr));
+  video->SetCompressedFrameCacheBudget(64 * 1024 * 1024);
+  
+  atomic<u64> readBytes = {0};
+  CountingInputStream* inputStream = new CountingInputStream(&readBytes);
+  ASSERT_TRUE(inputStream->Open(path));
+  ASSERT_TRUE(video->TakeAndOpen(inputStream, /*isStreamingInputStream*/ false, /*cacheAllFrames*/ false));
+  
+  ASSERT_TRUE(WaitUntilLoaded(video.get(), PlaybackMode::Loop));
+  
+  const FrameIndex& index = video->Index();
+  u64 readBytesAfterFirstLoop = 0;
+  
+  for (int loop = 0; loop < 2; ++ loop) {
+    for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+      ASSERT_TRUE(WaitUntilDisplayReady(video.get())) << "Timeout while waiting for frame " << frameIndex;
+      const s64 playbackTime = video->Update(0);
+      ASSERT_EQ(frameIndex, index.FindFrameIndexForTimestamp(playbackTime));
+      
+      // Advance to just after the start of the next frame (wrapping around to the first frame after the last one)
+      video->Update(index.At(frameIndex + 1).GetTimestamp() - playbackTime + 1);
+    }
+    
+    if (loop == 0) {
+      readBytesAfterFirstLoop = readBytes;
+    }
+  }
+  
+  const u64 compressedFrameCacheBytes = video->GetCompressedFrameCacheBytes();
+  
+  video->Destroy();
+  video.reset();
+  
+  LOG(INFO) << "Bytes read in the first loop: " << readBytesAfterFirstLoop << ", in the second loop: " << (readBytes - readBytesAfterFirstLoop)
+            << " (compressed frame cache: " << compressedFrameCacheBytes << " bytes)";
+  EXPECT_GT(compressedFrameCacheBytes, 0);
+  EXPECT_EQ(readBytesAfterFirstLoop, readBytes);
+}
+
+// Plays back several videos (one of them invisible) at the same time, which run their decoding work on a shared executor
+// with fewer threads than videos. All videos must still display each frame in turn.
+TEST_F(XRVideoPlayback, PlaysMultipleVideosOnSharedExecutor) {
+  constexpr int videoCount = 3;
+  constexpr int frameCount = 40;
+  constexpr int cachedDecodedFrameCount = 8;
+  
+  fs::path path;
+  ASSERT_TRUE(GenerateVideo(VideoConfig(frameCount, /*keyframeInterval*/ 10), &path));
+  
+  XRVideoExecutor executor;
+  ASSERT_TRUE(executor.Initialize(/*threadCount*/ 2, /*dav1dThreadCount*/ 1));
+  
+  vector<unique_ptr<ExternalXRVideo>> videos(videoCount);
+  for (int i = 0; i < videoCount; ++ i) {
+    videos[i].reset(new ExternalXRVideo(FrameCallbacks(&SlowPrepareDecodeFrame)));
+    videos[i]->SetExecutor(&executor);
+    videos[i]->SetVisible(i > 0);
+    ASSERT_TRUE(videos[i]->Initialize(cachedDecodedFrameCount, /*verboseDecoding*/ false, /*commonResources*/ nullptr));
+    ASSERT_TRUE(OpenMappedFile(videos[i].get(), path));
+  }
+  
+  for (auto& video : videos) {
+    ASSERT_TRUE(WaitUntilLoaded(video.get(), PlaybackMode::SingleShot));
+  }
+  
+  for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+    for (auto& video : videos) {
+      const FrameIndex& index = video->Index();
+      ASSERT_TRUE(WaitUntilDisplayReady(video.get())) << "Timeout while waiting for frame " << frameIndex;
+      const s64 playbackTime = video->Update(0);
+      ASSERT_EQ(frameIndex, index.FindFrameIndexForTimestamp(playbackTime));
+      
+      // Advance to the start of the next frame. This does not advance while the video is buffering.
+      if (frameIndex < frameCount - 1) {
+        ASSERT_TRUE(WaitFor(video.get(), timeoutSeconds, [&]() { return video->Update(index.At(frameIndex + 1).GetTimestamp() - playbackTime) != playbackTime; }));
+      }
+    }
+  }
+  
+  for (auto& video : videos) {
+    video->Destroy();
+  }
+  videos.clear();
+  executor.Destroy();
+}
+
+// Plays back two videos with large decoded frame caches whose frames together would exceed the budget of a shared memory governor.
+// The videos must keep their cached frames within the budget (with some tolerance, since the frames differ in size), while still
+// displaying each frame in turn.
+TEST_F(XRVideoPlayback, KeepsCachedFramesOfMultipleVideosWithinMemoryBudget) {
+  constexpr int videoCount = 2;
+  constexpr int frameCount = 60;
+  constexpr int cachedDecodedFrameCount = 40;
+  
+  fs::path path;
+  ASSERT_TRUE(GenerateVideo(VideoConfig(frameCount, /*keyframeInterval*/ 15), &path));
+  
+  // Budget for about 10 frames per video, while the videos' caches could hold 40 frames each (the frames take about 18 KiB)
+  constexpr s64 budgetBytes = videoCount * 10 * 18 * 1024;
+  XRVideoMemoryGovernor governor(budgetBytes);
+  
+  vector<unique_ptr<ExternalXRVideo>> videos(videoCount);
+  for (auto& video : videos) {
+    video.reset(new ExternalXRVideo(FrameCallbacks()));
+    video->SetMemoryGovernor(&governor, /*minCachedFrameCount*/ 3);
+    ASSERT_TRUE(video->Initialize(cachedDecodedFrameCount, /*verboseDecoding*/ false, /*commonResources*/ nullptr));
+    ASSERT_TRUE(OpenMappedFile(video.get(), path));
+  }
+  
+  for (auto& video : videos) {
+    ASSERT_TRUE(WaitUntilLoaded(video.get(), PlaybackMode::SingleShot));
+  }
+  
+  s64 maxCachedBytes = 0;
+  for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+    for (auto& video : videos) {
+      const FrameIndex& index = video->Index();
+      ASSERT_TRUE(WaitUntilDisplayReady(video.get())) << "Timeout while waiting for frame " << frameIndex;
+      const s64 playbackTime = video->Update(0);
+      ASSERT_EQ(frameIndex, index.FindFrameIndexForTimestamp(playbackTime));
+      
+      maxCachedBytes = max(maxCachedBytes, governor.GetCachedBytes());
+      
+      if (frameIndex < frameCount - 1) {
+        ASSERT_TRUE(WaitFor(video.get(), timeoutSeconds, [&]() { return video->Update(index.At(frameIndex + 1).GetTimestamp() - playbackTime) != playbackTime; }));
+      }
+    }
+  }
+  
+  for (auto& video : videos) {
+    video->Destroy();
+  }
+  videos.clear();
+  
+  LOG(INFO) << "Maximum cached bytes: " << maxCachedBytes << " (budget: " << budgetBytes << ")";
+  EXPECT_LE(maxCachedBytes, budgetBytes * 5 / 4);
+  EXPECT_EQ(0, governor.GetCachedBytes());
+}
+
+// Plays a video with two renditions of different texture sizes and mesh densities, and switches to the second rendition during playback.
+// The switch must take effect at a keyframe, and every frame must become ready for display, in particular those around the switch.
+TEST_F(XRVideoPlayback, SwitchesRenditionsAtKeyframes) {
+  constexpr int frameCount = 40;
+  constexpr int keyframeInterval = 10;
+  
+  int decodingRendition;
+  vector<u32> displayedTextureWidths;
+  ASSERT_NO_FATAL_FAILURE(PlayAndSwitchRendition(/*startRendition*/ 0, frameCount, keyframeInterval, &decodingRendition, &displayedTextureWidths));
+  
+  // The frames of the first group of pictures were read before the switch. At the latest, the switch takes effect
+  // with the group of pictures that was not read yet when it was requested.
+  EXPECT_EQ(1, decodingRendition);
+  EXPECT_LE(smallTextureFrameCount, frameCount - keyframeInterval);
+  EXPECT_GE(smallTextureFrameCount, frameCount - 2 * keyframeInterval);
+  EXPECT_EQ(0, smallTextureFrameCount % keyframeInterval);
+  EXPECT_EQ(smallTextureWidth, displayedTextureWidths.back());
+}
+
+// Like SwitchesRenditionsAtKeyframes, but switches from the small to the large rendition, such that
+// cache items that held frames with small textures get reused for frames with larger ones
+TEST_F(XRVideoPlayback, SwitchesToLargerRenditionAtKeyframes) {
+  constexpr int frameCount = 40;
+  constexpr int keyframeInterval = 10;
+  
+  int decodingRendition;
+  vector<u32> displayedTextureWidths;
+  ASSERT_NO_FATAL_FAILURE(PlayAndSwitchRendition(/*startRendition*/ 1, frameCount, keyframeInterval, &decodingRendition, &displayedTextureWidths));
+  
+  EXPECT_EQ(0, decodingRendition);
+  EXPECT_GE(smallTextureFrameCount, keyframeInterval);
+  EXPECT_LE(smallTextureFrameCount, 2 * keyframeInterval);
+  EXPECT_EQ(0, smallTextureFrameCount % keyframeInterval);
+  
+  // Once switched, all displayed frames have the large texture size
+  ASSERT_EQ(frameCount, static_cast<int>(displayedTextureWidths.size()));
+  EXPECT_EQ(smallTextureWidth, displayedTextureWidths.front());
+  for (int frameIndex = 2 * keyframeInterval; frameIndex < frameCount; ++ frameIndex) {
+    EXPECT_EQ(64u, displayedTextureWidths[frameIndex]) << "frame: " << frameIndex;
+  }
+}
@@ -0,0 +1,64 @@
+#include "scan_studio/viewer_common/xrvideo/xrvideo_memory_governor.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace scan_studio;
+
+/// Reports the given number of cached frames with the given size to the account.
+static void AddCachedFrames(XRVideoMemoryAccount* account, int frameCount, s64 bytesPerFrame) {
+  for (int i = 0; i < frameCount; ++ i) {
+    account->AddCachedFrame(bytesPerFrame);
+  }
+}
+
+// Distributes the budget that remains after the minimum slot counts evenly among the visible videos first,
+// measured in the average frame size of each video, and only then among the invisible ones
+TEST(XRVideoMemoryGovernor, PrefersVisibleVideosAndRespectsSlotRanges) {
+  XRVideoMemoryGovernor governor(/*budgetBytes*/ 1000);
+  
+  shared_ptr<XRVideoMemoryAccount> smallFrames = governor.CreateAccount();
+  shared_ptr<XRVideoMemoryAccount> largeFrames = governor.CreateAccount();
+  shared_ptr<XRVideoMemoryAccount> invisible = governor.CreateAccount();
+  
+  int slotLimitChangedCount = 0;
+  invisible->SetSlotLimitChangedCallback([&]() { ++ slotLimitChangedCount; });
+  
+  for (auto& account : {smallFrames, largeFrames, invisible}) {
+    account->SetSlotRange(/*minSlotCount*/ 1, /*maxSlotCount*/ 20);
+  }
+  invisible->SetVisible(false);
+  
+  AddCachedFrames(smallFrames.get(), 3, 20);
+  AddCachedFrames(largeFrames.get(), 3, 40);
+  AddCachedFrames(invisible.get(), 3, 10);
+  governor.Rebalance();
+  
+  // The minimum slot count is raised to 3, which takes 3 * (20 + 40 + 10) = 210 bytes. Of the remaining 790 bytes,
+  // the visible videos get 13 more slots each (780 bytes), and the remaining 10 bytes suffice for one slot of the invisible video.
+  EXPECT_EQ(16, smallFrames->GetSlotLimit());
+  EXPECT_EQ(16, largeFrames->GetSlotLimit());
+  EXPECT_EQ(4, invisible->GetSlotLimit());
+  EXPECT_EQ(1, slotLimitChangedCount);
+  EXPECT_EQ(3 * (20 + 40 + 10), governor.GetCachedBytes());
+  
+  // With a large budget, all videos get their maximum slot count
+  governor.SetBudget(100000);
+  EXPECT_EQ(20, smallFrames->GetSlotLimit());
+  EXPECT_EQ(20, largeFrames->GetSlotLimit());
+  EXPECT_EQ(20, invisible->GetSlotLimit());
+  EXPECT_EQ(2, slotLimitChangedCount);
+  
+  // With a tiny budget, all videos keep their minimum slot count
+  governor.SetBudget(0);
+  EXPECT_EQ(3, smallFrames->GetSlotLimit());
+  EXPECT_EQ(3, largeFrames->GetSlotLimit());
+  EXPECT_EQ(3, invisible->GetSlotLimit());
+  EXPECT_EQ(3, slotLimitChangedCount);
+  
+  // Destroying an account releases its share of the budget to the others
+  governor.SetBudget(1000);
+  largeFrames.reset();
+  EXPECT_EQ(20, smallFrames->GetSlotLimit());
+  EXPECT_EQ(20, invisible->GetSlotLimit());
+  EXPECT_EQ(5, slotLimitChangedCount);
+}
@@ -0,0 +1,101 @@
+#include "scan_studio/viewer_common/xrvideo/index.hpp"
+#include "scan_studio/viewer_common/xrvideo/rendition_set.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace scan_studio;
+
+static TimePoint TimeAt(const TimePoint& start, double seconds) {
+  return start + chrono::duration_cast<Clock::duration>(SecondsDuration(seconds));
+}
+
+/// Creates an index of a video with 30 frames per second, a keyframe every keyframeInterval frames, and frames of the given size
+static void CreateIndex(int frameCount, int keyframeInterval, u64 bytesPerFrame, FrameIndex* index) {
+  constexpr s64 frameDuration = 1000 * 1000 * 1000 / 30;
+  
+  index->Clear();
+  for (int frame = 0; frame < frameCount; ++ frame) {
+    index->PushFrame(frame * frameDuration, frame * bytesPerFrame, frame % keyframeInterval == 0);
+  }
+  index->PushVideoEnd(frameCount * frameDuration, frameCount * bytesPerFrame);
+}
+
+TEST(XRVideoRenditionSet, ParseManifest) {
+  const string manifest =
+      "#XRVIDEO-RENDITIONS\n"
+      "# Comment\n"
+      "high.xrv High quality\n"
+      "\n"
+      "  /videos/low.xrv\tLow  \r\n"
+      "https://cdn.example.com/medium.xrv Medium\n";
+  
+  vector<XRVideoRenditionInfo> renditions;
+  ASSERT_TRUE(ParseXRVideoRenditionManifest(manifest, "https://example.com/videos/set/renditions.txt?token=abc", &renditions));
+  ASSERT_EQ(3, renditions.size());
+  
+  EXPECT_EQ("https://example.com/videos/set/high.xrv", renditions[0].uri);
+  EXPECT_EQ("High quality", renditions[0].label);
+  EXPECT_EQ("https://example.com/videos/low.xrv", renditions[1].uri);
+  EXPECT_EQ("Low", renditions[1].label);
+  EXPECT_EQ("https://cdn.example.com/medium.xrv", renditions[2].uri);
+  EXPECT_EQ("Medium", renditions[2].label);
+  
+  // Local paths
+  ASSERT_TRUE(ParseXRVideoRenditionManifest("#XRVIDEO-RENDITIONS\nhigh.xrv\n", "/data/renditions.txt", &renditions));
+  ASSERT_EQ(1, renditions.size());
+  EXPECT_EQ("/data/high.xrv", renditions[0].uri);
+  EXPECT_EQ("", renditions[0].label);
+  
+  // A missing header or a missing rendition is an error
+  EXPECT_FALSE(ParseXRVideoRenditionManifest("high.xrv\n", "/data/renditions.txt", &renditions));
+  EXPECT_FALSE(ParseXRVideoRenditionManifest("#XRVIDEO-RENDITIONS\n# no renditions\n", "/data/renditions.txt", &renditions));
+}
+
+TEST(XRVideoRenditionSet, TimeAlignment) {
+  FrameIndex high, low, otherKeyframes;
+  CreateIndex(/*frameCount*/ 90, /*keyframeInterval*/ 30, /*bytesPerFrame*/ 40 * 1000, &high);
+  CreateIndex(/*frameCount*/ 90, /*keyframeInterval*/ 30, /*bytesPerFrame*/ 10 * 1000, &low);
+  CreateIndex(/*frameCount*/ 90, /*keyframeInterval*/ 15, /*bytesPerFrame*/ 10 * 1000, &otherKeyframes);
+  
+  EXPECT_TRUE(high.IsTimeAlignedWith(low));
+  EXPECT_FALSE(high.IsTimeAlignedWith(otherKeyframes));
+  
+  EXPECT_NEAR(30 * 40 * 1000, high.ComputeBytesPerSecond(), 1);
+  EXPECT_EQ(30, high.FindNextKeyframe(0));
+  EXPECT_EQ(90, high.FindNextKeyframe(75));
+}
+
+// The selector switches down quickly if the link or the decoder cannot keep up, and switches up
+// one rendition at a time only after a hold period and with a margin.
+TEST(XRVideoRenditionSet, SelectRendition) {
+  // Rendition 0 is the highest, rendition 1 the lowest, and rendition 3 cannot be played back
+  const vector<double> bytesPerSecond = {4 * 1000 * 1000, 1 * 1000 * 1000, 2 * 1000 * 1000, -1};
+  
+  const TimePoint start = Clock::now();
+  XRVideoRenditionSelector selector;
+  selector.SetRenditions(bytesPerSecond, start);
+  
+  // A fast link and a decoding load with headroom keep the highest rendition
+  EXPECT_EQ(0, selector.SelectRendition(0, /*linkBytesPerSecond*/ 10 * 1000 * 1000, /*decodingLoad*/ 0.5, /*playbackSpeed*/ 1, TimeAt(start, 3)));
+  
+  // A slow link switches down to the best rendition that fits
+  EXPECT_EQ(2, selector.SelectRendition(0, /*linkBytesPerSecond*/ 3 * 1000 * 1000, /*decodingLoad*/ 0.5, /*playbackSpeed*/ 1, TimeAt(start, 4)));
+  
+  // Switching up again requires the hold period to pass ...
+  EXPECT_EQ(2, selector.SelectRendition(2, /*linkBytesPerSecond*/ 10 * 1000 * 1000, /*decodingLoad*/ 0.2, /*playbackSpeed*/ 1, TimeAt(start, 6)));
+  EXPECT_EQ(0, selector.SelectRendition(2, /*linkBytesPerSecond*/ 10 * 1000 * 1000, /*decodingLoad*/ 0.2, /*playbackSpeed*/ 1, TimeAt(start, 13)));
+  
+  // A decoding load that exceeds real-time switches down, on a link of unknown throughput as well
+  EXPECT_EQ(1, selector.SelectRendition(0, /*linkBytesPerSecond*/ 0, /*decodingLoad*/ 3, /*playbackSpeed*/ 1, TimeAt(start, 16)));
+  
+  // Faster playback requires a correspondingly faster link
+  selector.SetRenditions(bytesPerSecond, start);
+  EXPECT_EQ(1, selector.SelectRendition(2, /*linkBytesPerSecond*/ 3 * 1000 * 1000, /*decodingLoad*/ 0.2, /*playbackSpeed*/ 2, TimeAt(start, 3)));
+  
+  // Without decoding time measurements, the selector does not switch up
+  selector.SetRenditions(bytesPerSecond, start);
+  EXPECT_EQ(1, selector.SelectRendition(1, /*linkBytesPerSecond*/ 100 * 1000 * 1000, /*decodingLoad*/ -1, /*playbackSpeed*/ 1, TimeAt(start, 20)));
+  
+  // A rendition that cannot be played back is never kept
+  EXPECT_EQ(1, selector.SelectRendition(3, /*linkBytesPerSecond*/ 100 * 1000 * 1000, /*decodingLoad*/ 0.2, /*playbackSpeed*/ 1, TimeAt(start, 20)));
+}
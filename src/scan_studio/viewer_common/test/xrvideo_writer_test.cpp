@@ -0,0 +1,174 @@
+#include "scan_studio/common/xrvideo_writer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <zstd.h>
+
+#include <loguru.hpp>
+
+#include <libvis/io/input_stream.h>
+
+#include "scan_studio/common/io/mapped_file_input_stream.hpp"
+#include "scan_studio/tools/synthetic_xrvideo.hpp"
+#include "scan_studio/viewer_common/test/temporary_path.hpp"
+#include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
+#include "scan_studio/viewer_common/xrvideo/index.hpp"
+
+using namespace scan_studio;
+
+// Generates a small synthetic video and verifies that the index and all frames can be read back and decoded
+TEST(XRVideoWriter, SyntheticVideoRoundTrip) {
+  SyntheticXRVideoConfig config;
+  config.frameCount = 12;
+  config.keyframeInterval = 5;
+  config.uniqueVertexCount = 300;
+  config.duplicatedVertexCount = 20;
+  config.triangleCount = 700;
+  config.deformationNodeCount = 40;
+  config.textureWidth = 64;
+  config.textureHeight = 32;
+  config.vertexAlpha = true;
+  
+  const fs::path path = fs::temp_directory_path() / "xrvideo_writer_test.xrv";
+  ASSERT_TRUE(GenerateSyntheticXRVideo(config, path));
+  
+  MappedFileInputStream* stream = new MappedFileInputStream();
+  ASSERT_TRUE(stream->Open(path));
+  XRVideoReader reader;
+  reader.TakeInputStream(stream, /*isStreamingInputStream*/ false, /*isMappedFileInputStream*/ true);
+  
+  XRVideoMetadata metadata;
+  EXPECT_TRUE(reader.ReadMetadata(&metadata));
+  
+  // Index chunk
+  ASSERT_TRUE(reader.FindNextChunk(xrVideoIndexChunkIdentifierV0));
+  FrameIndex index;
+  ASSERT_TRUE(index.CreateFromIndexChunk(&reader));
+  ASSERT_EQ(config.frameCount, index.GetFrameCount());
+  EXPECT_EQ(0, index.GetVideoStartTimestamp());
+  EXPECT_NEAR(config.frameCount * 1e9 / config.framesPerSecond, index.GetVideoEndTimestamp(), 1);
+  
+  // Frames
+  XRVideoDecodingContext decodingContext;
+  ASSERT_TRUE(decodingContext.Initialize());
+  shared_ptr<ZSTD_DCtx> textureCtx(ZSTD_createDCtx(), [](ZSTD_DCtx* ctx) { ZSTD_freeDCtx(ctx); });
+  
+  ASSERT_TRUE(reader.Seek(index.At(0).GetOffset()));
+  for (int frameIndex = 0; frameIndex < index.GetFrameCount(); ++ frameIndex) {
+    const bool expectKeyframe = (frameIndex % config.keyframeInterval) == 0;
+    EXPECT_EQ(expectKeyframe, index.At(frameIndex).IsKeyframe());
+    
+    XRVideoFrameView view;
+    u64 fileOffset;
+    ASSERT_TRUE(reader.ReadNextFrameView(&view, &fileOffset));
+    EXPECT_EQ(index.At(frameIndex).GetOffset(), fileOffset);
+    
+    const u8* dataPtr = view.data;
+    XRVideoFrameMetadata frameMetadata;
+    ASSERT_TRUE(XRVideoReadMetadata(&dataPtr, view.size, &frameMetadata));
+    EXPECT_EQ(expectKeyframe, frameMetadata.isKeyframe);
+    EXPECT_TRUE(frameMetadata.hasVertexAlpha);
+    EXPECT_TRUE(frameMetadata.zstdRGBTexture);
+    EXPECT_EQ(config.deformationNodeCount, frameMetadata.deformationNodeCount);
+    EXPECT_EQ(index.At(frameIndex).GetTimestamp(), frameMetadata.startTimestamp);
+    EXPECT_EQ(index.At(frameIndex + 1).GetTimestamp(), frameMetadata.endTimestamp);
+    if (expectKeyframe) {
+      EXPECT_EQ(config.uniqueVertexCount, frameMetadata.uniqueVertexCount);
+      EXPECT_EQ(config.uniqueVertexCount + config.duplicatedVertexCount, frameMetadata.vertexCount);
+      EXPECT_EQ(3 * config.triangleCount, frameMetadata.indexCount);
+    }
+    
+    vector<XRVideoVertex> vertices(frameMetadata.GetRenderableVertexCount());
+    vector<u16> indices(frameMetadata.indexCount);
+    vector<float> deformationState(frameMetadata.deformationNodeCount * 12);
+    vector<u8> vertexAlpha;
+    ASSERT_TRUE(XRVideoDecompressContent(
+        dataPtr, frameMetadata, &decodingContext,
+        vertices.data(), indices.data(), deformationState.data(),
+        /*outDuplicatedVertexSourceIndices*/ nullptr, &vertexAlpha, /*verboseDecoding*/ false));
+    EXPECT_EQ(config.uniqueVertexCount + config.duplicatedVertexCount, vertexAlpha.size());
+    
+    // The deformation state is stored as half floats, so the rotation part stays close to the identity
+    EXPECT_NEAR(1.f, deformationState[4], 1e-3f);
+    
+    // The texture is stored right after the deformation state
+    const u8* texturePtr = dataPtr + frameMetadata.compressedMeshSize + frameMetadata.compressedDeformationStateSize;
+    vector<u8> textureRGB(frameMetadata.textureWidth * frameMetadata.textureHeight * 3);
+    EXPECT_EQ(textureRGB.size(), ZSTD_decompressDCtx(textureCtx.get(), textureRGB.data(), textureRGB.size(), texturePtr, frameMetadata.compressedRGBSize));
+  }
+  
+  XRVideoFrameView view;
+  EXPECT_FALSE(reader.ReadNextFrameView(&view));
+  
+  reader.Close();
+  fs::remove(path);
+}
+
+static void ExpectEqualIndices(const FrameIndex& expected, const FrameIndex& actual) {
+  ASSERT_EQ(expected.GetFrameCount(), actual.GetFrameCount());
+  for (int frameIndex = 0; frameIndex <= expected.GetFrameCount(); ++ frameIndex) {
+    EXPECT_EQ(expected.At(frameIndex).GetTimestamp(), actual.At(frameIndex).GetTimestamp());
+    EXPECT_EQ(expected.At(frameIndex).GetOffset(), actual.At(frameIndex).GetOffset());
+    EXPECT_EQ(expected.At(frameIndex).IsKeyframe(), actual.At(frameIndex).IsKeyframe());
+  }
+}
+
+// Verifies that the index built from the frame headers (as for files without an index chunk) equals the one from the index chunk,
+// and that it survives a round trip through a sidecar index file, which is rejected for other videos
+TEST(XRVideoWriter, IndexFromFrameHeadersAndSidecarFile) {
+  SyntheticXRVideoConfig config;
+  config.frameCount = 17;
+  config.keyframeInterval = 6;
+  config.uniqueVertexCount = 100;
+  config.duplicatedVertexCount = 10;
+  config.triangleCount = 200;
+  config.deformationNodeCount = 20;
+  config.textureWidth = 16;
+  config.textureHeight = 16;
+  
+  const TemporaryPath temporaryPath("xrvideo_index_test", ".xrv");
+  const TemporaryPath temporaryOtherPath("xrvideo_index_test_other", ".xrv");
+  const TemporaryPath temporarySidecarPath("xrvideo_index_test", ".xrv.index");
+  const fs::path& path = temporaryPath.GetPath();
+  const fs::path& otherPath = temporaryOtherPath.GetPath();
+  const fs::path& sidecarPath = temporarySidecarPath.GetPath();
+  ASSERT_TRUE(GenerateSyntheticXRVideo(config, path));
+  config.frameCount = 18;
+  ASSERT_TRUE(GenerateSyntheticXRVideo(config, otherPath));
+  
+  auto openReader = [](const fs::path& path, XRVideoReader* reader) {
+    IfstreamInputStream* stream = new IfstreamInputStream();
+    if (!stream->Open(path)) {
+      delete stream;
+      return false;
+    }
+    reader->TakeInputStream(stream, /*isStreamingInputStream*/ false);
+    return true;
+  };
+  
+  XRVideoReader reader;
+  ASSERT_TRUE(openReader(path, &reader));
+  
+  FrameIndex chunkIndex;
+  ASSERT_TRUE(reader.FindNextChunk(xrVideoIndexChunkIdentifierV0));
+  ASSERT_TRUE(chunkIndex.CreateFromIndexChunk(&reader));
+  
+  FrameIndex headerIndex;
+  atomic<bool> quitRequested = {false};
+  ASSERT_TRUE(reader.Seek(0));
+  ASSERT_TRUE(headerIndex.CreateFromFrameHeaders(&reader, quitRequested));
+  ExpectEqualIndices(chunkIndex, headerIndex);
+  
+  ASSERT_TRUE(headerIndex.SaveToSidecarFile(sidecarPath, &reader));
+  FrameIndex sidecarIndex;
+  ASSERT_TRUE(sidecarIndex.LoadFromSidecarFile(sidecarPath, &reader));
+  ExpectEqualIndices(chunkIndex, sidecarIndex);
+  
+  XRVideoReader otherReader;
+  ASSERT_TRUE(openReader(otherPath, &otherReader));
+  FrameIndex otherIndex;
+  EXPECT_FALSE(otherIndex.LoadFromSidecarFile(sidecarPath, &otherReader));
+  
+  reader.Close();
+  otherReader.Close();
+}
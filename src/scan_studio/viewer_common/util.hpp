@@ -11,6 +11,19 @@ using namespace vis;
 /// Returns true if the string was copied in full, false if it was truncated to fit the destination buffer.
 bool SafeStringCopy(char* dest, int destSize, const char* src);
 
+/// Initial hash value for HashFNV1a().
+constexpr u64 fnv1aInitialHash = 0xcbf29ce484222325ull;
+
+/// Returns the 64-bit FNV-1a hash of the given data. To hash multiple pieces of data,
+/// pass the hash of the preceding pieces as `hash`. This is not a cryptographic hash.
+inline u64 HashFNV1a(const void* data, usize size, u64 hash = fnv1aInitialHash) {
+  const u8* bytes = static_cast<const u8*>(data);
+  for (usize i = 0; i < size; ++ i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  return hash;
+}
+
 /// Sets the current thread's name.
 /// At least with the Linux implementation, the name can only be up to 16 bytes long, including the terminating null character.
 #ifdef _WIN32
@@ -0,0 +1,119 @@
+#include "scan_studio/viewer_common/xrvideo/compressed_frame_cache.hpp"
+
+#include <algorithm>
+
+#include "scan_studio/viewer_common/xrvideo/playback_state.hpp"
+
+namespace scan_studio {
+
+void CompressedFrameCache::SetBudget(s64 bytes) {
+  lock_guard<mutex> lock(cacheMutex);
+  
+  budgetBytes = std::max<s64>(0, bytes);
+  while (cachedBytes > budgetBytes) {
+    Evict(cachedFrameIndices.back());
+  }
+}
+
+void CompressedFrameCache::Initialize(int frameCount) {
+  lock_guard<mutex> lock(cacheMutex);
+  
+  frames.clear();
+  frames.resize(frameCount);
+  cachedFrameIndices.clear();
+  cachedBytes = 0;
+}
+
+void CompressedFrameCache::Clear() {
+  Initialize(0);
+}
+
+bool CompressedFrameCache::Contains(int frameIndex, int rendition) {
+  lock_guard<mutex> lock(cacheMutex);
+  return frameIndex >= 0 && frameIndex < static_cast<int>(frames.size()) && frames[frameIndex].view.data != nullptr && frames[frameIndex].rendition == rendition;
+}
+
+bool CompressedFrameCache::Lookup(int frameIndex, int rendition, XRVideoFrameView* view) {
+  lock_guard<mutex> lock(cacheMutex);
+  
+  if (frameIndex < 0 || frameIndex >= static_cast<int>(frames.size()) || frames[frameIndex].view.data == nullptr || frames[frameIndex].rendition != rendition) {
+    return false;
+  }
+  
+  *view = frames[frameIndex].view;
+  return true;
+}
+
+void CompressedFrameCache::Insert(int frameIndex, int rendition, const XRVideoFrameView& view, const NextFramesIterator& playbackIt, bool copyData) {
+  lock_guard<mutex> lock(cacheMutex);
+  
+  if (frameIndex < 0 || frameIndex >= static_cast<int>(frames.size()) || view.data == nullptr) {
+    return;
+  }
+  if (frames[frameIndex].view.data != nullptr) {
+    if (frames[frameIndex].rendition == rendition) { return; }
+    Evict(frameIndex);
+  }
+  
+  const s64 frameBytes = view.size;
+  if (frameBytes > budgetBytes) {
+    return;
+  }
+  
+  if (cachedBytes + frameBytes > budgetBytes) {
+    // Check whether evicting the frames that will not be played back again frees enough space.
+    // If not, keep the cache as it is, since all of its frames will be played back again.
+    vector<int> evictableFrameIndices;
+    s64 evictableBytes = 0;
+    
+    for (int cachedFrameIndex : cachedFrameIndices) {
+      if (playbackIt.ComputeDurationToFrame(cachedFrameIndex) == numeric_limits<int>::max()) {
+        evictableFrameIndices.push_back(cachedFrameIndex);
+        evictableBytes += frames[cachedFrameIndex].view.size;
+      }
+    }
+    
+    if (cachedBytes - evictableBytes + frameBytes > budgetBytes) {
+      return;
+    }
+    
+    for (int evictableFrameIndex : evictableFrameIndices) {
+      if (cachedBytes + frameBytes <= budgetBytes) { break; }
+      Evict(evictableFrameIndex);
+    }
+  }
+  
+  if (copyData) {
+    shared_ptr<vector<u8>> buffer(new vector<u8>(view.data, view.data + view.size));
+    
+    frames[frameIndex].view.data = buffer->data();
+    frames[frameIndex].view.size = buffer->size();
+    frames[frameIndex].view.owner = std::move(buffer);
+  } else {
+    frames[frameIndex].view = view;
+  }
+  frames[frameIndex].rendition = rendition;
+  frames[frameIndex].cachedFrameIndicesPosition = cachedFrameIndices.size();
+  cachedFrameIndices.push_back(frameIndex);
+  cachedBytes += frameBytes;
+}
+
+s64 CompressedFrameCache::GetCachedBytes() {
+  lock_guard<mutex> lock(cacheMutex);
+  return cachedBytes;
+}
+
+void CompressedFrameCache::Evict(int frameIndex) {
+  CachedFrame& frame = frames[frameIndex];
+  
+  // Move the last item of cachedFrameIndices into the evicted frame's place
+  const int movedFrameIndex = cachedFrameIndices.back();
+  cachedFrameIndices[frame.cachedFrameIndicesPosition] = movedFrameIndex;
+  frames[movedFrameIndex].cachedFrameIndicesPosition = frame.cachedFrameIndicesPosition;
+  cachedFrameIndices.pop_back();
+  
+  cachedBytes -= frame.view.size;
+  frame = CachedFrame();
+}
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <libvis/vulkan/libvis.h>
+
+#include "scan_studio/common/xrvideo_file.hpp"
+
+namespace scan_studio {
+using namespace vis;
+
+class NextFramesIterator;
+
+/// In-memory cache for the compressed data of XRVideo frames, as read from the video's input stream.
+///
+/// This is a second cache tier between the input stream and the decoded frame cache: if a frame must be decoded again
+/// after it was dropped from the decoded frame cache (e.g., when looping a video that is longer than the decoded frame cache),
+/// the reading thread takes the frame's data from here instead of reading it again, which for streamed videos may require
+/// downloading it again. Since compressed frames are much smaller than decoded ones, a much larger part of a video
+/// (or all of it) fits into a given amount of memory.
+///
+/// The cache holds frames up to a budget in bytes. Once it is full, it only replaces frames that will not be played back
+/// (again) in the current playback mode (see NextFramesIterator::ComputeDurationToFrame()). When looping a video that does not
+/// fit into the budget, this keeps a fixed part of the video cached. Replacing the least recently read frames instead would
+/// evict each frame before it gets played again.
+///
+/// The cache is not used for MappedFileInputStreams, since their frame data is accessed in the file mapping directly.
+///
+/// For videos with multiple renditions (see XRVideo::TakeAndOpenRenditions()), the cache holds at most one rendition of each frame,
+/// and lookups only succeed for the requested rendition.
+class CompressedFrameCache {
+ public:
+  /// Sets the budget in bytes, evicting frames if the cached frames exceed it. A budget of zero disables the cache.
+  void SetBudget(s64 bytes);
+  
+  /// Drops all cached frames and prepares the cache for a video with the given number of frames.
+  void Initialize(int frameCount);
+  
+  /// Drops all cached frames.
+  void Clear();
+  
+  /// Returns true if the data of the given rendition of the given frame is cached.
+  bool Contains(int frameIndex, int rendition);
+  
+  /// If the data of the given rendition of the given frame is cached, outputs it in view and returns true. Otherwise, returns false.
+  bool Lookup(int frameIndex, int rendition, XRVideoFrameView* view);
+  
+  /// Offers the data of a frame that was read from the input stream to the cache. The frame gets cached if it fits into the budget,
+  /// possibly after evicting frames that will not be played back again according to playbackIt (which must be at the current playback position).
+  /// If another rendition of the frame is cached, it gets replaced.
+  ///
+  /// If copyData is true, the cache stores a copy of the frame's data instead of referencing the view's owner.
+  /// This must be used for views whose owner holds more memory than the frame itself (such as a pinned StreamingInputStream range),
+  /// since that memory would not be accounted for in the budget otherwise.
+  void Insert(int frameIndex, int rendition, const XRVideoFrameView& view, const NextFramesIterator& playbackIt, bool copyData = false);
+  
+  /// Returns the total size of the cached frames' data in bytes.
+  s64 GetCachedBytes();
+  
+ private:
+  /// Requires `cacheMutex` to be locked.
+  void Evict(int frameIndex);
+  
+  mutex cacheMutex;
+  
+  s64 budgetBytes = 0;
+  s64 cachedBytes = 0;
+  
+  struct CachedFrame {
+    /// The frame's data, or an empty view if the frame is not cached
+    XRVideoFrameView view;
+    
+    /// The rendition that the data belongs to
+    int rendition = 0;
+    
+    /// Position of the frame in cachedFrameIndices
+    int cachedFrameIndicesPosition = -1;
+  };
+  
+  /// Indexed by frame index
+  vector<CachedFrame> frames;
+  
+  /// Indices of the cached frames (unordered)
+  vector<int> cachedFrameIndices;
+};
+
+}
@@ -295,6 +295,17 @@ bool D3D11XRVideoFrame::Initialize(
     storageBufferView.reset(newView, [](ID3D11ShaderResourceView* view) { view->Release(); });
   }
   
+  // Re-create the textures if this frame is reused for a frame with a different texture size (e.g., of another rendition)
+  if (textureLuma) {
+    D3D11_TEXTURE2D_DESC textureLumaDesc;
+    textureLuma->GetDesc(&textureLumaDesc);
+    if (textureLumaDesc.Width != metadata.textureWidth || textureLumaDesc.Height != metadata.textureHeight) {
+      textureLuma.reset();
+      textureChromaU.reset();
+      textureChromaV.reset();
+    }
+  }
+  
   // Initialize textures (if not already allocated, e.g., when reusing this frame)
   if (!textureLuma || !textureChromaU || !textureChromaV) {
     if (!InitializeTextures(metadata.textureWidth, metadata.textureHeight)) {
@@ -528,6 +539,30 @@ void D3D11XRVideoFrame::Destroy() {
   device.reset();
 }
 
+void D3D11XRVideoFrame::ReleaseResources() {
+  verticesStagingBuffer.reset();
+  indicesStagingBuffer.reset();
+  
+  storageStagingBuffer.reset();
+  alphaStagingBuffer.reset();
+  
+  stagingTextureLuma.reset();
+  stagingTextureChromaU.reset();
+  stagingTextureChromaV.reset();
+  
+  if (!useExternalBuffers) {
+    vertexBuffer.reset();
+    indexBuffer.reset();
+    storageBufferView.reset();
+    storageBuffer.reset();
+    alphaBuffer.reset();
+    
+    textureLuma.reset();
+    textureChromaU.reset();
+    textureChromaV.reset();
+  }
+}
+
 void D3D11XRVideoFrame::WaitForResourceTransfers() {
   WaitForSingleObject(transferCompleteEvent, INFINITE);
   
@@ -43,6 +43,11 @@ class D3D11XRVideoFrame : public XRVideoFrame {
       bool verboseDecoding);
   void Destroy();
   
+  /// Releases the frame's buffers and textures after it got evicted from the decoded frame cache.
+  /// In contrast to Destroy(), the device remains, such that the frame can be initialized again.
+  /// External buffers (see UseExternalBuffers()) and the textures in this case remain, since their owner may still refer to them.
+  void ReleaseResources();
+  
   void WaitForResourceTransfers();
   
   /// TODO: Rendering is not implemented for the D3D11 path yet since so far, we only use that for the Unity plugin, where Unity does the rendering
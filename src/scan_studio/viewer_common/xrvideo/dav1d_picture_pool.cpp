@@ -0,0 +1,86 @@
+#include "scan_studio/viewer_common/xrvideo/dav1d_picture_pool.hpp"
+
+#include <cstdlib>
+
+#include <loguru.hpp>
+
+namespace scan_studio {
+
+/// dav1d requires the allocated picture area to have a width and height that are multiples of this
+constexpr u32 dav1dPictureSizeAlignment = 128;
+
+static inline u32 AlignPictureSize(u32 value) {
+  return ((value + dav1dPictureSizeAlignment - 1) / dav1dPictureSizeAlignment) * dav1dPictureSizeAlignment;
+}
+
+Dav1dPicturePool::Buffer::Buffer(usize size)
+    : size(size) {
+  #ifdef _WIN32
+    data = _aligned_malloc(size, DAV1D_PICTURE_ALIGNMENT);
+  #else
+    if (posix_memalign(&data, DAV1D_PICTURE_ALIGNMENT, size)) {
+      data = nullptr;
+    }
+  #endif
+}
+
+Dav1dPicturePool::Buffer::~Buffer() {
+  #ifdef _WIN32
+    _aligned_free(data);
+  #else
+    free(data);
+  #endif
+}
+
+Dav1dPicturePool::Layout::Layout(u32 width, u32 height) {
+  const u32 alignedHeight = AlignPictureSize(height);
+  
+  lumaStride = AlignPictureSize(width);
+  lumaSize = static_cast<usize>(lumaStride) * alignedHeight;
+  chromaSize = lumaSize / 4;
+  
+  bufferSize = lumaSize + 2 * chromaSize + DAV1D_PICTURE_ALIGNMENT;
+}
+
+int Dav1dPicturePool::Dav1dAllocPictureCallback(Dav1dPicture* pic) {
+  if (pic->p.layout != DAV1D_PIXEL_LAYOUT_I420 || pic->p.bpc != 8) {
+    LOG(ERROR) << "Dav1dPicturePool only supports 8-bit I420 pictures";
+    return DAV1D_ERR(EINVAL);
+  }
+  
+  const Layout layout(pic->p.w, pic->p.h);
+  
+  // All pooled buffers have the same size as long as the texture size does not change.
+  // If it did change, drop the old buffer.
+  Buffer buffer = buffers.TakeOrAllocate(layout.bufferSize);
+  if (buffer.size != layout.bufferSize) {
+    buffer = Buffer(layout.bufferSize);
+  }
+  if (buffer.data == nullptr) {
+    return DAV1D_ERR(ENOMEM);
+  }
+  
+  u8* data = static_cast<u8*>(buffer.data);
+  
+  pic->allocator_data = data;
+  
+  pic->stride[0] = layout.lumaStride;
+  pic->stride[1] = layout.lumaStride / 2;
+  
+  pic->data[0] = data;
+  pic->data[1] = data + layout.lumaSize;
+  pic->data[2] = data + layout.lumaSize + layout.chromaSize;
+  
+  buffer.Release();
+  return 0;
+}
+
+void Dav1dPicturePool::Dav1dReleasePictureCallback(Dav1dPicture* pic) {
+  buffers.PutBack(Buffer(pic->allocator_data, Layout(pic->p.w, pic->p.h).bufferSize));
+}
+
+bool Dav1dPicturePool::UsesTightLayout(u32 width, u32 height) {
+  return width % dav1dPictureSizeAlignment == 0 && height % dav1dPictureSizeAlignment == 0;
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <dav1d/dav1d.h>
+
+#include <libvis/vulkan/libvis.h>
+
+#include "scan_studio/common/cache.hpp"
+
+#include "scan_studio/viewer_common/xrvideo/video_thread.hpp"
+
+namespace scan_studio {
+using namespace vis;
+
+/// Thread-safe Dav1dZeroCopy implementation that lets dav1d decode into pooled I420 buffers,
+/// which are recycled through a Cache instead of being allocated for each picture.
+///
+/// If the picture width and height are multiples of 128 (which dav1d requires for the allocated area),
+/// the buffers use a tight stride, and the Y, U, and V planes directly follow each other. This is the same layout
+/// that XRVideoCopyTexture() outputs, so copying such a picture into a frame's texture memory is a single memcpy().
+/// A picture's buffer returns to the pool once the picture is released.
+/// For other picture sizes, the stride is padded to a multiple of 128 pixels.
+///
+/// The pool must outlive all pictures allocated from it, i.e., the VideoThread that uses it must be exited,
+/// and all pictures queued in the DecodingThread must be released, before it is destructed.
+class Dav1dPicturePool : public Dav1dZeroCopy {
+ public:
+  virtual int Dav1dAllocPictureCallback(Dav1dPicture* pic) override;
+  virtual void Dav1dReleasePictureCallback(Dav1dPicture* pic) override;
+  
+  /// Frees all currently pooled buffers, e.g., after switching to a video with a different texture size.
+  /// Buffers of pictures that are still in use get returned to the pool when the pictures are released.
+  inline void Clear() { buffers.Clear(); }
+  
+  /// Returns whether pictures of the given size are allocated with a tight stride and contiguous planes.
+  static bool UsesTightLayout(u32 width, u32 height);
+  
+ private:
+  struct Buffer {
+    Buffer(usize size);
+    
+    inline Buffer(void* data, usize size)
+        : data(data),
+          size(size) {}
+    
+    inline Buffer(Buffer&& other)
+        : data(other.data),
+          size(other.size) {
+      other.data = nullptr;
+    }
+    
+    inline Buffer& operator= (Buffer&& other) {
+      std::swap(data, other.data);
+      std::swap(size, other.size);
+      return *this;
+    }
+    
+    Buffer(const Buffer& other) = delete;
+    Buffer& operator= (const Buffer& other) = delete;
+    
+    ~Buffer();
+    
+    inline void Release() {
+      data = nullptr;
+    }
+    
+    void* data;
+    usize size;
+  };
+  
+  /// Layout of the buffer for a picture of a given size.
+  struct Layout {
+    Layout(u32 width, u32 height);
+    
+    u32 lumaStride;
+    usize lumaSize;
+    usize chromaSize;
+    
+    /// Size of the buffer, including padding.
+    usize bufferSize;
+  };
+  
+  Cache<Buffer> buffers;
+};
+
+}
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
+#include <functional>
 #include <mutex>
-#include <unordered_map>
+#include <set>
+#include <utility>
 #include <vector>
 
 #include <loguru.hpp>
@@ -11,6 +14,7 @@
 
 #include "scan_studio/viewer_common/xrvideo/index.hpp"
 #include "scan_studio/viewer_common/xrvideo/playback_state.hpp"
+#include "scan_studio/viewer_common/xrvideo/xrvideo_memory_governor.hpp"
 
 namespace scan_studio {
 using namespace vis;
@@ -52,6 +56,12 @@ struct DecodedFrameCacheItem {
   /// Invalid entries are set to -1.
   /// Only valid if HasValidData() returns true.
   int dependsOnFrameIndices[maxDependencyCount];
+  
+  /// Used by the DecodedFrameCache to flag cache items during a single pass over the cache (see DecodedFrameCache::BeginMarking()).
+  u32 mark = 0;
+  
+  /// The decoded data size that was reported to the cache's memory account for this item, or 0 if none.
+  s64 accountedBytes = 0;
 };
 
 /// Helper class returned by DecodedFrameCache's locking functions that automatically
@@ -60,7 +70,9 @@ template <typename FrameT>
 class WriteLockedCachedFrame {
  public:
   inline WriteLockedCachedFrame()
-      : cacheItem(nullptr) {}
+      : cacheItem(nullptr),
+        cacheItemIndex(-1),
+        cache(nullptr) {}
   
   ~WriteLockedCachedFrame() {
     Unlock();
@@ -115,6 +127,14 @@ class WriteLockedCachedFrame {
   /// Returns a pointer to the locked frame struct.
   inline FrameT* GetFrame() const { return &cacheItem->frame; }
   
+  /// Reports the decoded data size of the frame once it has been decoded, for the cache's memory account (if any).
+  void SetDecodedDataSize(s64 bytes) {
+    if (cacheItem != nullptr) {
+      lock_guard<mutex> lock(cache->framesMutex);
+      cache->AccountCacheItem(cacheItemIndex, bytes);
+    }
+  }
+  
  private:
   DecodedFrameCacheItem<FrameT>* cacheItem;  // not owned
   int cacheItemIndex;
@@ -127,7 +147,9 @@ template <typename FrameT>
 class ReadLockedCachedFrame {
  public:
   inline ReadLockedCachedFrame()
-      : cacheItem(nullptr) {}
+      : cacheItem(nullptr),
+        cacheItemIndex(-1),
+        cache(nullptr) {}
   
   ~ReadLockedCachedFrame() {
     Unlock();
@@ -202,13 +224,56 @@ class DecodedFrameCache {
  public:
   /// Creates a decoded frame cache that can store the given number of frames.
   bool Initialize(int capacity) {
+    lock_guard<mutex> lock(framesMutex);
+    
+    // The sizes of the previous frames are not accounted anymore, since their cache items may get removed
+    for (int cacheItemIndex = 0, size = cache.size(); cacheItemIndex < size; ++ cacheItemIndex) {
+      AccountCacheItem(cacheItemIndex, 0);
+    }
+    
     cache.resize(capacity);
+    
+    // Rebuild the lookup structures for the remaining cache items
+    frameIndexToCacheItemIndex.clear();
+    cachedFrameIndices.clear();
+    emptyCacheItemIndices.clear();
+    evictedCacheItemIndices.clear();
+    for (int cacheItemIndex = 0; cacheItemIndex < capacity; ++ cacheItemIndex) {
+      const int frameIndex = cache[cacheItemIndex].frameIndex;
+      if (frameIndex >= 0 && CacheItemIndexOfFrame(frameIndex) < 0) {
+        SetCacheItemIndexOfFrame(frameIndex, cacheItemIndex);
+        cachedFrameIndices.insert(frameIndex);
+      } else {
+        cache[cacheItemIndex].frameIndex = -1;
+        emptyCacheItemIndices.insert(cacheItemIndex);
+      }
+    }
+    
     return true;
   }
   
   void Destroy() {
+    SetMemoryAccount(nullptr);
     cache = vector<DecodedFrameCacheItem<FrameT>>();
-    frameIndexToCacheItemIndex = unordered_map<int, int>();
+    frameIndexToCacheItemIndex = vector<int>();
+    cachedFrameIndices.clear();
+    emptyCacheItemIndices.clear();
+    evictedCacheItemIndices.clear();
+  }
+  
+  /// Sets the account at which the cache reports the sizes of its decoded frames, and which limits the number of cache items that may hold frames
+  /// (see XRVideoMemoryGovernor), or nullptr (the default) to use all cache items. The account must remain valid while it is set.
+  void SetMemoryAccount(XRVideoMemoryAccount* account) {
+    lock_guard<mutex> lock(framesMutex);
+    
+    for (auto& cacheItem : cache) {
+      if (cacheItem.accountedBytes > 0) {
+        if (memoryAccount) { memoryAccount->RemoveCachedFrame(cacheItem.accountedBytes); }
+        if (account) { account->AddCachedFrame(cacheItem.accountedBytes); }
+      }
+    }
+    
+    memoryAccount = account;
   }
   
   /// Invalidates all cache items. This is useful when switching playback to another video:
@@ -249,6 +314,20 @@ class DecodedFrameCache {
     LOG(1) << "-- cache health end  --";
   }
   
+  /// For debugging and tests, returns the indices of all cached frames in the order in which they get evicted
+  /// for the given playback state (see VisitCachedFramesInEvictionOrder()).
+  vector<int> GetCachedFramesInEvictionOrder(const NextFramesIterator& nextPlayedFramesIt, const FrameIndex& index) {
+    lock_guard<mutex> lock(framesMutex);
+    
+    vector<int> frameIndices;
+    frameIndices.reserve(cachedFrameIndices.size());
+    VisitCachedFramesInEvictionOrder(nextPlayedFramesIt, index, [&](int frameIndex) {
+      frameIndices.push_back(frameIndex);
+      return true;
+    });
+    return frameIndices;
+  }
+  
   /// High-level: Finds and locks cache item(s) to decode the next frame required for playback.
   ///
   /// In detail:
@@ -272,6 +351,12 @@ class DecodedFrameCache {
   /// * Not locked
   /// * Expected to be shown last, given the current playback state
   /// If sufficient such cache items exist, locks and returns them.
+  ///
+  /// In addition, if the next played frames after that frame precede it within its group of pictures
+  /// (as for backward playback), these frames get decoded on the way to it anyway. Thus, the function
+  /// also returns cache items for as many of them as there are suitable free cache items for, such that
+  /// a group of pictures gets decoded only once and then played back in reverse.
+  ///
   /// GetFrameIndex() should be called on the returned locked cache items to know which frames to
   /// decode into them. The locked cache items are always returned in order of increasing frame index,
   /// and it always holds that all returned frame indices have the same base keyframe.
@@ -286,11 +371,27 @@ class DecodedFrameCache {
     NextFramesIterator it = nextPlayedFramesIt;
     
     int requiredFrameCount = 0;
-    vector<u8> cacheItemIsRequired(cache.size(), 0);
     
     // Lock as late as possible
     lock_guard<mutex> lock(framesMutex);
     
+    // Apply the slot limit of the memory account, evicting frames if it was lowered
+    const int slotLimit = GetSlotLimit();
+    if (static_cast<int>(cachedFrameIndices.size()) > slotLimit) {
+      EvictFramesAboveSlotLimit(nextPlayedFramesIt, index, slotLimit);
+    }
+    
+    // If all frames of the video are cached, there is nothing to decode.
+    // (Since the cached frame indices are unique, this is the case if there are as many of them as frames, and all of them are within the video.)
+    if (!cachedFrameIndices.empty() &&
+        static_cast<int>(cachedFrameIndices.size()) >= index.GetFrameCount() &&
+        *cachedFrameIndices.rbegin() < index.GetFrameCount()) {
+      return {};
+    }
+    
+    // Cache items that are required for the next played frames get marked with requiredMark
+    const u32 requiredMark = BeginMarking();
+    
     // Loop over the next frames, flagging the required cached frames
     while (!it.AtEnd()) {
       const int nextFrameIndex = *it;
@@ -306,8 +407,8 @@ class DecodedFrameCache {
       //
       // We do check for multiple 'required' counting for frame dependencies, since it
       // is a standard case that many dependent frames depend on the same keyframe.
-      auto nextFrameIt = frameIndexToCacheItemIndex.find(nextFrameIndex);
-      if (nextFrameIt == frameIndexToCacheItemIndex.end()) {
+      const int cacheIndex = CacheItemIndexOfFrame(nextFrameIndex);
+      if (cacheIndex < 0) {
         // The frame with index `nextFrameIndex` is missing. Aim to decode it.
         frameIndexToDecode = nextFrameIndex;
         break;
@@ -315,11 +416,9 @@ class DecodedFrameCache {
       
       // The frame with index `nextFrameIndex` is already in the cache.
       // Mark this cache item and its dependencies as required.
-      const int cacheIndex = nextFrameIt->second;
-      
-      // (Note that we are on purpose not checking if cacheItemIsRequired is already set here, see the comment above.)
+      // (Note that we are on purpose not checking if the cache item is already marked here, see the comment above.)
       ++ requiredFrameCount;
-      cacheItemIsRequired[cacheIndex] = 1;
+      cache[cacheIndex].mark = requiredMark;
       
       // Check for the dependencies of the frame.
       // If they are in the cache, mark them as required as well.
@@ -327,14 +426,13 @@ class DecodedFrameCache {
       for (int i = 0; i < DecodedFrameCacheItem<FrameT>::maxDependencyCount; ++ i) {
         const int dependencyFrameIndex = cache[cacheIndex].dependsOnFrameIndices[i];
         if (dependencyFrameIndex >= 0) {
-          auto dependencyFrameIt = frameIndexToCacheItemIndex.find(dependencyFrameIndex);
+          const int dependencyCacheIndex = CacheItemIndexOfFrame(dependencyFrameIndex);
           
-          if (dependencyFrameIt != frameIndexToCacheItemIndex.end()) {
+          if (dependencyCacheIndex >= 0) {
             // The dependency is cached.
-            const int dependencyCacheIndex = dependencyFrameIt->second;
-            if (!cacheItemIsRequired[dependencyCacheIndex]) {
+            if (cache[dependencyCacheIndex].mark != requiredMark) {
               ++ requiredFrameCount;
-              cacheItemIsRequired[dependencyCacheIndex] = 1;
+              cache[dependencyCacheIndex].mark = requiredMark;
             }
           } else {
             // The dependency is missing.
@@ -349,8 +447,8 @@ class DecodedFrameCache {
         break;
       }
       
-      if (requiredFrameCount >= cache.size()) {
-        // All frames in the cache are flagged as required.
+      if (requiredFrameCount >= slotLimit) {
+        // All frames in the cache (or as many as the slot limit allows) are flagged as required.
         return {};
       }
       
@@ -377,28 +475,41 @@ class DecodedFrameCache {
     // Try to obtain a cache item for each frame that needs to be decoded.
     // TODO: We don't need to stop entirely if we find cache space for some, but not all frames.
     //       We could already start decoding them partially (in the right order: with increasing frame index, starting from the keyframe).
-    auto findGoodFreeCacheItem = [&]() {
-      int longestDurationTillFrame = numeric_limits<int>::min();
+    // Empty cache items are preferred, but may only be used as long as the number of cached frames stays within the slot limit.
+    // Otherwise, the unlocked, non-required cached frame that will be played back last is chosen, which is the first
+    // such frame in eviction order (this usually only needs to skip the few locked frames).
+    int usedEmptyCacheItemCount = 0;
+    auto findGoodFreeCacheItem = [&](int* durationTillSelectedFrame = nullptr) {
       int selectedCacheIndex = -1;
       
-      for (int cacheIndex = 0, size = cache.size(); cacheIndex < size; ++ cacheIndex) {
-        DecodedFrameCacheItem<FrameT>& cacheItem = cache[cacheIndex];
-        
-        if (!cacheItemIsRequired[cacheIndex] && !cacheItem.IsWriteOrReadLocked()) {
-          // This cache item is available. Compute the duration from the current playback frame
-          // to this frame (measured in frames).
-          const int durationTillFrame =
-              cacheItem.HasValidData() ?
-              nextPlayedFramesIt.ComputeDurationToFrame(cacheItem.frameIndex) :
-              numeric_limits<int>::max();
-          
-          if (durationTillFrame > longestDurationTillFrame) {
-            longestDurationTillFrame = durationTillFrame;
+      if (static_cast<int>(cachedFrameIndices.size()) + usedEmptyCacheItemCount < slotLimit) {
+        for (int cacheIndex : emptyCacheItemIndices) {
+          if (!cache[cacheIndex].IsWriteOrReadLocked()) {
             selectedCacheIndex = cacheIndex;
+            break;
           }
         }
       }
       
+      if (selectedCacheIndex >= 0) {
+        ++ usedEmptyCacheItemCount;
+        if (durationTillSelectedFrame) { *durationTillSelectedFrame = numeric_limits<int>::max(); }
+        return selectedCacheIndex;
+      }
+      
+      VisitCachedFramesInEvictionOrder(nextPlayedFramesIt, index, [&](int frameIndex) {
+        const int cacheIndex = CacheItemIndexOfFrame(frameIndex);
+        const DecodedFrameCacheItem<FrameT>& cacheItem = cache[cacheIndex];
+        if (cacheItem.mark == requiredMark || cacheItem.IsWriteOrReadLocked()) {
+          return true;
+        }
+        selectedCacheIndex = cacheIndex;
+        return false;
+      });
+      
+      if (durationTillSelectedFrame) {
+        *durationTillSelectedFrame = (selectedCacheIndex >= 0) ? nextPlayedFramesIt.ComputeDurationToFrame(cache[selectedCacheIndex].frameIndex) : numeric_limits<int>::min();
+      }
       return selectedCacheIndex;
     };
     
@@ -432,7 +543,41 @@ class DecodedFrameCache {
         if (predecessorIfNeeded >= 0) { cache[predecessorCacheItem].isWriteLocked = false; }
         return {};
       }
-      // cache[frameToDecodeCacheItem].isWriteLocked = true;  // no need for this, since we do not do further searches below
+      cache[frameToDecodeCacheItem].isWriteLocked = true;  // exclude this item from the searches below
+    }
+    
+    // With backward playback, the next played frames after frameIndexToDecode are its preceding frames, which have to be decoded
+    // anyway to reach frameIndexToDecode (starting from the base keyframe). Instead of discarding them and later decoding the whole chain
+    // again for each of them, also decode those of them into the cache that come up within the cache's size in playback order.
+    // This only takes cache items whose frames will be played back later than the respective frame (or not at all),
+    // so it never evicts frames that are needed sooner. This is a no-op for forward playback.
+    vector<pair<int, int>> precedingFrames;  // pairs of (frame index, cache item index)
+    if (baseKeyframe >= 0) {
+      NextFramesIterator precedingIt = it;
+      ++ precedingIt;
+      
+      for (int i = 1, size = cache.size(); i < size && !precedingIt.AtEnd(); ++ i, ++ precedingIt) {
+        const int precedingFrameIndex = *precedingIt;
+        if (precedingFrameIndex <= baseKeyframe ||
+            precedingFrameIndex >= frameIndexToDecode ||
+            precedingFrameIndex == predecessorIfNeeded ||
+            FrameIsCached(precedingFrameIndex) ||
+            find_if(precedingFrames.begin(), precedingFrames.end(), [&](const pair<int, int>& item) { return item.first == precedingFrameIndex; }) != precedingFrames.end()) {
+          continue;
+        }
+        
+        int durationTillSelectedFrame;
+        const int precedingFrameCacheItem = findGoodFreeCacheItem(&durationTillSelectedFrame);
+        if (precedingFrameCacheItem < 0 ||
+            durationTillSelectedFrame <= nextPlayedFramesIt.ComputeDurationToFrame(precedingFrameIndex)) {
+          break;
+        }
+        
+        cache[precedingFrameCacheItem].isWriteLocked = true;  // exclude this item from the searches below
+        precedingFrames.emplace_back(precedingFrameIndex, precedingFrameCacheItem);
+      }
+      
+      sort(precedingFrames.begin(), precedingFrames.end());
     }
     
     // We succeeded in getting enough cache items.
@@ -453,12 +598,22 @@ class DecodedFrameCache {
       ConfigureCacheItem(frameToDecodeCacheItem, frameIndexToDecode, frameToDecodeDependencyCount, frameToDecodeDependencies);
     }
     
-    // Return the locked frames
+    for (const pair<int, int>& precedingFrame : precedingFrames) {
+      // Like for the predecessor above
+      const int precedingFrameDependencies[2] = {baseKeyframe, (precedingFrame.first - 1 != baseKeyframe) ? (precedingFrame.first - 1) : -1};
+      const int precedingFrameDependencyCount = 1 + (precedingFrame.first - 1 != baseKeyframe);
+      ConfigureCacheItem(precedingFrame.second, precedingFrame.first, precedingFrameDependencyCount, precedingFrameDependencies);
+    }
+    
+    // Return the locked frames (in order of increasing frame index, where all preceding frames lie between the base keyframe and the predecessor)
     vector<WriteLockedCachedFrame<FrameT>> lockedFrames;
-    lockedFrames.reserve(3);
+    lockedFrames.reserve(3 + precedingFrames.size());
     if (baseKeyframeIfNeeded >= 0) {
       lockedFrames.emplace_back(&cache[baseKeyframeCacheItem], baseKeyframeCacheItem, this);
     }
+    for (const pair<int, int>& precedingFrame : precedingFrames) {
+      lockedFrames.emplace_back(&cache[precedingFrame.second], precedingFrame.second, this);
+    }
     if (predecessorIfNeeded >= 0) {
       lockedFrames.emplace_back(&cache[predecessorCacheItem], predecessorCacheItem, this);
     }
@@ -468,6 +623,27 @@ class DecodedFrameCache {
     return lockedFrames;
   }
   
+  /// Locks and returns the empty cache items whose frames got evicted to apply the slot limit of the memory account
+  /// (see SetMemoryAccount()), such that the caller can release the resources of these frames. Otherwise, evicted cache items
+  /// would keep their frames' buffers allocated until another frame gets decoded into them, so lowering the slot limit would not free memory.
+  /// Each evicted cache item is returned once, unless it gets reused before (or is locked while) this function is called.
+  vector<WriteLockedCachedFrame<FrameT>> LockEvictedCacheItems() {
+    lock_guard<mutex> lock(framesMutex);
+    
+    vector<WriteLockedCachedFrame<FrameT>> lockedFrames;
+    for (auto it = evictedCacheItemIndices.begin(); it != evictedCacheItemIndices.end(); ) {
+      const int cacheItemIndex = *it;
+      if (cache[cacheItemIndex].IsWriteOrReadLocked()) {
+        ++ it;
+        continue;
+      }
+      
+      lockedFrames.emplace_back(&cache[cacheItemIndex], cacheItemIndex, this);
+      it = evictedCacheItemIndices.erase(it);
+    }
+    return lockedFrames;
+  }
+  
   /// Tries to lock and return the cache items for the given frames (in the same order as passed in).
   /// If at least one of the frames is not in the cache or is write-locked, returns an empty vector.
   vector<ReadLockedCachedFrame<FrameT>> LockFramesForReading(const vector<int>& frameIndices) {
@@ -475,12 +651,12 @@ class DecodedFrameCache {
     
     vector<int> cacheItemIndices(frameIndices.size());
     for (int i = 0, size = frameIndices.size(); i < size; ++ i) {
-      auto it = frameIndexToCacheItemIndex.find(frameIndices[i]);
-      if (it == frameIndexToCacheItemIndex.end() ||
-          cache[it->second].isWriteLocked) {
+      const int cacheItemIndex = CacheItemIndexOfFrame(frameIndices[i]);
+      if (cacheItemIndex < 0 ||
+          cache[cacheItemIndex].isWriteLocked) {
         return {};
       }
-      cacheItemIndices[i] = it->second;
+      cacheItemIndices[i] = cacheItemIndex;
     }
     
     vector<ReadLockedCachedFrame<FrameT>> lockedFrames;
@@ -504,6 +680,26 @@ class DecodedFrameCache {
     }
   }
   
+  /// Returns the lowest index of a frame in [firstFrameIndex, lastFrameIndex] that is cached (or locked for decoding into the cache),
+  /// ignoring the cache items of the given locked frames, or -1 if there is no such frame.
+  int FindCachedFrameInRange(int firstFrameIndex, int lastFrameIndex, const vector<WriteLockedCachedFrame<FrameT>>& ignoredFrames) {
+    lock_guard<mutex> lock(framesMutex);
+    
+    for (auto it = cachedFrameIndices.lower_bound(firstFrameIndex); it != cachedFrameIndices.end() && *it <= lastFrameIndex; ++ it) {
+      const int cacheItemIndex = CacheItemIndexOfFrame(*it);
+      
+      bool ignored = false;
+      for (const WriteLockedCachedFrame<FrameT>& ignoredFrame : ignoredFrames) {
+        if (ignoredFrame.GetCacheItemIndex() == cacheItemIndex) { ignored = true; break; }
+      }
+      if (!ignored) {
+        return *it;
+      }
+    }
+    
+    return -1;
+  }
+  
   /// Checks the current decoding progress: Counts how many frames could be displayed,
   /// starting from the given frames iterator position, with the currently cached data.
   /// Also determines the time range of these frames, returned in readyFramesStartTime
@@ -522,11 +718,12 @@ class DecodedFrameCache {
     
     NextFramesIterator it = nextPlayedFramesIt;
     
-    vector<u8> cacheItemIsRequired(cache.size(), 0);
-    
     // Lock as late as possible
     lock_guard<mutex> lock(framesMutex);
     
+    // Cache items that were counted in requiredFramesCount get marked with requiredMark
+    const u32 requiredMark = BeginMarking();
+    
     // Loop over the next frames
     while (!it.AtEnd()) {
       const int nextFrameIndex = *it;
@@ -534,28 +731,28 @@ class DecodedFrameCache {
       // Search for nextFrameIndex and the frames it depends on in the cache.
       bool frameIsInCacheAndReady = true;
       
-      auto nextFrameIt = frameIndexToCacheItemIndex.find(nextFrameIndex);
-      if (nextFrameIt == frameIndexToCacheItemIndex.end() ||
-          cache[nextFrameIt->second].isWriteLocked) {
+      const int nextFrameCacheIndex = CacheItemIndexOfFrame(nextFrameIndex);
+      if (nextFrameCacheIndex < 0 ||
+          cache[nextFrameCacheIndex].isWriteLocked) {
         break;
       }
-      if (!cacheItemIsRequired[nextFrameIt->second]) {
+      if (cache[nextFrameCacheIndex].mark != requiredMark) {
         ++ *requiredFramesCount;
-        cacheItemIsRequired[nextFrameIt->second] = 1;
+        cache[nextFrameCacheIndex].mark = requiredMark;
       }
       
       for (int i = 0; i < DecodedFrameCacheItem<FrameT>::maxDependencyCount; ++ i) {
-        const int dependencyFrameIndex = cache[nextFrameIt->second].dependsOnFrameIndices[i];
+        const int dependencyFrameIndex = cache[nextFrameCacheIndex].dependsOnFrameIndices[i];
         if (dependencyFrameIndex >= 0) {
-          auto dependencyFrameIt = frameIndexToCacheItemIndex.find(dependencyFrameIndex);
-          if (dependencyFrameIt == frameIndexToCacheItemIndex.end() ||
-              cache[dependencyFrameIt->second].isWriteLocked) {
+          const int dependencyCacheIndex = CacheItemIndexOfFrame(dependencyFrameIndex);
+          if (dependencyCacheIndex < 0 ||
+              cache[dependencyCacheIndex].isWriteLocked) {
             frameIsInCacheAndReady = false;
             break;
           }
-          if (!cacheItemIsRequired[dependencyFrameIt->second]) {
+          if (cache[dependencyCacheIndex].mark != requiredMark) {
             ++ *requiredFramesCount;
-            cacheItemIsRequired[dependencyFrameIt->second] = 1;
+            cache[dependencyCacheIndex].mark = requiredMark;
           }
         }
       }
@@ -565,7 +762,7 @@ class DecodedFrameCache {
       }
       
       // The frame with nextFrameIndex is in the cache and ready (i.e., not write-locked).
-      DecodedFrameCacheItem<FrameT>& nextFrameItem = cache[nextFrameIt->second];
+      DecodedFrameCacheItem<FrameT>& nextFrameItem = cache[nextFrameCacheIndex];
       
       ++ *readyFramesCount;
       *readyFramesStartTime = min(*readyFramesStartTime, nextFrameItem.frame.GetMetadata().startTimestamp);
@@ -586,6 +783,20 @@ class DecodedFrameCache {
     return cache.size();
   }
   
+  /// Returns the number of decoded frames that the cache currently may hold, which is limited
+  /// by the slot limit of the memory account (if set, see SetMemoryAccount()).
+  inline int GetSlotLimit() const {
+    const int capacity = cache.size();
+    return memoryAccount ? std::min(capacity, memoryAccount->GetSlotLimit()) : capacity;
+  }
+  
+  /// Sets a function that gets called whenever the last read lock of a cache item is released,
+  /// since this may allow to decode another frame into it. The function is called without framesMutex being locked.
+  /// Must be set before any read locks are taken.
+  inline void SetReadLocksReleasedCallback(const std::function<void()>& callback) {
+    readLocksReleasedCallback = callback;
+  }
+  
   /// Manually locks the frame cache (which allows copy-constructing read locks).
   inline void Lock() { framesMutex.lock(); }
   
@@ -599,8 +810,13 @@ class DecodedFrameCache {
   }
   
   void ReleaseReadLock(int cacheItemIndex) {
-    lock_guard<mutex> lock(framesMutex);
-    -- cache[cacheItemIndex].readLockCount;
+    framesMutex.lock();
+    const bool lastReadLockReleased = (-- cache[cacheItemIndex].readLockCount == 0);
+    framesMutex.unlock();
+    
+    if (lastReadLockReleased && readLocksReleasedCallback) {
+      readLocksReleasedCallback();
+    }
   }
   
   /// Calling this function requires framesMutex to be locked.
@@ -608,10 +824,149 @@ class DecodedFrameCache {
     if (framesMutex.try_lock()) { LOG(ERROR) << "framesMutex was not locked in call to InvalidateCacheItem()"; }
     auto& cacheItem = cache[cacheItemIndex];
     
-    if (cacheItem.frameIndex >= 0) {
-      frameIndexToCacheItemIndex.erase(cacheItem.frameIndex);
+    if (cacheItem.frameIndex >= 0 && CacheItemIndexOfFrame(cacheItem.frameIndex) == cacheItemIndex) {
+      frameIndexToCacheItemIndex[cacheItem.frameIndex] = -1;
+      cachedFrameIndices.erase(cacheItem.frameIndex);
     }
     cacheItem.frameIndex = -1;
+    emptyCacheItemIndices.insert(cacheItemIndex);
+    
+    AccountCacheItem(cacheItemIndex, 0);
+  }
+  
+  /// Sets the decoded data size of the given cache item that is reported to the memory account.
+  /// Calling this function requires framesMutex to be locked.
+  void AccountCacheItem(int cacheItemIndex, s64 bytes) {
+    auto& cacheItem = cache[cacheItemIndex];
+    
+    if (memoryAccount) {
+      if (cacheItem.accountedBytes > 0) { memoryAccount->RemoveCachedFrame(cacheItem.accountedBytes); }
+      if (bytes > 0) { memoryAccount->AddCachedFrame(bytes); }
+    }
+    cacheItem.accountedBytes = bytes;
+  }
+  
+  /// Invalidates unlocked cached frames until at most slotLimit frames remain cached (or no further frame may be evicted).
+  /// The frames that will be played back next (as many as fit within the slot limit) and the frames that they depend on are kept,
+  /// and among the others, the frames that will be played back last are evicted first.
+  /// Calling this function requires framesMutex to be locked.
+  void EvictFramesAboveSlotLimit(const NextFramesIterator& nextPlayedFramesIt, const FrameIndex& index, int slotLimit) {
+    // Mark the next played frames with their dependencies, as long as they are cached
+    const u32 keptMark = BeginMarking();
+    int keptFrameCount = 0;
+    
+    auto keepFrame = [&](int frameIndex) {
+      const int cacheIndex = CacheItemIndexOfFrame(frameIndex);
+      if (cacheIndex < 0) {
+        return false;
+      }
+      if (cache[cacheIndex].mark != keptMark) {
+        cache[cacheIndex].mark = keptMark;
+        ++ keptFrameCount;
+      }
+      return true;
+    };
+    
+    NextFramesIterator it = nextPlayedFramesIt;
+    for (int i = 0, size = cache.size(); i < size && !it.AtEnd() && keptFrameCount < slotLimit; ++ i, ++ it) {
+      const int frameIndex = *it;
+      
+      const int cacheIndex = CacheItemIndexOfFrame(frameIndex);
+      if (cacheIndex < 0) {
+        break;
+      }
+      
+      // Only keep the frame if all of its dependencies are cached as well, since it cannot be displayed otherwise
+      const auto& cacheItem = cache[cacheIndex];
+      bool dependenciesAreCached = true;
+      for (int d = 0; d < DecodedFrameCacheItem<FrameT>::maxDependencyCount; ++ d) {
+        const int dependencyFrameIndex = cacheItem.dependsOnFrameIndices[d];
+        dependenciesAreCached = dependenciesAreCached && (dependencyFrameIndex < 0 || FrameIsCached(dependencyFrameIndex));
+      }
+      if (!dependenciesAreCached) {
+        break;
+      }
+      
+      keepFrame(frameIndex);
+      for (int d = 0; d < DecodedFrameCacheItem<FrameT>::maxDependencyCount; ++ d) {
+        if (cacheItem.dependsOnFrameIndices[d] >= 0) { keepFrame(cacheItem.dependsOnFrameIndices[d]); }
+      }
+    }
+    
+    // Evict the other unlocked frames, starting with those that will be played back last.
+    // (The candidates are collected first, since evicting frames while visiting them would modify cachedFrameIndices.)
+    const int excessFrameCount = static_cast<int>(cachedFrameIndices.size()) - slotLimit;
+    vector<int> evictedCacheIndices;
+    evictedCacheIndices.reserve(excessFrameCount);
+    
+    VisitCachedFramesInEvictionOrder(nextPlayedFramesIt, index, [&](int frameIndex) {
+      const int cacheIndex = CacheItemIndexOfFrame(frameIndex);
+      const auto& cacheItem = cache[cacheIndex];
+      if (cacheItem.mark != keptMark && !cacheItem.IsWriteOrReadLocked()) {
+        evictedCacheIndices.push_back(cacheIndex);
+      }
+      return static_cast<int>(evictedCacheIndices.size()) < excessFrameCount;
+    });
+    
+    for (int cacheIndex : evictedCacheIndices) {
+      InvalidateCacheItem(cacheIndex);
+      evictedCacheItemIndices.insert(cacheIndex);
+    }
+  }
+  
+  /// Calls visit(frameIndex) for the cached frames in order of decreasing duration until they will be played back
+  /// (see NextFramesIterator::ComputeDurationToFrame()), i.e., the frame that should be evicted first is visited first.
+  /// Stops once visit() returns false. visit() must not change which frames are cached.
+  ///
+  /// Since the duration until a frame gets played back only depends on its position relative to the current frame,
+  /// this order follows from cachedFrameIndices (which is ordered by frame index) without computing and sorting the durations:
+  /// Frames that are not part of the video (anymore) come first, followed by the frames behind the current frame in playback direction
+  /// (which are only played back again after looping or reversing, if at all), followed by the frames ahead, farthest first.
+  /// Thus, the order moves along with the playback position without having to be updated, and visiting the first
+  /// evictable frame only needs to skip the frames that may not be evicted.
+  /// Calling this function requires framesMutex to be locked.
+  template <typename VisitorT>
+  void VisitCachedFramesInEvictionOrder(const NextFramesIterator& nextPlayedFramesIt, const FrameIndex& index, VisitorT visit) {
+    typedef set<int>::const_iterator SetIterator;
+    
+    auto visitRange = [&](SetIterator begin, SetIterator end, bool reverse) {
+      if (reverse) {
+        for (SetIterator it = end; it != begin; ) {
+          -- it;
+          if (!visit(*it)) { return false; }
+        }
+      } else {
+        for (SetIterator it = begin; it != end; ++ it) {
+          if (!visit(*it)) { return false; }
+        }
+      }
+      return true;
+    };
+    
+    const SetIterator videoFramesEnd = cachedFrameIndices.lower_bound(index.GetFrameCount());
+    if (!visitRange(videoFramesEnd, cachedFrameIndices.cend(), /*reverse*/ false)) {
+      return;
+    }
+    
+    const int currentFrame = *nextPlayedFramesIt;
+    const bool forward = nextPlayedFramesIt.PlayingForward();
+    
+    // The frames ahead include the current frame
+    const SetIterator aheadBegin = forward ? cachedFrameIndices.lower_bound(currentFrame) : cachedFrameIndices.cbegin();
+    const SetIterator aheadEnd = forward ? videoFramesEnd : cachedFrameIndices.upper_bound(currentFrame);
+    const SetIterator behindBegin = forward ? cachedFrameIndices.cbegin() : aheadEnd;
+    const SetIterator behindEnd = forward ? aheadBegin : videoFramesEnd;
+    
+    if (behindBegin != behindEnd) {
+      // Depending on the playback mode, the frames behind are played back again starting from one of their ends (or not at all)
+      const int firstBehindDuration = nextPlayedFramesIt.ComputeDurationToFrame(*behindBegin);
+      const int lastBehindDuration = nextPlayedFramesIt.ComputeDurationToFrame(*prev(behindEnd));
+      if (!visitRange(behindBegin, behindEnd, /*reverse*/ lastBehindDuration > firstBehindDuration)) {
+        return;
+      }
+    }
+    
+    visitRange(aheadBegin, aheadEnd, /*reverse*/ forward);
   }
   
   /// Calling this function requires framesMutex to be locked.
@@ -622,7 +977,10 @@ class DecodedFrameCache {
     InvalidateCacheItem(cacheItemIndex);
     
     cacheItem.frameIndex = frameIndex;
-    frameIndexToCacheItemIndex[frameIndex] = cacheItemIndex;
+    SetCacheItemIndexOfFrame(frameIndex, cacheItemIndex);
+    cachedFrameIndices.insert(frameIndex);
+    emptyCacheItemIndices.erase(cacheItemIndex);
+    evictedCacheItemIndices.erase(cacheItemIndex);
     
     if (dependencyCount > 0) {
       memcpy(cacheItem.dependsOnFrameIndices, dependencyFrameIndices, dependencyCount * sizeof(int));
@@ -635,7 +993,36 @@ class DecodedFrameCache {
   /// Calling this function requires framesMutex to be locked.
   bool FrameIsCached(int frameIndex) {
     if (framesMutex.try_lock()) { LOG(ERROR) << "framesMutex was not locked in call to FrameIsCached()"; }
-    return frameIndexToCacheItemIndex.find(frameIndex) != frameIndexToCacheItemIndex.end();
+    return CacheItemIndexOfFrame(frameIndex) >= 0;
+  }
+  
+  /// Returns the index of the cache item that holds the given frame, or -1 if the frame is not cached.
+  /// Calling this function requires framesMutex to be locked.
+  inline int CacheItemIndexOfFrame(int frameIndex) const {
+    return (frameIndex >= 0 && frameIndex < static_cast<int>(frameIndexToCacheItemIndex.size())) ? frameIndexToCacheItemIndex[frameIndex] : -1;
+  }
+  
+  /// Calling this function requires framesMutex to be locked.
+  void SetCacheItemIndexOfFrame(int frameIndex, int cacheItemIndex) {
+    if (frameIndex >= static_cast<int>(frameIndexToCacheItemIndex.size())) {
+      frameIndexToCacheItemIndex.resize(frameIndex + 1, -1);
+    }
+    frameIndexToCacheItemIndex[frameIndex] = cacheItemIndex;
+  }
+  
+  /// Returns a mark value that no cache item is marked with yet. This allows to flag cache items in a pass over the cache by
+  /// setting their `mark` to this value, without having to clear the flags of the previous pass.
+  /// Calling this function requires framesMutex to be locked.
+  u32 BeginMarking() {
+    ++ markGeneration;
+    if (markGeneration == 0) {
+      // The mark values wrapped around. Clear all marks to prevent confusing old marks with new ones.
+      for (auto& cacheItem : cache) {
+        cacheItem.mark = 0;
+      }
+      markGeneration = 1;
+    }
+    return markGeneration;
   }
   
   mutex framesMutex;
@@ -645,9 +1032,29 @@ class DecodedFrameCache {
   /// (i.e., cache.size() may be called without locking framesMutex).
   vector<DecodedFrameCacheItem<FrameT>> cache;
   
-  /// A map from frame index to cache item index to speed up checking whether
-  /// a certain frame is in the cache.
-  unordered_map<int, int> frameIndexToCacheItemIndex;
+  /// A map from frame index to cache item index (or -1 for frames that are not cached)
+  /// to speed up checking whether a certain frame is in the cache. Since frame indices are dense,
+  /// this is a vector, which grows on demand (see SetCacheItemIndexOfFrame()).
+  vector<int> frameIndexToCacheItemIndex;
+  
+  /// The indices of the cached frames in increasing order, which determines the order in which
+  /// they get evicted (see VisitCachedFramesInEvictionOrder()).
+  set<int> cachedFrameIndices;
+  
+  /// The indices of the cache items that do not hold a frame.
+  set<int> emptyCacheItemIndices;
+  
+  /// The indices of the empty cache items whose frames got evicted to apply the slot limit,
+  /// and whose frame resources were not released yet (see LockEvictedCacheItems()).
+  set<int> evictedCacheItemIndices;
+  
+  /// The last value returned by BeginMarking().
+  u32 markGeneration = 0;
+  
+  std::function<void()> readLocksReleasedCallback;
+  
+  /// Memory account (not owned), see SetMemoryAccount(). Protected by framesMutex.
+  XRVideoMemoryAccount* memoryAccount = nullptr;
 };
 
 }
@@ -12,6 +12,7 @@
 
 #include <libvis/vulkan/libvis.h>
 
+#include "scan_studio/common/slot_queue.hpp"
 #include "scan_studio/common/xrvideo_file.hpp"
 
 #include "scan_studio/viewer_common/timing.hpp"
@@ -22,6 +23,7 @@
 #include "scan_studio/viewer_common/xrvideo/decoded_frame_cache.hpp"
 #include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
 #include "scan_studio/viewer_common/xrvideo/transfer_thread.hpp"
+#include "scan_studio/viewer_common/xrvideo/xrvideo_executor.hpp"
 
 namespace scan_studio {
 using namespace vis;
@@ -69,8 +71,7 @@ class TextureFramePromise {
     this->picture = std::move(picture);
     status = Status::Fulfilled;
     
-    lock.unlock();
-    
+    // Notify while still holding the lock: The waiting thread owns the promise and may destruct it as soon as Wait() returns.
     fulfilledOrAbortedCondition.notify_all();
   }
   
@@ -86,8 +87,6 @@ class TextureFramePromise {
     this->rgbData = std::move(rgbData);
     status = Status::Fulfilled;
     
-    lock.unlock();
-    
     fulfilledOrAbortedCondition.notify_all();
   }
   
@@ -102,8 +101,6 @@ class TextureFramePromise {
     
     status = Status::Aborted;
     
-    lock.unlock();
-    
     fulfilledOrAbortedCondition.notify_all();
   }
   
@@ -148,6 +145,19 @@ class TextureFramePromise {
   vector<u8> rgbData;
 };
 
+/// Decodes the frames queued by the reading thread into their cache items, matching each frame with its texture frame
+/// (which the VideoThread delivers in frame order), and hands the decoded frames to the TransferThread in frame order.
+///
+/// The thread may use a pool of multiple workers (see SetWorkerCount()). Only the AV1 texture decoding of a video
+/// is inherently sequential, and this happens in the VideoThread. The remaining decoding work of a frame
+/// (mesh and deformation state decompression) does not depend on the previous frames, so the workers take
+/// consecutive frames from the work queue and decode them concurrently.
+///
+/// Alternatively, the thread may run its work as tasks on an XRVideoExecutor that is shared with other videos (see SetExecutor()).
+/// In this case, it does not start any threads itself. A task decodes one frame. It is only submitted once the frame's
+/// texture frame has arrived, and it only takes the frame from the work queue if the texture frame is still queued when it runs
+/// (a seek may have cleared it in between). Thus, tasks never register pending texture frame promises, and never block
+/// the executor's workers waiting for the video thread.
 template <typename FrameT>
 class DecodingThread {
  public:
@@ -162,32 +172,95 @@ class DecodingThread {
   }
   
   /// Configures the thread to use OpenGL. It takes ownership of the passed-in context object.
+  /// Since there is only a single context, this limits the thread to a single worker.
   void SetUseOpenGLContext(unique_ptr<GLContext>&& context) {
     workerThreadOpenGLContext = std::move(context);
   }
   
+  /// If set to non-null, the thread records the duration of XRVideoDecompressContent() for each frame in the given statistics object.
+  inline void SetPipelineStatistics(XRVideoPipelineStatistics* statistics) {
+    pipelineStatistics = statistics;
+    
+    for (auto& decodingContext : decodingContexts) {
+      decodingContext->SetPipelineStatistics(statistics);
+    }
+  }
+  
+  /// Sets the number of additional worker threads with which each decoding worker decompresses the independent parts of each frame in parallel
+  /// (see XRVideoDecodingContext::Initialize()). Takes effect when the thread is started the next time.
+  inline void SetDecompressionWorkerCount(int count) {
+    decompressionWorkerCount = count;
+  }
+  
+  /// Sets an executor on which to run the decoding work instead of on own worker threads, or nullptr (the default) to use own threads.
+  /// The executor must remain valid for as long as the thread may run. Takes effect when the thread is started the next time.
+  /// If an OpenGL context is used (see SetUseOpenGLContext()), the executor is not used, since the context is bound to the worker thread.
+  inline void SetExecutor(XRVideoExecutor* executor) {
+    this->executor = executor;
+  }
+  
+  /// Sets the priority with which the executor runs this thread's tasks (see XRVideoExecutorQueue::SetPriority()).
+  /// Does nothing if no executor is used.
+  inline void SetExecutorPriority(bool isVisible, s64 bufferedNanoseconds) {
+    if (executorQueue) {
+      executorQueue->SetPriority(isVisible, bufferedNanoseconds);
+    }
+  }
+  
+  /// Sets the number of workers (default: 1) that decode frames concurrently. Takes effect when the thread is started the next time.
+  ///
+  /// With more than one worker, FrameT::Initialize() gets called concurrently for different frames,
+  /// so it must not access resources that are shared between frames without synchronization.
+  /// If an OpenGL context is used (see SetUseOpenGLContext()), a single worker is used regardless of this setting.
+  inline void SetWorkerCount(int count) {
+    workerCount = std::max(1, count);
+  }
+  
   void StartThread(bool verboseDecoding, TransferThread<FrameT>* transferThread) {
-    if (thread.joinable()) { thread.join(); }
+    JoinWorkerThreads();
     
     this->verboseDecoding = verboseDecoding;
     this->transferThread = transferThread;
     
-    threadRunning = true;
+    const bool useExecutor = executor && !workerThreadOpenGLContext;
+    const int startedWorkerCount = (workerThreadOpenGLContext || useExecutor) ? 1 : workerCount;
+    
+    decodingContexts.resize(startedWorkerCount);
+    for (auto& decodingContext : decodingContexts) {
+      if (!decodingContext) {
+        decodingContext.reset(new XRVideoDecodingContext());
+      }
+      decodingContext->SetPipelineStatistics(pipelineStatistics);
+    }
+    
+    runningWorkerCount = startedWorkerCount;
     quitRequested = false;
-    threadInitialized = false;
-    currentTextureFramePromise = nullptr;
-    thread = std::thread(std::bind(&DecodingThread::ThreadMain, this));
+    initializedWorkerCount = 0;
+    threadInitializedSuccessfully = true;
+    pendingTextureFramePromises.Clear();
+    
+    if (useExecutor) {
+      // The executor's tasks run one at a time, so they share a single decoding context, which we initialize here.
+      runningWorkerCount = 0;
+      threadInitializedSuccessfully = decodingContexts.front()->Initialize(decompressionWorkerCount);
+      executorQueue = executor->CreateQueue();
+      return;
+    }
+    
+    for (int i = 0; i < startedWorkerCount; ++ i) {
+      workerThreads.emplace_back(std::bind(&DecodingThread::ThreadMain, this, decodingContexts[i].get()));
+    }
   }
   
-  /// Waits until the worker thread initialized.
+  /// Waits until all workers initialized.
   /// This function is provided to be able to wait until the worker thread called SDL_GL_MakeCurrent(),
   /// since this function is not thread-safe. I am not sure whether it also conflicts with other OpenGL
   /// calls, but to be on the safe side, we make the main thread wait for it.
-  /// Returns true if the worker thread initialized successfully, false if there was an error during
-  /// its initialization.
+  /// Returns true if all workers initialized successfully, false if there was an error during
+  /// the initialization of any of them.
   bool WaitForThreadToInitialize() {
     unique_lock<mutex> lock(threadInitializationMutex);
-    while (!threadInitialized) {
+    while (initializedWorkerCount < static_cast<int>(workerThreads.size())) {
       threadInitializedCondition.wait(lock);
     }
     return threadInitializedSuccessfully;
@@ -199,11 +272,7 @@ class DecodingThread {
     dav1dPictureQueueMutex.lock();
     
     // See the comments in ClearQueues().
-    abortCurrentFrame = true;
-    if (currentTextureFramePromise && currentTextureFramePromise->GetStatus() == TextureFramePromise::Status::Open) {
-      currentTextureFramePromise->Abort();
-      currentTextureFramePromise = nullptr;
-    }
+    AbortPendingTextureFramePromises();
     
     quitRequested = true;
     
@@ -213,14 +282,12 @@ class DecodingThread {
   }
   
   bool IsThreadRunning() const {
-    return threadRunning;
+    return runningWorkerCount > 0 || (executorQueue && executorQueue->IsBusy());
   }
   
   void WaitForThreadToExit() {
     RequestThreadToExit();
-    if (thread.joinable()) {
-      thread.join();
-    }
+    JoinWorkerThreads();
   }
   
   /// Called by the reading thread.
@@ -232,7 +299,7 @@ class DecodingThread {
   bool QueueFrame(
       int frameIndex,
       const shared_ptr<XRVideoFrameMetadata>& frameMetadata,
-      const shared_ptr<vector<u8>>& frameData,
+      const XRVideoFrameView& frameData,
       const u8* frameContentPtr,
       s64 readingTime,
       WriteLockedCachedFrame<FrameT>&& cacheItem) {
@@ -247,20 +314,24 @@ class DecodingThread {
       return false;
     }
     
-    WorkItem* newItem = new WorkItem();
-    newItem->frameIndex = frameIndex;
-    newItem->frameMetadata = frameMetadata;
-    newItem->frameData = frameData;
-    newItem->frameContentPtr = frameContentPtr;
-    newItem->readingTime = readingTime;
-    newItem->cacheItem = std::move(cacheItem);
-    newItem->lastFrameIndexQueuedForDecoding = lastFrameIndexQueuedForDecoding;
-    workQueue.push_back(newItem);
+    WorkItem newItem;
+    newItem.frameIndex = frameIndex;
+    newItem.frameMetadata = frameMetadata;
+    newItem.frameData = frameData;
+    newItem.frameContentPtr = frameContentPtr;
+    newItem.readingTime = readingTime;
+    newItem.cacheItem = std::move(cacheItem);
+    newItem.lastFrameIndexQueuedForDecoding = lastFrameIndexQueuedForDecoding;
+    workQueue.PushBack(std::move(newItem));
     
     lastFrameIndexQueuedForDecoding = frameIndex;
     
     lock.unlock();
-    newWorkCondition.notify_one();
+    if (executorQueue) {
+      SubmitExecutorTaskIfReady();
+    } else {
+      newWorkCondition.notify_one();
+    }
     
     return true;
   }
@@ -271,26 +342,21 @@ class DecodingThread {
   void QueueDav1dPicture(int frameIndex, UniqueDav1dPicturePtr&& picture) {
     unique_lock<mutex> lock(dav1dPictureQueueMutex);
     
-    // If ProcessItem() already created a promise for the picture that we just received,
-    // then use the picture to fulfill that promise.
-    // Otherwise, queue the picture to be picked up by ProcessItem() later.
-    if (currentTextureFramePromise) {
-      if (currentTextureFramePromiseFrameIndex == frameIndex) {
-        currentTextureFramePromise->Fulfill(std::move(picture));
-        currentTextureFramePromise = nullptr;
-      } else {
-        // TODO: What would be the best way to react to that, to maximize the chance that future decoding will be consistent again?
-        //       Discard our frame, discard the texture frame, discard both, or a complete flush of the pipeline?
-        //       I think that flushing the complete pipeline would be needed. For now, for simplicity we only discard both current items.
-        LOG(ERROR) << "Mismatch between the decoding thread's next item (" << currentTextureFramePromiseFrameIndex << ") and the next queued dav1d picture (" << frameIndex << ")";
-        currentTextureFramePromise->Abort();
-        currentTextureFramePromise = nullptr;
-      }
-    } else {
-      Dav1dPictureQueueItem* newItem = new Dav1dPictureQueueItem();
-      newItem->frameIndex = frameIndex;
-      newItem->picture = std::move(picture);
-      dav1dPictureQueue.push_back(newItem);
+    // If a worker already created a promise for the picture that we just received,
+    // then use the picture to fulfill that promise. (Since pictures arrive in frame order, this is the first pending promise.)
+    // Otherwise, queue the picture to be picked up by a worker later.
+    if (pendingTextureFramePromises.Empty()) {
+      Dav1dPictureQueueItem newItem;
+      newItem.frameIndex = frameIndex;
+      newItem.picture = std::move(picture);
+      dav1dPictureQueue.PushBack(std::move(newItem));
+    } else if (TextureFramePromise* promise = TakeFirstPendingTextureFramePromise(frameIndex)) {
+      promise->Fulfill(std::move(picture));
+    }
+    
+    lock.unlock();
+    if (executorQueue) {
+      SubmitExecutorTaskIfReady();
     }
   }
   
@@ -300,26 +366,19 @@ class DecodingThread {
   void QueueUncompressedRGB(int frameIndex, vector<u8>&& rgbData) {
     unique_lock<mutex> lock(dav1dPictureQueueMutex);
     
-    // If ProcessItem() already created a promise for the picture that we just received,
-    // then use the picture to fulfill that promise.
-    // Otherwise, queue the picture to be picked up by ProcessItem() later.
-    if (currentTextureFramePromise) {
-      if (currentTextureFramePromiseFrameIndex == frameIndex) {
-        currentTextureFramePromise->Fulfill(std::move(rgbData));
-        currentTextureFramePromise = nullptr;
-      } else {
-        // TODO: What would be the best way to react to that, to maximize the chance that future decoding will be consistent again?
-        //       Discard our frame, discard the texture frame, discard both, or a complete flush of the pipeline?
-        //       I think that flushing the complete pipeline would be needed. For now, for simplicity we only discard both current items.
-        LOG(ERROR) << "Mismatch between the decoding thread's next item (" << currentTextureFramePromiseFrameIndex << ") and the next queued dav1d picture (" << frameIndex << ")";
-        currentTextureFramePromise->Abort();
-        currentTextureFramePromise = nullptr;
-      }
-    } else {
-      Dav1dPictureQueueItem* newItem = new Dav1dPictureQueueItem();
-      newItem->frameIndex = frameIndex;
-      newItem->rgbData = std::move(rgbData);
-      dav1dPictureQueue.push_back(newItem);
+    // See QueueDav1dPicture().
+    if (pendingTextureFramePromises.Empty()) {
+      Dav1dPictureQueueItem newItem;
+      newItem.frameIndex = frameIndex;
+      newItem.rgbData = std::move(rgbData);
+      dav1dPictureQueue.PushBack(std::move(newItem));
+    } else if (TextureFramePromise* promise = TakeFirstPendingTextureFramePromise(frameIndex)) {
+      promise->Fulfill(std::move(rgbData));
+    }
+    
+    lock.unlock();
+    if (executorQueue) {
+      SubmitExecutorTaskIfReady();
     }
   }
   
@@ -329,35 +388,73 @@ class DecodingThread {
     {
       lock_guard<mutex> lock(dav1dPictureQueueMutex);
       
-      // abortCurrentFrame is required to ensure that, after ClearQueues() returns, we won't create
-      // a new, empty promise for an in-progress frame that won't have matching texture data (since we removed
-      // that texture data here).
-      abortCurrentFrame = true;
+      // Abort the promises that workers created for frames whose texture frames have not arrived yet
+      // (since we remove these texture frames from the queues here, or they might never arrive otherwise).
+      // Since we hold dav1dPictureQueueMutex, we can be sure that none of these promises is being fulfilled at the same time.
+      // Frames whose promise was already fulfilled may be being decoded right now, so we simply leave them as they are.
+      // Since workers take a work item and register its promise in one step while holding both mutexes,
+      // no worker can afterwards create a promise for a frame that was taken from the queue before it was cleared.
+      AbortPendingTextureFramePromises();
       
-      // If the thread already created a promise and it is not fulfilled yet, abort it.
-      // Since we hold dav1dPictureQueueMutex, we can be sure that the promise is not being fulfilled at the same time.
-      // However, in case the promise is already fulfilled, this means that the frame may be being decoded right now,
-      // so in that case we simply leave it as it is.
-      if (currentTextureFramePromise && currentTextureFramePromise->GetStatus() == TextureFramePromise::Status::Open) {
-        currentTextureFramePromise->Abort();
-        currentTextureFramePromise = nullptr;
+      dav1dPictureQueue.Clear();
+    }
+    
+    if (!workQueue.Empty()) {
+      lastFrameIndexQueuedForDecoding = workQueue.Front().lastFrameIndexQueuedForDecoding;
+    }
+    
+    for (usize i = 0; i < workQueue.Size(); ++ i) {
+      workQueue[i].cacheItem.Invalidate();
+    }
+    workQueue.Clear();
+  }
+  
+  /// Returns whether any of the queued frames is flagged in frameIsRelevant (which is indexed by frame index).
+  bool HasRelevantQueuedFrame(const vector<u8>& frameIsRelevant) {
+    lock_guard<mutex> lock(workQueueMutex);
+    
+    for (usize i = 0; i < workQueue.Size(); ++ i) {
+      if (frameIsRelevant[workQueue[i].frameIndex]) {
+        return true;
       }
+    }
+    return false;
+  }
+  
+  /// Counterpart to VideoThread::RemoveQueuedFramesAfterLastRelevantOne(), which must be called before, passing in its results:
+  /// Removes the last removedFrameCount queued frames, after which decoding continues at lastRetainedFrameIndex.
+  /// The retained frames that are not flagged in frameIsRelevant release their cache items, such that they only get decoded
+  /// to advance the decoding state.
+  void RemoveQueuedFramesAfterLastRelevantOne(usize removedFrameCount, int lastRetainedFrameIndex, const vector<u8>& frameIsRelevant) {
+    // NOTE: Never lock the two mutexes below in the opposite order, or there will be the chance of a deadlock.
+    lock_guard<mutex> lock(workQueueMutex);
+    
+    // Workers may have taken some of the removed frames from the work queue already. Since the video thread will never
+    // produce their texture frames, abort the promises of these workers. As the removed frames are the last ones,
+    // their promises are the last pending ones.
+    const usize removedWorkItemCount = min(removedFrameCount, workQueue.Size());
+    if (removedWorkItemCount < removedFrameCount) {
+      lock_guard<mutex> lock(dav1dPictureQueueMutex);
       
-      for (Dav1dPictureQueueItem* item : dav1dPictureQueue) {
-        delete item;
+      for (usize i = removedWorkItemCount; i < removedFrameCount && !pendingTextureFramePromises.Empty(); ++ i) {
+        pendingTextureFramePromises.PopBack().promise->Abort();
       }
-      dav1dPictureQueue.clear();
     }
     
-    if (!workQueue.empty()) {
-      lastFrameIndexQueuedForDecoding = workQueue.front()->lastFrameIndexQueuedForDecoding;
+    for (usize i = 0; i < removedWorkItemCount; ++ i) {
+      workQueue.Back().cacheItem.Invalidate();
+      workQueue.PopBack();
     }
     
-    for (WorkItem* item : workQueue) {
-      item->cacheItem.Invalidate();
-      delete item;
+    lastFrameIndexQueuedForDecoding = lastRetainedFrameIndex;
+    
+    for (usize i = 0; i < workQueue.Size(); ++ i) {
+      WriteLockedCachedFrame<FrameT>& cacheItem = workQueue[i].cacheItem;
+      if (cacheItem.GetFrame() != nullptr && !frameIsRelevant[workQueue[i].frameIndex]) {
+        cacheItem.Invalidate();
+        cacheItem.Unlock();
+      }
     }
-    workQueue.clear();
   }
   
   inline int GetLastFrameIndexQueuedForDecoding() {
@@ -368,6 +465,19 @@ class DecodingThread {
   }
   
  private:
+  /// A frame that is being decoded (or has been decoded) by a worker and that is handed to the transfer thread
+  /// once all frames that were taken from the work queue before it are done.
+  struct HandoffItem {
+    int frameIndex;
+    s64 readingTime;
+    s64 decodingTime = 0;
+    
+    /// Cache item of the decoded frame. Null if decoding failed or the frame is not done yet.
+    WriteLockedCachedFrame<FrameT> cacheItem;
+    
+    bool done = false;
+  };
+  
   struct WorkItem {
     /// Index of the frame.
     int frameIndex;
@@ -376,7 +486,7 @@ class DecodingThread {
     shared_ptr<XRVideoFrameMetadata> frameMetadata;
     
     /// The compressed frame data to decode.
-    shared_ptr<vector<u8>> frameData;
+    XRVideoFrameView frameData;
     
     /// Pointer to the start of the frame's encoded content (within the frameData buffer).
     const u8* frameContentPtr;
@@ -394,6 +504,9 @@ class DecodingThread {
     /// Then, we know that after decoding all previous queue items, the decoding state
     /// will be at this frame index.
     int lastFrameIndexQueuedForDecoding;
+    
+    /// Sequence number of the decoded frame's slot in handoffQueue, or -1 if the frame is not handed to the transfer thread.
+    s64 handoffSequenceNumber = -1;
   };
   
   struct Dav1dPictureQueueItem {
@@ -407,47 +520,133 @@ class DecodingThread {
     vector<u8> rgbData;
   };
   
-  void ThreadMain() {
-    const bool initializedSuccessfully = InitializeWorkerThread();
+  /// Promise of a worker for a texture frame that has not arrived yet.
+  struct PendingTextureFramePromise {
+    int frameIndex;
+    TextureFramePromise* promise;
+  };
+  
+  void ThreadMain(XRVideoDecodingContext* decodingContext) {
+    const bool initializedSuccessfully = InitializeWorkerThread(decodingContext);
     
     threadInitializationMutex.lock();
-    threadInitialized = true;
-    threadInitializedSuccessfully = initializedSuccessfully;
+    ++ initializedWorkerCount;
+    threadInitializedSuccessfully = threadInitializedSuccessfully && initializedSuccessfully;
     threadInitializationMutex.unlock();
     threadInitializedCondition.notify_all();
     
     if (!initializedSuccessfully) {
-      threadRunning = false;
+      -- runningWorkerCount;
       return;
     }
     
     while (!quitRequested) {
+      // Declared before taking a work item, since the promise may be registered in pendingTextureFramePromises while taking it
+      TextureFramePromise textureFramePromise;
+      
       unique_lock<mutex> lock(workQueueMutex);
       
-      while (workQueue.empty() && !quitRequested) {
+      while (workQueue.Empty() && !quitRequested) {
         newWorkCondition.wait(lock);
       }
       if (quitRequested) {
         break;
       }
       
-      WorkItem* item = workQueue.front();
-      workQueue.erase(workQueue.begin());
-      
-      abortCurrentFrame = false;
+      WorkItem item;
+      const bool haveTextureFrame = TakeWorkItem(&item, &textureFramePromise);
       
       lock.unlock();
       
-      ProcessItem(item);
+      if (haveTextureFrame) {
+        ProcessItem(&item, &textureFramePromise, decodingContext);
+      }
+    }
+    
+    DeinitializeWorkerThread(decodingContext);
+    -- runningWorkerCount;
+  }
+  
+  /// Takes the front item of the work queue, matches it with its texture frame (see TakeTextureFrame()), and reserves its slot
+  /// in the handoff queue. Must be called with workQueueMutex locked, and only if the work queue is not empty.
+  /// Returns false if the item must be discarded.
+  bool TakeWorkItem(WorkItem* item, TextureFramePromise* textureFramePromise) {
+    *item = workQueue.PopFront();
+    
+    // Match the item with its texture frame before releasing workQueueMutex, such that the texture frames,
+    // which arrive in frame order, get matched with the items in the order in which they were taken.
+    const bool haveTextureFrame = TakeTextureFrame(item, textureFramePromise);
+    
+    if (haveTextureFrame && item->cacheItem.GetFrame() != nullptr) {
+      HandoffItem handoffItem;
+      handoffItem.frameIndex = item->frameIndex;
+      handoffItem.readingTime = item->readingTime;
       
-      delete item;
+      lock_guard<mutex> handoffLock(handoffQueueMutex);
+      item->handoffSequenceNumber = handoffQueueFrontSequenceNumber + handoffQueue.Size();
+      handoffQueue.PushBack(std::move(handoffItem));
     }
     
-    DeinitializeWorkerThread();
-    threadRunning = false;
+    return haveTextureFrame;
   }
   
-  bool InitializeWorkerThread() {
+  /// Executor mode: Submits a task to decode the next work item if the item's texture frame has arrived and no task is submitted yet.
+  /// Must be called without holding workQueueMutex or dav1dPictureQueueMutex.
+  void SubmitExecutorTaskIfReady() {
+    // NOTE: Never lock the two mutexes below in the opposite order, or there will be the chance of a deadlock.
+    lock_guard<mutex> lock(workQueueMutex);
+    
+    if (executorTaskSubmitted || quitRequested || workQueue.Empty()) {
+      return;
+    }
+    
+    if (!IsTextureFrameQueued()) {
+      return;
+    }
+    
+    executorTaskSubmitted = true;
+    executorQueue->Submit([this]() { RunExecutorTask(); });
+  }
+  
+  /// Executor mode: Returns whether a texture frame is queued for the next work item. Must be called with workQueueMutex locked,
+  /// which keeps the texture frame queued until the item is taken, since texture frames are only removed with both mutexes locked.
+  /// Since there are no pending promises in executor mode, the picture queue contains all texture frames that were not taken yet.
+  bool IsTextureFrameQueued() {
+    lock_guard<mutex> lock(dav1dPictureQueueMutex);
+    return !dav1dPictureQueue.Empty();
+  }
+  
+  /// Executor mode: Decodes the next work item, whose texture frame is available, and then submits the next task if possible.
+  void RunExecutorTask() {
+    TextureFramePromise textureFramePromise;
+    WorkItem item;
+    bool haveTextureFrame = false;
+    
+    {
+      lock_guard<mutex> lock(workQueueMutex);
+      
+      // The work and picture queues may have been cleared after the task was submitted (for example, by ClearQueues() when seeking).
+      // Only take the next item if a texture frame is still queued, since TakeWorkItem() would register a pending promise otherwise,
+      // on which ProcessItem() would block this worker until the video thread delivers. In that case, the texture frame's arrival
+      // submits the next task. (If the queued texture frame is for a different frame, TakeWorkItem() discards both without waiting.)
+      if (!quitRequested && !workQueue.Empty() && IsTextureFrameQueued()) {
+        haveTextureFrame = TakeWorkItem(&item, &textureFramePromise);
+      }
+    }
+    
+    if (haveTextureFrame) {
+      ProcessItem(&item, &textureFramePromise, decodingContexts.front().get());
+    }
+    
+    {
+      lock_guard<mutex> lock(workQueueMutex);
+      executorTaskSubmitted = false;
+    }
+    
+    SubmitExecutorTaskIfReady();
+  }
+  
+  bool InitializeWorkerThread(XRVideoDecodingContext* decodingContext) {
     SCAN_STUDIO_SET_THREAD_NAME("scan-decoding");
     
     // Attention: According to the following post, SDL_GL_MakeCurrent() is not thread-safe on all platforms:
@@ -457,13 +656,13 @@ class DecodingThread {
       return false;
     }
     
-    if (!decodingContext.Initialize()) { return false; }
+    if (!decodingContext->Initialize(decompressionWorkerCount)) { return false; }
     
     return true;
   }
   
-  void DeinitializeWorkerThread() {
-    decodingContext.Destroy();
+  void DeinitializeWorkerThread(XRVideoDecodingContext* decodingContext) {
+    decodingContext->Destroy();
     
     // We do not delete the context anymore.
     // This way, the context survives restarts of the DecodingThread,
@@ -471,60 +670,101 @@ class DecodingThread {
     // workerThreadOpenGLContext.reset();
   }
   
-  void ProcessItem(WorkItem* item) {
-    // If the frame's dav1d picture was already decoded, create an already-fulfilled promise for it.
-    // Otherwise, create a promise that will be fulfilled later by QueueDav1dPicture() (or aborted).
-    TextureFramePromise textureFramePromise;
-    {
-      unique_lock<mutex> lock(dav1dPictureQueueMutex);
-      
-      if (abortCurrentFrame) {
-        item->cacheItem.Invalidate();
-        return;
+  void JoinWorkerThreads() {
+    if (executorQueue) {
+      executorQueue->CancelAndWait();
+      executorQueue.reset();
+      executorTaskSubmitted = false;
+      DeinitializeWorkerThread(decodingContexts.front().get());
+    }
+    
+    for (std::thread& thread : workerThreads) {
+      if (thread.joinable()) {
+        thread.join();
       }
-      
-      if (dav1dPictureQueue.empty()) {
-        // The picture is not available yet. Set a pointer to it so it can be fulfilled (or aborted) later.
-        currentTextureFramePromise = &textureFramePromise;
-        currentTextureFramePromiseFrameIndex = item->frameIndex;
-      } else if (dav1dPictureQueue.front()->frameIndex == item->frameIndex) {
-        // The picture is already available. Create a promise that is already fulfilled.
-        if (dav1dPictureQueue.front()->picture) {
-          textureFramePromise.Fulfill(std::move(dav1dPictureQueue.front()->picture));
-        } else {
-          textureFramePromise.Fulfill(std::move(dav1dPictureQueue.front()->rgbData));
-        }
-        delete dav1dPictureQueue.front();
-        dav1dPictureQueue.erase(dav1dPictureQueue.begin());
+    }
+    workerThreads.clear();
+  }
+  
+  /// Matches the given, just-taken work item with its texture frame. Must be called with workQueueMutex locked.
+  /// If the frame's dav1d picture was already decoded, fulfills the given promise with it.
+  /// Otherwise, registers the promise to be fulfilled later by QueueDav1dPicture() (or aborted).
+  /// Returns false (and invalidates the item's cache item) if the item must be discarded.
+  bool TakeTextureFrame(WorkItem* item, TextureFramePromise* textureFramePromise) {
+    lock_guard<mutex> lock(dav1dPictureQueueMutex);
+    
+    // Note that if there are pending promises, the picture queue is empty, since arriving pictures fulfill the pending promises first.
+    if (dav1dPictureQueue.Empty()) {
+      // The picture is not available yet. Register the promise so it can be fulfilled (or aborted) later.
+      // (This never happens in executor mode, see RunExecutorTask().)
+      pendingTextureFramePromises.PushBack({item->frameIndex, textureFramePromise});
+    } else if (dav1dPictureQueue.Front().frameIndex == item->frameIndex) {
+      // The picture is already available. Fulfill the promise right away.
+      Dav1dPictureQueueItem queuedItem = dav1dPictureQueue.PopFront();
+      if (queuedItem.picture) {
+        textureFramePromise->Fulfill(std::move(queuedItem.picture));
       } else {
-        // A picture is available, but it is for the wrong frame.
-        // TODO: What would be the best way to react to that, to maximize the chance that future decoding will be consistent again?
-        //       Discard our frame, discard the texture frame, discard both, or a complete flush of the pipeline?
-        //       I think that flushing the complete pipeline would be needed. For now, for simplicity we only discard both current items.
-        LOG(ERROR) << "Mismatch between the decoding thread's next item (" << item->frameIndex << ") and the next queued dav1d picture (" << dav1dPictureQueue.front()->frameIndex << ")";
-        delete dav1dPictureQueue.front();
-        dav1dPictureQueue.erase(dav1dPictureQueue.begin());
-        item->cacheItem.Invalidate();
-        return;
+        textureFramePromise->Fulfill(std::move(queuedItem.rgbData));
       }
+    } else {
+      // A picture is available, but it is for the wrong frame.
+      // TODO: What would be the best way to react to that, to maximize the chance that future decoding will be consistent again?
+      //       Discard our frame, discard the texture frame, discard both, or a complete flush of the pipeline?
+      //       I think that flushing the complete pipeline would be needed. For now, for simplicity we only discard both current items.
+      LOG(ERROR) << "Mismatch between the decoding thread's next item (" << item->frameIndex << ") and the next queued dav1d picture (" << dav1dPictureQueue.Front().frameIndex << ")";
+      dav1dPictureQueue.PopFront();
+      item->cacheItem.Invalidate();
+      return false;
+    }
+    
+    return true;
+  }
+  
+  /// For a texture frame with the given frame index that just arrived, removes the first pending promise and returns it
+  /// if it is for this frame index. Otherwise, aborts that promise and returns nullptr (in which case the texture frame is discarded as well).
+  /// Must be called with dav1dPictureQueueMutex locked, and only if there is a pending promise.
+  TextureFramePromise* TakeFirstPendingTextureFramePromise(int frameIndex) {
+    const PendingTextureFramePromise pending = pendingTextureFramePromises.PopFront();
+    
+    if (pending.frameIndex == frameIndex) {
+      return pending.promise;
     }
     
+    // TODO: What would be the best way to react to that, to maximize the chance that future decoding will be consistent again?
+    //       Discard our frame, discard the texture frame, discard both, or a complete flush of the pipeline?
+    //       I think that flushing the complete pipeline would be needed. For now, for simplicity we only discard both current items.
+    LOG(ERROR) << "Mismatch between the decoding thread's next item (" << pending.frameIndex << ") and the next queued dav1d picture (" << frameIndex << ")";
+    pending.promise->Abort();
+    return nullptr;
+  }
+  
+  /// Aborts all pending promises. Must be called with dav1dPictureQueueMutex locked.
+  void AbortPendingTextureFramePromises() {
+    for (usize i = 0; i < pendingTextureFramePromises.Size(); ++ i) {
+      pendingTextureFramePromises[i].promise->Abort();
+    }
+    pendingTextureFramePromises.Clear();
+  }
+  
+  void ProcessItem(WorkItem* item, TextureFramePromise* textureFramePromise, XRVideoDecodingContext* decodingContext) {
     if (item->cacheItem.GetFrame() != nullptr) {
       // Decode the frame into a cache item
       const TimePoint decodingStartTime = Clock::now();
       
-      if (!item->cacheItem.GetFrame()->Initialize(*item->frameMetadata, item->frameContentPtr, &textureFramePromise, &decodingContext, verboseDecoding)) {
+      if (!item->cacheItem.GetFrame()->Initialize(*item->frameMetadata, item->frameContentPtr, textureFramePromise, decodingContext, verboseDecoding)) {
         // This does happen if we abort the textureFramePromise when the video is seeked. In that case, it is not an error.
         // LOG(ERROR) << "Failed to initialize an XRVideo frame";
-
-        if (textureFramePromise.GetStatus() == TextureFramePromise::Status::Open) {
+        
+        if (textureFramePromise->GetStatus() == TextureFramePromise::Status::Open) {
           // This happens if the frame fails to initialize before the texture frame promise has been fulfilled.
-          // In that case, we must wait for the promise to be fulfilled, since textureFramePromise is a local variable here,
+          // In that case, we must wait for the promise to be fulfilled, since textureFramePromise is a local variable of the worker,
           // and the VideoThread would try to call Fulfill() (or Abort()) on it after it was destructed otherwise.
-          textureFramePromise.Wait();
+          textureFramePromise->Wait();
         }
-
+        
         item->cacheItem.Invalidate();
+        item->cacheItem.Unlock();
+        FinishHandoffItem(item->handoffSequenceNumber, 0, &item->cacheItem);
         return;
       }
       
@@ -534,49 +774,82 @@ class DecodingThread {
       const TimePoint decodingEndTime = Clock::now();
       const s64 decodingTime = NanosecondsFromTo(decodingStartTime, decodingEndTime);
       
-      transferThread->QueueFrame(item->frameIndex, item->readingTime, decodingTime, move(item->cacheItem));
+      item->cacheItem.SetDecodedDataSize(item->frameMetadata->GetDecodedDataSize());
+      
+      FinishHandoffItem(item->handoffSequenceNumber, decodingTime, &item->cacheItem);
       
       if (verboseDecoding) {
         LOG(1) << "DecodingThread: Decoded frame " << item->frameIndex << " in " << MillisecondsFromTo(decodingStartTime, decodingEndTime) << " ms";
       }
     } else {
       // (Partially) decode the frame only to advance the decoding state
-      textureFramePromise.Wait();
+      textureFramePromise->Wait();
     }
   }
   
-  // Decoding context (common to all render paths)
-  XRVideoDecodingContext decodingContext;
+  /// Marks the handoff item with the given sequence number as done, and hands all done items at the start of the handoff queue
+  /// (i.e., those that do not wait for any earlier frame anymore) to the transfer thread, in order.
+  void FinishHandoffItem(s64 handoffSequenceNumber, s64 decodingTime, WriteLockedCachedFrame<FrameT>* cacheItem) {
+    lock_guard<mutex> lock(handoffQueueMutex);
+    
+    HandoffItem& handoffItem = handoffQueue[handoffSequenceNumber - handoffQueueFrontSequenceNumber];
+    handoffItem.decodingTime = decodingTime;
+    handoffItem.cacheItem = std::move(*cacheItem);
+    handoffItem.done = true;
+    
+    while (!handoffQueue.Empty() && handoffQueue.Front().done) {
+      HandoffItem frontItem = handoffQueue.PopFront();
+      ++ handoffQueueFrontSequenceNumber;
+      if (frontItem.cacheItem.GetFrame() != nullptr) {
+        transferThread->QueueFrame(frontItem.frameIndex, frontItem.readingTime, frontItem.decodingTime, std::move(frontItem.cacheItem));
+      }
+    }
+  }
+  
+  // Decoding contexts (common to all render paths), one per worker
+  vector<unique_ptr<XRVideoDecodingContext>> decodingContexts;
+  XRVideoPipelineStatistics* pipelineStatistics = nullptr;
   
   // Work queue
   mutex workQueueMutex;
   condition_variable newWorkCondition;
-  vector<WorkItem*> workQueue;
+  SlotQueue<WorkItem> workQueue;
   int lastFrameIndexQueuedForDecoding = -1;
-  atomic<bool> abortCurrentFrame;
   
-  // Dav1d picture queue
+  // Dav1d picture queue, and the promises of the workers for pictures that have not arrived yet (in the order of the work items)
   mutex dav1dPictureQueueMutex;
-  vector<Dav1dPictureQueueItem*> dav1dPictureQueue;
-  TextureFramePromise* currentTextureFramePromise = nullptr;
-  int currentTextureFramePromiseFrameIndex = -1;
+  SlotQueue<Dav1dPictureQueueItem> dav1dPictureQueue;
+  SlotQueue<PendingTextureFramePromise> pendingTextureFramePromises;
+  
+  // Queue of frames to hand to the transfer thread, in the order in which they were taken from the work queue.
+  // The items are numbered consecutively; handoffQueueFrontSequenceNumber is the sequence number of the front item.
+  mutex handoffQueueMutex;
+  SlotQueue<HandoffItem> handoffQueue;
+  s64 handoffQueueFrontSequenceNumber = 0;
+  
+  // Executor mode (see SetExecutor()). executorTaskSubmitted is protected by workQueueMutex.
+  XRVideoExecutor* executor = nullptr;  // not owned
+  shared_ptr<XRVideoExecutorQueue> executorQueue;
+  bool executorTaskSubmitted = false;
   
   // OpenGL context for the worker thread
   unique_ptr<GLContext> workerThreadOpenGLContext;
   
   // Worker thread initialization
   mutex threadInitializationMutex;
-  bool threadInitialized;
+  int initializedWorkerCount = 0;
   bool threadInitializedSuccessfully;
   condition_variable threadInitializedCondition;
   
-  // Worker thread
-  atomic<bool> threadRunning;
+  // Worker threads
+  atomic<int> runningWorkerCount = {0};
   atomic<bool> quitRequested;
-  std::thread thread;
+  vector<std::thread> workerThreads;
   
   // Config
   bool verboseDecoding;
+  int decompressionWorkerCount = 0;
+  int workerCount = 1;
   
   // External objects
   TransferThread<FrameT>* transferThread;
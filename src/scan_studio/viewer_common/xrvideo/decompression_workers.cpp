@@ -0,0 +1,113 @@
+#include "scan_studio/viewer_common/xrvideo/decompression_workers.hpp"
+
+#include <zstd.h>
+
+#include <loguru.hpp>
+
+#include "scan_studio/viewer_common/timing.hpp"
+#include "scan_studio/viewer_common/util.hpp"
+
+namespace scan_studio {
+
+void XRVideoDecompressionJob::Run(ZSTD_DCtx* zstdCtx) {
+  const TimePoint startTime = Clock::now();
+  result = ZSTD_decompressDCtx(zstdCtx, dest, destCapacity, src, compressedSize);
+  duration = NanosecondsFromTo(startTime, Clock::now());
+}
+
+XRVideoDecompressionWorkers::~XRVideoDecompressionWorkers() {
+  Destroy();
+}
+
+bool XRVideoDecompressionWorkers::Initialize(int workerCount) {
+  Destroy();
+  
+  quitRequested = false;
+  
+  for (int i = 0; i < workerCount; ++ i) {
+    shared_ptr<ZSTD_DCtx> zstdCtx(ZSTD_createDCtx(), [](ZSTD_DCtx* ctx) { ZSTD_freeDCtx(ctx); });
+    if (!zstdCtx) {
+      LOG(ERROR) << "Failed to create a zstd decompression context";
+      Destroy();
+      return false;
+    }
+    
+    workerZStdContexts.push_back(zstdCtx);
+    workerThreads.emplace_back(&XRVideoDecompressionWorkers::WorkerMain, this, zstdCtx.get());
+  }
+  
+  return true;
+}
+
+void XRVideoDecompressionWorkers::Destroy() {
+  {
+    lock_guard<mutex> lock(jobsMutex);
+    quitRequested = true;
+  }
+  newJobsCondition.notify_all();
+  
+  for (std::thread& thread : workerThreads) {
+    thread.join();
+  }
+  workerThreads.clear();
+  workerZStdContexts.clear();
+}
+
+void XRVideoDecompressionWorkers::Run(XRVideoDecompressionJob* jobs, int jobCount, ZSTD_DCtx* callerZStdCtx) {
+  unique_lock<mutex> lock(jobsMutex);
+  
+  this->jobs = jobs;
+  this->jobCount = jobCount;
+  nextJob = 0;
+  remainingJobs = jobCount;
+  
+  // The calling thread takes the first (largest) job itself, so only wake up workers for the remaining ones
+  for (int i = 1; i < jobCount; ++ i) {
+    newJobsCondition.notify_one();
+  }
+  
+  RunJobs(lock, callerZStdCtx);
+  
+  while (remainingJobs > 0) {
+    jobsDoneCondition.wait(lock);
+  }
+  
+  this->jobs = nullptr;
+  this->jobCount = 0;
+  nextJob = 0;
+}
+
+void XRVideoDecompressionWorkers::WorkerMain(ZSTD_DCtx* zstdCtx) {
+  SCAN_STUDIO_SET_THREAD_NAME("scan-decompress");
+  
+  unique_lock<mutex> lock(jobsMutex);
+  
+  while (true) {
+    while (nextJob >= jobCount && !quitRequested) {
+      newJobsCondition.wait(lock);
+    }
+    if (quitRequested) {
+      break;
+    }
+    
+    RunJobs(lock, zstdCtx);
+  }
+}
+
+void XRVideoDecompressionWorkers::RunJobs(unique_lock<mutex>& lock, ZSTD_DCtx* zstdCtx) {
+  while (nextJob < jobCount) {
+    XRVideoDecompressionJob* job = &jobs[nextJob];
+    ++ nextJob;
+    
+    lock.unlock();
+    job->Run(zstdCtx);
+    lock.lock();
+    
+    -- remainingJobs;
+    if (remainingJobs == 0) {
+      jobsDoneCondition.notify_all();
+    }
+  }
+}
+
+}
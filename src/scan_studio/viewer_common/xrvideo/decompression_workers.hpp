@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <libvis/vulkan/libvis.h>
+
+typedef struct ZSTD_DCtx_s ZSTD_DCtx;
+
+namespace scan_studio {
+using namespace vis;
+
+/// A single zstd decompression of one of the independently compressed parts of an XRVideo frame
+/// (mesh data, deformation state, or vertex alpha), as run by XRVideoDecompressionWorkers.
+struct XRVideoDecompressionJob {
+  /// Runs the decompression with the given zstd context, setting `result` and `duration`.
+  void Run(ZSTD_DCtx* zstdCtx);
+  
+  // Input
+  /// Name of the decompressed part, for log messages.
+  const char* name;
+  const u8* src;
+  usize compressedSize;
+  u8* dest;
+  /// Capacity of `dest`. This is also the expected decompressed size.
+  usize destCapacity;
+  
+  // Output
+  /// Return value of ZSTD_decompressDCtx(): The decompressed size, or an error code that may be checked with ZSTD_isError().
+  usize result;
+  /// Duration of the decompression in nanoseconds.
+  s64 duration;
+};
+
+/// Small pool of worker threads, each with its own zstd decompression context, that decompresses the independent parts
+/// of a frame in parallel. This bounds the decompression latency of a frame by its largest part instead of the sum of all parts.
+///
+/// Run() must only be called by one thread at a time (the DecodingThread). The calling thread participates in running the jobs.
+class XRVideoDecompressionWorkers {
+ public:
+  ~XRVideoDecompressionWorkers();
+  
+  /// Starts the given number of worker threads.
+  bool Initialize(int workerCount);
+  
+  /// Stops the worker threads. Must not be called while Run() is in progress.
+  void Destroy();
+  
+  /// Runs the given jobs on the worker threads and on the calling thread (using `callerZStdCtx` for the latter),
+  /// and returns once all of them finished. Jobs are started in the given order, so the largest ones should come first.
+  void Run(XRVideoDecompressionJob* jobs, int jobCount, ZSTD_DCtx* callerZStdCtx);
+  
+  inline int GetWorkerCount() const { return static_cast<int>(workerThreads.size()); }
+  
+ private:
+  void WorkerMain(ZSTD_DCtx* zstdCtx);
+  
+  /// Runs jobs until there are no unstarted jobs left. Expects `lock` to be locked, and returns with it being locked.
+  void RunJobs(unique_lock<mutex>& lock, ZSTD_DCtx* zstdCtx);
+  
+  mutex jobsMutex;
+  condition_variable newJobsCondition;
+  condition_variable jobsDoneCondition;
+  
+  XRVideoDecompressionJob* jobs = nullptr;
+  int jobCount = 0;
+  int nextJob = 0;
+  int remainingJobs = 0;
+  bool quitRequested = false;
+  
+  vector<shared_ptr<ZSTD_DCtx>> workerZStdContexts;
+  vector<std::thread> workerThreads;
+};
+
+}
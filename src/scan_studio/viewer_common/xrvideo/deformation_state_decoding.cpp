@@ -0,0 +1,120 @@
+#include "scan_studio/viewer_common/xrvideo/deformation_state_decoding.hpp"
+
+#include <Eigen/Core>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+  #define SCAN_STUDIO_DEFORMATION_DECODING_F16C
+  #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define SCAN_STUDIO_DEFORMATION_DECODING_SSE2
+  #include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+  #define SCAN_STUDIO_DEFORMATION_DECODING_NEON
+  #include <arm_neon.h>
+#elif defined(__wasm_simd128__)
+  #define SCAN_STUDIO_DEFORMATION_DECODING_WASM_SIMD128
+  #include <wasm_simd128.h>
+#endif
+
+namespace scan_studio {
+
+// Notes on the SIMD implementations below:
+//
+// - They process 4 values at a time. Since a deformation node consists of 12 values and the identity
+//   is added to coefficients 0, 4, and 8, the 12-value identity pattern (1 0 0 0 1 0 0 0 1 0 0 0)
+//   is the same 4-lane pattern (1 0 0 0) repeated three times. Thus, all 4-value steps use the same bias vector.
+//
+// - Without native half-float conversion instructions (SSE2, WASM SIMD128), the conversion shifts the
+//   exponent and mantissa bits into place and then multiplies with 2^(127 - 15) to re-bias the exponent.
+//   This handles zeros and subnormals correctly as well (unless denormals-are-zero mode is enabled for the thread,
+//   in which case subnormal half floats, i.e., values below 6.1e-5 in magnitude, decode to zero). Infinity and NaN
+//   inputs, which have the maximum exponent, get the float's maximum exponent set explicitly.
+
+void XRVideoDecodeDeformationState(const u16* encodedValues, usize count, float* outDeformationState) {
+  usize i = 0;
+  
+  #if defined(SCAN_STUDIO_DEFORMATION_DECODING_F16C)
+    const __m128 identityBias = _mm_setr_ps(1, 0, 0, 0);
+    
+    for (; i + 4 <= count; i += 4) {
+      const __m128i halfValues = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(encodedValues + i));
+      _mm_storeu_ps(outDeformationState + i, _mm_add_ps(_mm_cvtph_ps(halfValues), identityBias));
+    }
+  #elif defined(SCAN_STUDIO_DEFORMATION_DECODING_SSE2)
+    const __m128 identityBias = _mm_setr_ps(1, 0, 0, 0);
+    const __m128i expMantMask = _mm_set1_epi32(0x7fff);
+    const __m128i maxFiniteHalf = _mm_set1_epi32(0x7bff);
+    const __m128i infNanExponent = _mm_set1_epi32(255 << 23);
+    const __m128 exponentRebias = _mm_set1_ps(0x1p112f);
+    
+    for (; i + 4 <= count; i += 4) {
+      const __m128i halfValues = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(encodedValues + i)), _mm_setzero_si128());
+      
+      const __m128i expMant = _mm_and_si128(halfValues, expMantMask);
+      const __m128i sign = _mm_slli_epi32(_mm_xor_si128(halfValues, expMant), 16);
+      const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(expMant, 13)), exponentRebias);
+      const __m128i infNanBits = _mm_and_si128(_mm_cmpgt_epi32(expMant, maxFiniteHalf), infNanExponent);
+      const __m128 floatValues = _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNanBits)));
+      
+      _mm_storeu_ps(outDeformationState + i, _mm_add_ps(floatValues, identityBias));
+    }
+  #elif defined(SCAN_STUDIO_DEFORMATION_DECODING_NEON)
+    const float identityBiasValues[4] = {1, 0, 0, 0};
+    const float32x4_t identityBias = vld1q_f32(identityBiasValues);
+    
+    for (; i + 4 <= count; i += 4) {
+      const float32x4_t floatValues = vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(encodedValues + i)));
+      vst1q_f32(outDeformationState + i, vaddq_f32(floatValues, identityBias));
+    }
+  #elif defined(SCAN_STUDIO_DEFORMATION_DECODING_WASM_SIMD128)
+    const v128_t identityBias = wasm_f32x4_make(1, 0, 0, 0);
+    const v128_t expMantMask = wasm_i32x4_splat(0x7fff);
+    const v128_t maxFiniteHalf = wasm_i32x4_splat(0x7bff);
+    const v128_t infNanExponent = wasm_i32x4_splat(255 << 23);
+    const v128_t exponentRebias = wasm_f32x4_splat(0x1p112f);
+    
+    for (; i + 4 <= count; i += 4) {
+      const v128_t halfValues = wasm_u32x4_load16x4(encodedValues + i);
+      
+      const v128_t expMant = wasm_v128_and(halfValues, expMantMask);
+      const v128_t sign = wasm_i32x4_shl(wasm_v128_xor(halfValues, expMant), 16);
+      const v128_t scaled = wasm_f32x4_mul(wasm_i32x4_shl(expMant, 13), exponentRebias);
+      const v128_t infNanBits = wasm_v128_and(wasm_i32x4_gt(expMant, maxFiniteHalf), infNanExponent);
+      const v128_t floatValues = wasm_v128_or(scaled, wasm_v128_or(sign, infNanBits));
+      
+      wasm_v128_store(outDeformationState + i, wasm_f32x4_add(floatValues, identityBias));
+    }
+  #endif
+  
+  // Remaining values (if count is not a multiple of 4, which does not happen for valid deformation states)
+  if (i < count) {
+    XRVideoDecodeDeformationStateScalar(encodedValues + i, count - i, outDeformationState + i);
+  }
+}
+
+void XRVideoDecodeDeformationStateScalar(const u16* encodedValues, usize count, float* outDeformationState) {
+  const Eigen::half* halfValues = reinterpret_cast<const Eigen::half*>(encodedValues);
+  
+  for (usize i = 0; i < count; ++ i) {
+    const int coeffIdx = i % 12;
+    const bool isOneInIdentity = coeffIdx == 0 || coeffIdx == 4 || coeffIdx == 8;
+    
+    outDeformationState[i] = static_cast<float>(halfValues[i]) + (isOneInIdentity ? 1.f : 0);
+  }
+}
+
+const char* XRVideoDeformationStateDecodingInstructionSet() {
+  #if defined(SCAN_STUDIO_DEFORMATION_DECODING_F16C)
+    return "F16C";
+  #elif defined(SCAN_STUDIO_DEFORMATION_DECODING_SSE2)
+    return "SSE2";
+  #elif defined(SCAN_STUDIO_DEFORMATION_DECODING_NEON)
+    return "NEON";
+  #elif defined(SCAN_STUDIO_DEFORMATION_DECODING_WASM_SIMD128)
+    return "WASM SIMD128";
+  #else
+    return "scalar";
+  #endif
+}
+
+}
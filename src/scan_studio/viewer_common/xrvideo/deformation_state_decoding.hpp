@@ -0,0 +1,25 @@
+#pragma once
+
+#include <libvis/vulkan/libvis.h>
+
+namespace scan_studio {
+using namespace vis;
+
+/// Decodes an XRVideo frame's deformation state from its storage format into floats.
+///
+/// The storage format consists of IEEE 754 half-precision floats (given as their raw bits in `encodedValues`),
+/// with 12 values per deformation node. For each node, 1 has been subtracted from the diagonal coefficients
+/// of its rotation part (coefficients 0, 4, and 8) before encoding, which is reverted here.
+///
+/// This uses SIMD instructions where they are available: F16C on x86 if enabled at compile time (e.g., with -mf16c or /arch:AVX2),
+/// SSE2 otherwise, NEON on ARM64, and SIMD128 on WebAssembly if compiled with -msimd128. Otherwise, it falls back to
+/// XRVideoDecodeDeformationStateScalar().
+void XRVideoDecodeDeformationState(const u16* encodedValues, usize count, float* outDeformationState);
+
+/// Plain scalar implementation of XRVideoDecodeDeformationState().
+void XRVideoDecodeDeformationStateScalar(const u16* encodedValues, usize count, float* outDeformationState);
+
+/// Returns the name of the instruction set that XRVideoDecodeDeformationState() uses, e.g., for benchmark output.
+const char* XRVideoDeformationStateDecodingInstructionSet();
+
+}
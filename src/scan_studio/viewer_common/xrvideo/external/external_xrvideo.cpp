@@ -3,7 +3,9 @@
 namespace scan_studio {
 
 ExternalXRVideo::ExternalXRVideo(SRPlayer_XRVideo_External_Config callbacks)
-    : callbacks(callbacks) {}
+    : callbacks(callbacks) {
+  videoThread.SetUseDav1dZeroCopy(&dav1dPicturePool);
+}
 
 ExternalXRVideo::~ExternalXRVideo() {
   Destroy();
@@ -62,6 +64,9 @@ bool ExternalXRVideo::ResizeDecodedFrameCache(int cachedDecodedFrameCount) {
   }
   framesLockedForRendering.clear();
   
+  // Drop pooled pictures of a previous video, which may have a different texture size
+  dav1dPicturePool.Clear();
+  
   decodedFrameCache.Initialize(cachedDecodedFrameCount);
   for (int cacheItemIndex = 0; cacheItemIndex < cachedDecodedFrameCount; ++ cacheItemIndex) {
     WriteLockedCachedFrame<ExternalXRVideoFrame> lockedFrame = decodedFrameCache.LockCacheItemForWriting(cacheItemIndex);
@@ -2,6 +2,7 @@
 
 #include <memory>
 
+#include "scan_studio/viewer_common/xrvideo/dav1d_picture_pool.hpp"
 #include "scan_studio/viewer_common/xrvideo/decoded_frame_cache.hpp"
 #include "scan_studio/viewer_common/xrvideo/decoding_thread.hpp"
 #include "scan_studio/viewer_common/xrvideo/external/external_xrvideo_frame.hpp"
@@ -32,6 +33,9 @@ class ExternalXRVideo : public XRVideoImpl<ExternalXRVideoFrame> {
   
  private:
   SRPlayer_XRVideo_External_Config callbacks;
+  
+  /// Pool for the pictures decoded by dav1d, such that their textures can be copied out in one go
+  Dav1dPicturePool dav1dPicturePool;
 };
 
 class ExternalXRVideoRenderLock : public XRVideoRenderLockImpl<ExternalXRVideoFrame> {
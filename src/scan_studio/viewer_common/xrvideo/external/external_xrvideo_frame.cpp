@@ -70,8 +70,9 @@ bool ExternalXRVideoFrame::Initialize(
     return false;
   }
   
-  // Decompress the frame data
-  vector<u8> vertexAlpha;
+  // Decompress the frame data.
+  // The vertex alpha data is only needed until the after-decode callback returns, so we use the decoding context's scratch vector for it.
+  vector<u8>& vertexAlpha = *decodingContext->GetVertexAlphaScratchVector();
   
   if (!XRVideoDecompressContent(
       contentPtr, metadata, decodingContext,
@@ -89,7 +90,8 @@ bool ExternalXRVideoFrame::Initialize(
     return false;
   }
   auto textureData = textureFramePromise->Take();
-  // TODO: Try to use zero-copy to improve performance (unless the different allocation slows down decoding more than the removal of the copy helps)
+  // The picture was allocated by the video's Dav1dPicturePool, so for texture sizes that are multiples of 128, this is a single memcpy().
+  // TODO: Avoiding the copy entirely would require an API that lets the application use the picture's buffer directly.
   if (textureData) {
     XRVideoCopyTexture(*textureData, static_cast<u8*>(texturePtr), verboseDecoding);
   } else {
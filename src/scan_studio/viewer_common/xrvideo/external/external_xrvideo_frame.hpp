@@ -35,6 +35,10 @@ class ExternalXRVideoFrame : public XRVideoFrame {
       bool verboseDecoding);
   void Destroy();
   
+  /// Called after the frame got evicted from the decoded frame cache. The frame's data is owned by the application
+  /// (see the construct-frame callback), which keeps it per cache item, so there is nothing to release here.
+  inline void ReleaseResources() {}
+  
   void WaitForResourceTransfers();
   
   /// Returns the externally provided frame user data.
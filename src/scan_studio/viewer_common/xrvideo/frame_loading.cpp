@@ -1,11 +1,12 @@
 #include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
 
+#include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <cstddef>
+#include <cstring>
 #include <vector>
 
-#include <Eigen/Core>
-
 #include <zstd.h>
 
 #include <dav1d/dav1d.h>
@@ -16,16 +17,34 @@
 #include "scan_studio/common/xrvideo_file.hpp"
 #include "scan_studio/viewer_common/debug.hpp"
 #include "scan_studio/viewer_common/timing.hpp"
+#include "scan_studio/viewer_common/xrvideo/deformation_state_decoding.hpp"
+#include "scan_studio/viewer_common/xrvideo/pipeline_statistics.hpp"
 
 namespace scan_studio {
 
-bool XRVideoDecodingContext::Initialize() {
+bool XRVideoDecodingContext::Initialize(int decompressionWorkerCount) {
   zstdCtx.reset(ZSTD_createDCtx(), [](ZSTD_DCtx* ctx) { ZSTD_freeDCtx(ctx); });
+  
+  decompressionWorkers.reset();
+  if (decompressionWorkerCount > 0) {
+    decompressionWorkers.reset(new XRVideoDecompressionWorkers());
+    if (!decompressionWorkers->Initialize(decompressionWorkerCount)) {
+      decompressionWorkers.reset();
+      return false;
+    }
+  }
+  
   return true;
 }
 
 void XRVideoDecodingContext::Destroy() {
+  decompressionWorkers.reset();
   zstdCtx.reset();
+  
+  meshDataScratch.Release();
+  deformationStateScratch.Release();
+  vertexWeightsScratch.Release();
+  vertexAlphaScratch = vector<u8>();
 }
 
 bool XRVideoReadMetadata(const u8** data, usize dataSize, XRVideoFrameMetadata* metadata) {
@@ -119,82 +138,62 @@ bool XRVideoReadMetadata(const u8** data, usize dataSize, XRVideoFrameMetadata*
   return true;
 }
 
-static bool DecompressWithZStd(const u8* src, usize compressedSize, u8* dest, usize destCapacity, usize expectedSize, const char* name, bool verboseDecoding, ZSTD_DCtx* zstdCtx) {
-  const TimePoint meshDecompressionStartTime = Clock::now();
-  const usize decompressedBytes = ZSTD_decompressDCtx(zstdCtx, dest, destCapacity, src, compressedSize);
-  const TimePoint meshDecompressionEndTime = Clock::now();
-  
-  if (ZSTD_isError(decompressedBytes)) {
-    LOG(ERROR) << "Error decompressing the mesh with zstd: " << ZSTD_getErrorName(decompressedBytes);
+/// Checks the result of a decompression job. Returns true if the job succeeded.
+static bool CheckDecompressionJobResult(const XRVideoDecompressionJob& job, bool verboseDecoding) {
+  if (ZSTD_isError(job.result)) {
+    LOG(ERROR) << job.name << ": Error decompressing with zstd: " << ZSTD_getErrorName(job.result);
     return false;
-  } else if (decompressedBytes != expectedSize) {
-    LOG(ERROR) << name << ": Obtained unexpected byte count (" << decompressedBytes << ") for decompressed data, expected to be " << expectedSize;
+  } else if (job.result != job.destCapacity) {
+    LOG(ERROR) << job.name << ": Obtained unexpected byte count (" << job.result << ") for decompressed data, expected to be " << job.destCapacity;
     return false;
   }
   if (verboseDecoding) {
-    LOG(1) << name << " decompressed with zstd in " << (MillisecondsDuration(meshDecompressionEndTime - meshDecompressionStartTime).count()) << " ms";
+    LOG(1) << job.name << " decompressed with zstd in " << (1e-6 * job.duration) << " ms";
   }
   
   return true;
 }
 
-static bool DecompressMeshData(const XRVideoFrameMetadata& metadata, vector<u8>* meshData, u32* encodedTexcoordDataSize, const u8** dataPtr, bool verboseDecoding, ZSTD_DCtx* zstdCtx) {
-  *encodedTexcoordDataSize = metadata.vertexCount * 2 * sizeof(u16);
-  const usize meshDataSize =
-      metadata.uniqueVertexCount * 3 * sizeof(u16) +
-      (metadata.vertexCount - metadata.uniqueVertexCount) * sizeof(u16) +
-      *encodedTexcoordDataSize +
-      metadata.indexCount * sizeof(u16) +
-      metadata.encodedVertexWeightsSize;
-  
-  meshData->resize(meshDataSize);  // TODO: Keep allocated?
-  if (!DecompressWithZStd(
-      *dataPtr, metadata.compressedMeshSize,
-      meshData->data(), /*destCapacity*/ meshDataSize, /*expectedSize*/ meshDataSize,
-      "Mesh data", verboseDecoding, zstdCtx)) {
-    return false;
-  }
-  
-  *dataPtr += metadata.compressedMeshSize;
-  return true;
-}
+/// Pointers to the parts of a keyframe's decompressed mesh data.
+struct MeshDataParts {
+  const u16* uniqueVertexData;
+  const u16* duplicatedVertexSourceIndices;
+  const u16* encodedTexcoordData;
+  const u16* indexData;
+  const u8* encodedVertexWeights;
+};
 
-static bool DecompressDeformationStateData(const XRVideoFrameMetadata& metadata, float* outDeformationState, const u8** dataPtr, bool verboseDecoding, ZSTD_DCtx* zstdCtx) {
-  const u32 deformationStateDataSize = metadata.GetDeformationStateDataSize();
+static MeshDataParts GetMeshDataParts(const XRVideoFrameMetadata& metadata, const u8* meshData) {
+  MeshDataParts parts;
+  const u8* meshDataPtr = meshData;
   
-  // Decompress the values
-  vector<Eigen::half> encodedValues(deformationStateDataSize / sizeof(float));  // TODO: Consider using a pre-allocated buffer rather than allocating a new buffer for each decode
-  const u32 encodedValuesSize = encodedValues.size() * sizeof(Eigen::half);
+  parts.uniqueVertexData = reinterpret_cast<const u16*>(meshDataPtr);
+  meshDataPtr += metadata.uniqueVertexCount * 3 * sizeof(u16);
   
-  if (!DecompressWithZStd(
-      *dataPtr, metadata.compressedDeformationStateSize,
-      reinterpret_cast<u8*>(encodedValues.data()), /*destCapacity*/ encodedValuesSize, /*expectedSize*/ encodedValuesSize,
-      "Deformation state data", verboseDecoding, zstdCtx)) {
-    return false;
-  }
-  *dataPtr += metadata.compressedDeformationStateSize;
+  parts.duplicatedVertexSourceIndices = reinterpret_cast<const u16*>(meshDataPtr);
+  meshDataPtr += (metadata.vertexCount - metadata.uniqueVertexCount) * sizeof(u16);
   
-  // Decode the values
-  for (int i = 0, size = encodedValues.size(); i < size; ++ i) {
-    const int coeffIdx = i % 12;
-    const bool isOneInIdentity = coeffIdx == 0 || coeffIdx == 4 || coeffIdx == 8;
-    
-    outDeformationState[i] = static_cast<float>(encodedValues[i]) + (isOneInIdentity ? 1.f : 0);
-  }
+  parts.encodedTexcoordData = reinterpret_cast<const u16*>(meshDataPtr);
+  meshDataPtr += metadata.vertexCount * 2 * sizeof(u16);
   
-  return true;
+  parts.indexData = reinterpret_cast<const u16*>(meshDataPtr);
+  meshDataPtr += metadata.GetIndexDataSize();
+  
+  parts.encodedVertexWeights = meshDataPtr;
+  
+  return parts;
 }
 
 struct VertexWeights {
   u16 nodeIndices[XRVideoVertex::K];
   u8 nodeWeights[XRVideoVertex::K];
 };
+static_assert(sizeof(VertexWeights) == sizeof(XRVideoVertex) - offsetof(XRVideoVertex, nodeIndices), "VertexWeights must match the layout of the weights part of XRVideoVertex");
 
-static void DecodeVertexWeights(const XRVideoFrameMetadata& metadata, const u8* vertexWeightsPtr, vector<VertexWeights>* decodedVertexWeights) {
-  decodedVertexWeights->resize(metadata.vertexCount);
-  
+/// Decodes the vertex weights of the unique vertices into decodedVertexWeights, which must have space for metadata.vertexCount items.
+static void DecodeVertexWeights(const XRVideoFrameMetadata& metadata, const u8* vertexWeightsPtr, VertexWeights* decodedVertexWeights) {
   const u8* vertexWeightsEndPtr = vertexWeightsPtr + metadata.encodedVertexWeightsSize;
-  VertexWeights* weightsPtr = decodedVertexWeights->data();
+  VertexWeights* weightsPtr = decodedVertexWeights;
   
   while (vertexWeightsPtr < vertexWeightsEndPtr) {
     const u16 firstNodeIndexWithEncodedNodeCount = *reinterpret_cast<const u16*>(vertexWeightsPtr);
@@ -237,7 +236,7 @@ static void DecodeVertexWeights(const XRVideoFrameMetadata& metadata, const u8*
   if (vertexWeightsPtr != vertexWeightsEndPtr) {
     LOG(ERROR) << "Deformation graph decoding error: Read past vertexWeightsEndPtr";
   }
-  if (weightsPtr != decodedVertexWeights->data() + metadata.uniqueVertexCount) {
+  if (weightsPtr != decodedVertexWeights + metadata.uniqueVertexCount) {
     LOG(ERROR) << "Deformation graph decoding error: Vertex count does not match";
   }
 }
@@ -292,10 +291,141 @@ static void WriteRenderableVertices(
   }
 }
 
-static bool DecompressVertexAlphaData(const XRVideoFrameMetadata& metadata, vector<u8>* outVertexAlpha, const u8** dataPtr, bool verboseDecoding, ZSTD_DCtx* zstdCtx) {
+/// Loads a quantized vertex position, returning it packed with a zero w component.
+static inline u64 LoadPosition(const u16* position) {
+  return static_cast<u64>(position[0]) | (static_cast<u64>(position[1]) << 16) | (static_cast<u64>(position[2]) << 32);
+}
+
+/// Writes a vertex with sequential stores (with the components packed in little-endian byte order).
+static inline void StoreVertex(u64 position, u32 texcoords, u64 nodeIndices, u32 nodeWeights, XRVideoVertex* outVertex) {
+  u8* outPtr = reinterpret_cast<u8*>(outVertex);
+  memcpy(outPtr + offsetof(XRVideoVertex, x), &position, sizeof(u64));
+  memcpy(outPtr + offsetof(XRVideoVertex, tx), &texcoords, sizeof(u32));
+  memcpy(outPtr + offsetof(XRVideoVertex, nodeIndices), &nodeIndices, sizeof(u64));
+  memcpy(outPtr + offsetof(XRVideoVertex, nodeWeights), &nodeWeights, sizeof(u32));
+}
+
+void XRVideoDecodeRenderableVertices(
+    const XRVideoFrameMetadata& metadata,
+    const u8* meshData,
+    XRVideoScratchBuffer* vertexWeightsScratch,
+    XRVideoVertex* outVertices) {
+  static_assert(XRVideoVertex::K == 4, "The implementation below assumes four node assignments per vertex");
+  
+  // Maximum size of the encoded weights of one vertex
+  constexpr usize maxEncodedVertexWeightsSize = XRVideoVertex::K * (sizeof(u16) + sizeof(u8));
+  
+  // Masks for the used parts of the packed node indices and node weights, indexed by the node count
+  constexpr u64 nodeIndexMasks[XRVideoVertex::K + 1] = {0, 0xffffull, 0xffffffffull, 0xffffffffffffull, 0xffffffffffffffffull};
+  constexpr u32 nodeWeightMasks[XRVideoVertex::K + 1] = {0, 0xff, 0xffff, 0xffffff, 0xffffffff};
+  
+  const MeshDataParts parts = GetMeshDataParts(metadata, meshData);
+  
+  // Compact copy of the unique vertices' weights, used to resolve the duplicated vertices
+  // without reading back from outVertices (which may be write-combined memory)
+  VertexWeights* uniqueVertexWeights = vertexWeightsScratch->Get<VertexWeights>(metadata.uniqueVertexCount);
+  
+  const u8* vertexWeightsPtr = parts.encodedVertexWeights;
+  const u8* vertexWeightsEndPtr = vertexWeightsPtr + metadata.encodedVertexWeightsSize;
+  bool vertexWeightsExhausted = false;
+  
+  // Unique vertices
+  const u32 uniqueVertexCount = metadata.uniqueVertexCount;
+  for (u32 i = 0; i < uniqueVertexCount; ++ i) {
+    const u64 position = LoadPosition(parts.uniqueVertexData + 3 * i);
+    u32 texcoords;
+    memcpy(&texcoords, parts.encodedTexcoordData + 2 * i, sizeof(u32));
+    
+    // Vertex weights. The encoding of each vertex starts with the first node index, with the node count minus one
+    // stored in the upper two bits, followed by the remaining node indices and then one weight byte per node.
+    // We load the maximum encoded size and mask out the parts that belong to the following vertices.
+    // Close to the end of the data, the remaining bytes are copied to a local buffer first to prevent reading out of bounds.
+    const usize remainingVertexWeightsSize = vertexWeightsEndPtr - vertexWeightsPtr;
+    const u8* encodedPtr = vertexWeightsPtr;
+    u8 encodedTail[maxEncodedVertexWeightsSize];
+    if (remainingVertexWeightsSize < maxEncodedVertexWeightsSize) {
+      memset(encodedTail, 0xff, maxEncodedVertexWeightsSize);
+      memcpy(encodedTail, vertexWeightsPtr, remainingVertexWeightsSize);
+      encodedPtr = encodedTail;
+    }
+    
+    u64 nodeIndices;
+    memcpy(&nodeIndices, encodedPtr, sizeof(u64));
+    const u32 firstNodeIndexWithEncodedNodeCount = nodeIndices & 0xffff;
+    const u32 nodeAssignmentCount = ((firstNodeIndexWithEncodedNodeCount & 0xc000) >> 14) + 1;
+    u32 nodeWeights;
+    
+    if (firstNodeIndexWithEncodedNodeCount != UINT16_MAX && 3 * nodeAssignmentCount <= remainingVertexWeightsSize) {
+      // Clear the node count bits, and replicate the last node index into the unused node index slots
+      nodeIndices &= ~static_cast<u64>(0xc000);
+      const u64 lastNodeIndex = (nodeIndices >> (16 * (nodeAssignmentCount - 1))) & 0xffff;
+      nodeIndices = (nodeIndices & nodeIndexMasks[nodeAssignmentCount]) | ((lastNodeIndex * 0x0001000100010001ull) & ~nodeIndexMasks[nodeAssignmentCount]);
+      
+      memcpy(&nodeWeights, encodedPtr + 2 * nodeAssignmentCount, sizeof(u32));
+      nodeWeights &= nodeWeightMasks[nodeAssignmentCount];
+      
+      vertexWeightsPtr += 3 * nodeAssignmentCount;
+    } else {
+      if (remainingVertexWeightsSize < 2) {
+        if (!vertexWeightsExhausted) {
+          LOG(ERROR) << "Deformation graph decoding error: Vertex count does not match";
+          vertexWeightsExhausted = true;
+        }
+      } else if (firstNodeIndexWithEncodedNodeCount == UINT16_MAX) {
+        // The vertex does not have any nodes assigned. This case should in theory never occur.
+        LOG(WARNING) << "Encountered a vertex without any assigned nodes";
+        vertexWeightsPtr += 2;
+      } else {
+        LOG(ERROR) << "Deformation graph decoding error: Read past vertexWeightsEndPtr";
+        vertexWeightsPtr = vertexWeightsEndPtr;
+        vertexWeightsExhausted = true;
+      }
+      nodeIndices = 0;
+      nodeWeights = 0;
+    }
+    
+    memcpy(&uniqueVertexWeights[i].nodeIndices, &nodeIndices, sizeof(u64));
+    memcpy(&uniqueVertexWeights[i].nodeWeights, &nodeWeights, sizeof(u32));
+    StoreVertex(position, texcoords, nodeIndices, nodeWeights, &outVertices[i]);
+  }
+  
+  if (vertexWeightsPtr < vertexWeightsEndPtr) {
+    LOG(ERROR) << "Deformation graph decoding error: Vertex count does not match";
+  }
+  
+  // Duplicated vertices
+  for (u32 i = metadata.uniqueVertexCount; i < metadata.vertexCount; ++ i) {
+    const u32 sourceVertex = parts.duplicatedVertexSourceIndices[i - metadata.uniqueVertexCount];
+    
+    const u64 position = LoadPosition(parts.uniqueVertexData + 3 * sourceVertex);
+    u32 texcoords;
+    memcpy(&texcoords, parts.encodedTexcoordData + 2 * i, sizeof(u32));
+    u64 nodeIndices;
+    memcpy(&nodeIndices, &uniqueVertexWeights[sourceVertex].nodeIndices, sizeof(u64));
+    u32 nodeWeights;
+    memcpy(&nodeWeights, &uniqueVertexWeights[sourceVertex].nodeWeights, sizeof(u32));
+    
+    StoreVertex(position, texcoords, nodeIndices, nodeWeights, &outVertices[i]);
+  }
+}
+
+void XRVideoDecodeRenderableVerticesTwoPass(
+    const XRVideoFrameMetadata& metadata,
+    const u8* meshData,
+    XRVideoScratchBuffer* vertexWeightsScratch,
+    XRVideoVertex* outVertices) {
+  const MeshDataParts parts = GetMeshDataParts(metadata, meshData);
+  
+  VertexWeights* decodedVertexWeights = vertexWeightsScratch->Get<VertexWeights>(metadata.vertexCount);
+  DecodeVertexWeights(metadata, parts.encodedVertexWeights, decodedVertexWeights);
+  WriteRenderableVertices(metadata, parts.uniqueVertexData, parts.duplicatedVertexSourceIndices, parts.encodedTexcoordData, decodedVertexWeights, outVertices);
+}
+
+/// Resizes outVertexAlpha to the decompressed size of the vertex alpha data and returns a job to decompress it there.
+static bool SetUpVertexAlphaDecompression(const XRVideoFrameMetadata& metadata, const u8* compressedVertexAlpha, vector<u8>* outVertexAlpha, XRVideoDecodingContext* decodingContext, XRVideoDecompressionJob* job) {
   // NOTE: We use ZSTD_getFrameContentSize() to get the decompressed size here because for dependent frames,
   //       the vertex count is not known here during decoding.
-  unsigned long long decompressedSize = ZSTD_getFrameContentSize(*dataPtr, metadata.compressedVertexAlphaSize);
+  unsigned long long decompressedSize = ZSTD_getFrameContentSize(compressedVertexAlpha, metadata.compressedVertexAlphaSize);
   if (decompressedSize == ZSTD_CONTENTSIZE_UNKNOWN) {
     LOG(ERROR) << "Got ZSTD_CONTENTSIZE_UNKNOWN while decompressing vertex alpha";
     return false;
@@ -304,16 +434,16 @@ static bool DecompressVertexAlphaData(const XRVideoFrameMetadata& metadata, vect
     return false;
   }
   
-  outVertexAlpha->resize(decompressedSize);
-  
-  if (!DecompressWithZStd(
-      *dataPtr, metadata.compressedVertexAlphaSize,
-      outVertexAlpha->data(), /*destCapacity*/ decompressedSize, /*expectedSize*/ decompressedSize,
-      "Vertex alpha data", verboseDecoding, zstdCtx)) {
-    return false;
+  if (decompressedSize > outVertexAlpha->capacity()) {
+    decodingContext->CountVertexAlphaAllocation();
   }
-  *dataPtr += metadata.compressedVertexAlphaSize;
+  outVertexAlpha->resize(decompressedSize);
   
+  job->name = "Vertex alpha data";
+  job->src = compressedVertexAlpha;
+  job->compressedSize = metadata.compressedVertexAlphaSize;
+  job->dest = outVertexAlpha->data();
+  job->destCapacity = decompressedSize;
   return true;
 }
 
@@ -327,25 +457,81 @@ bool XRVideoDecompressContent(
     u16* outDuplicatedVertexSourceIndices,
     vector<u8>* outVertexAlpha,
     bool verboseDecoding) {
-  const u8* dataPtr = content;
+  XRVideoPipelineStatistics* pipelineStatistics = decodingContext->GetPipelineStatistics();
   
   TimePoint decompressionStartTime;
-  if (verboseDecoding) {
+  if (verboseDecoding || pipelineStatistics) {
     decompressionStartTime = Clock::now();
   }
   
-  // Decompress the mesh data for keyframes
-  vector<u8> meshData;
-  u32 encodedTexcoordDataSize = 0;
-  if (metadata.isKeyframe &&
-      !DecompressMeshData(metadata, &meshData, &encodedTexcoordDataSize, &dataPtr, verboseDecoding, decodingContext->GetZStdContext())) {
-    return false;
+  // Set up the decompression of the frame's independently compressed parts. The texture is decoded by the VideoThread.
+  const u8* compressedMeshData = content;
+  const u8* compressedDeformationState = compressedMeshData + (metadata.isKeyframe ? metadata.compressedMeshSize : 0);
+  const u8* compressedVertexAlpha = compressedDeformationState + metadata.compressedDeformationStateSize + metadata.compressedRGBSize;
+  
+  constexpr int maxDecompressionJobCount = 3;
+  XRVideoDecompressionJob decompressionJobs[maxDecompressionJobCount];
+  int decompressionJobCount = 0;
+  
+  const u8* meshData = nullptr;
+  if (metadata.isKeyframe) {
+    const usize meshDataSize = metadata.GetMeshDataSize();
+    u8* meshDataBuffer = decodingContext->GetMeshDataScratchBuffer().Get<u8>(meshDataSize);
+    meshData = meshDataBuffer;
+    
+    XRVideoDecompressionJob& job = decompressionJobs[decompressionJobCount++];
+    job.name = "Mesh data";
+    job.src = compressedMeshData;
+    job.compressedSize = metadata.compressedMeshSize;
+    job.dest = meshDataBuffer;
+    job.destCapacity = meshDataSize;
   }
   
-  // Decompress the deformation state data
-  if (metadata.compressedDeformationStateSize > 0 &&
-      !DecompressDeformationStateData(metadata, outDeformationState, &dataPtr, verboseDecoding, decodingContext->GetZStdContext())) {
-    return false;
+  const u32 encodedDeformationStateValueCount = metadata.GetDeformationStateDataSize() / sizeof(float);
+  u16* encodedDeformationState = nullptr;
+  if (metadata.compressedDeformationStateSize > 0) {
+    encodedDeformationState = decodingContext->GetDeformationStateScratchBuffer().Get<u16>(encodedDeformationStateValueCount);
+    
+    XRVideoDecompressionJob& job = decompressionJobs[decompressionJobCount++];
+    job.name = "Deformation state data";
+    job.src = compressedDeformationState;
+    job.compressedSize = metadata.compressedDeformationStateSize;
+    job.dest = reinterpret_cast<u8*>(encodedDeformationState);
+    job.destCapacity = encodedDeformationStateValueCount * sizeof(u16);
+  }
+  
+  if (outVertexAlpha) {
+    outVertexAlpha->clear();
+    
+    if (metadata.compressedVertexAlphaSize > 0 &&
+        !SetUpVertexAlphaDecompression(metadata, compressedVertexAlpha, outVertexAlpha, decodingContext, &decompressionJobs[decompressionJobCount++])) {
+      return false;
+    }
+  }
+  
+  // Run the decompression, in parallel if the decoding context has decompression workers.
+  // The largest parts are started first, since they determine the overall latency.
+  XRVideoDecompressionWorkers* decompressionWorkers = decodingContext->GetDecompressionWorkers();
+  if (decompressionWorkers && decompressionJobCount > 1) {
+    sort(decompressionJobs, decompressionJobs + decompressionJobCount, [](const XRVideoDecompressionJob& a, const XRVideoDecompressionJob& b) {
+      return a.compressedSize > b.compressedSize;
+    });
+    decompressionWorkers->Run(decompressionJobs, decompressionJobCount, decodingContext->GetZStdContext());
+  } else {
+    for (int i = 0; i < decompressionJobCount; ++ i) {
+      decompressionJobs[i].Run(decodingContext->GetZStdContext());
+    }
+  }
+  
+  for (int i = 0; i < decompressionJobCount; ++ i) {
+    if (!CheckDecompressionJobResult(decompressionJobs[i], verboseDecoding)) {
+      return false;
+    }
+  }
+  
+  // Decode the deformation state values
+  if (encodedDeformationState) {
+    XRVideoDecodeDeformationState(encodedDeformationState, encodedDeformationStateValueCount, outDeformationState);
   }
   
   // Convert the mesh to renderable format
@@ -358,37 +544,17 @@ bool XRVideoDecompressContent(
     // TODO: This should better be done on the GPU with a compute shader for better performance.
     //       Note that compute shaders are only supported from OpenGL ES 3.1 on,
     //       however they could be emulated with a fragment shader / transform feedback.
-    // Set pointers to the mesh data parts (vertices, indices, texcoords)
-    const u8* meshDataPtr = meshData.data();
-    
-    const u16* uniqueVertexData = reinterpret_cast<const u16*>(meshDataPtr);
-    meshDataPtr += metadata.uniqueVertexCount * 3 * sizeof(u16);
-    
-    const u16* duplicatedVertexSourceIndices = reinterpret_cast<const u16*>(meshDataPtr);
-    meshDataPtr += (metadata.vertexCount - metadata.uniqueVertexCount) * sizeof(u16);
-    
-    const u16* encodedTexcoordData = reinterpret_cast<const u16*>(meshDataPtr);
-    meshDataPtr += encodedTexcoordDataSize;
-    
-    const u16* indexData = reinterpret_cast<const u16*>(meshDataPtr);
-    meshDataPtr += metadata.GetIndexDataSize();
-    
-    const u8* encodedVertexWeights = reinterpret_cast<const u8*>(meshDataPtr);
-    meshDataPtr += metadata.encodedVertexWeightsSize;
+    const MeshDataParts parts = GetMeshDataParts(metadata, meshData);
     
     // Copy the index data to the output
-    memcpy(outIndices, indexData, metadata.GetIndexDataSize());
+    memcpy(outIndices, parts.indexData, metadata.GetIndexDataSize());
     
-    // Decode the vertex weights (node indices and node weights)
-    vector<VertexWeights> decodedVertexWeights;
-    DecodeVertexWeights(metadata, encodedVertexWeights, &decodedVertexWeights);
-    
-    // Write out the renderable vertices
-    WriteRenderableVertices(metadata, uniqueVertexData, duplicatedVertexSourceIndices, encodedTexcoordData, decodedVertexWeights.data(), static_cast<XRVideoVertex*>(outVertices));
+    // Decode the vertex weights (node indices and node weights) and write out the renderable vertices
+    XRVideoDecodeRenderableVertices(metadata, meshData, &decodingContext->GetVertexWeightsScratchBuffer(), static_cast<XRVideoVertex*>(outVertices));
     
     // If non-null, copy the duplicated source vertices indices to the output
     if (outDuplicatedVertexSourceIndices != nullptr) {
-      memcpy(outDuplicatedVertexSourceIndices, duplicatedVertexSourceIndices, (metadata.vertexCount - metadata.uniqueVertexCount) * sizeof(u16));
+      memcpy(outDuplicatedVertexSourceIndices, parts.duplicatedVertexSourceIndices, (metadata.vertexCount - metadata.uniqueVertexCount) * sizeof(u16));
     }
     
     if (verboseDecoding) {
@@ -397,20 +563,14 @@ bool XRVideoDecompressContent(
     }
   }
   
-  // Decompress the vertex alpha data
-  dataPtr += metadata.compressedRGBSize;
-  if (outVertexAlpha) {
-    outVertexAlpha->clear();
-    
-    if (metadata.compressedVertexAlphaSize > 0 &&
-        !DecompressVertexAlphaData(metadata, outVertexAlpha, &dataPtr, verboseDecoding, decodingContext->GetZStdContext())) {
-      return false;
-    }
-  }
-  
-  if (verboseDecoding) {
+  if (verboseDecoding || pipelineStatistics) {
     const TimePoint decompressionEndTime = Clock::now();
-    LOG(1) << "Frame decoded in " << (MillisecondsDuration(decompressionEndTime - decompressionStartTime).count()) << " ms";
+    if (pipelineStatistics) {
+      pipelineStatistics->Record(XRVideoPipelineStage::ContentDecoding, NanosecondsFromTo(decompressionStartTime, decompressionEndTime));
+    }
+    if (verboseDecoding) {
+      LOG(1) << "Frame decoded in " << (MillisecondsDuration(decompressionEndTime - decompressionStartTime).count()) << " ms";
+    }
   }
   
   return true;
@@ -419,6 +579,12 @@ bool XRVideoDecompressContent(
 void XRVideoCopyTexture(const Dav1dPicture& picture, u8* outTexture, bool verboseDecoding) {
   const usize lumaPixelCount = picture.p.w * picture.p.h;
   
+  if (XRVideoIsContiguousTexture(picture)) {
+    // The picture already has the output layout, so it can be copied in one go
+    memcpy(outTexture, picture.data[0], (lumaPixelCount * 3) / 2);
+    return;
+  }
+  
   XRVideoCopyTexture(
       picture,
       outTexture,
@@ -427,6 +593,16 @@ void XRVideoCopyTexture(const Dav1dPicture& picture, u8* outTexture, bool verbos
       verboseDecoding);
 }
 
+bool XRVideoIsContiguousTexture(const Dav1dPicture& picture) {
+  const usize lumaPixelCount = picture.p.w * picture.p.h;
+  const u8* luma = static_cast<const u8*>(picture.data[0]);
+  
+  return picture.stride[0] == picture.p.w &&
+         picture.stride[1] == picture.p.w / 2 &&
+         picture.data[1] == luma + lumaPixelCount &&
+         picture.data[2] == luma + (lumaPixelCount * 5) / 4;
+}
+
 void XRVideoCopyTexture(const Dav1dPicture& picture, u8* outTextureLuma, u8* outTextureChromaU, u8* outTextureChromaV, bool verboseDecoding) {
   const int width = picture.p.w;
   const int height = picture.p.h;
@@ -441,7 +617,7 @@ void XRVideoCopyTexture(const Dav1dPicture& picture, u8* outTextureLuma, u8* out
       // Tight packing
       memcpy(outTextureLuma, picture.data[0], width * height);
     } else {
-      for (u32 y = 0; y < height; ++ y) {
+      for (int y = 0; y < height; ++ y) {
         memcpy(
             outTextureLuma + y * width,
             static_cast<const u8*>(picture.data[0]) + y * picture.stride[0],
@@ -463,7 +639,7 @@ void XRVideoCopyTexture(const Dav1dPicture& picture, u8* outTextureLuma, u8* out
           (width * height) / 4);
     } else {
       const u32 tightStride = width / 2;
-      for (u32 y = 0; y < height / 2; ++ y) {
+      for (int y = 0; y < height / 2; ++ y) {
         memcpy(
             outTextureChromaU + y * tightStride,
             static_cast<const u8*>(picture.data[1]) + y * picture.stride[1],
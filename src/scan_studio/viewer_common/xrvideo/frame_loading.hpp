@@ -1,17 +1,22 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
 #include <vector>
 
 #include <libvis/vulkan/libvis.h>
 
+#include "scan_studio/viewer_common/xrvideo/decompression_workers.hpp"
+
 typedef struct Dav1dPicture Dav1dPicture;
 typedef struct ZSTD_DCtx_s ZSTD_DCtx;
 
 namespace scan_studio {
 using namespace vis;
 
+class XRVideoPipelineStatistics;
+
 // This file contains functions to load XRVideo frames from their compressed storage format.
 
 #pragma pack(push, 1)
@@ -104,6 +109,17 @@ struct XRVideoFrameMetadata {
     return indexCount * sizeof(u16);
   }
   
+  /// Size in bytes of the decompressed mesh data (for keyframes only).
+  /// It consists of the unique vertex positions, the source indices of the duplicated vertices,
+  /// the texture coordinates, the indices, and the encoded vertex weights, in this order.
+  inline u32 GetMeshDataSize() const {
+    return uniqueVertexCount * 3 * sizeof(u16) +
+           (vertexCount - uniqueVertexCount) * sizeof(u16) +
+           vertexCount * 2 * sizeof(u16) +
+           GetIndexDataSize() +
+           encodedVertexWeightsSize;
+  }
+  
   /// Size in bytes of the deformation state
   inline u32 GetDeformationStateDataSize() const {
     return deformationNodeCount * 12 * sizeof(float);
@@ -114,6 +130,12 @@ struct XRVideoFrameMetadata {
     return zstdRGBTexture ? (textureWidth * textureHeight * 3) : ((textureWidth * textureHeight * 3) / 2);
   }
   
+  /// Approximate size in bytes of the frame's decoded data (renderable vertices and indices for keyframes,
+  /// deformation state, and texture), as held in a decoded frame cache item.
+  inline u32 GetDecodedDataSize() const {
+    return GetRenderableVertexDataSize() + (isKeyframe ? GetIndexDataSize() : 0) + GetDeformationStateDataSize() + GetTextureDataSize();
+  }
+  
   /// Size in bytes required for the luma part of the texture
   inline u32 GetTextureLumaDataSize() const { return textureWidth * textureHeight; }
   /// Size in bytes required for the chroma parts of the texture
@@ -125,18 +147,95 @@ struct XRVideoFrameMetadata {
   inline float GetBBoxMaxZ() const { return vertexFactorZ * UINT16_MAX + bboxMinZ; }
 };
 
+/// Growable scratch memory that is reused across decoded frames,
+/// such that decoding does not need to perform heap allocations once the buffer is large enough.
+/// The buffer only grows, and it does not preserve its content when it grows.
+class XRVideoScratchBuffer {
+ public:
+  /// Returns a pointer to storage for at least `count` elements of type T,
+  /// growing the buffer if it is too small.
+  template <typename T>
+  inline T* Get(usize count) {
+    const usize size = count * sizeof(T);
+    if (size > capacity) {
+      // Grow with some headroom, such that slowly increasing frame sizes do not cause an allocation for each frame
+      capacity = std::max(size, capacity + capacity / 2);
+      data.reset(new u8[capacity]);
+      ++ allocationCount;
+    }
+    return reinterpret_cast<T*>(data.get());
+  }
+  
+  /// Frees the buffer's memory.
+  inline void Release() {
+    data.reset();
+    capacity = 0;
+  }
+  
+  inline usize GetCapacity() const { return capacity; }
+  
+  /// Returns the number of times that the buffer allocated memory.
+  inline u32 GetAllocationCount() const { return allocationCount; }
+  
+ private:
+  unique_ptr<u8[]> data;
+  usize capacity = 0;
+  atomic<u32> allocationCount = {0};
+};
+
 /// Groups necessary context data to decode XRVideo frames.
 /// TODO: This used to contain the dav1d context as well.
 ///       Now that the dav1d context was moved out, should this be renamed / dissolved?
 class XRVideoDecodingContext {
  public:
-  bool Initialize();
+  /// Initializes the context. If decompressionWorkerCount is larger than zero, XRVideoDecompressContent() decompresses
+  /// the independent parts of each frame (mesh data, deformation state, vertex alpha) in parallel,
+  /// using this many additional worker threads.
+  bool Initialize(int decompressionWorkerCount = 0);
   void Destroy();
   
   inline ZSTD_DCtx* GetZStdContext() const { return zstdCtx.get(); }
   
+  /// Returns the decompression workers, or nullptr if the context was initialized without them.
+  inline XRVideoDecompressionWorkers* GetDecompressionWorkers() const { return decompressionWorkers.get(); }
+  
+  /// If set to non-null, XRVideoDecompressContent() records its duration in the given statistics object.
+  inline void SetPipelineStatistics(XRVideoPipelineStatistics* statistics) { pipelineStatistics = statistics; }
+  inline XRVideoPipelineStatistics* GetPipelineStatistics() const { return pipelineStatistics.load(); }
+  
+  /// Scratch buffers used by XRVideoDecompressContent() for intermediate data.
+  /// They grow to the largest mesh and deformation node counts encountered in the video and are then reused for all following frames.
+  inline XRVideoScratchBuffer& GetMeshDataScratchBuffer() { return meshDataScratch; }
+  inline XRVideoScratchBuffer& GetDeformationStateScratchBuffer() { return deformationStateScratch; }
+  inline XRVideoScratchBuffer& GetVertexWeightsScratchBuffer() { return vertexWeightsScratch; }
+  
+  /// Vertex alpha buffer that may be passed to XRVideoDecompressContent() by callers that
+  /// only need the vertex alpha data temporarily, to avoid allocating a new vector for each frame.
+  inline vector<u8>* GetVertexAlphaScratchVector() { return &vertexAlphaScratch; }
+  
+  /// Counts reallocations of vertex alpha vectors passed to XRVideoDecompressContent() with this context.
+  inline void CountVertexAlphaAllocation() { ++ vertexAlphaAllocationCount; }
+  
+  /// Returns the total number of heap allocations that decoding with this context has performed for intermediate data
+  /// (including those for growing vertex alpha vectors passed to XRVideoDecompressContent()).
+  /// Once all scratch buffers have grown to the sizes required by the video, this stays constant during playback.
+  inline u64 GetScratchAllocationCount() const {
+    return static_cast<u64>(meshDataScratch.GetAllocationCount()) +
+           deformationStateScratch.GetAllocationCount() +
+           vertexWeightsScratch.GetAllocationCount() +
+           vertexAlphaAllocationCount;
+  }
+  
  private:
   shared_ptr<ZSTD_DCtx> zstdCtx;
+  unique_ptr<XRVideoDecompressionWorkers> decompressionWorkers;
+  atomic<XRVideoPipelineStatistics*> pipelineStatistics = {nullptr};
+  
+  XRVideoScratchBuffer meshDataScratch;
+  XRVideoScratchBuffer deformationStateScratch;
+  XRVideoScratchBuffer vertexWeightsScratch;
+  vector<u8> vertexAlphaScratch;
+  atomic<u32> vertexAlphaAllocationCount = {0};
 };
 
 /// Reads the given XRVideo frame's metadata.
@@ -219,6 +318,32 @@ bool XRVideoDecompressContent(
     vector<u8>* outVertexAlpha,
     bool verboseDecoding);
 
+/// Writes the renderable vertices of a keyframe, given its decompressed mesh data (see XRVideoFrameMetadata::GetMeshDataSize()).
+/// This is called by XRVideoDecompressContent() and is exposed for testing and benchmarking.
+///
+/// The vertex weights are decoded in the same pass that writes the unique vertices, and each vertex is written
+/// with sequential stores of whole components, such that `outVertices` may point to write-combined (e.g., mapped GPU) memory.
+/// `outVertices` is never read from. Duplicated vertices get their weights from a compact copy of the unique vertices'
+/// weights that is kept in `vertexWeightsScratch` for this purpose.
+void XRVideoDecodeRenderableVertices(
+    const XRVideoFrameMetadata& metadata,
+    const u8* meshData,
+    XRVideoScratchBuffer* vertexWeightsScratch,
+    XRVideoVertex* outVertices);
+
+/// Reference implementation of XRVideoDecodeRenderableVertices() that first decodes all vertex weights
+/// into `vertexWeightsScratch` and then writes the vertices in a second pass.
+void XRVideoDecodeRenderableVerticesTwoPass(
+    const XRVideoFrameMetadata& metadata,
+    const u8* meshData,
+    XRVideoScratchBuffer* vertexWeightsScratch,
+    XRVideoVertex* outVertices);
+
+/// Returns whether the planes of the given picture use a tight stride and directly follow each other in memory
+/// (Y, U, V), i.e., whether picture.data[0] points to texture data in the layout that XRVideoCopyTexture() outputs.
+/// This is the case for pictures allocated by Dav1dPicturePool if the texture size is a multiple of 128.
+bool XRVideoIsContiguousTexture(const Dav1dPicture& picture);
+
 /// Copies the YUV texture data out of the Dav1dPicture object to continuous storage.
 /// The Y, U, and V parts follow each other in that order.
 void XRVideoCopyTexture(
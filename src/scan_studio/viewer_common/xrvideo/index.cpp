@@ -1,5 +1,7 @@
 #include "scan_studio/viewer_common/xrvideo/index.hpp"
 
+#include <algorithm>
+#include <cstdio>
 #include <limits>
 #include <memory>
 
@@ -9,8 +11,25 @@
 
 #include "scan_studio/common/xrvideo_file.hpp"
 
+#include "scan_studio/viewer_common/timing.hpp"
+#include "scan_studio/viewer_common/util.hpp"
+
 namespace scan_studio {
 
+/// Header of sidecar index files (see FrameIndex::SaveToSidecarFile()).
+/// It is followed by the zstd-compressed index array, in the same format as in index chunks (see XRVideoIndexChunkScheme).
+typedef BufferScheme<
+    BufferField<u32>,  // magic (set to frameIndexSidecarMagic)
+    BufferField<u8>,   // version (set to frameIndexSidecarCurrentVersion)
+    BufferField<u64>,  // size of the video in bytes
+    BufferField<u64>,  // hash of the first and last bytes of the video (see FrameIndex::ComputeSidecarKey())
+    BufferField<u64>,  // file offset of the first frame chunk in the video
+    BufferField<u32>   // size of the compressed index array that follows
+    > FrameIndexSidecarHeaderScheme;
+
+constexpr u32 frameIndexSidecarMagic = 0x49565258;  // "XRVI" in little endian
+constexpr u8 frameIndexSidecarCurrentVersion = 0;
+
 FrameIndex::FrameIndex() {}
 
 bool FrameIndex::CreateFromIndexChunk(XRVideoReader* reader) {
@@ -48,37 +67,200 @@ bool FrameIndex::CreateFromIndexChunk(XRVideoReader* reader) {
     return false;
   }
   
+  // Seek to the first frame chunk to determine the file offset on which to start summing the frame sizes onto
+  if (!reader->FindNextChunk(xrVideoFrameChunkIdentifierV0)) {
+    LOG(ERROR) << "Failed to read index from chunk: Failed to seek to the first frame chunk";
+    return false;
+  }
+  
+  return CreateFromCompressedIndexArray(compressedIndexArray.data(), compressedIndexArray.size(), reader->GetFileOffset());
+}
+
+bool FrameIndex::CreateFromFrameHeaders(XRVideoReader* reader, const atomic<bool>& quitRequested) {
+  Clear();
+  
+  const u64 streamSize = reader->GetStreamSize();
+  
+  s64 startTimestamp;
+  s64 endTimestamp;
+  s64 lastFrameEndTimestamp = numeric_limits<s64>::lowest();
+  bool isKeyframe;
+  u64 frameOffsetInFile;
+  u64 lastFrameEndOffset = reader->GetFileOffset();
+  
+  while (reader->ReadNextFrameHeader(&startTimestamp, &endTimestamp, &isKeyframe, &frameOffsetInFile)) {
+    if (reader->GetFileOffset() > streamSize) {
+      LOG(WARNING) << "File is truncated";
+      break;
+    }
+    
+    PushFrame(startTimestamp, frameOffsetInFile, isKeyframe);
+    lastFrameEndTimestamp = endTimestamp;
+    lastFrameEndOffset = reader->GetFileOffset();
+    
+    if (quitRequested) { return false; }
+  }
+  
+  PushVideoEnd(lastFrameEndTimestamp, lastFrameEndOffset);
+  return true;
+}
+
+bool FrameIndex::LoadFromSidecarFile(const fs::path& path, XRVideoReader* reader) {
+  FILE* file = fopen(path.string().c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  
+  vector<u8> data;
+  vector<u8> readBuffer(64 * 1024);
+  while (true) {
+    const usize bytesRead = fread(readBuffer.data(), 1, readBuffer.size(), file);
+    if (bytesRead == 0) { break; }
+    data.insert(data.end(), readBuffer.begin(), readBuffer.begin() + bytesRead);
+  }
+  fclose(file);
+  
+  if (data.size() < FrameIndexSidecarHeaderScheme::GetConstantSize()) {
+    LOG(WARNING) << "The sidecar index file is truncated: " << path.string();
+    return false;
+  }
+  
+  u32 magic;
+  u8 version;
+  u64 videoSize;
+  u64 videoHash;
+  u64 firstFrameOffset;
+  u32 compressedIndexArraySize;
+  StructuredVectorReader<FrameIndexSidecarHeaderScheme>(data)
+      .Read(&magic)
+      .Read(&version)
+      .Read(&videoSize)
+      .Read(&videoHash)
+      .Read(&firstFrameOffset)
+      .Read(&compressedIndexArraySize);
+  if (magic != frameIndexSidecarMagic || version != frameIndexSidecarCurrentVersion) {
+    LOG(WARNING) << "The sidecar index file has an unknown format: " << path.string();
+    return false;
+  }
+  if (data.size() != FrameIndexSidecarHeaderScheme::GetConstantSize() + compressedIndexArraySize) {
+    LOG(WARNING) << "The sidecar index file is truncated: " << path.string();
+    return false;
+  }
+  
+  // Check that the sidecar file belongs to the video
+  u64 actualVideoSize;
+  u64 actualVideoHash;
+  if (!ComputeSidecarKey(reader, &actualVideoSize, &actualVideoHash)) {
+    return false;
+  }
+  if (actualVideoSize != videoSize || actualVideoHash != videoHash) {
+    LOG(1) << "The sidecar index file belongs to a different video: " << path.string();
+    return false;
+  }
+  
+  return CreateFromCompressedIndexArray(data.data() + FrameIndexSidecarHeaderScheme::GetConstantSize(), compressedIndexArraySize, firstFrameOffset);
+}
+
+bool FrameIndex::SaveToSidecarFile(const fs::path& path, XRVideoReader* reader) const {
+  if (GetFrameCount() == 0) {
+    LOG(ERROR) << "Cannot save an empty index to a sidecar file";
+    return false;
+  }
+  
+  u64 videoSize;
+  u64 videoHash;
+  if (!ComputeSidecarKey(reader, &videoSize, &videoHash)) {
+    return false;
+  }
+  
+  // Create the index array in the same format as in index chunks, deriving the frame sizes from the offsets
+  const u32 chunkHeaderSize = XRVideoChunkHeaderScheme::GetConstantSize();
+  const int frameCount = GetFrameCount();
+  
+  vector<u8> indexArray(frameCount * XRVideoIndexArrayItemScheme::GetConstantSize() + sizeof(s64));
+  for (int frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
+    const u64 frameSize = offsets[frameIndex + 1] - offsets[frameIndex] - chunkHeaderSize;
+    if (frameSize >= xrVideoIndexArrayItemIsKeyframeBit) {
+      LOG(ERROR) << "Frame " << frameIndex << " is too large to be stored in a sidecar index file";
+      return false;
+    }
+    
+    StructuredVectorWriter<XRVideoIndexArrayItemScheme>(&indexArray, frameIndex * XRVideoIndexArrayItemScheme::GetConstantSize())
+        .Write(static_cast<u32>(frameSize) | ((baseKeyframes[frameIndex] == frameIndex) ? xrVideoIndexArrayItemIsKeyframeBit : 0))
+        .Write(timestamps[frameIndex]);
+  }
+  memcpy(indexArray.data() + indexArray.size() - sizeof(s64), &timestamps.back(), sizeof(s64));
+  
+  vector<u8> compressedIndexArray(ZSTD_compressBound(indexArray.size()));
+  const usize compressedIndexArraySize = ZSTD_compress(compressedIndexArray.data(), compressedIndexArray.size(), indexArray.data(), indexArray.size(), /*compressionLevel*/ 3);
+  if (ZSTD_isError(compressedIndexArraySize)) {
+    LOG(ERROR) << "Error compressing the sidecar index with zstd: " << ZSTD_getErrorName(compressedIndexArraySize);
+    return false;
+  }
+  
+  // Write to a temporary file first and then rename it, such that no incomplete sidecar file remains if writing fails
+  const fs::path temporaryPath = path.string() + ".tmp";
+  FILE* file = fopen(temporaryPath.string().c_str(), "wb");
+  if (!file) {
+    LOG(WARNING) << "Cannot open the sidecar index file for writing: " << temporaryPath.string();
+    return false;
+  }
+  
+  StructuredFileWriter<FrameIndexSidecarHeaderScheme>(file)
+      .Write(frameIndexSidecarMagic)
+      .Write(frameIndexSidecarCurrentVersion)
+      .Write(videoSize)
+      .Write(videoHash)
+      .Write(offsets[0])
+      .Write(static_cast<u32>(compressedIndexArraySize));
+  const bool success = fwrite(compressedIndexArray.data(), 1, compressedIndexArraySize, file) == compressedIndexArraySize;
+  if (fclose(file) != 0 || !success) {
+    LOG(WARNING) << "Failed to write the sidecar index file: " << temporaryPath.string();
+    fs::remove(temporaryPath);
+    return false;
+  }
+  
+  error_code errorCode;
+  fs::rename(temporaryPath, path, errorCode);
+  if (errorCode) {
+    LOG(WARNING) << "Failed to rename the sidecar index file to: " << path.string() << " (" << errorCode.message() << ")";
+    fs::remove(temporaryPath, errorCode);
+    return false;
+  }
+  
+  return true;
+}
+
+bool FrameIndex::CreateFromCompressedIndexArray(const u8* compressedIndexArray, usize compressedIndexArraySize, u64 firstFrameOffset) {
+  Clear();
+  
   // Decompress the index array
   shared_ptr<ZSTD_DCtx> zstdCtx(ZSTD_createDCtx(), [](ZSTD_DCtx* ctx) { ZSTD_freeDCtx(ctx); });
   
-  const unsigned long long indexArraySize = ZSTD_getFrameContentSize(compressedIndexArray.data(), compressedIndexArraySize);
+  const unsigned long long indexArraySize = ZSTD_getFrameContentSize(compressedIndexArray, compressedIndexArraySize);
   if (indexArraySize == ZSTD_CONTENTSIZE_UNKNOWN || indexArraySize == ZSTD_CONTENTSIZE_ERROR) {
     LOG(ERROR) << "ZSTD_getFrameContentSize() failed, return value: " << indexArraySize << " (compressedIndexArraySize: " << compressedIndexArraySize << ")";
     return false;
   }
   
   vector<u8> indexArray(indexArraySize);
-  const usize decompressedBytes = ZSTD_decompressDCtx(zstdCtx.get(), indexArray.data(), indexArraySize, compressedIndexArray.data(), compressedIndexArraySize);
+  const usize decompressedBytes = ZSTD_decompressDCtx(zstdCtx.get(), indexArray.data(), indexArraySize, compressedIndexArray, compressedIndexArraySize);
   if (ZSTD_isError(decompressedBytes)) {
     LOG(ERROR) << "Error decompressing index chunk data with zstd: " << ZSTD_getErrorName(decompressedBytes)
                << " (compressedIndexArraySize: " << compressedIndexArraySize << ", indexArraySize: " << indexArraySize << ")";
     return false;
   }
   
-  // Seek to the first frame chunk to determine the file offset on which to start summing the frame sizes onto
-  if (!reader->FindNextChunk(xrVideoFrameChunkIdentifierV0)) {
-    LOG(ERROR) << "Failed to read index from chunk: Failed to seek to the first frame chunk";
-    return false;
-  }
-  
   // Parse the index array
   const usize indexArrayItemSize = XRVideoIndexArrayItemScheme::GetConstantSize();
   const usize frameCount = (indexArraySize - sizeof(s64)) / indexArrayItemSize;
-  frames.reserve(frameCount);
+  timestamps.reserve(frameCount + 1);
+  offsets.reserve(frameCount + 1);
+  baseKeyframes.reserve(frameCount + 1);
   
   const u32 chunkHeaderSize = XRVideoChunkHeaderScheme::GetConstantSize();
   
-  u64 currentFileOffset = reader->GetFileOffset();
+  u64 currentFileOffset = firstFrameOffset;
   
   for (usize frameIndex = 0; frameIndex < frameCount; ++ frameIndex) {
     u32 frameSizeInBytesAndIsKeyframeFlag;
@@ -98,29 +280,98 @@ bool FrameIndex::CreateFromIndexChunk(XRVideoReader* reader) {
   return true;
 }
 
+bool FrameIndex::ComputeSidecarKey(XRVideoReader* reader, u64* videoSize, u64* videoHash) {
+  // Hash the video size and its first and last bytes (FNV-1a). This detects changed videos without reading them completely.
+  constexpr usize hashedBytesAtEachEnd = 64 * 1024;
+  
+  // Seek first, since this resets the error state of some input streams after reading past the end, which SizeInBytes() may depend on
+  if (!reader->Seek(0)) {
+    LOG(ERROR) << "Failed to seek to the start of the video for identifying its sidecar index file";
+    return false;
+  }
+  
+  *videoSize = reader->GetStreamSize();
+  *videoHash = HashFNV1a(videoSize, sizeof(*videoSize));
+  
+  const usize headSize = std::min<u64>(*videoSize, hashedBytesAtEachEnd);
+  const usize tailSize = std::min<u64>(*videoSize - headSize, hashedBytesAtEachEnd);
+  vector<u8> buffer(std::max(headSize, tailSize));
+  
+  if (reader->Read(headSize, buffer.data()) != headSize) {
+    LOG(ERROR) << "Failed to read the start of the video for identifying its sidecar index file";
+    return false;
+  }
+  *videoHash = HashFNV1a(buffer.data(), headSize, *videoHash);
+  
+  if (!reader->Seek(*videoSize - tailSize) || reader->Read(tailSize, buffer.data()) != tailSize) {
+    LOG(ERROR) << "Failed to read the end of the video for identifying its sidecar index file";
+    return false;
+  }
+  *videoHash = HashFNV1a(buffer.data(), tailSize, *videoHash);
+  
+  return true;
+}
+
 void FrameIndex::Clear() {
-  frames.clear();
+  timestamps.clear();
+  offsets.clear();
+  baseKeyframes.clear();
+  minFrameDuration = -1;
+  maxFrameDuration = -1;
 }
 
 void FrameIndex::PushFrame(s64 startTimestamp, u64 offset, bool isKeyframe) {
-  frames.emplace_back(startTimestamp, offset, isKeyframe);
+  // Keep track of whether the frame rate is constant, judging from the start timestamps
+  // (the last frame may be shorter or longer, since its duration is determined by the video end timestamp)
+  const int frameCount = timestamps.size();
+  if (frameCount > 0) {
+    const s64 frameDuration = startTimestamp - timestamps[frameCount - 1];
+    minFrameDuration = (frameCount == 1) ? frameDuration : std::min(minFrameDuration, frameDuration);
+    maxFrameDuration = (frameCount == 1) ? frameDuration : std::max(maxFrameDuration, frameDuration);
+  }
+  
+  PushItem(startTimestamp, offset, isKeyframe);
 }
 
 void FrameIndex::PushVideoEnd(s64 endTimestamp, u64 endOffset) {
-  frames.emplace_back(endTimestamp, endOffset, /*isKeyframe*/ false);
+  PushItem(endTimestamp, endOffset, /*isKeyframe*/ false);
+}
+
+void FrameIndex::PushItem(s64 timestamp, u64 offset, bool isKeyframe) {
+  const int itemIndex = timestamps.size();
+  
+  timestamps.push_back(timestamp);
+  offsets.push_back(offset);
+  baseKeyframes.push_back(isKeyframe ? itemIndex : ((itemIndex > 0) ? baseKeyframes.back() : -1));
 }
 
 int FrameIndex::FindFrameIndexForTimestamp(s64 timestamp) const {
   if (timestamp < GetVideoStartTimestamp()) { return -1; }
   if (timestamp > GetVideoEndTimestamp()) { return -1; }
   
+  if (HasConstantFrameRate()) {
+    // Estimate the frame from the average frame duration, then correct the estimate against the timestamps,
+    // which may differ from the estimate by a frame due to rounding. The last frame extends until the video end timestamp.
+    const int frameCount = GetFrameCount();
+    const double framesPerNanosecond = (frameCount - 1) / static_cast<double>(timestamps[frameCount - 1] - timestamps[0]);
+    int frameIndex = std::min<s64>((timestamp - GetVideoStartTimestamp()) * framesPerNanosecond, frameCount - 1);
+    
+    while (frameIndex > 0 && timestamps[frameIndex] > timestamp) {
+      -- frameIndex;
+    }
+    while (frameIndex < frameCount - 1 && timestamps[frameIndex + 1] <= timestamp) {
+      ++ frameIndex;
+    }
+    return frameIndex;
+  }
+  
   int lowest = 0;
-  int highest = frames.size() - 2;  // exclude the dummy item at the end
+  int highest = timestamps.size() - 2;  // exclude the dummy item at the end
   
   while (lowest < highest) {
     const int mid = (lowest + highest + 1) / 2;
     
-    if (frames[mid].GetTimestamp() > timestamp) {
+    if (timestamps[mid] > timestamp) {
       highest = mid - 1;
     } else {
       lowest = mid;
@@ -134,12 +385,7 @@ void FrameIndex::FindDependencyFrames(int frameIndex, int* baseKeyframeIfNeeded,
   *baseKeyframeIfNeeded = -1;
   *predecessorIfNeeded = -1;
   
-  *baseKeyframeIfNeeded = frameIndex;
-  
-  while (*baseKeyframeIfNeeded >= 0 &&
-         !At(*baseKeyframeIfNeeded).IsKeyframe()) {
-    -- *baseKeyframeIfNeeded;
-  }
+  *baseKeyframeIfNeeded = baseKeyframes[frameIndex];
   if (*baseKeyframeIfNeeded < 0) {
     // This should never happen in theory, since the first frame should
     // always be guaranteed to be a keyframe.
@@ -155,5 +401,26 @@ void FrameIndex::FindDependencyFrames(int frameIndex, int* baseKeyframeIfNeeded,
   }
 }
 
+int FrameIndex::FindNextKeyframe(int frameIndex) const {
+  const int frameCount = GetFrameCount();
+  
+  int nextKeyframe = frameIndex + 1;
+  while (nextKeyframe < frameCount && baseKeyframes[nextKeyframe] != nextKeyframe) {
+    ++ nextKeyframe;
+  }
+  return std::min(nextKeyframe, frameCount);
+}
+
+bool FrameIndex::IsTimeAlignedWith(const FrameIndex& other) const {
+  return timestamps == other.timestamps && baseKeyframes == other.baseKeyframes;
+}
+
+double FrameIndex::ComputeBytesPerSecond() const {
+  if (timestamps.size() < 2) { return 0; }
+  
+  const double videoSeconds = NanosecondsToSeconds(GetVideoEndTimestamp() - GetVideoStartTimestamp());
+  return (videoSeconds > 0) ? ((offsets.back() - offsets.front()) / videoSeconds) : 0;
+}
+
 }
 
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 
+#include <libvis/io/filesystem.h>
 #include <libvis/vulkan/libvis.h>
 
 namespace scan_studio {
@@ -38,6 +40,10 @@ class FrameIndexItem {
 /// For very large files, we might want to load the video index only partially, or we might want to only store information
 /// about every Xth frame (from which we can start searching for the following frames X+1, X+2, ...), to save space. This could be
 /// implemented in this class.
+///
+/// The frame data is stored in separate arrays for the timestamps, offsets, and base keyframes (instead of an array of FrameIndexItems),
+/// such that the binary search for a timestamp only touches the timestamps. Each frame's base keyframe is precomputed,
+/// and if the frames have a constant frame rate, the frame for a timestamp is computed directly instead of searching for it.
 class FrameIndex {
  public:
   /// Constructs an empty frame index.
@@ -53,6 +59,22 @@ class FrameIndex {
   /// The given XRVideo reader's file cursor must be at the start of the file's index chunk.
   bool CreateFromIndexChunk(XRVideoReader* reader);
   
+  /// Creates the index by going over the frame chunks of the file, starting at the reader's current file cursor.
+  /// Only the frame headers are read, while the rest of the frame data is seeked over.
+  /// This is for files without an index chunk. `quitRequested` is polled to allow aborting for large files.
+  bool CreateFromFrameHeaders(XRVideoReader* reader, const atomic<bool>& quitRequested);
+  
+  /// Loads the index from a sidecar file that was written with SaveToSidecarFile() for the video that is read by the given reader.
+  /// Returns false if the file does not exist, cannot be parsed, or belongs to a different video. For the latter,
+  /// sidecar files are keyed by the video's size and a hash of its first and last bytes.
+  /// The reader's file cursor is undefined afterwards.
+  bool LoadFromSidecarFile(const fs::path& path, XRVideoReader* reader);
+  
+  /// Saves the index to a sidecar file for the video that is read by the given reader, such that it can be loaded
+  /// quickly with LoadFromSidecarFile() when opening the video again. This is useful for videos without an index chunk.
+  /// The reader's file cursor is undefined afterwards.
+  bool SaveToSidecarFile(const fs::path& path, XRVideoReader* reader) const;
+  
   /// Removes all frame data from the index.
   void Clear();
   
@@ -62,7 +84,8 @@ class FrameIndex {
   /// Sets the video end timestamp and end offset. Must be called exactly once after adding all frames.
   void PushVideoEnd(s64 endTimestamp, u64 endOffset);
   
-  /// Performs a binary search to find the frame that should be displayed at the given timestamp.
+  /// Finds the frame that should be displayed at the given timestamp. This is O(1) for videos with a constant frame rate
+  /// (see HasConstantFrameRate()), and performs a binary search otherwise.
   /// If the timestamp is out of the valid range for the video, returns -1.
   int FindFrameIndexForTimestamp(s64 timestamp) const;
   
@@ -71,24 +94,62 @@ class FrameIndex {
   /// or if such frames are not required to display frameIndex, then -1 is passed back there.
   /// Note that this function may return the same frame as base keyframe and as predecessor (if the
   /// frame after a keyframe is passed in as frameIndex).
+  /// This is O(1), since the base keyframe of each frame is precomputed.
   void FindDependencyFrames(int frameIndex, int* baseKeyframeIfNeeded, int* predecessorIfNeeded) const;
   
+  /// Returns the index of the first keyframe after the given frame, or GetFrameCount() if there is none.
+  int FindNextKeyframe(int frameIndex) const;
+  
+  /// Returns true if the other index has the same number of frames with the same timestamps and keyframes as this index
+  /// (while the offsets may differ). This is required for indices of different renditions of the same video,
+  /// such that playback can switch between the renditions at any keyframe.
+  bool IsTimeAlignedWith(const FrameIndex& other) const;
+  
+  /// Returns the average data rate of the video's frames in bytes per second of playback time,
+  /// or zero if the video has no duration.
+  double ComputeBytesPerSecond() const;
+  
   /// Returns the index item for the given frame index.
   ///
   /// Note that the first frame in an XRVideo is always guaranteed to be a keyframe
   /// (if not, XRVideo::TakeAndOpen() returns failure).
-  inline const FrameIndexItem& At(int frameIndex) const { return frames[frameIndex]; }
+  inline FrameIndexItem At(int frameIndex) const { return FrameIndexItem(timestamps[frameIndex], offsets[frameIndex], baseKeyframes[frameIndex] == frameIndex); }
+  
+  inline s64 GetVideoStartTimestamp() const { return timestamps.front(); }
+  inline s64 GetVideoEndTimestamp() const { return timestamps.back(); }
   
-  inline s64 GetVideoStartTimestamp() const { return frames.front().GetTimestamp(); }
-  inline s64 GetVideoEndTimestamp() const { return frames.back().GetTimestamp(); }
+  inline int GetFrameCount() const { return timestamps.size() - 1; }
   
-  inline int GetFrameCount() const { return frames.size() - 1; }
+  /// Returns true if all frames (except possibly the last one) have the same duration, up to a difference of one nanosecond
+  /// from rounding the timestamps (e.g., 30 fps videos have frame durations of 33333333 and 33333334 ns). In this case,
+  /// FindFrameIndexForTimestamp() computes the frame index directly.
+  inline bool HasConstantFrameRate() const { return minFrameDuration > 0 && maxFrameDuration - minFrameDuration <= 1; }
   
  private:
-  /// Vector of frame items. Contains a dummy item at the end whose timestamp is set
-  /// to the end timestamp of the last frame in the video, and whose offset is set to
-  /// the end offset of the last frame in the video.
-  vector<FrameIndexItem> frames;
+  /// Appends an item to the arrays below.
+  void PushItem(s64 timestamp, u64 offset, bool isKeyframe);
+  
+  /// Creates the index from the zstd-compressed index array of an index chunk (see XRVideoIndexChunkScheme),
+  /// given the file offset of the first frame chunk.
+  bool CreateFromCompressedIndexArray(const u8* compressedIndexArray, usize compressedIndexArraySize, u64 firstFrameOffset);
+  
+  /// Computes the key that identifies the video read by the given reader in sidecar files.
+  static bool ComputeSidecarKey(XRVideoReader* reader, u64* videoSize, u64* videoHash);
+  
+  /// Start timestamps of the frames in nanoseconds. Like the other arrays below, this contains
+  /// a dummy item at the end, whose timestamp is set to the end timestamp of the last frame in the video.
+  vector<s64> timestamps;
+  
+  /// File offsets of the frames. The dummy item at the end is set to the end offset of the last frame in the video.
+  vector<u64> offsets;
+  
+  /// For each frame, the index of the last keyframe at or before it (i.e., the frame itself for keyframes),
+  /// or -1 if there is none.
+  vector<int> baseKeyframes;
+  
+  /// The minimum and maximum duration of the frames (except the last one), or -1 if there are less than two frames.
+  s64 minFrameDuration = -1;
+  s64 maxFrameDuration = -1;
 };
 
 }
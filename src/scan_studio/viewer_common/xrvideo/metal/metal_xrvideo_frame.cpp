@@ -178,6 +178,13 @@ bool MetalXRVideoFrame::Initialize(
     storageBuffer->setLabel(NS::String::string("storageBuffer", NS::UTF8StringEncoding));
   }
   
+  // Re-create the textures if this frame is reused for a frame with a different texture size (e.g., of another rendition)
+  if (textureLuma && (textureLuma->width() != metadata.textureWidth || textureLuma->height() != metadata.textureHeight)) {
+    textureLuma.reset();
+    textureChromaU.reset();
+    textureChromaV.reset();
+  }
+  
   // Initialize textures (if not already allocated, e.g., when reusing this frame)
   if (!textureLuma || !textureChromaU || !textureChromaV) {
     if (!InitializeTextures(metadata.textureWidth, metadata.textureHeight)) {
@@ -187,7 +194,6 @@ bool MetalXRVideoFrame::Initialize(
   
   // Decompress the frame data
   // TODO: Is our access pattern to the write-combined memory buffers okay, or do we have to use page-locked memory only, or better a separate memcpy into write-combined memory?
-  vector<u8> vertexAlpha;
   if (!XRVideoDecompressContent(
       contentPtr, metadata, decodingContext,
       metadata.isKeyframe ? (useStagingBuffers ? verticesStagingBuffer->contents() : vertexBuffer->contents()) : nullptr,
@@ -322,6 +328,30 @@ void MetalXRVideoFrame::Destroy() {
   textureLuma.reset();
   textureChromaU.reset();
   textureChromaV.reset();
+  
+  vertexAlpha = vector<u8>();
+}
+
+void MetalXRVideoFrame::ReleaseResources() {
+  verticesStagingBuffer.reset();
+  indicesStagingBuffer.reset();
+  
+  storageStagingBuffer.reset();
+  alphaStagingBuffer.reset();
+  textureStagingBuffer.reset();
+  
+  if (!useExternalBuffers) {
+    vertexBuffer.reset();
+    indexBuffer.reset();
+    storageBuffer.reset();
+    alphaBuffer.reset();
+    
+    textureLuma.reset();
+    textureChromaU.reset();
+    textureChromaV.reset();
+  }
+  
+  vertexAlpha = vector<u8>();
 }
 
 void MetalXRVideoFrame::WaitForResourceTransfers() {
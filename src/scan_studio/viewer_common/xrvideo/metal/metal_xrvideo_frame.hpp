@@ -47,6 +47,10 @@ class MetalXRVideoFrame : public XRVideoFrame {
       bool verboseDecoding);
   void Destroy();
   
+  /// Releases the frame's buffers and textures after it got evicted from the decoded frame cache.
+  /// External buffers (see UseExternalBuffers()) and the textures in this case remain, since their owner may still refer to them.
+  void ReleaseResources();
+  
   void WaitForResourceTransfers();
   
   /// Adds the rendering commands to the render command encoder.
@@ -92,6 +96,9 @@ class MetalXRVideoFrame : public XRVideoFrame {
   NS::SharedPtr<MTL::Buffer> alphaStagingBuffer;
   NS::SharedPtr<MTL::Buffer> textureStagingBuffer;
   
+  /// Vertex alpha values of the last loaded frame, kept such that their memory gets reused when loading the next frame into this object.
+  vector<u8> vertexAlpha;
+  
   struct BlitCompleteSync {
     mutex blitCompleteMutex;
     bool blitComplete;
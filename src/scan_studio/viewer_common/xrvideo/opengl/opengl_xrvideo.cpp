@@ -89,12 +89,23 @@ int OpenGLXRVideo::Dav1dAllocPictureCallback(Dav1dPicture* pic) {
   
   pic->allocator_data = picture.textureDataPtr;
   
-  pic->stride[0] = dav1dZeroCopyVideoWidth;
-  pic->stride[1] = dav1dZeroCopyVideoWidth / 2;
+  // For videos with multiple renditions, the configured size is the maximum texture size of all renditions,
+  // and pictures of smaller renditions use the beginning of the allocation. The planes are laid out according
+  // to the picture's own size, since this is what the frame's texture gets allocated with.
+  const u32 pictureWidth = pic->p.w;
+  const u32 pictureHeight = pic->p.h;
+  if (pictureWidth > dav1dZeroCopyVideoWidth || pictureHeight > dav1dZeroCopyVideoHeight) {
+    LOG(ERROR) << "The picture size (" << pictureWidth << " x " << pictureHeight << ") exceeds the configured size (" << dav1dZeroCopyVideoWidth << " x " << dav1dZeroCopyVideoHeight << ")";
+    dav1dPictureCache.PutBack(std::move(picture));
+    return DAV1D_ERR(EINVAL);
+  }
+  
+  pic->stride[0] = pictureWidth;
+  pic->stride[1] = pictureWidth / 2;
   
   pic->data[0] = picture.textureDataPtr;
-  pic->data[1] = static_cast<u8*>(picture.textureDataPtr) + (dav1dZeroCopyVideoWidth * dav1dZeroCopyVideoHeight);
-  pic->data[2] = static_cast<u8*>(picture.textureDataPtr) + (dav1dZeroCopyVideoWidth * dav1dZeroCopyVideoHeight * 5) / 4;
+  pic->data[1] = static_cast<u8*>(picture.textureDataPtr) + (pictureWidth * pictureHeight);
+  pic->data[2] = static_cast<u8*>(picture.textureDataPtr) + (pictureWidth * pictureHeight * 5) / 4;
   
   picture.Release();
   return 0;
@@ -322,6 +322,16 @@ void OpenGLXRVideoFrame::Destroy() {
   }
 }
 
+void OpenGLXRVideoFrame::ReleaseResources() {
+  textureData.reset();
+  deformationState = vector<float>();
+  vertexAlpha = vector<u8>();
+  #ifdef __EMSCRIPTEN__
+    vertexStagingBuffer = vector<u8>();
+    indexStagingBuffer = vector<u8>();
+  #endif
+}
+
 void OpenGLXRVideoFrame::Render(
     const float* modelViewDataColumnMajor,
     const float* modelViewProjectionDataColumnMajor,
@@ -62,6 +62,11 @@ class OpenGLXRVideoFrame : public XRVideoFrame {
       bool verboseDecoding);
   void Destroy();
   
+  /// Releases the frame's CPU-side data after it got evicted from the decoded frame cache.
+  /// The OpenGL objects remain, since they may only be deleted with an OpenGL context being current,
+  /// and since they may have been provided externally (see UseExternalBuffers() and InitializeTextures()).
+  void ReleaseResources();
+  
   /// If this frame is a keyframe, then lastKeyframe may be nullptr.
   void Render(
       const float* modelViewDataColumnMajor,
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include <libvis/vulkan/libvis.h>
+
+namespace scan_studio {
+using namespace vis;
+
+/// Stages of the XRVideo decoding pipeline, as recorded by XRVideoPipelineStatistics.
+enum class XRVideoPipelineStage {
+  /// ReadingThread: Reading a frame's compressed data
+  Reading = 0,
+  
+  /// VideoThread: Decoding a frame's texture (with dav1d, or zstd for XRVideoZStdRGBTextureBitflag)
+  VideoDecoding,
+  
+  /// DecodingThread: XRVideoDecompressContent() for a frame
+  ContentDecoding,
+  
+  /// TransferThread: Waiting for a frame's resource transfers
+  Transfer,
+  
+  Count
+};
+
+/// Collects the per-frame durations of the stages of the XRVideo decoding pipeline, for benchmarking.
+///
+/// Durations are only recorded if an instance of this class is passed to XRVideo::SetPipelineStatistics().
+/// Otherwise, the decoding threads skip all recording. Record() may be called from any thread.
+class XRVideoPipelineStatistics {
+ public:
+  inline void Record(XRVideoPipelineStage stage, s64 nanoseconds) {
+    lock_guard<mutex> lock(samplesMutex);
+    samples[static_cast<int>(stage)].push_back(nanoseconds);
+  }
+  
+  /// Returns a copy of all recorded durations for the given stage, in nanoseconds, in the order in which they were recorded.
+  inline vector<s64> GetSamples(XRVideoPipelineStage stage) const {
+    lock_guard<mutex> lock(samplesMutex);
+    return samples[static_cast<int>(stage)];
+  }
+  
+  /// Discards all recorded durations.
+  inline void Clear() {
+    lock_guard<mutex> lock(samplesMutex);
+    for (auto& stageSamples : samples) {
+      stageSamples.clear();
+    }
+  }
+  
+  /// Returns the given percentile (in [0, 100]) of the given values, using the nearest-rank method.
+  /// Sorts the values in-place. Returns zero for empty input.
+  static inline s64 Percentile(vector<s64>* values, float percentile) {
+    if (values->empty()) { return 0; }
+    std::sort(values->begin(), values->end());
+    
+    const usize rank = static_cast<usize>(std::max(0.f, std::min(1.f, percentile / 100.f)) * (values->size() - 1) + 0.5f);
+    return (*values)[rank];
+  }
+  
+ private:
+  mutable mutex samplesMutex;
+  vector<s64> samples[static_cast<int>(XRVideoPipelineStage::Count)];
+};
+
+}
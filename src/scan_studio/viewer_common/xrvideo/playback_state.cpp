@@ -117,6 +117,14 @@ s64 PlaybackState::Advance(s64 elapsedTime) {
   return currentTime;
 }
 
+void PlaybackState::NotifyDecodedFrameCacheSpaceAvailable() {
+  // The reading thread holds the lock from checking the decoded frame cache until it starts waiting.
+  // Acquiring the lock here thus ensures that the notification cannot get lost in-between.
+  accessMutex.lock();
+  accessMutex.unlock();
+  playbackChangeCondition.notify_all();
+}
+
 void PlaybackState::Lock() {
   accessMutex.lock();
 }
@@ -86,8 +86,14 @@ class PlaybackState {
   /// * Advance() changed the current time
   /// * Seek() changed the current time
   /// * SetPlaybackConditions() changed anything
+  /// * NotifyDecodedFrameCacheSpaceAvailable() was called
   inline condition_variable& GetPlaybackChangeCondition() { return playbackChangeCondition; }
   
+  /// Wakes up the threads waiting on GetPlaybackChangeCondition() without changing the playback,
+  /// since space for decoding further frames became available in the decoded frame cache.
+  /// Attention: The PlaybackState must not be locked by the calling thread.
+  void NotifyDecodedFrameCacheSpaceAvailable();
+  
  private:
   mutable mutex accessMutex;
   
@@ -128,6 +134,9 @@ class NextFramesIterator {
   /// frame, returns 0.
   int ComputeDurationToFrame(int frameIndex) const;
   
+  /// Returns true if the iterator's current frame is played back in forward direction, false if backward.
+  inline bool PlayingForward() const { return forward; }
+  
   /// Returns the iterator's current frame.
   int operator*() const;
   
@@ -15,10 +15,12 @@
 #include "scan_studio/viewer_common/timing.hpp"
 #include "scan_studio/viewer_common/util.hpp"
 
+#include "scan_studio/viewer_common/xrvideo/compressed_frame_cache.hpp"
 #include "scan_studio/viewer_common/xrvideo/decoded_frame_cache.hpp"
 #include "scan_studio/viewer_common/xrvideo/decoding_thread.hpp"
 #include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
 #include "scan_studio/viewer_common/xrvideo/index.hpp"
+#include "scan_studio/viewer_common/xrvideo/pipeline_statistics.hpp"
 #include "scan_studio/viewer_common/xrvideo/playback_state.hpp"
 #include "scan_studio/viewer_common/xrvideo/video_thread.hpp"
 
@@ -56,6 +58,128 @@ class ReadingThread {
     }
   }
   
+  /// If set to non-null, the thread records the duration of reading each frame in the given statistics object.
+  inline void SetPipelineStatistics(XRVideoPipelineStatistics* statistics) {
+    pipelineStatistics = statistics;
+  }
+  
+  /// Sets the budget in bytes for keeping the compressed data of read frames in memory (see CompressedFrameCache).
+  /// Zero (the default) disables this.
+  inline void SetCompressedFrameCacheBudget(s64 bytes) {
+    compressedFrameCache.SetBudget(bytes);
+  }
+  
+  /// Returns the total size of the compressed frame data that is currently kept in memory.
+  inline s64 GetCompressedFrameCacheBytes() {
+    return compressedFrameCache.GetCachedBytes();
+  }
+  
+  /// Sets the path of the sidecar file that caches the index of files without an index chunk (see FrameIndex::SaveToSidecarFile()),
+  /// or an empty path to not use a sidecar file. Must not be called while the thread is running.
+  inline void SetSidecarIndexPath(const fs::path& path) {
+    sidecarIndexPath = path;
+  }
+  
+  /// Sets the readers of the video's renditions other than the first one (see XRVideo::TakeAndOpenRenditions()),
+  /// whose first rendition is read by the reader that is passed to StartThread(). The renditions' frames must be time-aligned.
+  /// The vector is not owned, and must not be changed while the thread is running.
+  inline void SetAdditionalRenditionReaders(const vector<unique_ptr<XRVideoReader>>* readers) {
+    additionalRenditionReaders = readers;
+  }
+  
+  /// Returns the number of renditions of the video.
+  inline int GetRenditionCount() const {
+    return 1 + (additionalRenditionReaders ? additionalRenditionReaders->size() : 0);
+  }
+  
+  /// Sets the rendition to read frames from. Since the frames of a group of pictures must come from the same rendition,
+  /// this takes effect at the next keyframe that is read (as long as no other frames of that keyframe's group of pictures
+  /// are in the decoded frame cache yet). Thus, switching renditions neither invalidates the decoded frames nor stalls playback.
+  inline void SetTargetRendition(int rendition) {
+    targetRendition = rendition;
+  }
+  
+  /// Returns the rendition of the frame that was queued for decoding last.
+  inline int GetDecodingRendition() const {
+    return decodingRendition;
+  }
+  
+  /// Returns the average data rate of each rendition in bytes per second of playback time (see FrameIndex::ComputeBytesPerSecond()),
+  /// or -1 for renditions that cannot be played back since their index could not be loaded or is not time-aligned with that of the first rendition.
+  /// Must only be accessed once asynchronous loading finished (see XRVideoAsyncLoadState::Ready).
+  inline const vector<double>& GetRenditionBytesPerSecond() const {
+    return renditionBytesPerSecond;
+  }
+  
+  /// Returns the estimated throughput of the streaming connection of the rendition that is currently decoded
+  /// (or, if it has no estimate yet, the highest estimate of the other renditions' connections) in bytes per second,
+  /// or zero if the video is not streamed or there is no estimate yet.
+  double GetLinkBytesPerSecond() {
+    if (!reader->UsesStreamingInputStream()) { return 0; }
+    
+    const int currentRendition = decodingRendition;
+    if (currentRendition < GetRenditionCount()) {
+      StreamingBandwidthEstimator& estimator = RenditionReader(currentRendition)->GetStreamingInputStream()->GetBandwidthEstimator();
+      if (estimator.HasEstimates()) {
+        return estimator.GetBytesPerSecond();
+      }
+    }
+    
+    double result = 0;
+    for (int rendition = 0; rendition < GetRenditionCount(); ++ rendition) {
+      result = std::max(result, RenditionReader(rendition)->GetStreamingInputStream()->GetBandwidthEstimator().GetBytesPerSecond());
+    }
+    return result;
+  }
+  
+  /// Returns the playback duration that the reading thread tries to stream in advance of the playback position
+  /// (see StreamingBandwidthEstimator::ComputeWindow()), or zero if the video is not streamed.
+  /// Must only be called once asynchronous loading finished (see XRVideoAsyncLoadState::Ready).
+  s64 GetStreamingLookaheadNanoseconds() {
+    if (!reader->UsesStreamingInputStream()) { return 0; }
+    
+    const int rendition = GetPlayableTargetRendition();
+    StreamingInputStream* streaming = RenditionReader(rendition)->GetStreamingInputStream();
+    const StreamingWindow window = streaming->GetBandwidthEstimator().ComputeWindow(std::max(0.0, renditionBytesPerSecond[rendition]), streaming->GetMaxConcurrentRequests());
+    return SecondsToNanoseconds(window.lookaheadSeconds);
+  }
+  
+  /// Returns the playback duration of the frames that will be played back next (starting at the position of nextPlayedFramesIt)
+  /// whose data is available without waiting for the network, since they are cached or their data has been streamed already.
+  /// Counting stops at the first frame whose data is not available, or once maxNanoseconds is reached. If all remaining frames
+  /// of the video are available, returns maxNanoseconds. The frames' data is assumed to be read from the target rendition.
+  /// Must only be called once asynchronous loading finished (see XRVideoAsyncLoadState::Ready).
+  s64 ComputeStreamedNanoseconds(NextFramesIterator nextPlayedFramesIt, s64 maxNanoseconds) {
+    if (!reader->UsesStreamingInputStream()) { return maxNanoseconds; }
+    
+    const int rendition = GetPlayableTargetRendition();
+    StreamingInputStream* streaming = RenditionReader(rendition)->GetStreamingInputStream();
+    const FrameIndex& index = RenditionIndex(rendition);
+    
+    s64 streamedNanoseconds = 0;
+    
+    while (!nextPlayedFramesIt.AtEnd()) {
+      const int nextFrameIndex = *nextPlayedFramesIt;
+      
+      const bool isAvailable =
+          decodedFrameCache->FindCachedFrameInRange(nextFrameIndex, nextFrameIndex, {}) >= 0 ||
+          compressedFrameCache.Contains(nextFrameIndex, rendition) ||
+          streaming->IsRangeAvailable(index.At(nextFrameIndex).GetOffset(), index.At(nextFrameIndex + 1).GetOffset() - 1);
+      if (!isAvailable) {
+        return streamedNanoseconds;
+      }
+      
+      streamedNanoseconds += index.At(nextFrameIndex + 1).GetTimestamp() - index.At(nextFrameIndex).GetTimestamp();
+      if (streamedNanoseconds >= maxNanoseconds) {
+        break;
+      }
+      
+      ++ nextPlayedFramesIt;
+    }
+    
+    return maxNanoseconds;
+  }
+  
   void StartThread(
       bool verboseDecoding,
       PlaybackState* playbackState,
@@ -112,7 +236,9 @@ class ReadingThread {
     // This is not implemented in an ideal way, but this seems like the best solution
     // for now without potentially complicating the process a lot.
     while (currentlyReading) {
-      reader->AbortRead();
+      for (int rendition = 0; rendition < GetRenditionCount(); ++ rendition) {
+        RenditionReader(rendition)->AbortRead();
+      }
       this_thread::sleep_for(100us);
     }
   }
@@ -140,7 +266,9 @@ class ReadingThread {
     
     if (reader->UsesStreamingInputStream()) {
       streamingMutex.lock();
-      reader->GetStreamingInputStream()->DropPendingRequests();
+      for (int rendition = 0; rendition < GetRenditionCount(); ++ rendition) {
+        RenditionReader(rendition)->GetStreamingInputStream()->DropPendingRequests();
+      }
       streamingMutex.unlock();
     }
   }
@@ -159,6 +287,11 @@ class ReadingThread {
     }
     currentlyReading = false;
     
+    // The data of frames in a MappedFileInputStream is accessed in the file mapping directly,
+    // so the compressed frame cache is only used for other input streams.
+    compressedFrameCache.Initialize(reader->UsesMappedFileInputStream() ? 0 : frameIndex->GetFrameCount());
+    frameRenditions.assign(frameIndex->GetFrameCount(), 0);
+    
     // If caching all frames, then the decoded frames cache will only be resized (on the main thread) after the
     // frame count has been read asynchronously above (in ReadFileMetadataAndIndex()). To prevent race conditions,
     // we wait here for this resize to happen before using decodedFrameCache below.
@@ -172,7 +305,8 @@ class ReadingThread {
     while (!quitRequested) {
       unique_lock<mutex> playbackStateLock(playbackState->GetMutex());
       
-      vector<WriteLockedCachedFrame<FrameT>> lockedCacheItems = decodedFrameCache->LockCacheItemsForDecodingNextFrame(NextFramesIterator(playbackState, frameIndex), *frameIndex);
+      const NextFramesIterator nextPlayedFramesIt(playbackState, frameIndex);
+      vector<WriteLockedCachedFrame<FrameT>> lockedCacheItems = decodedFrameCache->LockCacheItemsForDecodingNextFrame(nextPlayedFramesIt, *frameIndex);
       
       // Check quitRequested while holding playbackStateLock to ensure
       // we catch it getting set to true by RequestThreadToExit() before possibly blocking below
@@ -186,11 +320,10 @@ class ReadingThread {
         // If we are streaming data, then query some data in advance before going into the wait,
         // to get a larger pre-buffered region for being able to better handle unreliable network conditions.
         if (reader->UsesStreamingInputStream()) {
-          NextFramesIterator nextPlayedFramesIt(playbackState, frameIndex);
           playbackStateLock.unlock();
           streamingMutex.lock();
           if (!abortCurrentFrames) {
-            PreScheduleFramesForStreaming(nextPlayedFramesIt, *frameIndex);
+            PreScheduleFramesForStreaming(nextPlayedFramesIt);
           }
           streamingMutex.unlock();
           playbackStateLock.lock();
@@ -203,26 +336,25 @@ class ReadingThread {
         //       time is within the same frame as before the change. Perhaps we could
         //       detect this here (and whether the other playback state settings also remain constant)
         //       and in this case skip checking the whole decoded frame cache validity?
-        // TODO: The reason for the used timeout in the wait_for() below is that playback time changes (that we are waiting for) are not the
-        //       only event that makes more frames available for reading. More frames also become
-        //       available if read locks to existing, no longer needed frames are dropped.
-        //       This happens when read locks are deleted (delayed) for video frames rendered in previous
-        //       render frames, or when the video playback latches on to the current frame
-        //       while buffering (after buffering started because the current frame was not
-        //       available in the cache). But, so far, we don't have a mechanism for these
-        //       events to wake up the reading thread. Thus the automatic wake-up after a short
-        //       duration. This wake-up is necessary to be able to completely fill the decoded frames cache during
-        //       buffering if at the start of buffering some frames were unavailable due to existing read locks onto them.
-        //       And if decoding is slow, a filled cache is the only condition that will resume playback.
-        //       So, the timeout is ultimately necessary to avoid hanging playback due to buffering forever.
-        //       The "to do" item here is that it would probably be nicer if read lock releasing would directly
-        //       wake up the reading thread.
+        // Playback time changes (that we are waiting for) are not the only event that makes more frames available for reading.
+        // More frames also become available if read locks to existing, no longer needed frames are dropped.
+        // This happens when read locks are deleted (delayed) for video frames rendered in previous
+        // render frames, or when the video playback latches on to the current frame
+        // while buffering (after buffering started because the current frame was not
+        // available in the cache). Releasing the last read lock of a cache item wakes us up via
+        // PlaybackState::NotifyDecodedFrameCacheSpaceAvailable(). This is necessary to be able to completely
+        // fill the decoded frames cache during buffering if at the start of buffering some frames were unavailable
+        // due to existing read locks onto them, since, if decoding is slow, a filled cache is the only condition
+        // that will resume playback.
+        //
+        // The timeout remains as a fallback for cache items that become free without any notification,
+        // such as items whose decoding failed, to avoid hanging playback due to buffering forever.
         playbackState->GetPlaybackChangeCondition().wait_for(playbackStateLock, 250ms);
       } else {
         abortCurrentFrames = false;
         playbackStateLock.unlock();
         
-        ReadFramesForDecoding(move(lockedCacheItems));
+        ReadFramesForDecoding(move(lockedCacheItems), nextPlayedFramesIt);
       }
     }
     
@@ -234,95 +366,160 @@ class ReadingThread {
     *hasMetadata = reader->ReadMetadata(metadata);
     if (quitRequested) { return false; }
     
-    // Load the frame index from the index chunk, if present, or compile it from the frame data (slow)
+    if (!ReadIndex(reader, frameIndex, sidecarIndexPath)) {
+      return false;
+    }
+    
+    // Sanity check: Ensure that we have at least one frame, and that the first frame is a keyframe.
+    // Otherwise, fail loading.
+    if (frameIndex->GetFrameCount() == 0) {
+      LOG(ERROR) << "The XRVideo does not contain any frames.";
+      return false;
+    }
+    if (!frameIndex->At(0).IsKeyframe()) {
+      LOG(ERROR) << "The first frame in the XRVideo is not a keyframe.";
+      return false;
+    }
+    
+    if (!ReadTextureSize(reader, *frameIndex, textureWidth, textureHeight)) {
+      return false;
+    }
+    
+    LoadAdditionalRenditions();
+    if (quitRequested) { return false; }
+    
+    // Initialize our playback state
+    playbackState->SetPlaybackTimeRange(frameIndex->GetVideoStartTimestamp(), frameIndex->GetVideoEndTimestamp());
+    playbackState->Seek(frameIndex->GetVideoStartTimestamp(), /*forward*/ true);
+    
+    // Signal that the video metadata has been loaded
+    *asyncLoadState = XRVideoAsyncLoadState::Ready;
+    return true;
+  }
+  
+  /// Loads the frame index of the video read by the given reader from its index chunk, if present, or from the sidecar index file
+  /// at the given path (unless it is empty), if available. Otherwise, compiles it from the frame headers (slow for large files).
+  bool ReadIndex(XRVideoReader* reader, FrameIndex* index, const fs::path& sidecarIndexPath) {
     if (reader->FindNextChunk(xrVideoIndexChunkIdentifierV0)) {
       if (quitRequested) { return false; }
       
-      if (!frameIndex->CreateFromIndexChunk(reader)) {
+      if (!index->CreateFromIndexChunk(reader)) {
         LOG(ERROR) << "Reading the XRVideo file's index chunk failed";
         return false;
       }
+    } else if (!sidecarIndexPath.empty() && index->LoadFromSidecarFile(sidecarIndexPath, reader)) {
+      if (verboseDecoding) { LOG(1) << "ReadingThread: Loaded the index from the sidecar file " << sidecarIndexPath.string(); }
     } else {
-      // Go over all XRVideo frames in the file to create the index.
-      LOG(WARNING) << "The opened file does not have an index chunk. Seeking over the whole file to build an index. This may be slow.";
+      if (quitRequested) { return false; }
       
-      vector<u8> frameData;
-      s64 lastFrameEndTimestamp = numeric_limits<s64>::lowest();
+      // Go over the headers of all XRVideo frames in the file to create the index, seeking over the frame data.
+      LOG(WARNING) << "The opened file does not have an index chunk. Seeking over the whole file to build an index. This may be slow.";
       
-      frameIndex->Clear();
       reader->Seek(0);
-      
-      while (true) {
-        // const TimePoint readStartTime = Clock::now();
-        
-        u64 frameOffsetInFile;
-        if (!reader->ReadNextFrame(&frameData, &frameOffsetInFile)) {
-          break;
-        }
-        
-        // const TimePoint readEndTime = Clock::now();
-        // LOG(1) << "Read frame data (" << frameData.size() << " bytes) from file in " << (MillisecondsFromTo(readStartTime, readEndTime)) << " ms";
-        
-        // Read the metadata
-        const u8* dataPtr = frameData.data();
-        XRVideoFrameMetadata frameMetadata;
-        if (!XRVideoReadMetadata(&dataPtr, frameData.size(), &frameMetadata)) {
-          LOG(ERROR) << "Reading XRVideo metadata failed";
-          return false;
-        }
-        
-        // Add the index item
-        frameIndex->PushFrame(frameMetadata.startTimestamp, frameOffsetInFile, frameMetadata.isKeyframe);
-        lastFrameEndTimestamp = frameMetadata.endTimestamp;
-        
-        if (quitRequested) { return false; }
+      if (!index->CreateFromFrameHeaders(reader, quitRequested)) {
+        return false;
       }
       
-      frameIndex->PushVideoEnd(lastFrameEndTimestamp, reader->GetFileOffset());
-    }
-    
-    // Sanity check: Ensure that we have at least one frame, and that the first frame is a keyframe.
-    // Otherwise, fail loading.
-    if (frameIndex->GetFrameCount() == 0) {
-      LOG(ERROR) << "The XRVideo does not contain any frames.";
-      return false;
-    }
-    if (!frameIndex->At(0).IsKeyframe()) {
-      LOG(ERROR) << "The first frame in the XRVideo is not a keyframe.";
-      return false;
+      // Save the index such that opening the file again is fast
+      if (!sidecarIndexPath.empty() && index->GetFrameCount() > 0) {
+        index->SaveToSidecarFile(sidecarIndexPath, reader);
+      }
     }
     
-    // Peek into the first frame to read the video's texture size.
-    // TODO: Once we update the XRV format, it would make sense to add a "maxTextureSize" attribute to the file header instead.
-    reader->Seek(frameIndex->At(0).GetOffset());
+    return true;
+  }
+  
+  /// Peeks into the first frame of the video read by the given reader to read the video's texture size.
+  /// TODO: Once we update the XRV format, it would make sense to add a "maxTextureSize" attribute to the file header instead.
+  bool ReadTextureSize(XRVideoReader* reader, const FrameIndex& index, u16* width, u16* height) {
+    reader->Seek(index.At(0).GetOffset());
     
-    vector<u8> frameData;
+    XRVideoFrameView frameData;
     u64 frameOffsetInFile;
-    if (!reader->ReadNextFrame(&frameData, &frameOffsetInFile)) {
+    if (!reader->ReadNextFrameView(&frameData, &frameOffsetInFile)) {
       LOG(ERROR) << "The XRVideo does not contain any frames.";
       return false;
     }
     
-    const u8* dataPtr = frameData.data();
+    const u8* dataPtr = frameData.data;
     XRVideoFrameMetadata frameMetadata;
-    if (!XRVideoReadMetadata(&dataPtr, frameData.size(), &frameMetadata)) {
+    if (!XRVideoReadMetadata(&dataPtr, frameData.size, &frameMetadata)) {
       LOG(ERROR) << "Reading XRVideo metadata failed";
       return false;
     }
     
-    *textureWidth = frameMetadata.textureWidth;
-    *textureHeight = frameMetadata.textureHeight;
+    *width = frameMetadata.textureWidth;
+    *height = frameMetadata.textureHeight;
+    return true;
+  }
+  
+  /// Loads the indices of the additional renditions (see SetAdditionalRenditionReaders()) and computes the data rates of all renditions.
+  /// Renditions whose index cannot be loaded, or is not time-aligned with the index of the first rendition, are excluded from playback.
+  /// Raises the texture size to the largest texture size of the renditions, such that resources that are allocated
+  /// for the video's texture size (e.g., for zero-copy decoding with dav1d) fit the frames of all renditions.
+  void LoadAdditionalRenditions() {
+    const int renditionCount = GetRenditionCount();
+    
+    additionalRenditionIndices.clear();
+    additionalRenditionIndices.resize(renditionCount - 1);
+    renditionBytesPerSecond.assign(renditionCount, -1);
+    renditionBytesPerSecond[0] = frameIndex->ComputeBytesPerSecond();
+    
+    for (int rendition = 1; rendition < renditionCount && !quitRequested; ++ rendition) {
+      XRVideoReader* renditionReader = RenditionReader(rendition);
+      FrameIndex& renditionIndex = additionalRenditionIndices[rendition - 1];
+      
+      u16 renditionTextureWidth, renditionTextureHeight;
+      if (!ReadIndex(renditionReader, &renditionIndex, /*sidecarIndexPath*/ fs::path()) ||
+          renditionIndex.GetFrameCount() == 0 ||
+          !ReadTextureSize(renditionReader, renditionIndex, &renditionTextureWidth, &renditionTextureHeight)) {
+        if (!quitRequested) { LOG(ERROR) << "Failed to load rendition " << rendition << " of the XRVideo, it will not be played back"; }
+        continue;
+      }
+      if (!renditionIndex.IsTimeAlignedWith(*frameIndex)) {
+        LOG(ERROR) << "The frames of rendition " << rendition << " of the XRVideo are not time-aligned with those of its first rendition, it will not be played back";
+        continue;
+      }
+      
+      *textureWidth = std::max(*textureWidth, renditionTextureWidth);
+      *textureHeight = std::max(*textureHeight, renditionTextureHeight);
+      renditionBytesPerSecond[rendition] = renditionIndex.ComputeBytesPerSecond();
+    }
     
-    // Initialize our playback state
-    playbackState->SetPlaybackTimeRange(frameIndex->GetVideoStartTimestamp(), frameIndex->GetVideoEndTimestamp());
-    playbackState->Seek(frameIndex->GetVideoStartTimestamp(), /*forward*/ true);
+    decodingRendition = 0;
+  }
+  
+  inline XRVideoReader* RenditionReader(int rendition) const {
+    return (rendition == 0) ? reader : (*additionalRenditionReaders)[rendition - 1].get();
+  }
+  
+  inline const FrameIndex& RenditionIndex(int rendition) const {
+    return (rendition == 0) ? *frameIndex : additionalRenditionIndices[rendition - 1];
+  }
+  
+  /// Returns the rendition to read the group of pictures that starts at the given keyframe from:
+  /// If frames of the group of pictures are in the decoded frame cache already (ignoring the given locked frames), this is the rendition
+  /// that they were decoded from, since the frames of a group of pictures depend on each other. Otherwise, this is the target rendition.
+  int ChooseRenditionForGroupOfPictures(int keyframeIndex, const vector<WriteLockedCachedFrame<FrameT>>& ignoredFrames) {
+    if (GetRenditionCount() == 1) { return 0; }
+    
+    const int cachedFrameIndex = decodedFrameCache->FindCachedFrameInRange(keyframeIndex, frameIndex->FindNextKeyframe(keyframeIndex) - 1, ignoredFrames);
+    if (cachedFrameIndex >= 0) {
+      return frameRenditions[cachedFrameIndex];
+    }
     
-    // Signal that the video metadata has been loaded
-    *asyncLoadState = XRVideoAsyncLoadState::Ready;
-    return true;
+    return GetPlayableTargetRendition();
+  }
+  
+  /// Returns the target rendition (see SetTargetRendition()), or the first rendition if the target rendition cannot be played back.
+  int GetPlayableTargetRendition() const {
+    const int rendition = targetRendition;
+    return (rendition > 0 && rendition < GetRenditionCount() && renditionBytesPerSecond[rendition] >= 0) ? rendition : 0;
   }
   
-  void ReadFramesForDecoding(vector<WriteLockedCachedFrame<FrameT>>&& lockedCacheItems) {
+  /// Reads the frames required to decode the frames of the given locked cache items, and queues them for decoding.
+  /// nextPlayedFramesIt must be at the playback position at which the cache items were locked.
+  void ReadFramesForDecoding(vector<WriteLockedCachedFrame<FrameT>>&& lockedCacheItems, const NextFramesIterator& nextPlayedFramesIt) {
     // We must decode frames sequentially, starting from a keyframe, due to the AV.1 texture video frames.
     // Thus, starting from the lowest frame index of the lockedCacheItems, we find its base keyframe by going back, in order
     // to find out where we have to start decoding to finally reach frameIndexToDecode.
@@ -366,12 +563,43 @@ class ReadingThread {
     
     // Read the frames in the range [startFrameIndex, maxFrameIndex] and queue them up for decoding.
     // Store the frames that we have cached frame items for, while discarding the others.
-    // NOTE: This decoding strategy will not work properly with files played back backwards:
-    //       Requesting a dependent frame that has many other dependent frames before it will
-    //       require decoding all the other dependent frames, but throw them away, despite them
-    //       being needed for rendering soon as well.
+    // Note that for backward playback, the decoded frame cache also returns cache items for the preceding frames
+    // that will be played back next (see LockCacheItemsForDecodingNextFrame()), such that we do not discard these,
+    // which would require decoding the chain of dependent frames again for each of them.
     int nextCacheItem = 0;
     
+    // Choose the rendition to read each frame from. Renditions may only change at keyframes,
+    // so if decoding continues after the last queued frame, it continues in that frame's rendition.
+    vector<int> renditions(maxFrameIndex - startFrameIndex + 1);
+    int rendition = frameIndex->At(startFrameIndex).IsKeyframe() ? 0 : frameRenditions[startFrameIndex - 1];
+    
+    for (int currentFrameIndex = startFrameIndex; currentFrameIndex <= maxFrameIndex; ++ currentFrameIndex) {
+      if (frameIndex->At(currentFrameIndex).IsKeyframe()) {
+        rendition = ChooseRenditionForGroupOfPictures(currentFrameIndex, lockedCacheItems);
+      }
+      renditions[currentFrameIndex - startFrameIndex] = rendition;
+    }
+    
+    // If streaming, request the frames in ranges that are aligned to frame chunk boundaries (if they were not requested yet,
+    // e.g., by PreScheduleFramesForStreaming()). Otherwise, reading them would request ranges that start at the first read frame,
+    // but do not end at a frame boundary, such that the following frames could not be accessed without copying their data.
+    if (reader->UsesStreamingInputStream()) {
+      lock_guard<mutex> streamingLock(streamingMutex);
+      if (!abortCurrentFrames) {
+        for (int firstFrameIndex = startFrameIndex; firstFrameIndex <= maxFrameIndex; ) {
+          const int firstFrameRendition = renditions[firstFrameIndex - startFrameIndex];
+          
+          int lastFrameIndex = firstFrameIndex;
+          while (lastFrameIndex < maxFrameIndex && renditions[lastFrameIndex + 1 - startFrameIndex] == firstFrameRendition) {
+            ++ lastFrameIndex;
+          }
+          
+          StreamFrames(firstFrameIndex, lastFrameIndex, ComputeStreamingWindow(firstFrameRendition).maxStreamSize, firstFrameRendition);
+          firstFrameIndex = lastFrameIndex + 1;
+        }
+      }
+    }
+    
     auto invalidateFollowingCacheItems = [&nextCacheItem, &lockedCacheItems]() {
       for (; nextCacheItem < lockedCacheItems.size(); ++ nextCacheItem) {
         lockedCacheItems[nextCacheItem].Invalidate();
@@ -381,17 +609,30 @@ class ReadingThread {
     for (int currentFrameIndex = startFrameIndex; currentFrameIndex <= maxFrameIndex; ++ currentFrameIndex) {
       const TimePoint readingStartTime = Clock::now();
       
-      reader->Seek(frameIndex->At(currentFrameIndex).GetOffset());
+      const int frameRendition = renditions[currentFrameIndex - startFrameIndex];
+      XRVideoReader* renditionReader = RenditionReader(frameRendition);
       
-      shared_ptr<vector<u8>> frameData(new vector<u8>());
-      currentlyReading = true;
-      if (quitRequested || !reader->ReadNextFrame(frameData.get())) {
+      if (verboseDecoding && frameIndex->At(currentFrameIndex).IsKeyframe() && frameRendition != decodingRendition) {
+        LOG(1) << "ReadingThread: Switching from rendition " << decodingRendition << " to rendition " << frameRendition << " at keyframe " << currentFrameIndex;
+      }
+      
+      // Take the frame's data from the compressed frame cache if possible, otherwise read it from the input stream
+      XRVideoFrameView frameData;
+      if (!compressedFrameCache.Lookup(currentFrameIndex, frameRendition, &frameData)) {
+        renditionReader->Seek(RenditionIndex(frameRendition).At(currentFrameIndex).GetOffset());
+        
+        currentlyReading = true;
+        if (quitRequested || !renditionReader->ReadNextFrameView(&frameData)) {
+          currentlyReading = false;
+          if (!quitRequested) { LOG(ERROR) << "Failed to read XRVideo frame " << currentFrameIndex; }
+          invalidateFollowingCacheItems();
+          return;
+        }
         currentlyReading = false;
-        if (!quitRequested) { LOG(ERROR) << "Failed to read XRVideo frame " << currentFrameIndex; }
-        invalidateFollowingCacheItems();
-        return;
+        
+        // Streamed frame data may be a view into a pinned range, which must not be kept alive as a whole by the cache
+        compressedFrameCache.Insert(currentFrameIndex, frameRendition, frameData, nextPlayedFramesIt, /*copyData*/ renditionReader->UsesStreamingInputStream());
       }
-      currentlyReading = false;
       
       WriteLockedCachedFrame<FrameT>* cacheItem = nullptr;
       if (nextCacheItem < lockedCacheItems.size() && lockedCacheItems[nextCacheItem].GetFrameIndex() == currentFrameIndex) {
@@ -401,6 +642,9 @@ class ReadingThread {
       
       const TimePoint readingEndTime = Clock::now();
       
+      if (XRVideoPipelineStatistics* statistics = pipelineStatistics.load()) {
+        statistics->Record(XRVideoPipelineStage::Reading, NanosecondsFromTo(readingStartTime, readingEndTime));
+      }
       if (verboseDecoding) {
         LOG(1) << "ReadingThread: Read frame " << currentFrameIndex << " in " << MillisecondsFromTo(readingStartTime, readingEndTime) << " ms";
       }
@@ -419,8 +663,8 @@ class ReadingThread {
         // video thread and the decoding thread (and it should not take long to do that).
         shared_ptr<XRVideoFrameMetadata> frameMetadata(new XRVideoFrameMetadata());
         
-        const u8* frameContentPtr = frameData->data();
-        if (!XRVideoReadMetadata(&frameContentPtr, frameData->size(), frameMetadata.get())) {
+        const u8* frameContentPtr = frameData.data;
+        if (!XRVideoReadMetadata(&frameContentPtr, frameData.size, frameMetadata.get())) {
           LOG(ERROR) << "Reading XRVideo metadata failed";
           if (cacheItem) { cacheItem->Invalidate(); } invalidateFollowingCacheItems(); break;
         }
@@ -450,28 +694,45 @@ class ReadingThread {
         // Did a clear of the decoding thread's work queue make QueueFrame() fail due
         // to inconsistent decoding state?
         if (!success) { invalidateFollowingCacheItems(); break; }
+        
+        frameRenditions[currentFrameIndex] = frameRendition;
+        decodingRendition = frameRendition;
       }
     }
   }
   
-  void PreScheduleFramesForStreaming(NextFramesIterator nextPlayedFramesIt, const FrameIndex& index) {
-    // The number of seconds of video that we will try to buffer in advance
-    const float secondsToBufferInAdvance = 5.f;
-    const s64 nanosecondsToBufferInAdvance = SecondsToNanoseconds(secondsToBufferInAdvance);
+  /// Computes the streaming window (see StreamingBandwidthEstimator::ComputeWindow()) for the current estimates of the given rendition's
+  /// streaming connection and the rendition's average data rate, and raises the stream's cache size to hold it if necessary.
+  StreamingWindow ComputeStreamingWindow(int rendition) {
+    StreamingInputStream* streaming = RenditionReader(rendition)->GetStreamingInputStream();
+    
+    const StreamingWindow window = streaming->GetBandwidthEstimator().ComputeWindow(std::max(0.0, renditionBytesPerSecond[rendition]), streaming->GetMaxConcurrentRequests());
+    streaming->SetRequiredCacheSize(window.requiredCacheSize);
+    return window;
+  }
+  
+  void PreScheduleFramesForStreaming(NextFramesIterator nextPlayedFramesIt) {
+    const FrameIndex& index = *frameIndex;
+    
+    // The number of seconds of video that we will try to buffer in advance, adapted to the streaming connection
+    // (of the target rendition, which the frames that are not decoded yet will mostly be read from)
+    const StreamingWindow window = ComputeStreamingWindow(GetPlayableTargetRendition());
+    const s64 nanosecondsToBufferInAdvance = SecondsToNanoseconds(window.lookaheadSeconds);
     
     // The maximum number of frames that we iterate through to buffer data in advance
     // (intended to prevent this loop from taking too much time to run if the time criterion is not reached for some reason)
-    const int maxLookaheadFrames = static_cast<int>(30 * secondsToBufferInAdvance + 0.5f);
-    
-    StreamingInputStream* streaming = reader->GetStreamingInputStream();
+    const double videoSeconds = NanosecondsToSeconds(index.GetVideoEndTimestamp() - index.GetVideoStartTimestamp());
+    const double framesPerSecond = (videoSeconds > 0) ? (index.GetFrameCount() / videoSeconds) : 30;
+    const int maxLookaheadFrames = std::max(1, static_cast<int>(1.5 * framesPerSecond * window.lookaheadSeconds + 0.5));
     
-    s64 scheduleRangeFrom = -1;
-    s64 scheduleRangeTo = -1;
+    // Range of consecutive frames (in file order and of the same rendition) that will be played back next
+    int scheduleFirstFrameIndex = -1;
+    int scheduleLastFrameIndex = -1;
+    int scheduleRendition = 0;
     
-    auto streamScheduledRange = [&scheduleRangeFrom, &scheduleRangeTo, &streaming]() {
-      constexpr s64 maxStreamSize = 6 * 1024 * 1024;  // 6 MiB  // TODO: Put this parameter in the same location as minStreamSize
-      streaming->StreamRange(scheduleRangeFrom, scheduleRangeTo, /*allowExtendRange*/ true, maxStreamSize);
-    };
+    // The rendition that the frames of the group of pictures with the given keyframe are expected to be read from
+    int lastKeyframeIndex = -1;
+    int lastKeyframeRendition = 0;
     
     s64 bufferedNanoseconds = 0;
     int lookaheadFrames = 0;
@@ -479,29 +740,30 @@ class ReadingThread {
     while (!nextPlayedFramesIt.AtEnd()) {
       const int nextFrameIndex = *nextPlayedFramesIt;
       
-      const auto& thisIndexItem = index.At(nextFrameIndex);
-      const auto& nextIndexItem = index.At(nextFrameIndex + 1);
-      
-      const u64 frameRangeFrom = thisIndexItem.GetOffset();
-      const u64 frameRangeTo = nextIndexItem.GetOffset() - 1;
+      int baseKeyframeIndex, predecessorIndex;
+      index.FindDependencyFrames(nextFrameIndex, &baseKeyframeIndex, &predecessorIndex);
+      if (baseKeyframeIndex < 0) { baseKeyframeIndex = nextFrameIndex; }
+      if (baseKeyframeIndex != lastKeyframeIndex) {
+        lastKeyframeIndex = baseKeyframeIndex;
+        lastKeyframeRendition = ChooseRenditionForGroupOfPictures(baseKeyframeIndex, {});
+      }
       
-      // Add the frame's data range to the scheduled frames.
-      // Notice that we ignore the frames that this frame is dependent on here (this could be a keyframe and a previous frame)
-      // since in almost all cases, their data should already be available or already be requested.
-      if (scheduleRangeFrom < 0) {
-        scheduleRangeFrom = frameRangeFrom;
-        scheduleRangeTo = frameRangeTo;
-      } else if (frameRangeFrom == scheduleRangeTo + 1) {
-        scheduleRangeTo = frameRangeTo;
-      } else if (frameRangeTo == scheduleRangeFrom - 1) {
-        scheduleRangeFrom = frameRangeFrom;
+      if (scheduleFirstFrameIndex < 0) {
+        scheduleFirstFrameIndex = nextFrameIndex;
+        scheduleLastFrameIndex = nextFrameIndex;
+        scheduleRendition = lastKeyframeRendition;
+      } else if (nextFrameIndex == scheduleLastFrameIndex + 1 && lastKeyframeRendition == scheduleRendition) {
+        scheduleLastFrameIndex = nextFrameIndex;
+      } else if (nextFrameIndex == scheduleFirstFrameIndex - 1 && lastKeyframeRendition == scheduleRendition) {
+        scheduleFirstFrameIndex = nextFrameIndex;
       } else {
-        streamScheduledRange();
-        scheduleRangeFrom = frameRangeFrom;
-        scheduleRangeTo = frameRangeTo;
+        StreamFrames(scheduleFirstFrameIndex, scheduleLastFrameIndex, window.maxStreamSize, scheduleRendition);
+        scheduleFirstFrameIndex = nextFrameIndex;
+        scheduleLastFrameIndex = nextFrameIndex;
+        scheduleRendition = lastKeyframeRendition;
       }
       
-      bufferedNanoseconds += nextIndexItem.GetTimestamp() - thisIndexItem.GetTimestamp();
+      bufferedNanoseconds += index.At(nextFrameIndex + 1).GetTimestamp() - index.At(nextFrameIndex).GetTimestamp();
       if (bufferedNanoseconds >= nanosecondsToBufferInAdvance) {
         break;
       }
@@ -514,8 +776,42 @@ class ReadingThread {
       ++ nextPlayedFramesIt;
     }
     
-    if (scheduleRangeFrom >= 0) {
-      streamScheduledRange();
+    if (scheduleFirstFrameIndex >= 0) {
+      StreamFrames(scheduleFirstFrameIndex, scheduleLastFrameIndex, window.maxStreamSize, scheduleRendition);
+    }
+  }
+  
+  /// Requests the data of the given rendition of the frames in [firstFrameIndex, lastFrameIndex] to be streamed, except for frames whose data is in the compressed frame cache.
+  /// Notice that we ignore the frames that these frames are dependent on here (this could be a keyframe and a previous frame)
+  /// since in almost all cases, their data should already be available or already be requested.
+  ///
+  /// The requested ranges are aligned to frame chunk boundaries (instead of being extended or split at arbitrary offsets),
+  /// such that the reader can access the frames without copying their data (see StreamingInputStream::ReadPinned()).
+  /// Ranges are split at frame boundaries such that they do not exceed maxStreamSize (unless a single frame does).
+  void StreamFrames(int firstFrameIndex, int lastFrameIndex, s64 maxStreamSize, int rendition) {
+    StreamingInputStream* streaming = RenditionReader(rendition)->GetStreamingInputStream();
+    const FrameIndex& index = RenditionIndex(rendition);
+    
+    s64 rangeFrom = -1;
+    s64 rangeTo = -1;
+    
+    for (int frameIndex = firstFrameIndex; frameIndex <= lastFrameIndex + 1; ++ frameIndex) {
+      const bool streamFrame = frameIndex <= lastFrameIndex && !compressedFrameCache.Contains(frameIndex, rendition);
+      const s64 frameRangeFrom = streamFrame ? index.At(frameIndex).GetOffset() : -1;
+      const s64 frameRangeTo = streamFrame ? (index.At(frameIndex + 1).GetOffset() - 1) : -1;
+      
+      // Request the accumulated range if the frame does not get added to it, or if adding it would exceed maxStreamSize
+      if (rangeFrom >= 0 && (!streamFrame || frameRangeTo - rangeFrom + 1 > maxStreamSize)) {
+        streaming->StreamRange(rangeFrom, rangeTo, /*allowExtendRange*/ false, /*maxStreamSize*/ -1);
+        rangeFrom = -1;
+      }
+      
+      if (streamFrame) {
+        if (rangeFrom < 0) {
+          rangeFrom = frameRangeFrom;
+        }
+        rangeTo = frameRangeTo;
+      }
     }
   }
   
@@ -530,6 +826,30 @@ class ReadingThread {
   
   // Config
   bool verboseDecoding;
+  atomic<XRVideoPipelineStatistics*> pipelineStatistics = {nullptr};
+  
+  CompressedFrameCache compressedFrameCache;
+  
+  /// See SetSidecarIndexPath()
+  fs::path sidecarIndexPath;
+  
+  /// See SetAdditionalRenditionReaders() (not owned)
+  const vector<unique_ptr<XRVideoReader>>* additionalRenditionReaders = nullptr;
+  
+  /// The frame indices of the additional renditions (indexed by rendition - 1), loaded by LoadAdditionalRenditions()
+  vector<FrameIndex> additionalRenditionIndices;
+  
+  /// See GetRenditionBytesPerSecond()
+  vector<double> renditionBytesPerSecond;
+  
+  /// See SetTargetRendition() and GetDecodingRendition()
+  atomic<int> targetRendition = {0};
+  atomic<int> decodingRendition = {0};
+  
+  /// For each frame, the rendition that it was queued for decoding from the last time.
+  /// Since the frames of a group of pictures are always read from the same rendition (see ChooseRenditionForGroupOfPictures()),
+  /// this is also the rendition of the frame in the decoded frame cache, if it is cached.
+  vector<int> frameRenditions;
   
   // External state
   atomic<bool> decodedFrameCacheInitialized;
@@ -0,0 +1,170 @@
+#include "scan_studio/viewer_common/xrvideo/rendition_set.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <loguru.hpp>
+
+namespace scan_studio {
+
+/// First line of rendition set manifests
+constexpr const char* renditionManifestHeader = "#XRVIDEO-RENDITIONS";
+
+/// The factor by which the connection's throughput must exceed a rendition's data rate to keep playing it back,
+/// and to switch up to it, respectively
+constexpr double keepRenditionLinkMargin = 1.1;
+constexpr double switchUpLinkMargin = 1.5;
+
+/// The maximum (estimated) decoding load to keep playing back a rendition, and to switch up to it, respectively
+constexpr double keepRenditionMaxDecodingLoad = 1.0;
+constexpr double switchUpMaxDecodingLoad = 0.7;
+
+/// The minimum number of seconds since the last switch before switching down and up, respectively.
+/// This gives the throughput and decoding time measurements some time to reflect the current rendition.
+constexpr double switchDownHoldSeconds = 2;
+constexpr double switchUpHoldSeconds = 8;
+
+static string TrimWhitespace(const string& text) {
+  const usize begin = text.find_first_not_of(" \t\r\n");
+  if (begin == string::npos) { return string(); }
+  const usize end = text.find_last_not_of(" \t\r\n");
+  return text.substr(begin, end + 1 - begin);
+}
+
+static string ResolveRenditionUri(const string& uri, const string& manifestUri) {
+  // URIs that specify a scheme are absolute
+  if (uri.find("://") != string::npos) {
+    return uri;
+  }
+  
+  // The query and fragment of the manifest URI do not take part in resolving
+  const string base = manifestUri.substr(0, manifestUri.find_first_of("?#"));
+  
+  const usize schemeEnd = base.find("://");
+  const usize pathStart = (schemeEnd == string::npos) ? 0 : base.find('/', schemeEnd + 3);
+  
+  if (uri.front() == '/') {
+    // Resolve against the origin (if the manifest URI is a local path, the rendition URI is absolute already)
+    return (schemeEnd == string::npos) ? uri : (base.substr(0, pathStart) + uri);
+  }
+  
+  const usize lastSlash = base.rfind('/');
+  if (pathStart == string::npos || lastSlash == string::npos || lastSlash < pathStart) {
+    // The manifest URI has no path (e.g., "https://example.com") or is a file name without directory
+    return (schemeEnd == string::npos) ? uri : (base + "/" + uri);
+  }
+  return base.substr(0, lastSlash + 1) + uri;
+}
+
+bool ParseXRVideoRenditionManifest(const string& text, const string& manifestUri, vector<XRVideoRenditionInfo>* renditions) {
+  renditions->clear();
+  
+  istringstream stream(text);
+  string line;
+  bool haveHeader = false;
+  
+  while (getline(stream, line)) {
+    line = TrimWhitespace(line);
+    
+    if (!haveHeader) {
+      if (line.empty()) { continue; }
+      if (line != renditionManifestHeader) {
+        LOG(ERROR) << "The rendition manifest does not start with " << renditionManifestHeader;
+        return false;
+      }
+      haveHeader = true;
+      continue;
+    }
+    
+    if (line.empty() || line.front() == '#') { continue; }
+    
+    const usize separator = line.find_first_of(" \t");
+    
+    XRVideoRenditionInfo rendition;
+    rendition.uri = ResolveRenditionUri(line.substr(0, separator), manifestUri);
+    if (separator != string::npos) {
+      rendition.label = TrimWhitespace(line.substr(separator + 1));
+    }
+    renditions->push_back(rendition);
+  }
+  
+  if (renditions->empty()) {
+    LOG(ERROR) << "The rendition manifest does not list any rendition";
+    return false;
+  }
+  return true;
+}
+
+void XRVideoRenditionSelector::SetRenditions(const vector<double>& bytesPerSecond, const TimePoint& now) {
+  renditionBytesPerSecond = bytesPerSecond;
+  
+  renditionsByRate.clear();
+  for (int rendition = 0; rendition < static_cast<int>(bytesPerSecond.size()); ++ rendition) {
+    if (bytesPerSecond[rendition] >= 0) {
+      renditionsByRate.push_back(rendition);
+    }
+  }
+  std::stable_sort(renditionsByRate.begin(), renditionsByRate.end(), [&](int a, int b) { return bytesPerSecond[a] < bytesPerSecond[b]; });
+  
+  lastSwitchTime = now;
+}
+
+int XRVideoRenditionSelector::SelectRendition(int currentRendition, double linkBytesPerSecond, double decodingLoad, double playbackSpeed, const TimePoint& now) {
+  const auto currentIt = std::find(renditionsByRate.begin(), renditionsByRate.end(), currentRendition);
+  if (currentIt == renditionsByRate.end()) {
+    return renditionsByRate.empty() ? currentRendition : renditionsByRate.front();
+  }
+  const int currentRank = currentIt - renditionsByRate.begin();
+  
+  const double secondsSinceSwitch = SecondsFromTo(lastSwitchTime, now);
+  int result = currentRendition;
+  
+  if (!Fits(currentRendition, currentRendition, linkBytesPerSecond, decodingLoad, playbackSpeed, keepRenditionLinkMargin, keepRenditionMaxDecodingLoad)) {
+    // Switch down to the best rendition that is expected to keep up, or to the lowest one if none is
+    if (secondsSinceSwitch >= switchDownHoldSeconds) {
+      result = renditionsByRate.front();
+      for (int rank = currentRank - 1; rank > 0; -- rank) {
+        if (Fits(renditionsByRate[rank], currentRendition, linkBytesPerSecond, decodingLoad, playbackSpeed, keepRenditionLinkMargin, keepRenditionMaxDecodingLoad)) {
+          result = renditionsByRate[rank];
+          break;
+        }
+      }
+    }
+  } else if (currentRank + 1 < static_cast<int>(renditionsByRate.size()) && secondsSinceSwitch >= switchUpHoldSeconds) {
+    // Switch up by one rank if the next rendition is expected to keep up with a margin
+    const int nextRendition = renditionsByRate[currentRank + 1];
+    if (Fits(nextRendition, currentRendition, linkBytesPerSecond, decodingLoad, playbackSpeed, switchUpLinkMargin, switchUpMaxDecodingLoad)) {
+      result = nextRendition;
+    }
+  }
+  
+  if (result != currentRendition) {
+    lastSwitchTime = now;
+  }
+  return result;
+}
+
+bool XRVideoRenditionSelector::Fits(int rendition, int currentRendition, double linkBytesPerSecond, double decodingLoad, double playbackSpeed, double linkMargin, double maxDecodingLoad) const {
+  const double bytesPerSecond = renditionBytesPerSecond[rendition];
+  const double currentBytesPerSecond = renditionBytesPerSecond[currentRendition];
+  
+  if (linkBytesPerSecond > 0 && bytesPerSecond * fabs(playbackSpeed) * linkMargin > linkBytesPerSecond) {
+    return false;
+  }
+  
+  if (decodingLoad >= 0) {
+    // Estimate the rendition's decoding load from that of the current rendition, assuming that it is proportional to the data rate
+    const double estimatedDecodingLoad = (currentBytesPerSecond > 0) ? (decodingLoad * bytesPerSecond / currentBytesPerSecond) : decodingLoad;
+    if (estimatedDecodingLoad > maxDecodingLoad) {
+      return false;
+    }
+  } else if (bytesPerSecond > currentBytesPerSecond) {
+    // Without decoding time measurements, do not switch to a rendition that is more expensive to decode
+    return false;
+  }
+  
+  return true;
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <libvis/vulkan/libvis.h>
+
+#include "scan_studio/viewer_common/timing.hpp"
+
+namespace scan_studio {
+using namespace vis;
+
+/// A rendition of an XRVideo, as listed in a rendition set manifest (see ParseXRVideoRenditionManifest()).
+struct XRVideoRenditionInfo {
+  /// The URI of the rendition's XRVideo file. Relative URIs in the manifest are resolved against the manifest's URI.
+  string uri;
+  
+  /// An optional label for the rendition (e.g., for showing a quality selection to the user), or an empty string.
+  string label;
+};
+
+/// Parses a rendition set manifest, which lists the renditions of an XRVideo that was published at several texture resolutions and mesh densities.
+/// All renditions must be time-aligned: they must have the same frames with the same timestamps and keyframes (see FrameIndex::IsTimeAlignedWith()).
+/// The manifest is a text file with the following format:
+///
+///   #XRVIDEO-RENDITIONS
+///   # Comment lines start with '#'. Each other non-empty line lists a rendition's URI, optionally followed by a label.
+///   video_high.xrv High quality
+///   video_medium.xrv Medium quality
+///   https://cdn.example.com/video_low.xrv Low quality
+///
+/// The renditions may be listed in any order; the first one is used at the start of playback. URIs are resolved against manifestUri
+/// if they are relative (i.e., if they do not specify a scheme such as "https://"); URIs that start with '/' are resolved against its origin.
+/// Returns true on success, false if the manifest cannot be parsed or does not list any rendition.
+bool ParseXRVideoRenditionManifest(const string& text, const string& manifestUri, vector<XRVideoRenditionInfo>* renditions);
+
+/// Chooses the rendition to play back for a video with multiple renditions (see XRVideo::TakeAndOpenRenditions()),
+/// based on the measured throughput of the streaming connection and the measured decoding speed.
+///
+/// Renditions are ranked by their data rate, which is assumed to be proportional to their decoding cost, since both grow
+/// with the texture resolution and the mesh density. The selector switches down as soon as the current rendition cannot be
+/// streamed or decoded in real-time, and switches up one rank at a time if the next rendition is expected to play back with a margin.
+/// Switching up requires a minimum time to have passed since the previous switch, which prevents oscillating between renditions
+/// whose requirements are close to the available resources, and gives the measurements time to adapt to the current rendition.
+class XRVideoRenditionSelector {
+ public:
+  /// Sets the average data rates of the renditions in bytes per second of playback time (see FrameIndex::ComputeBytesPerSecond()),
+  /// indexed by rendition. Renditions with a negative data rate are never selected. Resets the time since the last switch.
+  void SetRenditions(const vector<double>& bytesPerSecond, const TimePoint& now);
+  
+  /// Returns the rendition to play back, given the rendition that frames are currently decoded from and the current measurements:
+  /// - linkBytesPerSecond is the estimated throughput of the streaming connection, or zero if it is unknown or the video is not streamed.
+  /// - decodingLoad is the average decoding time per frame divided by the share of the frames' playback duration that is available
+  ///   for decoding (see XRVideo::ShouldBuffer()), i.e., values above 1 mean that decoding cannot keep up with playback.
+  ///   It is negative if it is unknown.
+  /// - playbackSpeed is the playback speed, by which the data rates of the renditions are scaled.
+  int SelectRendition(int currentRendition, double linkBytesPerSecond, double decodingLoad, double playbackSpeed, const TimePoint& now);
+  
+ private:
+  /// Returns whether the given rendition is expected to play back without stalls if the throughput of the connection
+  /// exceeds the rendition's data rate by the factor linkMargin, and the decoding load (estimated from that of the
+  /// current rendition) stays below maxDecodingLoad.
+  bool Fits(int rendition, int currentRendition, double linkBytesPerSecond, double decodingLoad, double playbackSpeed, double linkMargin, double maxDecodingLoad) const;
+  
+  /// Data rate of each rendition (indexed by rendition)
+  vector<double> renditionBytesPerSecond;
+  
+  /// The selectable renditions in order of increasing data rate
+  vector<int> renditionsByRate;
+  
+  /// The time of the last switch (or of SetRenditions())
+  TimePoint lastSwitchTime;
+};
+
+}
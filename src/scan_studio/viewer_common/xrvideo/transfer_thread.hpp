@@ -9,6 +9,7 @@
 
 #include <libvis/vulkan/libvis.h>
 
+#include "scan_studio/common/slot_queue.hpp"
 #include "scan_studio/common/xrvideo_file.hpp"
 
 #include "scan_studio/viewer_common/timing.hpp"
@@ -18,9 +19,16 @@
 
 #include "scan_studio/viewer_common/xrvideo/decoded_frame_cache.hpp"
 #include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
+#include "scan_studio/viewer_common/xrvideo/pipeline_statistics.hpp"
 
 namespace scan_studio {
 
+/// Waits for the resource transfers of the decoded frames (which the DecodingThread started) to finish,
+/// and then unlocks the frames' cache items such that they can be displayed.
+///
+/// This always runs on an own thread of the video, even if the video uses an XRVideoExecutor (see XRVideo::SetExecutor()),
+/// since waiting for the transfers blocks on GPU fences (or on the application's transfer callback for the external render path),
+/// which would tie up the executor's workers that the other videos' decoding tasks need.
 template <typename FrameT>
 class TransferThread {
  public:
@@ -39,6 +47,11 @@ class TransferThread {
     workerThreadOpenGLContext = std::move(context);
   }
   
+  /// If set to non-null, the thread records the duration of waiting for each frame's resource transfers in the given statistics object.
+  inline void SetPipelineStatistics(XRVideoPipelineStatistics* statistics) {
+    pipelineStatistics = statistics;
+  }
+  
   void StartThread(bool verboseDecoding) {
     if (thread.joinable()) { thread.join(); }
     
@@ -83,14 +96,14 @@ class TransferThread {
   }
   
   void QueueFrame(int frameIndex, s64 readingTime, s64 decodingTime, WriteLockedCachedFrame<FrameT>&& cacheItem) {
-    WorkItem* newItem = new WorkItem();
-    newItem->frameIndex = frameIndex;
-    newItem->readingTime = readingTime;
-    newItem->decodingTime = decodingTime;
-    newItem->cacheItem = move(cacheItem);
+    WorkItem newItem;
+    newItem.frameIndex = frameIndex;
+    newItem.readingTime = readingTime;
+    newItem.decodingTime = decodingTime;
+    newItem.cacheItem = move(cacheItem);
     
     workQueueMutex.lock();
-    workQueue.push_back(newItem);
+    workQueue.PushBack(move(newItem));
     workQueueMutex.unlock();
     
     newWorkCondition.notify_one();
@@ -98,14 +111,14 @@ class TransferThread {
   
   void ClearQueue(bool finishAllTransfers) {
     workQueueMutex.lock();
-    for (WorkItem* item : workQueue) {
+    for (usize i = 0; i < workQueue.Size(); ++ i) {
+      WorkItem& item = workQueue[i];
       if (finishAllTransfers) {
-        item->cacheItem.GetFrame()->WaitForResourceTransfers();
+        item.cacheItem.GetFrame()->WaitForResourceTransfers();
       }
-      item->cacheItem.Invalidate();
-      delete item;
+      item.cacheItem.Invalidate();
     }
-    workQueue.clear();
+    workQueue.Clear();
     workQueueMutex.unlock();
   }
   
@@ -150,21 +163,18 @@ class TransferThread {
     while (!quitRequested) {
       unique_lock<mutex> lock(workQueueMutex);
       
-      while (workQueue.empty() && !quitRequested) {
+      while (workQueue.Empty() && !quitRequested) {
         newWorkCondition.wait(lock);
       }
       if (quitRequested) {
         break;
       }
       
-      WorkItem* item = workQueue.front();
-      workQueue.erase(workQueue.begin());
+      WorkItem item = workQueue.PopFront();
       
       lock.unlock();
       
-      ProcessItem(item);
-      
-      delete item;
+      ProcessItem(&item);
     }
     
     DeinitializeWorkerThread();
@@ -202,6 +212,9 @@ class TransferThread {
       
       const TimePoint transferEndTime = Clock::now();
       const s64 transferTimeEstimate = NanosecondsFromTo(transferStartTime, transferEndTime);
+      if (XRVideoPipelineStatistics* statistics = pipelineStatistics.load()) {
+        statistics->Record(XRVideoPipelineStage::Transfer, transferTimeEstimate);
+      }
       
       // Update the average frame decoding time.
       // We assume that frame reading, decoding, and transfer may run in parallel.
@@ -247,7 +260,7 @@ class TransferThread {
   // Work queue
   mutex workQueueMutex;
   condition_variable newWorkCondition;
-  vector<WorkItem*> workQueue;
+  SlotQueue<WorkItem> workQueue;
   
   // OpenGL context for the worker thread
   unique_ptr<GLContext> workerThreadOpenGLContext;
@@ -265,6 +278,7 @@ class TransferThread {
   
   // Config
   bool verboseDecoding;
+  atomic<XRVideoPipelineStatistics*> pipelineStatistics = {nullptr};
 };
 
 }
@@ -18,9 +18,12 @@
 
 #include <libvis/vulkan/libvis.h>
 
+#include "scan_studio/common/slot_queue.hpp"
+
 #include "scan_studio/viewer_common/util.hpp"
 
 #include "scan_studio/viewer_common/xrvideo/decoding_thread.hpp"
+#include "scan_studio/viewer_common/xrvideo/pipeline_statistics.hpp"
 
 namespace scan_studio {
 using namespace vis;
@@ -78,6 +81,17 @@ class VideoThread {
     this->dav1dZeroCopy = dav1dZeroCopy;
   }
   
+  /// If set to non-null, the thread records the duration of decoding each frame's texture in the given statistics object.
+  inline void SetPipelineStatistics(XRVideoPipelineStatistics* statistics) {
+    pipelineStatistics = statistics;
+  }
+  
+  /// Sets the number of threads used by dav1d, or zero (the default) to choose it automatically.
+  /// Takes effect when the thread is started the next time.
+  inline void SetDav1dThreadCount(int count) {
+    dav1dThreadCount = count;
+  }
+  
   void StartThread(bool verboseDecoding, DecodingThread<FrameT>* decodingThread, FrameIndex* frameIndex) {
     if (thread.joinable()) { thread.join(); }
     
@@ -108,7 +122,7 @@ class VideoThread {
     }
   }
   
-  bool QueueFrame(int frameIndex, const shared_ptr<XRVideoFrameMetadata>& frameMetadata, const shared_ptr<vector<u8>>& frameData, const u8* frameContentPtr) {
+  bool QueueFrame(int frameIndex, const shared_ptr<XRVideoFrameMetadata>& frameMetadata, const XRVideoFrameView& frameData, const u8* frameContentPtr) {
     unique_lock<mutex> lock(workQueueMutex);
     
     if (!frameMetadata->isKeyframe && frameIndex != lastFrameIndexQueuedForDecoding + 1) {
@@ -119,13 +133,13 @@ class VideoThread {
       return false;
     }
     
-    WorkItem* newItem = new WorkItem();
-    newItem->frameIndex = frameIndex;
-    newItem->frameMetadata = frameMetadata;
-    newItem->frameData = frameData;
-    newItem->frameContentPtr = frameContentPtr;
-    newItem->lastFrameIndexQueuedForDecoding = lastFrameIndexQueuedForDecoding;
-    workQueue.push_back(newItem);
+    WorkItem newItem;
+    newItem.frameIndex = frameIndex;
+    newItem.frameMetadata = frameMetadata;
+    newItem.frameData = frameData;
+    newItem.frameContentPtr = frameContentPtr;
+    newItem.lastFrameIndexQueuedForDecoding = lastFrameIndexQueuedForDecoding;
+    workQueue.PushBack(std::move(newItem));
     
     lastFrameIndexQueuedForDecoding = frameIndex;
     
@@ -144,19 +158,53 @@ class VideoThread {
     
     // After calling dav1d_flush() (which will be done after we set abortCurrentFrames = true above),
     // we have to pass a keyframe to dav1d. So we cannot continue after the last decoded frame, as this would do:
-    // if (!workQueue.empty()) {
-    //   lastFrameIndexQueuedForDecoding = workQueue.front()->lastFrameIndexQueuedForDecoding;
+    // if (!workQueue.Empty()) {
+    //   lastFrameIndexQueuedForDecoding = workQueue.Front().lastFrameIndexQueuedForDecoding;
     // }
     lastFrameIndexQueuedForDecoding = -1;
     
-    for (WorkItem* item : workQueue) {
-      delete item;
-    }
-    workQueue.clear();
+    workQueue.Clear();
     
     workQueueMutex.unlock();
   }
   
+  /// Returns whether any of the queued frames is flagged in frameIsRelevant (which is indexed by frame index).
+  bool HasRelevantQueuedFrame(const vector<u8>& frameIsRelevant) {
+    lock_guard<mutex> lock(workQueueMutex);
+    
+    for (usize i = 0; i < workQueue.Size(); ++ i) {
+      if (frameIsRelevant[workQueue[i].frameIndex]) {
+        return true;
+      }
+    }
+    return false;
+  }
+  
+  /// Removes the queued frames that follow the last queued frame which is flagged in frameIsRelevant
+  /// (or all queued frames, if none is flagged). The remaining frames, as well as those that were already
+  /// passed to dav1d, continue to get decoded. In contrast to ClearQueueAndAbortCurrentFrames(), dav1d is not flushed,
+  /// so decoding may continue after the last retained frame, whose index is passed back in lastRetainedFrameIndex.
+  /// Returns the number of removed frames.
+  usize RemoveQueuedFramesAfterLastRelevantOne(const vector<u8>& frameIsRelevant, int* lastRetainedFrameIndex) {
+    lock_guard<mutex> lock(workQueueMutex);
+    
+    usize retainedCount = workQueue.Size();
+    while (retainedCount > 0 && !frameIsRelevant[workQueue[retainedCount - 1].frameIndex]) {
+      -- retainedCount;
+    }
+    
+    const usize removedCount = workQueue.Size() - retainedCount;
+    if (removedCount > 0) {
+      lastFrameIndexQueuedForDecoding = workQueue[retainedCount].lastFrameIndexQueuedForDecoding;
+      while (workQueue.Size() > retainedCount) {
+        workQueue.PopBack();
+      }
+    }
+    
+    *lastRetainedFrameIndex = lastFrameIndexQueuedForDecoding;
+    return removedCount;
+  }
+  
   inline int GetLastFrameIndexQueuedForDecoding() {
     workQueueMutex.lock();
     const int result = lastFrameIndexQueuedForDecoding;
@@ -175,7 +223,7 @@ class VideoThread {
     shared_ptr<XRVideoFrameMetadata> frameMetadata;
     
     /// The compressed frame data to decode.
-    shared_ptr<vector<u8>> frameData;
+    XRVideoFrameView frameData;
     
     /// Pointer to the start of the frame's encoded content (within the frameData buffer).
     const u8* frameContentPtr;
@@ -197,28 +245,32 @@ class VideoThread {
     while (!quitRequested) {
       unique_lock<mutex> lock(workQueueMutex);
       
-      while (workQueue.empty() && !quitRequested) {
+      while (workQueue.Empty() && !quitRequested) {
         newWorkCondition.wait(lock);
       }
       if (quitRequested) {
         break;
       }
       
-      WorkItem* item = workQueue.front();
-      workQueue.erase(workQueue.begin());
+      WorkItem item = workQueue.PopFront();
       
       // If the last frames were aborted, make sure that we won't get any further frames that dav1d had cached internally.
       if (abortCurrentFrames) {
         dav1d_flush(dav1dCtx.get());
-        frameQueue.clear();
+        frameQueue.Clear();
       }
       
       abortCurrentFrames = false;
       
       lock.unlock();
       
-      ProcessItem(item);
-      delete item;
+      if (XRVideoPipelineStatistics* statistics = pipelineStatistics.load()) {
+        const TimePoint processingStartTime = Clock::now();
+        ProcessItem(&item);
+        statistics->Record(XRVideoPipelineStage::VideoDecoding, NanosecondsFromTo(processingStartTime, Clock::now()));
+      } else {
+        ProcessItem(&item);
+      }
       
       // If, after processing a frame, our work queue is empty, drain any remaining frames from dav1d before waiting for new work.
       // This is necessary to avoid stalling decoding in at least two cases:
@@ -234,7 +286,7 @@ class VideoThread {
       // (or abort and call dav1d_flush(), after which a keyframe must be passed in next).
       // Otherwise, after a while, dav1d_get_picture() will hang.
       workQueueMutex.lock();
-      const bool workQueueIsEmpty = workQueue.empty();
+      const bool workQueueIsEmpty = workQueue.Empty();
       workQueueMutex.unlock();
       
       if (workQueueIsEmpty) {
@@ -308,6 +360,10 @@ class VideoThread {
       dav1dSettings.n_threads = 4;  // std::max(4, dav1d_num_logical_processors_copy());
     #endif
     
+    if (dav1dThreadCount > 0) {
+      dav1dSettings.n_threads = dav1dThreadCount;
+    }
+    
     // It can be very important for decoding bandwidth to have max_frame_delay > 1.
     // We use dav1d's default. For n_threads == 4, that would be 2.
     dav1dSettings.max_frame_delay = 0;
@@ -358,10 +414,10 @@ class VideoThread {
     // Special case: If frameMetadata.compressedRGBSize is zero, then no texture is stored because
     //               the video frame is empty.
     if (frameMetadata.compressedRGBSize == 0) {
-      if (frameQueue.empty()) {
+      if (frameQueue.Empty()) {
         if (!OutputEmptyPicture(item->frameIndex)) { return; }
       } else {
-        frameQueue.emplace_back(item->frameIndex, /*isEmpty*/ true, frameMetadata.textureWidth, frameMetadata.textureHeight);
+        frameQueue.PushBack(FrameBeingDecoded(item->frameIndex, /*isEmpty*/ true, frameMetadata.textureWidth, frameMetadata.textureHeight));
       }
       return;
     }
@@ -373,7 +429,7 @@ class VideoThread {
       return;
     }
     
-    shared_ptr<vector<u8>>* frameDataPointerCopy = new shared_ptr<vector<u8>>(item->frameData);
+    shared_ptr<const void>* frameDataPointerCopy = new shared_ptr<const void>(item->frameData.owner);
     Dav1dData data = {0};
     
     int res = dav1d_data_wrap(&data, textureDataPtr, frameMetadata.compressedRGBSize, &Dav1dFreeDataCallback, /*cookie*/ frameDataPointerCopy);
@@ -396,7 +452,7 @@ class VideoThread {
       }
       
       if (res != DAV1D_ERR(EAGAIN)) {
-        frameQueue.emplace_back(item->frameIndex, /*isEmpty*/ false, frameMetadata.textureWidth, frameMetadata.textureHeight);
+        frameQueue.PushBack(FrameBeingDecoded(item->frameIndex, /*isEmpty*/ false, frameMetadata.textureWidth, frameMetadata.textureHeight));
       }
       
       if (quitRequested || abortCurrentFrames) { dav1d_data_unref(&data); return; }
@@ -454,9 +510,9 @@ class VideoThread {
   /// Returns true on success (whether a frame was received or not), false if an error occurred.
   bool GetPictures(bool atEndOfVideo, bool* pictureReceived) {
     auto getEmptyTextureFrames = [this]() {
-      while (!frameQueue.empty() && frameQueue.front().isEmpty) {
-        if (!OutputEmptyPicture(frameQueue.front().frameIndex)) { return false; }
-        frameQueue.erase(frameQueue.begin());
+      while (!frameQueue.Empty() && frameQueue.Front().isEmpty) {
+        if (!OutputEmptyPicture(frameQueue.Front().frameIndex)) { return false; }
+        frameQueue.PopFront();
       }
       return true;
     };
@@ -474,17 +530,18 @@ class VideoThread {
     if (res >= 0) {
       if (pictureReceived) { *pictureReceived = true; }
       
-      if (frameQueue.empty()) {
+      if (frameQueue.Empty()) {
         LOG(ERROR) << "Got a frame from dav1d" << (atEndOfVideo ? " at the end of the video stream" : "") << ", but frameQueue is empty";
       } else {
-        const bool success = OutputPicture(frameQueue.front(), std::move(picture));
-        frameQueue.erase(frameQueue.begin());
+        const bool success = OutputPicture(frameQueue.PopFront(), std::move(picture));
         if (!success) { return false; }
       }
     } else if (res != DAV1D_ERR(EAGAIN)) {
       // A decoding error occurred.
       LOG(ERROR) << "dav1d_get_picture() " << (atEndOfVideo ? " at the end of the video stream" : "") << "returned " << res;
-      frameQueue.erase(frameQueue.begin());
+      if (!frameQueue.Empty()) {
+        frameQueue.PopFront();
+      }
     }
     
     // Get any empty texture frames after the dav1d picture(s)
@@ -547,14 +604,14 @@ class VideoThread {
   }
   
   static void Dav1dFreeDataCallback(const uint8_t* /*buf*/, void* cookie) {
-    shared_ptr<vector<u8>>* frameDataPointerCopy = static_cast<shared_ptr<vector<u8>>*>(cookie);
+    shared_ptr<const void>* frameDataPointerCopy = static_cast<shared_ptr<const void>*>(cookie);
     delete frameDataPointerCopy;
   }
   
   // Work queue
   mutex workQueueMutex;
   condition_variable newWorkCondition;
-  vector<WorkItem*> workQueue;
+  SlotQueue<WorkItem> workQueue;
   int lastFrameIndexQueuedForDecoding = -1;
   
   atomic<bool> abortCurrentFrames;
@@ -569,6 +626,8 @@ class VideoThread {
   // Queue of frame indices passed to dav1d.
   // Pairs of (frameIndex, isEmpty).
   struct FrameBeingDecoded {
+    inline FrameBeingDecoded() = default;
+    
     inline FrameBeingDecoded(
         int frameIndex,
         bool isEmpty,
@@ -584,7 +643,7 @@ class VideoThread {
     u32 textureWidth;
     u32 textureHeight;
   };
-  vector<FrameBeingDecoded> frameQueue;
+  SlotQueue<FrameBeingDecoded> frameQueue;
   
   // ZStd context, only allocated upon encountering a zstd-encoded texture
   shared_ptr<ZSTD_DCtx> zstdCtx;
@@ -596,6 +655,8 @@ class VideoThread {
   
   // Config
   bool verboseDecoding;
+  int dav1dThreadCount = 0;
+  atomic<XRVideoPipelineStatistics*> pipelineStatistics = {nullptr};
   
   // External objects
   DecodingThread<FrameT>* decodingThread;
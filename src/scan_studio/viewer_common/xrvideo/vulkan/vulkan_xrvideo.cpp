@@ -15,7 +15,9 @@ VulkanXRVideo::VulkanXRVideo(
     VulkanDevice* device)
     : viewCount(viewCount),
       framesInFlightCount(framesInFlightCount),
-      device(device) {}
+      device(device) {
+  videoThread.SetUseDav1dZeroCopy(&dav1dPicturePool);
+}
 
 VulkanXRVideo::~VulkanXRVideo() {
   Destroy();
@@ -131,6 +133,9 @@ bool VulkanXRVideo::ResizeDecodedFrameCache(int cachedDecodedFrameCount) {
   }
   framesLockedForRendering.clear();
   
+  // Drop pooled pictures of a previous video, which may have a different texture size
+  dav1dPicturePool.Clear();
+  
   decodedFrameCache.Initialize(cachedDecodedFrameCount);
   for (int cacheItemIndex = 0; cacheItemIndex < cachedDecodedFrameCount; ++ cacheItemIndex) {
     WriteLockedCachedFrame<VulkanXRVideoFrame> lockedFrame = decodedFrameCache.LockCacheItemForWriting(cacheItemIndex);
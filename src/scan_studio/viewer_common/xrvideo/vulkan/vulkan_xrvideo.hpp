@@ -14,6 +14,7 @@
 #include <libvis/vulkan/pipeline.h>
 #include <libvis/vulkan/render_pass.h>
 
+#include "scan_studio/viewer_common/xrvideo/dav1d_picture_pool.hpp"
 #include "scan_studio/viewer_common/xrvideo/decoded_frame_cache.hpp"
 #include "scan_studio/viewer_common/xrvideo/decoding_thread.hpp"
 #include "scan_studio/viewer_common/xrvideo/xrvideo.hpp"
@@ -54,6 +55,9 @@ class VulkanXRVideo : public XRVideoImpl<VulkanXRVideoFrame> {
   
   u32 currentFrame = 0;
   
+  /// Pool for the pictures decoded by dav1d, such that their textures can be copied to the staging buffers in one go
+  Dav1dPicturePool dav1dPicturePool;
+  
   // Uniform buffers for the vertex shader (for each frame in flight)
   #pragma pack(push, 1)
   struct UniformBufferDataVertex {
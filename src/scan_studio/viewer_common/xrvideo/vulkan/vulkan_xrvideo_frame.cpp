@@ -129,6 +129,18 @@ bool VulkanXRVideoFrame::Initialize(
     vertexAlphaBuffer.SetDebugNameIfDebugging("vertexAlphaBuffer");
   }
   
+  // Destroy the textures if this frame is reused for a frame with a different texture size (e.g., of another rendition),
+  // such that they get re-created below
+  auto destroyTextureIfSizeDiffers = [](VulkanTexture* texture, u32 width, u32 height) {
+    if (texture->is_initialized() && (texture->image().width() != width || texture->image().height() != height)) {
+      texture->Destroy();
+    }
+  };
+  destroyTextureIfSizeDiffers(&textureRGB, metadata.textureWidth, metadata.textureHeight);
+  destroyTextureIfSizeDiffers(&textureLuma, metadata.textureWidth, metadata.textureHeight);
+  destroyTextureIfSizeDiffers(&textureChromaU, metadata.textureWidth / 2, metadata.textureHeight / 2);
+  destroyTextureIfSizeDiffers(&textureChromaV, metadata.textureWidth / 2, metadata.textureHeight / 2);
+  
   // Initialize textures (if not reusing this frame)
   if (metadata.zstdRGBTexture) {
     if (!textureRGB.is_initialized()) {
@@ -196,6 +208,7 @@ bool VulkanXRVideoFrame::Initialize(
     }
   } else {
     auto textureData = textureFramePromise->Take();
+    // The picture was allocated by the video's Dav1dPicturePool, so for texture sizes that are multiples of 128, this is a single memcpy().
     // TODO: Try to use zero-copy to improve performance, handling shared-CPU-GPU-memory devices and devices with dedicated GPU memory
     if (textureData) {
       XRVideoCopyTexture(*textureData, textureStagingBuffer.data<u8>(), verboseDecoding);
@@ -378,6 +391,11 @@ void VulkanXRVideoFrame::Destroy() {
   textureRGB.Destroy();
 }
 
+void VulkanXRVideoFrame::ReleaseResources() {
+  // Destroy() keeps the device that was set by Configure(), and Initialize() re-creates all resources that are not initialized
+  Destroy();
+}
+
 void VulkanXRVideoFrame::WaitForResourceTransfers() {
   if (!transferFence.Wait()) {
     LOG(ERROR) << "An error occurred in waiting for transferFence";
@@ -45,6 +45,10 @@ class VulkanXRVideoFrame : public XRVideoFrame {
       bool verboseDecoding);
   void Destroy();
   
+  /// Releases the frame's buffers and textures after it got evicted from the decoded frame cache.
+  /// The configuration remains, such that the frame can be initialized again.
+  void ReleaseResources();
+  
   void WaitForResourceTransfers();
   
   void EnsureResourcesAreInGraphicsQueueFamily(VulkanCommandBuffer* cmdBuf);
@@ -23,6 +23,16 @@ constexpr bool kVerbose = false;
 
 constexpr float bufferingDurationThresholdInSeconds = 0.1f;
 
+/// Decoding is considered to be real-time if it takes at most this share of the frames' playback duration
+constexpr double realtimeDecodingHeadroomFactor = 0.85;
+
+/// Playback of streamed videos only starts once this share of the streaming lookahead (see StreamingBandwidthEstimator::ComputeWindow())
+/// has been streamed. Since the lookahead grows as the link's headroom over the video's data rate shrinks, slow links buffer deeper.
+constexpr double minStreamedLookaheadShareForPlayback = 1 / 3.;
+
+/// The interval in which the rendition gets chosen for videos with multiple renditions
+constexpr double renditionSelectionIntervalInSeconds = 0.5;
+
 void XRVideo::SetExternalFrameResourcesCallbacks(std::function<bool(int, void*)> allocateCallback, std::function<void()> releaseAllCallback) {
   allocateExternalFrameResourcesCallback = allocateCallback;
   releaseAllExternalFrameResourcesCallback = releaseAllCallback;
@@ -38,7 +48,21 @@ bool XRVideo::Initialize(int cachedDecodedFrameCount, bool verboseDecoding, XRVi
   return true;
 }
 
-bool XRVideo::TakeAndOpen(InputStream* videoInputStream, bool isStreamingInputStream, bool cacheAllFrames) {
+bool XRVideo::TakeAndOpen(InputStream* videoInputStream, bool isStreamingInputStream, bool cacheAllFrames, bool isMappedFileInputStream) {
+  return TakeAndOpenRenditions({videoInputStream}, isStreamingInputStream, cacheAllFrames, isMappedFileInputStream);
+}
+
+bool XRVideo::TakeAndOpenRenditions(const vector<InputStream*>& renditionInputStreams, bool areStreamingInputStreams, bool cacheAllFrames, bool areMappedFileInputStreams) {
+  if (renditionInputStreams.empty()) {
+    LOG(ERROR) << "No input stream was given";
+    return false;
+  }
+  
+  vector<unique_ptr<InputStream>> additionalRenditionInputStreams;
+  for (usize rendition = 1; rendition < renditionInputStreams.size(); ++ rendition) {
+    additionalRenditionInputStreams.emplace_back(renditionInputStreams[rendition]);
+  }
+  
   // TODO: If this is called while a video is already being loaded, is there a chance that
   //       the ReadingThread modifies asyncLoadState after the assignment below, but before it
   //       switches to the new file?
@@ -47,18 +71,20 @@ bool XRVideo::TakeAndOpen(InputStream* videoInputStream, bool isStreamingInputSt
   if (reader.IsOpen()) {
     // Initiate a delayed switch to the new video (see the comment on TakeAndOpen()).
     RequestLoadingThreadsToExit();
-    nextInputStream.reset(videoInputStream);
-    nextInputStreamIsStreamingInputStream = isStreamingInputStream;
+    nextInputStream.reset(renditionInputStreams.front());
+    nextAdditionalRenditionInputStreams = std::move(additionalRenditionInputStreams);
+    nextInputStreamIsStreamingInputStream = areStreamingInputStreams;
+    nextInputStreamIsMappedFileInputStream = areMappedFileInputStreams;
     nextCacheAllFrames = cacheAllFrames;
     return true;
   }
   
-  return TakeAndOpenImpl(videoInputStream, isStreamingInputStream, cacheAllFrames);
+  return TakeAndOpenImpl(renditionInputStreams.front(), std::move(additionalRenditionInputStreams), areStreamingInputStreams, areMappedFileInputStreams, cacheAllFrames);
 }
 
 s64 XRVideo::Update(s64 elapsedNanoseconds) {
   constexpr s64 kErrorAndPreLoadReturnValue = numeric_limits<s64>::lowest();
-
+  
   if (!reader.IsOpen()) {
     return kErrorAndPreLoadReturnValue;
   }
@@ -89,6 +115,11 @@ s64 XRVideo::Update(s64 elapsedNanoseconds) {
     SetDecodedFrameCacheInitialized(true);
   }
   
+  // For videos with multiple renditions, choose the rendition to read the following frames from
+  if (GetRenditionCount() > 1) {
+    UpdateRendition();
+  }
+  
   // If we were buffering, check whether enough frames were decoded so we can stop doing that
   if (isBuffering && !ShouldBuffer()) {
     StopBuffering();
@@ -140,6 +171,15 @@ s64 XRVideo::Update(s64 elapsedNanoseconds) {
     StartBuffering();
   }
   
+  if (executor) {
+    UpdateExecutorPriority();
+  }
+  if (memoryAccount) {
+    memoryAccount->SetVisible(isVisible);
+    memoryAccount->Governor()->RebalanceIfDue();
+    ReleaseEvictedFrameResources();
+  }
+  
   return playbackTime;
 }
 
@@ -150,12 +190,32 @@ void XRVideo::Seek(s64 timestamp, bool forward) {
   // outdated frames again after we call AbortCurrentFrames() on it.
   playbackState.Lock();
   
-  // Abort frame reading and clear the frame decoding thread queue from already-read, but not decoded, frames.
-  // TODO: We should keep those frames in the queues that happen to be still relevant for the seeked-to video time, if any.
-  ClearLoadingThreadWorkQueues();
-  
   playbackState.Seek(timestamp, forward);
   
+  // Abort frame reading and clear the loading threads' queues from already-read, but not decoded, frames,
+  // except for those that are still relevant for the seeked-to video time (for example, with small forward seeks
+  // or scrubbing within a group of pictures). This avoids decoding these frames again, starting from their keyframe.
+  // (The index may only be accessed once async loading finished; before, there are no queued frames anyway.)
+  if (asyncLoadState == XRVideoAsyncLoadState::Ready) {
+    // Flag the frames that the reading thread will read for the seeked-to video time: the next frames that will be
+    // played back (as many as fit into the cache), and the frames that these depend on.
+    vector<u8> frameIsRelevant(index.GetFrameCount(), 0);
+    NextFramesIterator nextFramesIt(&playbackState, &index);
+    for (int i = 0, cacheCapacity = GetUsableCacheCapacity(); i < cacheCapacity && !nextFramesIt.AtEnd() && *nextFramesIt >= 0; ++ i, ++ nextFramesIt) {
+      const int frameIndex = *nextFramesIt;
+      frameIsRelevant[frameIndex] = 1;
+      
+      int baseKeyframe, predecessor;
+      index.FindDependencyFrames(frameIndex, &baseKeyframe, &predecessor);
+      if (baseKeyframe >= 0) { frameIsRelevant[baseKeyframe] = 1; }
+      if (predecessor >= 0) { frameIsRelevant[predecessor] = 1; }
+    }
+    
+    ClearIrrelevantLoadingThreadWork(frameIsRelevant);
+  } else {
+    ClearLoadingThreadWorkQueues();
+  }
+  
   playbackState.Unlock();
   
   // If an insufficient number of frames to display is cached after seeking, go into buffering state.
@@ -217,7 +277,9 @@ bool XRVideo::ShouldBuffer() {
   //    * The video has finished decoding.
   //    * The cache is nearly full with ready frames ("nearly", because it might not get filled completely,
   //      since some frames depend on other frames, thus there might not be exactly enough space for the last frame).
-  const int cacheCapacity = GetCacheCapacity();
+  // 3) For streamed videos, unless all remaining frames are decoded: A share of the streaming lookahead has been streamed,
+  //    such that playback does not stall right away if the network is slow.
+  const int cacheCapacity = GetUsableCacheCapacity();
   
   playbackState.Lock();
   const NextFramesIterator nextFramesIt(&playbackState, &index);
@@ -245,10 +307,10 @@ bool XRVideo::ShouldBuffer() {
     remainingFramesInVideo = numeric_limits<int>::max();
   }
   
-  constexpr double realtimeDecodingHeadroomFactor = 0.85;
-  
   const s64 averageFrameDuration = (readyFramesCount > 0) ? (fabs(readyFramesEndTime - readyFramesStartTime) / readyFramesCount) : 0;
-  const int minimumReadyFramesCount = min(min(5, cacheCapacity), remainingFramesInVideo);
+  // Small caches (e.g., if limited by a memory governor) may have to hold the keyframe and predecessor of the ready frames as well,
+  // so they cannot always hold five ready frames.
+  const int minimumReadyFramesCount = min(min(5, max(1, cacheCapacity - 2)), remainingFramesInVideo);
   
   float newBufferingProgress = 0;
   
@@ -275,7 +337,17 @@ bool XRVideo::ShouldBuffer() {
     //        This may be useful if you suspect that more frames stay locked than they should.
     // PrintCacheHealth();
     
-    if (averageDecodingTimeSampleCount > 0 &&
+    double streamingProgress = 1;
+    if (remainingFramesToDecodeCount > 0) {
+      const s64 requiredStreamedNanoseconds = minStreamedLookaheadShareForPlayback * GetStreamingLookaheadNanoseconds();
+      if (requiredStreamedNanoseconds > 0) {
+        streamingProgress = ComputeStreamedNanoseconds(nextFramesIt, requiredStreamedNanoseconds) / static_cast<double>(requiredStreamedNanoseconds);
+      }
+    }
+    const bool enoughDataStreamed = streamingProgress >= 1;
+    
+    if (enoughDataStreamed &&
+        averageDecodingTimeSampleCount > 0 &&
         readyFramesCount >= 5 &&
         averageFrameDecodingTime <= realtimeDecodingHeadroomFactor * averageFrameDuration) {
       // Decoding is faster than real-time --> start playback.
@@ -298,9 +370,13 @@ bool XRVideo::ShouldBuffer() {
           requiredFramesCount / static_cast<double>(cacheCapacity - 2));
     }
     
+    // Waiting for the streamed data limits the progress
+    newBufferingProgress = std::min<double>(newBufferingProgress, streamingProgress);
+    
     if (remainingFramesToDecodeCount == 0 ||
-        decodingTimeEstimateForRemainderOfVideo <= realtimeDecodingHeadroomFactor * videoRemainderPlaybackTime ||
-        (cacheCapacity < index.GetFrameCount() && requiredFramesCount >= cacheCapacity - 2)) {  // the 2 comes from the two frames that a third frame may depend on
+        (enoughDataStreamed &&
+          (decodingTimeEstimateForRemainderOfVideo <= realtimeDecodingHeadroomFactor * videoRemainderPlaybackTime ||
+           (cacheCapacity < index.GetFrameCount() && requiredFramesCount >= cacheCapacity - 2)))) {  // the 2 comes from the two frames that a third frame may depend on
       // We expect to fill the cache before playback of the whole cache will finish if starting playback now, or the cache is nearly full --> start playback.
       // TODO: In this case, we expect to run into issues and require buffering again (unless the video has only a few more frames than the decoded frame cache).
       //       We might want to reduce the playback speed and show a warning to the user to choose a lower video quality, if available.
@@ -331,6 +407,77 @@ bool XRVideo::ShouldBuffer() {
   return true;
 }
 
+void XRVideo::UpdateRendition() {
+  if (renditionSetting >= 0) {
+    SetTargetRendition(renditionSetting);
+    return;
+  }
+  
+  const TimePoint now = Clock::now();
+  if (!renditionSelectorInitialized) {
+    renditionSelector.SetRenditions(GetRenditionBytesPerSecond(), now);
+    renditionSelectorInitialized = true;
+    lastRenditionSelectionTime = now;
+    return;
+  }
+  
+  if (SecondsFromTo(lastRenditionSelectionTime, now) < renditionSelectionIntervalInSeconds) {
+    return;
+  }
+  lastRenditionSelectionTime = now;
+  
+  playbackState.Lock();
+  const NextFramesIterator nextFramesIt(&playbackState, &index);
+  const double playbackSpeed = playbackState.GetPlaybackSpeed();
+  playbackState.Unlock();
+  
+  int requiredFramesCount, readyFramesCount;
+  s64 readyFramesStartTime, readyFramesEndTime;
+  int averageDecodingTimeSampleCount;
+  s64 averageFrameDecodingTime;
+  CheckDecodingProgress(
+      nextFramesIt,
+      &requiredFramesCount, &readyFramesCount,
+      &readyFramesStartTime, &readyFramesEndTime,
+      &averageDecodingTimeSampleCount, &averageFrameDecodingTime);
+  
+  // The decoding load is relative to the decoding time that ShouldBuffer() considers to be real-time
+  const double averageFrameDuration = (index.GetVideoEndTimestamp() - index.GetVideoStartTimestamp()) / static_cast<double>(index.GetFrameCount());
+  const double decodingLoad =
+      (averageDecodingTimeSampleCount > 0 && averageFrameDuration > 0) ?
+      (averageFrameDecodingTime * fabs(playbackSpeed) / (realtimeDecodingHeadroomFactor * averageFrameDuration)) : -1;
+  
+  const int currentRendition = GetDecodingRendition();
+  const int rendition = renditionSelector.SelectRendition(currentRendition, GetLinkBytesPerSecond(), decodingLoad, playbackSpeed, now);
+  if (kVerbose && rendition != currentRendition) {
+    LOG(INFO) << "Switching from rendition " << currentRendition << " to rendition " << rendition << " (decoding load: " << decodingLoad
+              << ", link bytes per second: " << GetLinkBytesPerSecond() << ")";
+  }
+  SetTargetRendition(rendition);
+}
+
+void XRVideo::UpdateExecutorPriority() {
+  playbackState.Lock();
+  const NextFramesIterator nextFramesIt(&playbackState, &index);
+  const double playbackSpeed = playbackState.GetPlaybackSpeed();
+  playbackState.Unlock();
+  
+  int requiredFramesCount, readyFramesCount;
+  s64 readyFramesStartTime, readyFramesEndTime;
+  int averageDecodingTimeSampleCount;
+  s64 averageFrameDecodingTime;
+  CheckDecodingProgress(
+      nextFramesIt,
+      &requiredFramesCount, &readyFramesCount,
+      &readyFramesStartTime, &readyFramesEndTime,
+      &averageDecodingTimeSampleCount, &averageFrameDecodingTime);
+  
+  // Use the time span of the ready frames, which works for both playback directions. (When a loop wraps around
+  // within the ready frames, this overestimates the buffered time, which is acceptable for prioritization.)
+  const s64 bufferedNanoseconds = (readyFramesCount > 0) ? static_cast<s64>((readyFramesEndTime - readyFramesStartTime) / playbackSpeed) : 0;
+  SetExecutorPriority(isVisible, bufferedNanoseconds);
+}
+
 void XRVideo::StartBuffering() {
   isBuffering = true;
   bufferingProgressPercent = 0;
@@ -351,15 +498,26 @@ bool XRVideo::SwitchToNextInputStream() {
   ClearLoadingThreadWorkQueues();
   
   // Assign the next input stream to the reader and restart the loading threads
-  if (!TakeAndOpenImpl(nextInputStream.release(), nextInputStreamIsStreamingInputStream, nextCacheAllFrames)) {
+  if (!TakeAndOpenImpl(nextInputStream.release(), std::move(nextAdditionalRenditionInputStreams), nextInputStreamIsStreamingInputStream, nextInputStreamIsMappedFileInputStream, nextCacheAllFrames)) {
     return false;
   }
   
   return true;
 }
 
-bool XRVideo::TakeAndOpenImpl(InputStream* videoInputStream, bool isStreamingInputStream, bool cacheAllFrames) {
-  reader.TakeInputStream(videoInputStream, isStreamingInputStream);
+bool XRVideo::TakeAndOpenImpl(InputStream* videoInputStream, vector<unique_ptr<InputStream>>&& additionalRenditionInputStreams, bool isStreamingInputStream, bool isMappedFileInputStream, bool cacheAllFrames) {
+  reader.TakeInputStream(videoInputStream, isStreamingInputStream, isMappedFileInputStream);
+  
+  additionalRenditionReaders.clear();
+  for (unique_ptr<InputStream>& renditionInputStream : additionalRenditionInputStreams) {
+    additionalRenditionReaders.emplace_back(new XRVideoReader());
+    additionalRenditionReaders.back()->TakeInputStream(renditionInputStream.release(), isStreamingInputStream, isMappedFileInputStream);
+  }
+  nextAdditionalRenditionInputStreams.clear();
+  
+  // The rendition selector gets initialized with the renditions' data rates once they were loaded
+  renditionSelectorInitialized = false;
+  SetTargetRendition(0);
   
   this->cacheAllFrames = cacheAllFrames;
   
@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include <libvis/io/filesystem.h>
 #include <libvis/io/input_stream.h>
 #include <libvis/vulkan/libvis.h>
 
@@ -13,8 +14,10 @@
 #include "scan_studio/viewer_common/xrvideo/decoding_thread.hpp"
 #include "scan_studio/viewer_common/xrvideo/frame_loading.hpp"
 #include "scan_studio/viewer_common/xrvideo/index.hpp"
+#include "scan_studio/viewer_common/xrvideo/pipeline_statistics.hpp"
 #include "scan_studio/viewer_common/xrvideo/playback_state.hpp"
 #include "scan_studio/viewer_common/xrvideo/reading_thread.hpp"
+#include "scan_studio/viewer_common/xrvideo/rendition_set.hpp"
 #include "scan_studio/viewer_common/xrvideo/transfer_thread.hpp"
 #include "scan_studio/viewer_common/xrvideo/video_thread.hpp"
 
@@ -85,10 +88,24 @@ class XRVideo {
   /// This is used to improve streaming performance by calling additional functions
   /// on StreamingInputStream to pre-read data.
   ///
+  /// Similarly, `isMappedFileInputStream` must be set to true if a MappedFileInputStream is passed in.
+  /// In this case, frame data is passed to the decoding threads directly from the file mapping, without copying it.
+  ///
   /// TODO: Since this takes a raw pointer, code using this function tends to be dangerous,
   ///       potentially forgetting to delete the pointer in error cases or deleting it when it was already taken.
   ///       Use a unique or shared pointer instead.
-  bool TakeAndOpen(InputStream* videoInputStream, bool isStreamingInputStream, bool cacheAllFrames);
+  bool TakeAndOpen(InputStream* videoInputStream, bool isStreamingInputStream, bool cacheAllFrames, bool isMappedFileInputStream = false);
+  
+  /// Variant of TakeAndOpen() for a video that is published in multiple renditions (e.g., at several texture resolutions and mesh densities,
+  /// as listed by a rendition set manifest, see ParseXRVideoRenditionManifest()). Takes ownership of one input stream per rendition,
+  /// which must all be of the type given by the flags (see TakeAndOpen()). The frames of the renditions must be time-aligned
+  /// (see FrameIndex::IsTimeAlignedWith()); renditions that are not get excluded from playback.
+  ///
+  /// Playback starts with the first rendition. Afterwards, the rendition is chosen according to SetRendition(), by default adaptively to the
+  /// measured throughput of the streaming connection and the decoding headroom (see XRVideoRenditionSelector). Renditions are switched
+  /// at the next keyframe that gets read, while the already decoded frames remain valid, such that switching does not stall playback.
+  /// The indices of all renditions are loaded while opening the video. The video's texture size is the largest one among the renditions.
+  bool TakeAndOpenRenditions(const vector<InputStream*>& renditionInputStreams, bool areStreamingInputStreams, bool cacheAllFrames, bool areMappedFileInputStreams = false);
   
   /// Updates the XRVideo's playback state by the elapsed time.
   /// Returns the updated playback time.
@@ -124,6 +141,65 @@ class XRVideo {
   /// this to become true).
   bool IsCurrentFrameDisplayReady();
   
+  /// Sets an object in which the loading threads record the per-frame durations of the decoding pipeline stages
+  /// (e.g., for benchmarking), or nullptr (the default) to disable recording.
+  /// The object must remain valid for as long as the loading threads may run.
+  virtual void SetPipelineStatistics(XRVideoPipelineStatistics* statistics) = 0;
+  
+  /// Sets the number of additional worker threads (default: 0) that decompress the independently compressed parts
+  /// of each frame (mesh data, deformation state, vertex alpha) in parallel. This reduces the decoding latency of keyframes,
+  /// e.g., for seeking, at the cost of more threads. Takes effect when the loading threads are started the next time,
+  /// so it should be called before TakeAndOpen().
+  virtual void SetDecompressionWorkerCount(int count) = 0;
+  
+  /// Sets the number of decoding workers (default: 1) that decode consecutive frames concurrently, which speeds up filling the
+  /// decoded frame cache, e.g., after seeking or when caching all frames. Decoded frames are still handed on in frame order.
+  /// Since this calls the frames' Initialize() concurrently, it is only useful for render paths that support this:
+  /// The OpenGL render path always uses a single worker, since it has only one worker thread context, and
+  /// for the external render path, the decoding thread callbacks must be safe to be called concurrently for different frames.
+  /// Takes effect when the loading threads are started the next time, so it should be called before TakeAndOpen().
+  virtual void SetDecodingWorkerCount(int count) = 0;
+  
+  /// Makes the video run its frame decoding work as tasks on the given executor, which is shared with other videos, instead of
+  /// on its own decoding worker threads (in which case SetDecodingWorkerCount() has no effect), or nullptr (the default) to use own threads.
+  /// This bounds the total number of decoding threads for scenes with many videos. The executor also determines the number of threads
+  /// that the video's AV1 decoder uses. The video's reading, video, and transfer threads remain own threads of the video, since they block
+  /// (see XRVideoExecutor), so each video still uses three threads besides the executor. The OpenGL render path does not support executors, since its decoding thread owns an OpenGL context.
+  /// The executor must remain valid until the video is destroyed. Takes effect when the loading threads are started the next time,
+  /// so it should be called before TakeAndOpen().
+  virtual void SetExecutor(XRVideoExecutor* executor) = 0;
+  
+  /// Makes the video's decoded frame cache take part in the given memory governor's budget, or nullptr (the default) to always use the whole cache.
+  /// The governor then limits the number of cached frames to between minCachedFrameCount (raised to 3 if smaller) and the cache size configured with Initialize()
+  /// (or the video's frame count if caching all frames). The governor must remain valid until the video is destroyed.
+  virtual void SetMemoryGovernor(XRVideoMemoryGovernor* governor, int minCachedFrameCount) = 0;
+  
+  /// Sets the budget in bytes for keeping the compressed data of read frames in memory, or zero (the default) to disable this.
+  /// Frames that must be decoded again after they were dropped from the decoded frame cache (e.g., when looping a video that is
+  /// longer than the cache) are then taken from memory instead of being read (or, when streaming, downloaded) again.
+  /// Since compressed frames are much smaller than decoded ones, this allows keeping much longer videos in memory than cacheAllFrames.
+  /// Has no effect for MappedFileInputStreams, whose data is accessed in the file mapping directly.
+  virtual void SetCompressedFrameCacheBudget(s64 bytes) = 0;
+  
+  /// Returns the total size in bytes of the compressed frame data that is kept in memory (see SetCompressedFrameCacheBudget()).
+  virtual s64 GetCompressedFrameCacheBytes() = 0;
+  
+  /// Sets the path of a sidecar file that caches the frame index for videos without an index chunk, or an empty path (the default) to not use one.
+  /// Building the index for such videos requires seeking over all their frames, which is slow for large files (especially when streaming).
+  /// If the sidecar file exists and belongs to the video, the index is loaded from it instead; otherwise, the index is saved to it once built.
+  /// Takes effect when the loading threads are started the next time, so it should be called before TakeAndOpen().
+  virtual void SetSidecarIndexPath(const fs::path& path) = 0;
+  
+  /// Sets whether the video is currently visible (default: true). If the video uses an executor (see SetExecutor()),
+  /// the executor prefers the decoding work of visible videos over that of invisible ones.
+  /// Likewise, a memory governor (see SetMemoryGovernor()) assigns its budget to visible videos first.
+  inline void SetVisible(bool visible) { isVisible = visible; }
+  
+  /// For videos with multiple renditions (see TakeAndOpenRenditions()), sets the rendition to play back,
+  /// or -1 (the default) to choose the rendition adaptively.
+  inline void SetRendition(int rendition) { renditionSetting = rendition; }
+  inline int GetRendition() const { return renditionSetting; }
+  
   
   // --- Accessors ---
   
@@ -167,6 +243,12 @@ class XRVideo {
     return index;
   }
   
+  /// Returns the number of renditions of the video (which is 1 unless it was opened with TakeAndOpenRenditions()).
+  inline int GetRenditionCount() const { return 1 + additionalRenditionReaders.size(); }
+  
+  /// Returns the rendition that frames are currently decoded from. The frames that were decoded before may be from another rendition.
+  virtual int GetDecodingRendition() const = 0;
+  
   /// Returns whether the video is in the buffering state.
   inline bool IsBuffering() const { return isBuffering; }
   
@@ -210,8 +292,15 @@ class XRVideo {
   
   virtual int GetCacheCapacity() const = 0;
   
+  /// Returns the number of frames that the decoded frame cache may currently hold,
+  /// which may be less than GetCacheCapacity() if a memory governor is used.
+  virtual int GetUsableCacheCapacity() const = 0;
+  
   virtual void InvalidateAllCacheItems() = 0;
   
+  /// Releases the resources of the frames that the decoded frame cache evicted to apply the slot limit of the memory account (if any).
+  virtual void ReleaseEvictedFrameResources() = 0;
+  
   virtual void CheckDecodingProgress(
       const NextFramesIterator& nextPlayedFramesIt,
       int* requiredFramesCount, int* readyFramesCount,
@@ -220,16 +309,36 @@ class XRVideo {
   
   virtual void DebugPrintCacheHealth() {}
   
+  /// Passes the video's priority on to the executor (see SetExecutor()), if one is used.
+  /// bufferedNanoseconds is the playback duration of the decoded frames ahead of the current playback time.
+  virtual void SetExecutorPriority(bool isVisible, s64 bufferedNanoseconds) = 0;
+  
   virtual void ClearLoadingThreadWorkQueues() = 0;
   
+  /// Variant of ClearLoadingThreadWorkQueues() for seeking, which keeps the queued frames that are flagged in frameIsRelevant
+  /// (indexed by frame index), as well as the queued frames that these depend on.
+  virtual void ClearIrrelevantLoadingThreadWork(const vector<u8>& frameIsRelevant) = 0;
+  
+  /// Rendition support, see ReadingThread.
+  virtual void SetTargetRendition(int rendition) = 0;
+  virtual const vector<double>& GetRenditionBytesPerSecond() const = 0;
+  virtual double GetLinkBytesPerSecond() = 0;
+  virtual s64 GetStreamingLookaheadNanoseconds() = 0;
+  virtual s64 ComputeStreamedNanoseconds(const NextFramesIterator& nextFramesIt, s64 maxNanoseconds) = 0;
+  
   bool ShouldBuffer();
   
+  /// For videos with multiple renditions, chooses the rendition to read the following frames from (see SetRendition()).
+  void UpdateRendition();
+  
+  void UpdateExecutorPriority();
+  
   void StartBuffering();
   void StopBuffering();
   
   bool SwitchToNextInputStream();
   
-  bool TakeAndOpenImpl(InputStream* videoInputStream, bool isStreamingInputStream, bool cacheAllFrames);
+  bool TakeAndOpenImpl(InputStream* videoInputStream, vector<unique_ptr<InputStream>>&& additionalRenditionInputStreams, bool isStreamingInputStream, bool isMappedFileInputStream, bool cacheAllFrames);
   
   
   // --- Asynchronously initialized metadata / state (at reading thread startup) ---
@@ -253,6 +362,11 @@ class XRVideo {
   /// The current playback state of the video.
   PlaybackState playbackState;
   
+  /// The video's account at the memory governor set with SetMemoryGovernor(), or null.
+  /// Declared after playbackState, which the account's callback accesses, such that it is destructed before.
+  shared_ptr<XRVideoMemoryAccount> memoryAccount;
+  int minCachedFrameCount = 3;
+  
   // --- End of asynchronously initialized metadata / state ---
   
   
@@ -282,6 +396,12 @@ class XRVideo {
   /// Whether to output verbose log messages for frame decoding.
   bool verboseDecoding;
   
+  /// The executor set with SetExecutor() (not owned), or nullptr if the video uses its own decoding threads.
+  XRVideoExecutor* executor = nullptr;
+  
+  /// Whether the video is visible, as set with SetVisible().
+  bool isVisible = true;
+  
   /// The cached decoded frame count configured with Initialize().
   int cachedDecodedFrameCount;
   
@@ -293,10 +413,25 @@ class XRVideo {
   /// this is exclusively used by the reading thread (and thus other uses would not be thread-safe).
   XRVideoReader reader;
   
-  /// The next input stream to switch to.
-  /// This is used on multiple calls to TakeAndOpen().
+  /// The readers of the video's renditions other than the first one, which is read by `reader` (see TakeAndOpenRenditions()).
+  /// Like `reader`, these are exclusively used by the reading thread while it runs.
+  vector<unique_ptr<XRVideoReader>> additionalRenditionReaders;
+  
+  /// The rendition set with SetRendition(), or -1 for adaptive rendition selection.
+  int renditionSetting = -1;
+  
+  /// Adaptive rendition selection (see UpdateRendition()).
+  /// The selector gets initialized with the renditions' data rates once async loading finished.
+  XRVideoRenditionSelector renditionSelector;
+  bool renditionSelectorInitialized = false;
+  TimePoint lastRenditionSelectionTime;
+  
+  /// The next input stream(s) to switch to.
+  /// This is used on multiple calls to TakeAndOpen() or TakeAndOpenRenditions().
   unique_ptr<InputStream> nextInputStream;
+  vector<unique_ptr<InputStream>> nextAdditionalRenditionInputStreams;
   bool nextInputStreamIsStreamingInputStream;
+  bool nextInputStreamIsMappedFileInputStream;
   bool nextCacheAllFrames;
   
   /// External frame resources callbacks (may be null)
@@ -315,10 +450,74 @@ class XRVideo {
 template <class FrameT>
 class XRVideoImpl : public XRVideo {
  public:
+  inline XRVideoImpl() {
+    // Wake up the reading thread when read locks get released, since it may have been waiting for cache space.
+    // Note that read locks are never released while holding the playbackState lock.
+    decodedFrameCache.SetReadLocksReleasedCallback([this]() { playbackState.NotifyDecodedFrameCacheSpaceAvailable(); });
+    
+    readingThread.SetAdditionalRenditionReaders(&additionalRenditionReaders);
+  }
+  
   virtual inline ~XRVideoImpl() {}
   
+  virtual void SetPipelineStatistics(XRVideoPipelineStatistics* statistics) override {
+    readingThread.SetPipelineStatistics(statistics);
+    videoThread.SetPipelineStatistics(statistics);
+    decodingThread.SetPipelineStatistics(statistics);
+    transferThread.SetPipelineStatistics(statistics);
+  }
+  
+  virtual void SetDecompressionWorkerCount(int count) override {
+    decodingThread.SetDecompressionWorkerCount(count);
+  }
+  
+  virtual void SetDecodingWorkerCount(int count) override {
+    decodingThread.SetWorkerCount(count);
+  }
+  
+  virtual void SetExecutor(XRVideoExecutor* executor) override {
+    this->executor = executor;
+    decodingThread.SetExecutor(executor);
+    videoThread.SetDav1dThreadCount(executor ? executor->GetDav1dThreadCount() : 0);
+  }
+  
+  virtual void SetMemoryGovernor(XRVideoMemoryGovernor* governor, int minCachedFrameCount) override {
+    decodedFrameCache.SetMemoryAccount(nullptr);
+    memoryAccount.reset();
+    
+    if (governor) {
+      this->minCachedFrameCount = minCachedFrameCount;
+      memoryAccount = governor->CreateAccount();
+      memoryAccount->SetVisible(isVisible);
+      memoryAccount->SetSlotLimitChangedCallback([this]() { playbackState.NotifyDecodedFrameCacheSpaceAvailable(); });
+      if (decodedFrameCache.GetCapacity() > 0) {
+        memoryAccount->SetSlotRange(minCachedFrameCount, decodedFrameCache.GetCapacity());
+      }
+      decodedFrameCache.SetMemoryAccount(memoryAccount.get());
+    }
+  }
+  
+  virtual void SetCompressedFrameCacheBudget(s64 bytes) override {
+    readingThread.SetCompressedFrameCacheBudget(bytes);
+  }
+  
+  virtual s64 GetCompressedFrameCacheBytes() override {
+    return readingThread.GetCompressedFrameCacheBytes();
+  }
+  
+  virtual void SetSidecarIndexPath(const fs::path& path) override {
+    readingThread.SetSidecarIndexPath(path);
+  }
+  
+  virtual int GetDecodingRendition() const override {
+    return readingThread.GetDecodingRendition();
+  }
+  
  protected:
   virtual void SetDecodedFrameCacheInitialized(bool initialized) override {
+    if (initialized && memoryAccount) {
+      memoryAccount->SetSlotRange(minCachedFrameCount, decodedFrameCache.GetCapacity());
+    }
     readingThread.SetDecodedFrameCacheInitialized(initialized);
   }
   
@@ -365,10 +564,20 @@ class XRVideoImpl : public XRVideo {
     return decodedFrameCache.GetCapacity();
   }
   
+  virtual int GetUsableCacheCapacity() const override {
+    return decodedFrameCache.GetSlotLimit();
+  }
+  
   virtual void InvalidateAllCacheItems() override {
     decodedFrameCache.InvalidateAllCacheItems();
   }
   
+  virtual void ReleaseEvictedFrameResources() override {
+    for (WriteLockedCachedFrame<FrameT>& lockedFrame : decodedFrameCache.LockEvictedCacheItems()) {
+      lockedFrame.GetFrame()->ReleaseResources();
+    }
+  }
+  
   virtual void CheckDecodingProgress(
       const NextFramesIterator& nextPlayedFramesIt,
       int* requiredFramesCount, int* readyFramesCount,
@@ -382,6 +591,10 @@ class XRVideoImpl : public XRVideo {
     decodedFrameCache.DebugPrintCacheHealth();
   }
   
+  virtual void SetExecutorPriority(bool isVisible, s64 bufferedNanoseconds) override {
+    decodingThread.SetExecutorPriority(isVisible, bufferedNanoseconds);
+  }
+  
   virtual void ClearLoadingThreadWorkQueues() override {
     // In case the reading thread is in its loop to read a range of frames, abort it.
     // If ClearLoadingThreadWorkQueues() is called for seeking, we hold the playbackState lock,
@@ -419,6 +632,59 @@ class XRVideoImpl : public XRVideo {
     transferThread.ClearQueue(/*finishAllTransfers*/ false);
   }
   
+  virtual void ClearIrrelevantLoadingThreadWork(const vector<u8>& frameIsRelevant) override {
+    // Abort the reading thread's current range of frames. Since we hold the playbackState lock,
+    // it will choose the frames to read anew for the seeked-to video time (see ClearLoadingThreadWorkQueues()).
+    readingThread.AbortCurrentFrames();
+    
+    // If none of the queued frames is relevant anymore, and the frames to read for the seeked-to video time
+    // do not continue the decoding chain after the last queued frame either, then clear everything. This also flushes dav1d,
+    // which stops decoding the frames that were already passed to it as soon as possible.
+    const int lastQueuedFrameIndex = videoThread.GetLastFrameIndexQueuedForDecoding();
+    const bool decodingChainContinues =
+        lastQueuedFrameIndex >= 0 && lastQueuedFrameIndex < static_cast<int>(frameIsRelevant.size()) &&
+        (frameIsRelevant[lastQueuedFrameIndex] || (lastQueuedFrameIndex + 1 < static_cast<int>(frameIsRelevant.size()) && frameIsRelevant[lastQueuedFrameIndex + 1]));
+    
+    if (!decodingChainContinues &&
+        !videoThread.HasRelevantQueuedFrame(frameIsRelevant) &&
+        !decodingThread.HasRelevantQueuedFrame(frameIsRelevant)) {
+      ClearLoadingThreadWorkQueues();
+      return;
+    }
+    
+    // Otherwise, only remove the frames after the last relevant one, retaining the frames before it
+    // (which are required to decode it), such that the decoding state remains consistent without flushing dav1d.
+    // Frames that the video thread already passed to dav1d cannot be removed anymore; if the last relevant frame
+    // is among them, all of the video thread's queued frames get removed.
+    // The reading thread continues after the last retained frame if the seeked-to frames follow it,
+    // or otherwise starts at a keyframe, which dav1d accepts at any time.
+    int lastRetainedFrameIndex;
+    const usize removedFrameCount = videoThread.RemoveQueuedFramesAfterLastRelevantOne(frameIsRelevant, &lastRetainedFrameIndex);
+    decodingThread.RemoveQueuedFramesAfterLastRelevantOne(removedFrameCount, lastRetainedFrameIndex, frameIsRelevant);
+    
+    // The transfer thread's queue only contains frames that are decoded already, so these are kept in any case.
+  }
+  
+  virtual void SetTargetRendition(int rendition) override {
+    readingThread.SetTargetRendition(rendition);
+  }
+  
+  virtual const vector<double>& GetRenditionBytesPerSecond() const override {
+    return readingThread.GetRenditionBytesPerSecond();
+  }
+  
+  virtual double GetLinkBytesPerSecond() override {
+    return readingThread.GetLinkBytesPerSecond();
+  }
+  
+  virtual s64 GetStreamingLookaheadNanoseconds() override {
+    return readingThread.GetStreamingLookaheadNanoseconds();
+  }
+  
+  virtual s64 ComputeStreamedNanoseconds(const NextFramesIterator& nextFramesIt, s64 maxNanoseconds) override {
+    return readingThread.ComputeStreamedNanoseconds(nextFramesIt, maxNanoseconds);
+  }
+  
   /// XRVideo frames
   DecodedFrameCache<FrameT> decodedFrameCache;
   vector<ReadLockedCachedFrame<FrameT>> framesLockedForRendering;
@@ -0,0 +1,139 @@
+#include "scan_studio/viewer_common/xrvideo/xrvideo_executor.hpp"
+
+#include <algorithm>
+
+#include <loguru.hpp>
+
+#include "scan_studio/viewer_common/util.hpp"
+
+namespace scan_studio {
+
+void XRVideoExecutorQueue::Submit(function<void()>&& task) {
+  {
+    lock_guard<mutex> lock(executor->executorMutex);
+    
+    tasks.PushBack(std::move(task));
+    if (tasks.Size() == 1 && !isRunning) {
+      executor->MakeRunnable(this);
+    }
+  }
+  executor->newTaskCondition.notify_one();
+}
+
+void XRVideoExecutorQueue::SetPriority(bool isVisible, s64 bufferedNanoseconds) {
+  lock_guard<mutex> lock(executor->executorMutex);
+  
+  this->isVisible = isVisible;
+  this->bufferedNanoseconds = bufferedNanoseconds;
+}
+
+void XRVideoExecutorQueue::CancelAndWait() {
+  unique_lock<mutex> lock(executor->executorMutex);
+  
+  if (!tasks.Empty() && !isRunning) {
+    auto& runnableQueues = executor->runnableQueues;
+    runnableQueues.erase(find(runnableQueues.begin(), runnableQueues.end(), this));
+  }
+  tasks.Clear();
+  
+  while (isRunning) {
+    executor->taskFinishedCondition.wait(lock);
+  }
+}
+
+bool XRVideoExecutorQueue::IsBusy() {
+  lock_guard<mutex> lock(executor->executorMutex);
+  return isRunning || !tasks.Empty();
+}
+
+
+XRVideoExecutor::~XRVideoExecutor() {
+  Destroy();
+}
+
+bool XRVideoExecutor::Initialize(int threadCount, int dav1dThreadCount) {
+  Destroy();
+  
+  if (threadCount <= 0) {
+    threadCount = std::max<int>(1, std::thread::hardware_concurrency());
+  }
+  
+  quitRequested = false;
+  this->dav1dThreadCount = std::max(1, dav1dThreadCount);
+  
+  for (int i = 0; i < threadCount; ++ i) {
+    workerThreads.emplace_back(&XRVideoExecutor::WorkerMain, this);
+  }
+  
+  return true;
+}
+
+void XRVideoExecutor::Destroy() {
+  {
+    lock_guard<mutex> lock(executorMutex);
+    quitRequested = true;
+    
+    if (!runnableQueues.empty()) {
+      LOG(ERROR) << "XRVideoExecutor::Destroy() called while videos still have queued tasks";
+      runnableQueues.clear();
+    }
+  }
+  newTaskCondition.notify_all();
+  
+  for (std::thread& thread : workerThreads) {
+    thread.join();
+  }
+  workerThreads.clear();
+}
+
+shared_ptr<XRVideoExecutorQueue> XRVideoExecutor::CreateQueue() {
+  return shared_ptr<XRVideoExecutorQueue>(new XRVideoExecutorQueue(this));
+}
+
+void XRVideoExecutor::WorkerMain() {
+  SCAN_STUDIO_SET_THREAD_NAME("scan-executor");
+  
+  unique_lock<mutex> lock(executorMutex);
+  
+  while (true) {
+    while (runnableQueues.empty() && !quitRequested) {
+      newTaskCondition.wait(lock);
+    }
+    if (quitRequested) {
+      break;
+    }
+    
+    // Take the next task of the queue with the highest priority
+    auto queueIt = runnableQueues.begin();
+    for (auto it = queueIt + 1; it != runnableQueues.end(); ++ it) {
+      if ((*it)->RunsBefore(**queueIt)) {
+        queueIt = it;
+      }
+    }
+    
+    XRVideoExecutorQueue* queue = *queueIt;
+    runnableQueues.erase(queueIt);
+    
+    function<void()> task = queue->tasks.PopFront();
+    queue->isRunning = true;
+    
+    lock.unlock();
+    task();
+    task = nullptr;  // destruct the task's captures before the queue may be released after CancelAndWait() returns
+    lock.lock();
+    
+    queue->isRunning = false;
+    if (!queue->tasks.Empty()) {
+      MakeRunnable(queue);
+      newTaskCondition.notify_one();
+    }
+    taskFinishedCondition.notify_all();
+  }
+}
+
+void XRVideoExecutor::MakeRunnable(XRVideoExecutorQueue* queue) {
+  queue->runnableSequenceNumber = nextRunnableSequenceNumber ++;
+  runnableQueues.push_back(queue);
+}
+
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <libvis/vulkan/libvis.h>
+
+#include "scan_studio/common/slot_queue.hpp"
+
+namespace scan_studio {
+using namespace vis;
+
+class XRVideoExecutor;
+
+/// Serial task queue of a single XRVideo on an XRVideoExecutor.
+///
+/// The tasks of a queue run one at a time, in the order in which they were submitted, but not necessarily always on the same thread.
+/// This keeps the ordering guarantees that the video's loading threads rely on.
+class XRVideoExecutorQueue {
+ friend class XRVideoExecutor;
+ public:
+  /// Queues the given task to run on the executor.
+  void Submit(function<void()>&& task);
+  
+  /// Sets the queue's scheduling priority. The executor runs the tasks of visible videos first,
+  /// and among these, those of the videos whose next not-yet-decoded frame will be needed soonest
+  /// (i.e., with the least duration of decoded frames ahead of their playback position).
+  void SetPriority(bool isVisible, s64 bufferedNanoseconds);
+  
+  /// Removes all tasks that have not started yet, and waits until the running task (if any) has finished.
+  void CancelAndWait();
+  
+  /// Returns true if the queue has a task that is queued or running.
+  bool IsBusy();
+  
+ private:
+  inline XRVideoExecutorQueue(XRVideoExecutor* executor)
+      : executor(executor) {}
+  
+  /// Returns true if this queue's tasks should run before those of the other queue. Requires the executor's mutex to be locked.
+  inline bool RunsBefore(const XRVideoExecutorQueue& other) const {
+    if (isVisible != other.isVisible) { return isVisible; }
+    if (bufferedNanoseconds != other.bufferedNanoseconds) { return bufferedNanoseconds < other.bufferedNanoseconds; }
+    return runnableSequenceNumber < other.runnableSequenceNumber;
+  }
+  
+  XRVideoExecutor* executor;  // not owned
+  
+  // The attributes below are protected by the executor's mutex.
+  SlotQueue<function<void()>> tasks;
+  bool isRunning = false;
+  bool isVisible = true;
+  s64 bufferedNanoseconds = 0;
+  
+  /// Sequence number at which the queue last became runnable, to alternate between queues with the same priority
+  u64 runnableSequenceNumber = 0;
+};
+
+/// Process-wide pool of worker threads that is shared by multiple XRVideos, for example, for scenes that show
+/// many videos at once. Instead of each video using its own decoding worker threads, the videos submit their
+/// decoding tasks to the executor (see XRVideo::SetExecutor()), which bounds the total number of decoding threads.
+/// Decoding tasks never block: they are only run once the frame's texture frame has arrived (see DecodingThread).
+///
+/// The other pipeline stages remain on own threads of each video, since they block, which would tie up the executor's workers:
+/// the reading thread blocks on file and network I/O, the video thread waits for the AV1 decoder's output,
+/// and the transfer thread waits for GPU fences (see TransferThread).
+///
+/// Each video has its own serial queue (XRVideoExecutorQueue). Whenever a worker becomes free, it takes the next task
+/// of the queue with the highest priority that is not running already. Since the tasks of a queue must run one at a time,
+/// a busy queue's tasks are never taken by a second worker; instead, the other workers continue with the other videos' queues.
+///
+/// Since dav1d cannot use an external thread pool, the executor also holds the number of threads
+/// that the dav1d context of each video using it should use (see GetDav1dThreadCount()).
+class XRVideoExecutor {
+ friend class XRVideoExecutorQueue;
+ public:
+  ~XRVideoExecutor();
+  
+  /// Starts the given number of worker threads (or one per logical processor if threadCount is zero).
+  /// dav1dThreadCount is the number of threads that each video's dav1d context should use.
+  bool Initialize(int threadCount, int dav1dThreadCount);
+  
+  /// Stops the worker threads. All videos that use the executor must have been destroyed before.
+  void Destroy();
+  
+  /// Creates a new queue for a video.
+  shared_ptr<XRVideoExecutorQueue> CreateQueue();
+  
+  inline int GetThreadCount() const { return static_cast<int>(workerThreads.size()); }
+  inline int GetDav1dThreadCount() const { return dav1dThreadCount; }
+  
+ private:
+  void WorkerMain();
+  
+  /// Adds the queue to the runnable queues. Requires `executorMutex` to be locked.
+  void MakeRunnable(XRVideoExecutorQueue* queue);
+  
+  mutex executorMutex;
+  condition_variable newTaskCondition;
+  
+  /// Signaled when a task finished running, for XRVideoExecutorQueue::CancelAndWait()
+  condition_variable taskFinishedCondition;
+  
+  /// Queues that have tasks and are not running (unordered; there are only few of them, so they are searched linearly)
+  vector<XRVideoExecutorQueue*> runnableQueues;
+  u64 nextRunnableSequenceNumber = 0;
+  
+  bool quitRequested = false;
+  int dav1dThreadCount = 4;
+  vector<std::thread> workerThreads;
+};
+
+}
@@ -0,0 +1,170 @@
+#include "scan_studio/viewer_common/xrvideo/xrvideo_memory_governor.hpp"
+
+#include <algorithm>
+
+#include <loguru.hpp>
+
+namespace scan_studio {
+
+XRVideoMemoryAccount::~XRVideoMemoryAccount() {
+  governor->Unregister(this);
+}
+
+void XRVideoMemoryAccount::SetSlotRange(int minSlotCount, int maxSlotCount) {
+  lock_guard<mutex> lock(governor->governorMutex);
+  
+  this->minSlotCount = std::max(3, minSlotCount);
+  this->maxSlotCount = std::max(this->minSlotCount, maxSlotCount);
+  governor->RebalanceLocked();
+}
+
+void XRVideoMemoryAccount::SetVisible(bool isVisible) {
+  lock_guard<mutex> lock(governor->governorMutex);
+  
+  if (this->isVisible != isVisible) {
+    this->isVisible = isVisible;
+    governor->RebalanceLocked();
+  }
+}
+
+void XRVideoMemoryAccount::SetSlotLimitChangedCallback(const std::function<void()>& callback) {
+  lock_guard<mutex> lock(governor->governorMutex);
+  slotLimitChangedCallback = callback;
+}
+
+
+void XRVideoMemoryGovernor::SetBudget(s64 bytes) {
+  lock_guard<mutex> lock(governorMutex);
+  
+  budgetBytes = bytes;
+  RebalanceLocked();
+}
+
+shared_ptr<XRVideoMemoryAccount> XRVideoMemoryGovernor::CreateAccount() {
+  shared_ptr<XRVideoMemoryAccount> account(new XRVideoMemoryAccount(this));
+  
+  lock_guard<mutex> lock(governorMutex);
+  accounts.push_back(account.get());
+  RebalanceLocked();
+  
+  return account;
+}
+
+void XRVideoMemoryGovernor::Rebalance() {
+  lock_guard<mutex> lock(governorMutex);
+  RebalanceLocked();
+}
+
+void XRVideoMemoryGovernor::RebalanceIfDue() {
+  constexpr double rebalanceIntervalSeconds = 0.1;
+  
+  lock_guard<mutex> lock(governorMutex);
+  
+  if (SecondsFromTo(lastRebalanceTime, Clock::now()) >= rebalanceIntervalSeconds) {
+    RebalanceLocked();
+  }
+}
+
+s64 XRVideoMemoryGovernor::GetCachedBytes() {
+  lock_guard<mutex> lock(governorMutex);
+  
+  s64 result = 0;
+  for (XRVideoMemoryAccount* account : accounts) {
+    result += account->cachedBytes;
+  }
+  return result;
+}
+
+void XRVideoMemoryGovernor::RebalanceLocked() {
+  lastRebalanceTime = Clock::now();
+  
+  const int accountCount = accounts.size();
+  
+  // Determine the size of a slot of each account from the account's cached frames.
+  // For accounts without cached frames, use the average size over all accounts. If that is not known either,
+  // bytesPerSlot is zero, and the account only gets its minimum slot count until its first frames got decoded.
+  s64 totalCachedBytes = 0;
+  s64 totalCachedFrameCount = 0;
+  for (XRVideoMemoryAccount* account : accounts) {
+    totalCachedBytes += account->cachedBytes;
+    totalCachedFrameCount += account->cachedFrameCount;
+  }
+  const s64 averageBytesPerSlot = (totalCachedFrameCount > 0) ? std::max<s64>(1, totalCachedBytes / totalCachedFrameCount) : 0;
+  
+  vector<s64> bytesPerSlot(accountCount);
+  vector<int> newSlotLimits(accountCount);
+  s64 remainingBytes = budgetBytes;
+  
+  for (int i = 0; i < accountCount; ++ i) {
+    const XRVideoMemoryAccount* account = accounts[i];
+    const int cachedFrameCount = account->cachedFrameCount;
+    bytesPerSlot[i] = (cachedFrameCount > 0) ? std::max<s64>(1, account->cachedBytes / cachedFrameCount) : averageBytesPerSlot;
+    
+    newSlotLimits[i] = account->minSlotCount;
+    remainingBytes -= account->minSlotCount * bytesPerSlot[i];
+  }
+  
+  // Distribute the remaining budget evenly, first among the visible accounts, then among the invisible ones
+  for (int pass = 0; pass < 2; ++ pass) {
+    const bool visible = (pass == 0);
+    
+    auto isUnsaturated = [&](int i) {
+      return accounts[i]->isVisible == visible && bytesPerSlot[i] > 0 && newSlotLimits[i] < accounts[i]->maxSlotCount;
+    };
+    
+    while (remainingBytes > 0) {
+      // Give each unsaturated account the same number of slots, as far as the budget suffices
+      s64 bytesPerRound = 0;
+      for (int i = 0; i < accountCount; ++ i) {
+        if (isUnsaturated(i)) { bytesPerRound += bytesPerSlot[i]; }
+      }
+      if (bytesPerRound == 0) {
+        break;
+      }
+      
+      const s64 slotsPerAccount = remainingBytes / bytesPerRound;
+      if (slotsPerAccount == 0) {
+        // The budget does not suffice for another slot for each account. Hand out single slots for as long as it lasts.
+        for (int i = 0; i < accountCount; ++ i) {
+          if (isUnsaturated(i) && bytesPerSlot[i] <= remainingBytes) {
+            ++ newSlotLimits[i];
+            remainingBytes -= bytesPerSlot[i];
+          }
+        }
+        break;
+      }
+      
+      for (int i = 0; i < accountCount; ++ i) {
+        if (isUnsaturated(i)) {
+          const int addedSlots = std::min<s64>(slotsPerAccount, accounts[i]->maxSlotCount - newSlotLimits[i]);
+          newSlotLimits[i] += addedSlots;
+          remainingBytes -= addedSlots * bytesPerSlot[i];
+        }
+      }
+    }
+  }
+  
+  for (int i = 0; i < accountCount; ++ i) {
+    XRVideoMemoryAccount* account = accounts[i];
+    const int oldSlotLimit = account->slotLimit.exchange(newSlotLimits[i]);
+    
+    if (newSlotLimits[i] != oldSlotLimit && account->slotLimitChangedCallback) {
+      account->slotLimitChangedCallback();
+    }
+  }
+}
+
+void XRVideoMemoryGovernor::Unregister(XRVideoMemoryAccount* account) {
+  lock_guard<mutex> lock(governorMutex);
+  
+  auto it = find(accounts.begin(), accounts.end(), account);
+  if (it == accounts.end()) {
+    LOG(ERROR) << "Attempting to unregister an XRVideoMemoryAccount that is not registered";
+    return;
+  }
+  accounts.erase(it);
+  
+  RebalanceLocked();
+}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <libvis/vulkan/libvis.h>
+
+#include "scan_studio/viewer_common/timing.hpp"
+
+namespace scan_studio {
+using namespace vis;
+
+class XRVideoMemoryGovernor;
+
+/// Account of a single video's decoded frame cache at an XRVideoMemoryGovernor.
+///
+/// The cache reports the decoded data sizes of the frames that enter and leave it, and limits the number of
+/// cache items that hold frames to the slot limit that the governor assigns to the account.
+class XRVideoMemoryAccount {
+ friend class XRVideoMemoryGovernor;
+ public:
+  /// Unregisters the account from its governor.
+  ~XRVideoMemoryAccount();
+  
+  /// Sets the range in which the governor chooses the account's slot limit.
+  /// minSlotCount is raised to 3 if smaller, since displaying a frame may require two other frames (its keyframe and predecessor),
+  /// and maxSlotCount should be the capacity of the video's decoded frame cache.
+  void SetSlotRange(int minSlotCount, int maxSlotCount);
+  
+  /// Sets whether the video is visible. The governor assigns the budget to visible videos first.
+  void SetVisible(bool isVisible);
+  
+  /// Sets a function that gets called (with the governor's mutex locked) whenever the slot limit changed.
+  /// If it was raised, the video may decode further frames, and if it was lowered, the video should evict frames
+  /// even if it is not decoding (e.g., while it is paused).
+  void SetSlotLimitChangedCallback(const std::function<void()>& callback);
+  
+  /// Called by the decoded frame cache when a decoded frame with the given data size enters the cache.
+  inline void AddCachedFrame(s64 bytes) {
+    cachedBytes += bytes;
+    ++ cachedFrameCount;
+  }
+  
+  /// Called by the decoded frame cache when a frame that was added with AddCachedFrame() leaves the cache.
+  inline void RemoveCachedFrame(s64 bytes) {
+    cachedBytes -= bytes;
+    -- cachedFrameCount;
+  }
+  
+  /// Returns the maximum number of decoded frames that the video's cache may hold.
+  inline int GetSlotLimit() const { return slotLimit; }
+  
+  /// Returns the total decoded data size of the frames in the video's cache.
+  inline s64 GetCachedBytes() const { return cachedBytes; }
+  
+  inline XRVideoMemoryGovernor* Governor() const { return governor; }
+  
+ private:
+  inline XRVideoMemoryAccount(XRVideoMemoryGovernor* governor)
+      : governor(governor) {}
+  
+  XRVideoMemoryGovernor* governor;  // not owned
+  
+  atomic<s64> cachedBytes = {0};
+  atomic<int> cachedFrameCount = {0};
+  atomic<int> slotLimit = {3};
+  
+  // The attributes below are protected by the governor's mutex.
+  int minSlotCount = 3;
+  int maxSlotCount = 3;
+  bool isVisible = true;
+  std::function<void()> slotLimitChangedCallback;
+};
+
+/// Process-wide budget for the decoded frames of multiple XRVideos (see XRVideo::SetMemoryGovernor()).
+///
+/// The governor assigns each video a slot limit, i.e., a maximum number of frames in its decoded frame cache,
+/// within the video's slot range. Each video first gets its minimum slot count. The remaining budget is then
+/// distributed evenly among the visible videos (one slot at a time, up to their maximum slot counts),
+/// and afterwards among the invisible ones. Since the frames of different videos differ in size,
+/// the budget is measured in bytes, using the average decoded data size of each video's cached frames.
+///
+/// The decoded frame cache applies a lowered slot limit by evicting the frames that will be played back last,
+/// and the video releases the resources of the evicted frames in its next XRVideo::Update(). The cache never evicts locked frames, which include the frames that the displayed frame depends on,
+/// so a video may exceed its slot limit (and thus the budget) temporarily.
+class XRVideoMemoryGovernor {
+ friend class XRVideoMemoryAccount;
+ public:
+  /// Creates a governor with the given budget in bytes.
+  inline XRVideoMemoryGovernor(s64 budgetBytes)
+      : budgetBytes(budgetBytes) {}
+  
+  /// Sets the budget in bytes and rebalances the slot limits.
+  void SetBudget(s64 bytes);
+  inline s64 GetBudget() const { return budgetBytes; }
+  
+  /// Creates an account for a video. The governor must remain valid until all its accounts are destroyed.
+  shared_ptr<XRVideoMemoryAccount> CreateAccount();
+  
+  /// Recomputes the slot limits of all accounts. This happens automatically when the accounts or the budget change.
+  void Rebalance();
+  
+  /// Rebalances if the last rebalancing was a while ago, such that the slot limits follow the changing sizes of the cached frames.
+  /// The videos call this in each XRVideo::Update().
+  void RebalanceIfDue();
+  
+  /// Returns the total decoded data size of the frames cached by all videos.
+  s64 GetCachedBytes();
+  
+ private:
+  /// Implementation of Rebalance(). Requires `governorMutex` to be locked.
+  void RebalanceLocked();
+  
+  void Unregister(XRVideoMemoryAccount* account);
+  
+  mutex governorMutex;
+  
+  s64 budgetBytes;
+  vector<XRVideoMemoryAccount*> accounts;
+  TimePoint lastRebalanceTime;
+};
+
+}